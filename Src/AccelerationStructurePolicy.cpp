@@ -0,0 +1,85 @@
+#include "AccelerationStructurePolicy.h"
+
+namespace
+{
+	MeshClass ClassifyMesh(const MeshBuildInfo& mesh, const AccelerationStructurePolicySettings& settings)
+	{
+		switch (mesh.mobility)
+		{
+		case MeshMobility::Deforming:
+			return MeshClass::Deformable;
+		case MeshMobility::Rebuilt:
+			return MeshClass::FrequentlyRebuilt;
+		default:
+			return mesh.triangleCount >= settings.heroTriangleCount ? MeshClass::StaticHero : MeshClass::StaticBackground;
+		}
+	}
+
+	uint32_t SelectBuildFlags(const MeshClass meshClass, const bool overBudget)
+	{
+		using namespace AccelerationStructureBuildFlags;
+
+		switch (meshClass)
+		{
+		case MeshClass::StaticHero:
+			return PreferFastTrace | AllowCompaction;
+		case MeshClass::StaticBackground:
+			return AllowCompaction | (overBudget ? MinimizeMemory : PreferFastTrace);
+		case MeshClass::Deformable:
+			// Refit every frame, so the build only happens once but updates must be allowed
+			return AllowUpdate | PreferFastBuild | (overBudget ? MinimizeMemory : None);
+		case MeshClass::FrequentlyRebuilt:
+			// Compaction needs a readback round trip, which is never worth it for a structure that is about to be rebuilt
+			return PreferFastBuild;
+		default:
+			return None;
+		}
+	}
+}
+
+AccelerationStructurePolicyReport PlanBottomLevelBuilds(const std::vector<MeshBuildInfo>& meshes, const AccelerationStructurePolicySettings& settings)
+{
+	AccelerationStructurePolicyReport report;
+
+	for (const MeshBuildInfo& mesh : meshes)
+	{
+		report.estimatedBytes += mesh.triangleCount * settings.estimatedBytesPerTriangle;
+	}
+
+	report.overBudget = report.estimatedBytes > settings.memoryBudget;
+	report.meshPlans.reserve(meshes.size());
+
+	for (const MeshBuildInfo& mesh : meshes)
+	{
+		const MeshClass meshClass = ClassifyMesh(mesh, settings);
+		report.meshPlans.push_back({ meshClass, SelectBuildFlags(meshClass, report.overBudget) });
+		report.classCounts[static_cast<size_t>(meshClass)]++;
+	}
+
+	return report;
+}
+
+uint32_t PlanTopLevelBuild(const size_t instanceCount, const bool hasMovingInstances, const AccelerationStructurePolicySettings& settings)
+{
+	using namespace AccelerationStructureBuildFlags;
+
+	const uint32_t speedFlag = instanceCount > settings.fastBuildInstanceCount ? PreferFastBuild : PreferFastTrace;
+	return speedFlag | (hasMovingInstances ? AllowUpdate : None);
+}
+
+const char* GetMeshClassName(const MeshClass meshClass)
+{
+	switch (meshClass)
+	{
+	case MeshClass::StaticHero:
+		return "static hero";
+	case MeshClass::StaticBackground:
+		return "static background";
+	case MeshClass::Deformable:
+		return "deformable";
+	case MeshClass::FrequentlyRebuilt:
+		return "frequently rebuilt";
+	default:
+		return "unknown";
+	}
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Mirrors D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS so that the policy does not depend on d3d12.h
+namespace AccelerationStructureBuildFlags
+{
+	enum : uint32_t
+	{
+		None				= 0x00,
+		AllowUpdate			= 0x01,
+		AllowCompaction		= 0x02,
+		PreferFastTrace		= 0x04,
+		PreferFastBuild		= 0x08,
+		MinimizeMemory		= 0x10
+	};
+}
+
+enum class MeshMobility
+{
+	Static,			// never changes after load
+	Deforming,		// vertices move every frame but the topology stays the same
+	Rebuilt			// topology changes, so the structure is built from scratch every time
+};
+
+enum class MeshClass
+{
+	StaticHero,
+	StaticBackground,
+	Deformable,
+	FrequentlyRebuilt,
+	Count
+};
+
+struct MeshBuildInfo
+{
+	uint64_t triangleCount;
+	MeshMobility mobility;
+};
+
+struct AccelerationStructurePolicySettings
+{
+	uint64_t heroTriangleCount = 20000;			// static meshes at least this big are worth the best trace performance
+	uint64_t estimatedBytesPerTriangle = 64;	// rough BLAS size before compaction, used against the budget
+	uint64_t memoryBudget = ~0ull;				// for all BLASes
+	uint64_t fastBuildInstanceCount = 4096;		// TLASes with more instances than this favour build speed
+};
+
+struct AccelerationStructureBuildPlan
+{
+	MeshClass meshClass;
+	uint32_t buildFlags;
+};
+
+struct AccelerationStructurePolicyReport
+{
+	std::vector<AccelerationStructureBuildPlan> meshPlans;
+	size_t classCounts[static_cast<size_t>(MeshClass::Count)] = {};
+	uint64_t estimatedBytes = 0;
+	bool overBudget = false;
+};
+
+// Classifies each mesh and picks its BLAS build flags. Static meshes are split into heroes and background by
+// triangle count. If the estimated size of all BLASes exceeds the memory budget, background meshes trade trace
+// speed for memory; heroes keep PREFER_FAST_TRACE either way.
+AccelerationStructurePolicyReport PlanBottomLevelBuilds(const std::vector<MeshBuildInfo>& meshes, const AccelerationStructurePolicySettings& settings);
+
+// Picks the TLAS build flags. A TLAS over moving instances is refit, so it needs ALLOW_UPDATE.
+uint32_t PlanTopLevelBuild(const size_t instanceCount, const bool hasMovingInstances, const AccelerationStructurePolicySettings& settings);
+
+const char* GetMeshClassName(const MeshClass meshClass);
@@ -0,0 +1,333 @@
+#include "AlphaClip.h"
+#include "TriangleOpacity.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	float Cross2(const Vec2& o, const Vec2& a, const Vec2& b)
+	{
+		return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+	}
+
+	float PolygonArea(const std::vector<Vec2>& poly)
+	{
+		float area = 0.f;
+		for (size_t i = 0; i < poly.size(); i++)
+		{
+			const Vec2& a = poly[i];
+			const Vec2& b = poly[(i + 1) % poly.size()];
+			area += a.x * b.y - b.x * a.y;
+		}
+
+		return 0.5f * area;
+	}
+
+	// Andrew's monotone chain, counter clockwise
+	std::vector<Vec2> ConvexHull(std::vector<Vec2> points)
+	{
+		std::sort(points.begin(), points.end(), [](const Vec2& a, const Vec2& b)
+		{
+			return a.x < b.x || (a.x == b.x && a.y < b.y);
+		});
+
+		if (points.size() < 3)
+		{
+			return points;
+		}
+
+		std::vector<Vec2> hull(2 * points.size());
+		size_t k = 0;
+
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			while (k >= 2 && Cross2(hull[k - 2], hull[k - 1], points[i]) <= 0.f)
+			{
+				k--;
+			}
+
+			hull[k++] = points[i];
+		}
+
+		for (size_t i = points.size() - 1, lowerSize = k + 1; i > 0; i--)
+		{
+			while (k >= lowerSize && Cross2(hull[k - 2], hull[k - 1], points[i - 1]) <= 0.f)
+			{
+				k--;
+			}
+
+			hull[k++] = points[i - 1];
+		}
+
+		hull.resize(k - 1);
+		return hull;
+	}
+
+	// Removes hull edges until at most maxVertices remain. Removing edge (i, i + 1) extends its two neighbouring edges
+	// until they meet, so the polygon only ever grows. Picks the edge that adds the least area each time.
+	bool ReduceHull(std::vector<Vec2>& hull, const size_t maxVertices)
+	{
+		while (hull.size() > maxVertices)
+		{
+			const size_t n = hull.size();
+			float bestArea = INFINITY;
+			size_t bestEdge = n;
+			Vec2 bestPoint = {};
+
+			for (size_t i = 0; i < n; i++)
+			{
+				const Vec2& prev = hull[(i + n - 1) % n];
+				const Vec2& a = hull[i];
+				const Vec2& b = hull[(i + 1) % n];
+				const Vec2& next = hull[(i + 2) % n];
+
+				const Vec2 d0 = { a.x - prev.x, a.y - prev.y };
+				const Vec2 d1 = { next.x - b.x, next.y - b.y };
+
+				// The neighbouring edges only meet outside the hull if they turn by less than 180 degrees in total
+				const float denom = d0.x * d1.y - d0.y * d1.x;
+				if (denom <= 1e-12f)
+				{
+					continue;
+				}
+
+				const float t = ((b.x - a.x) * d1.y - (b.y - a.y) * d1.x) / denom;
+				const Vec2 meet = { a.x + t * d0.x, a.y + t * d0.y };
+				const float addedArea = std::fabs(Cross2(a, meet, b)) * 0.5f;
+
+				if (addedArea < bestArea)
+				{
+					bestArea = addedArea;
+					bestEdge = i;
+					bestPoint = meet;
+				}
+			}
+
+			if (bestEdge == n)
+			{
+				return false;
+			}
+
+			hull[bestEdge] = bestPoint;
+			hull.erase(hull.begin() + (bestEdge + 1) % n);
+		}
+
+		return true;
+	}
+
+	// Sutherland-Hodgman against a counter clockwise triangle
+	std::vector<Vec2> ClipToTriangle(const std::vector<Vec2>& poly, const Vec2 tri[3])
+	{
+		std::vector<Vec2> result = poly;
+
+		for (int edge = 0; edge < 3 && !result.empty(); edge++)
+		{
+			const Vec2& a = tri[edge];
+			const Vec2& b = tri[(edge + 1) % 3];
+
+			std::vector<Vec2> input;
+			input.swap(result);
+
+			for (size_t i = 0; i < input.size(); i++)
+			{
+				const Vec2& p = input[i];
+				const Vec2& q = input[(i + 1) % input.size()];
+				const float dp = Cross2(a, b, p);
+				const float dq = Cross2(a, b, q);
+
+				if (dp >= 0.f)
+				{
+					result.push_back(p);
+				}
+
+				if ((dp >= 0.f) != (dq >= 0.f))
+				{
+					const float t = dp / (dp - dq);
+					result.push_back({ p.x + t * (q.x - p.x), p.y + t * (q.y - p.y) });
+				}
+			}
+		}
+
+		return result;
+	}
+
+	// Returns false if the triangle should be kept as it is
+	bool ClipTriangle(const OpacityMask& mask, const Vec2 uv[3], const AlphaClipSettings& settings, std::vector<Vec3>& outBarycentrics)
+	{
+		Vec2 tri[3];
+		for (int i = 0; i < 3; i++)
+		{
+			if (!std::isfinite(uv[i].x) || !std::isfinite(uv[i].y))
+			{
+				return false;
+			}
+
+			tri[i] = { uv[i].x * mask.width, uv[i].y * mask.height };
+		}
+
+		const float triArea = Cross2(tri[0], tri[1], tri[2]) * 0.5f;
+		if (std::fabs(triArea) < 1e-6f)
+		{
+			return false;
+		}
+
+		// Counter clockwise in texel space. The barycentrics are mapped back to the original vertex order below.
+		int order[3] = { 0, 1, 2 };
+		if (triArea < 0.f)
+		{
+			std::swap(order[1], order[2]);
+		}
+
+		const Vec2 ccwTri[3] = { tri[order[0]], tri[order[1]], tri[order[2]] };
+
+		// The outermost opaque texels of each row are enough to build the hull from
+		std::vector<Vec2> points;
+		int64_t rowY = INT64_MIN;
+		int64_t rowMinX = 0;
+		int64_t rowMaxX = 0;
+
+		auto flushRow = [&]()
+		{
+			if (rowY == INT64_MIN)
+			{
+				return;
+			}
+
+			// Bilinear footprint of the texels, as used by the classification
+			const float y0 = rowY - 0.5f;
+			const float y1 = rowY + 1.5f;
+			points.push_back({ rowMinX - 0.5f, y0 });
+			points.push_back({ rowMinX - 0.5f, y1 });
+			points.push_back({ rowMaxX + 1.5f, y0 });
+			points.push_back({ rowMaxX + 1.5f, y1 });
+		};
+
+		const bool scanned = ForEachFootprintTexel(ccwTri, [&](const int64_t x, const int64_t y)
+		{
+			if (mask.Fetch(x, y) < settings.alphaCutoff)
+			{
+				return true;
+			}
+
+			if (y != rowY)
+			{
+				flushRow();
+				rowY = y;
+				rowMinX = x;
+			}
+
+			rowMaxX = x;
+			return true;
+		});
+
+		flushRow();
+
+		if (!scanned || points.empty())
+		{
+			return false;
+		}
+
+		std::vector<Vec2> hull = ConvexHull(points);
+		if (hull.size() < 3 || !ReduceHull(hull, settings.maxHullVertices))
+		{
+			return false;
+		}
+
+		const std::vector<Vec2> clipped = ClipToTriangle(hull, ccwTri);
+		if (clipped.size() < 3)
+		{
+			return false;
+		}
+
+		const float clippedArea = PolygonArea(clipped);
+		if (clippedArea > (1.f - settings.minAreaReduction) * std::fabs(triArea))
+		{
+			return false;
+		}
+
+		// Barycentrics relative to the triangle in its original vertex order
+		outBarycentrics.clear();
+		for (const Vec2& p : clipped)
+		{
+			const float w1 = Cross2(tri[2], tri[0], p) / (2.f * triArea);
+			const float w2 = Cross2(tri[0], tri[1], p) / (2.f * triArea);
+			outBarycentrics.push_back({ 1.f - w1 - w2, w1, w2 });
+		}
+
+		// Keep the winding of the source triangle
+		if (triArea < 0.f)
+		{
+			std::reverse(outBarycentrics.begin(), outBarycentrics.end());
+		}
+
+		return true;
+	}
+
+	double TriangleArea(const Vec3& a, const Vec3& b, const Vec3& c)
+	{
+		return 0.5 * Length(Cross(b - a, c - a));
+	}
+}
+
+AlphaClipResult ClipAlphaTestedTriangles(
+	const OpacityMask& mask, 
+	const std::vector<Vec2>& uvs, 
+	const std::vector<Vec3>& positions, 
+	const std::vector<uint32_t>& indices, 
+	const size_t alphaTestedTriangleCount, 
+	const AlphaClipSettings& settings)
+{
+	AlphaClipResult result;
+	result.alphaTestedIndices.reserve(3 * alphaTestedTriangleCount);
+
+	const uint32_t vertexCount = static_cast<uint32_t>(positions.size());
+	std::vector<Vec3> barycentrics;
+
+	for (size_t triIdx = 0; triIdx < alphaTestedTriangleCount; triIdx++)
+	{
+		const uint32_t i0 = indices[3 * triIdx];
+		const uint32_t i1 = indices[3 * triIdx + 1];
+		const uint32_t i2 = indices[3 * triIdx + 2];
+
+		const double area = TriangleArea(positions[i0], positions[i1], positions[i2]);
+		result.areaBefore += area;
+
+		const Vec2 uv[3] = { uvs[i0], uvs[i1], uvs[i2] };
+		if (mask.texels.empty() || !ClipTriangle(mask, uv, settings, barycentrics))
+		{
+			result.alphaTestedIndices.insert(result.alphaTestedIndices.end(), { i0, i1, i2 });
+			result.areaAfter += area;
+			continue;
+		}
+
+		const uint32_t firstVertex = vertexCount + static_cast<uint32_t>(result.newVertices.size());
+		for (const Vec3& bary : barycentrics)
+		{
+			result.newVertices.push_back({ triIdx, bary });
+		}
+
+		// The clipped polygon is convex, so a fan will do
+		for (uint32_t i = 1; i + 1 < barycentrics.size(); i++)
+		{
+			result.alphaTestedIndices.insert(result.alphaTestedIndices.end(), { firstVertex, firstVertex + i, firstVertex + i + 1 });
+		}
+
+		// Barycentric interpolation is affine, so the area shrinks by the same ratio as in texture space
+		double polygonArea = 0.0;
+		for (size_t i = 1; i + 1 < barycentrics.size(); i++)
+		{
+			auto blend = [&](const Vec3& w)
+			{
+				return positions[i0] * w.x + positions[i1] * w.y + positions[i2] * w.z;
+			};
+
+			polygonArea += TriangleArea(blend(barycentrics[0]), blend(barycentrics[i]), blend(barycentrics[i + 1]));
+		}
+
+		result.areaAfter += polygonArea;
+		result.clippedTriangleCount++;
+	}
+
+	return result;
+}
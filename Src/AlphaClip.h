@@ -0,0 +1,44 @@
+#pragma once
+
+#include "CpuMath.h"
+#include "OpacityMask.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct AlphaClipSettings
+{
+	uint8_t alphaCutoff = 128;
+	uint32_t maxHullVertices = 6;		// the clipped polygon has at most this many vertices plus three
+	float minAreaReduction = 0.25f;		// triangles that would shrink by less than this are left alone
+};
+
+// A vertex created by the clip, as a blend of the three vertices of the triangle it was cut from
+struct AlphaClipVertex
+{
+	size_t sourceTriangle;
+	Vec3 barycentrics;
+};
+
+struct AlphaClipResult
+{
+	// Indices at or past the original vertex count refer to newVertices
+	std::vector<AlphaClipVertex> newVertices;
+	std::vector<uint32_t> alphaTestedIndices;
+	size_t clippedTriangleCount = 0;
+	double areaBefore = 0.0;
+	double areaAfter = 0.0;
+};
+
+// Shrinks the alpha tested triangles, which come first in the index list, to the opaque part of the mask. The
+// opaque texels inside each triangle are wrapped in a convex hull, the hull is reduced to a bounded number of
+// vertices by extending its edges, clipped to the triangle and fan triangulated. The result covers every texel
+// that can pass the alpha test, so nothing visible is lost. Areas are measured on the positions.
+AlphaClipResult ClipAlphaTestedTriangles(
+	const OpacityMask& mask, 
+	const std::vector<Vec2>& uvs, 
+	const std::vector<Vec3>& positions, 
+	const std::vector<uint32_t>& indices, 
+	const size_t alphaTestedTriangleCount, 
+	const AlphaClipSettings& settings);
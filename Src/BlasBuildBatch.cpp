@@ -0,0 +1,48 @@
+#include "BlasBuildBatch.h"
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+
+BlasBuildBatchPlan PlanBlasBuildBatches(const std::vector<uint64_t>& scratchSizes, const uint64_t arenaCapacity, const uint64_t alignment)
+{
+	BlasBuildBatchPlan plan;
+
+	auto alignSize = [alignment](const uint64_t size)
+	{
+		return (size + (alignment - 1)) & ~(alignment - 1);
+	};
+
+	// First fit decreasing
+	std::vector<size_t> order(scratchSizes.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&scratchSizes](const size_t a, const size_t b)
+	{
+		return scratchSizes[a] > scratchSizes[b];
+	});
+
+	// An oversized build grows the arena, in which case the other batches may as well make use of the extra space
+	const uint64_t capacity = order.empty() ? arenaCapacity : std::max(arenaCapacity, alignSize(scratchSizes[order.front()]));
+
+	for (const size_t buildIndex : order)
+	{
+		const uint64_t size = alignSize(scratchSizes[buildIndex]);
+
+		auto batchIt = std::find_if(plan.batches.begin(), plan.batches.end(), [size, capacity](const BlasBuildBatch& batch)
+		{
+			return batch.scratchUsed + size <= capacity;
+		});
+
+		if (batchIt == plan.batches.end())
+		{
+			plan.batches.emplace_back();
+			batchIt = std::prev(plan.batches.end());
+		}
+
+		batchIt->builds.push_back({ buildIndex, batchIt->scratchUsed });
+		batchIt->scratchUsed += size;
+		plan.arenaSize = std::max(plan.arenaSize, batchIt->scratchUsed);
+	}
+
+	return plan;
+}
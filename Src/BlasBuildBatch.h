@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct BlasBuildSlot
+{
+	size_t buildIndex;			// index into the scratch size list the plan was made from
+	uint64_t scratchOffset;		// offset into the shared scratch arena
+};
+
+struct BlasBuildBatch
+{
+	std::vector<BlasBuildSlot> builds;	// issued back to back, followed by a single UAV barrier
+	uint64_t scratchUsed = 0;
+};
+
+struct BlasBuildBatchPlan
+{
+	std::vector<BlasBuildBatch> batches;
+	uint64_t arenaSize = 0;				// scratch arena size needed to execute the plan
+};
+
+// Packs BLAS builds into as few batches as possible so that the builds of a batch use disjoint ranges of one
+// scratch arena of at most arenaCapacity bytes. Scratch is reused between batches, which is why a barrier is
+// needed after each one. A build whose scratch alone exceeds the capacity grows the arena to fit it.
+BlasBuildBatchPlan PlanBlasBuildBatches(const std::vector<uint64_t>& scratchSizes, const uint64_t arenaCapacity, const uint64_t alignment);
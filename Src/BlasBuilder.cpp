@@ -0,0 +1,131 @@
+#include "stdafx.h"
+#include "BlasBuilder.h"
+#include "BlasBuildBatch.h"
+
+void BlasBuilder::Init(ResourceHeap* scratchHeap, const size_t arenaCapacity)
+{
+	m_scratchHeap = scratchHeap;
+	m_arenaCapacity = arenaCapacity;
+}
+
+void BlasBuilder::Enqueue(
+	const D3D12_RAYTRACING_GEOMETRY_DESC* geometryDescs,
+	const uint32_t geometryCount,
+	const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags,
+	const uint64_t scratchSize,
+	const D3D12_GPU_VIRTUAL_ADDRESS destBLAS,
+	const D3D12_GPU_VIRTUAL_ADDRESS compactedSizeQuery)
+{
+	PendingBuild build;
+	build.geometryDescs.assign(geometryDescs, geometryDescs + geometryCount);
+	build.flags = flags;
+	build.scratchSize = scratchSize;
+	build.destBLAS = destBLAS;
+	build.compactedSizeQuery = compactedSizeQuery;
+
+	m_pendingBuilds.push_back(std::move(build));
+}
+
+void BlasBuilder::Flush(ID3D12Device5* device, ID3D12GraphicsCommandList4* cmdList)
+{
+	if (m_pendingBuilds.empty())
+	{
+		return;
+	}
+
+	std::vector<uint64_t> scratchSizes;
+	scratchSizes.reserve(m_pendingBuilds.size());
+	for (const PendingBuild& build : m_pendingBuilds)
+	{
+		scratchSizes.push_back(build.scratchSize);
+	}
+
+	const BlasBuildBatchPlan plan = PlanBlasBuildBatches(scratchSizes, m_arenaCapacity, D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT);
+	ReserveScratch(device, static_cast<size_t>(plan.arenaSize));
+
+	const D3D12_GPU_VIRTUAL_ADDRESS scratchBase = m_scratchArena->GetGPUVirtualAddress();
+
+	for (const BlasBuildBatch& batch : plan.batches)
+	{
+		for (const BlasBuildSlot& slot : batch.builds)
+		{
+			const PendingBuild& build = m_pendingBuilds[slot.buildIndex];
+
+			D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc{};
+			buildDesc.Inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_BOTTOM_LEVEL;
+			buildDesc.Inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+			buildDesc.Inputs.pGeometryDescs = build.geometryDescs.data();
+			buildDesc.Inputs.NumDescs = static_cast<UINT>(build.geometryDescs.size());
+			buildDesc.Inputs.Flags = build.flags;
+			buildDesc.ScratchAccelerationStructureData = scratchBase + slot.scratchOffset;
+			buildDesc.DestAccelerationStructureData = build.destBLAS;
+
+			D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_DESC postbuildInfoDesc{};
+			postbuildInfoDesc.InfoType = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE;
+			postbuildInfoDesc.DestBuffer = build.compactedSizeQuery;
+
+			cmdList->BuildRaytracingAccelerationStructure(&buildDesc, build.compactedSizeQuery != 0 ? 1 : 0, &postbuildInfoDesc);
+		}
+
+		// One barrier per batch. This makes the results visible and lets the next batch reuse the scratch arena.
+		D3D12_RESOURCE_BARRIER uavBarrier{};
+		uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+		uavBarrier.UAV.pResource = nullptr;
+		cmdList->ResourceBarrier(1, &uavBarrier);
+	}
+
+	std::wstring out = L"*** BLAS builds : " + std::to_wstring(m_pendingBuilds.size()) + L" builds in " + std::to_wstring(plan.batches.size()) +
+		L" batches, " + std::to_wstring(plan.arenaSize / 1024) + L" KB scratch\n";
+	OutputDebugString(out.c_str());
+
+	m_pendingBuilds.clear();
+}
+
+void BlasBuilder::ReleaseScratch()
+{
+	if (m_scratchArena)
+	{
+		m_scratchArena.Reset();
+		m_scratchHeap->Free(m_scratchArenaAlloc);
+		m_scratchArenaSize = 0;
+	}
+}
+
+void BlasBuilder::ReserveScratch(ID3D12Device5* device, const size_t sizeInBytes)
+{
+	// Reuse the arena from a previous flush if it is big enough. Callers flushing more than once must have waited
+	// on the GPU in between if the arena has to grow.
+	if (m_scratchArena && m_scratchArenaSize >= sizeInBytes)
+	{
+		return;
+	}
+
+	ReleaseScratch();
+
+	D3D12_RESOURCE_DESC scratchBufDesc = {};
+	scratchBufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	scratchBufDesc.Alignment = max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+	scratchBufDesc.Width = sizeInBytes;
+	scratchBufDesc.Height = 1;
+	scratchBufDesc.DepthOrArraySize = 1;
+	scratchBufDesc.MipLevels = 1;
+	scratchBufDesc.Format = DXGI_FORMAT_UNKNOWN;
+	scratchBufDesc.SampleDesc.Count = 1;
+	scratchBufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	scratchBufDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+	m_scratchArenaAlloc = m_scratchHeap->GetAlloc(scratchBufDesc.Width);
+	m_scratchArenaSize = sizeInBytes;
+
+	HRESULT hr = device->CreatePlacedResource(
+		m_scratchHeap->GetHeap(),
+		m_scratchArenaAlloc,
+		&scratchBufDesc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		nullptr,
+		IID_PPV_ARGS(m_scratchArena.GetAddressOf())
+	);
+
+	assert(SUCCEEDED(hr));
+	m_scratchArena->SetName(L"blas_scratch_arena");
+}
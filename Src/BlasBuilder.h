@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Common.h"
+#include "ResourceHeap.h"
+
+// Collects BLAS builds so that they can be issued back to back out of one shared scratch arena
+class BlasBuilder
+{
+public:
+	void Init(ResourceHeap* scratchHeap, const size_t arenaCapacity);
+
+	void Enqueue(
+		const D3D12_RAYTRACING_GEOMETRY_DESC* geometryDescs,
+		const uint32_t geometryCount,
+		const D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags,
+		const uint64_t scratchSize,
+		const D3D12_GPU_VIRTUAL_ADDRESS destBLAS,
+		const D3D12_GPU_VIRTUAL_ADDRESS compactedSizeQuery);
+
+	// Records all pending builds. The scratch arena stays in use until the command list has executed on the GPU.
+	void Flush(ID3D12Device5* device, ID3D12GraphicsCommandList4* cmdList);
+
+	// Must only be called once the GPU has finished executing the flushed builds
+	void ReleaseScratch();
+
+private:
+	void ReserveScratch(ID3D12Device5* device, const size_t sizeInBytes);
+
+private:
+	struct PendingBuild
+	{
+		std::vector<D3D12_RAYTRACING_GEOMETRY_DESC> geometryDescs;
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS flags;
+		uint64_t scratchSize;
+		D3D12_GPU_VIRTUAL_ADDRESS destBLAS;
+		D3D12_GPU_VIRTUAL_ADDRESS compactedSizeQuery;
+	};
+
+	std::vector<PendingBuild> m_pendingBuilds;
+
+	ResourceHeap* m_scratchHeap = nullptr;
+	size_t m_arenaCapacity = 0;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_scratchArena;
+	ResourceHeap::Alloc m_scratchArenaAlloc = 0;
+	size_t m_scratchArenaSize = 0;
+};
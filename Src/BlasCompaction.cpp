@@ -0,0 +1,51 @@
+#include "BlasCompaction.h"
+#include "HeapAllocator.h"
+
+#include <algorithm>
+#include <numeric>
+
+BlasCompactionPlan PlanBlasCompaction(const std::vector<BlasCompactionEntry>& entries, HeapAllocator& allocator, const size_t alignment)
+{
+	BlasCompactionPlan plan;
+
+	auto alignSize = [alignment](const uint64_t size) -> size_t
+	{
+		return static_cast<size_t>((size + (alignment - 1)) & ~static_cast<uint64_t>(alignment - 1));
+	};
+
+	// Place the biggest savings first so that they are the ones that still fit if the heap is nearly full
+	std::vector<size_t> order(entries.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&](const size_t a, const size_t b)
+	{
+		const size_t savingsA = entries[a].currentSize - std::min<size_t>(entries[a].currentSize, alignSize(entries[a].compactedSize));
+		const size_t savingsB = entries[b].currentSize - std::min<size_t>(entries[b].currentSize, alignSize(entries[b].compactedSize));
+		return savingsA > savingsB;
+	});
+
+	for (const size_t entryIndex : order)
+	{
+		const BlasCompactionEntry& entry = entries[entryIndex];
+		plan.bytesBefore += entry.currentSize;
+
+		// A zero size means the query was never written
+		const size_t compactedSize = alignSize(entry.compactedSize);
+		if (entry.compactedSize == 0 || compactedSize >= entry.currentSize)
+		{
+			plan.bytesAfter += entry.currentSize;
+			continue;
+		}
+
+		const size_t newOffset = allocator.Allocate(compactedSize, alignment);
+		if (newOffset == HeapAllocator::k_invalidOffset)
+		{
+			plan.bytesAfter += entry.currentSize;
+			continue;
+		}
+
+		plan.relocations.push_back({ entryIndex, newOffset, compactedSize });
+		plan.bytesAfter += compactedSize;
+	}
+
+	return plan;
+}
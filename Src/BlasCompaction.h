@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class HeapAllocator;
+
+struct BlasCompactionEntry
+{
+	size_t currentOffset;		// placement of the uncompacted BLAS in the heap
+	size_t currentSize;			// ResultDataMaxSizeInBytes (aligned) it was allocated with
+	uint64_t compactedSize;		// as reported by the COMPACTED_SIZE postbuild query
+};
+
+struct BlasRelocation
+{
+	size_t entryIndex;
+	size_t newOffset;
+	size_t newSize;
+};
+
+struct BlasCompactionPlan
+{
+	std::vector<BlasRelocation> relocations;
+	size_t bytesBefore = 0;
+	size_t bytesAfter = 0;
+};
+
+// Decides which BLASes are worth compacting and reserves a right-sized placement for each one from the allocator.
+// The original placements are left allocated since the compaction copy reads from them; the caller must free
+// them once the copies have completed on the GPU.
+BlasCompactionPlan PlanBlasCompaction(const std::vector<BlasCompactionEntry>& entries, HeapAllocator& allocator, const size_t alignment);
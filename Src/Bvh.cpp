@@ -0,0 +1,1307 @@
+#include "Bvh.h"
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+
+namespace
+{
+	// The top of the tree is split serially until there are this many subtrees per thread, or they get too small
+	constexpr size_t k_subtreesPerThread = 4;
+	constexpr uint32_t k_minParallelSubtreeSize = 4096;
+
+	float Component(const Vec3& v, const int axis)
+	{
+		return axis == 0 ? v.x : (axis == 1 ? v.y : v.z);
+	}
+
+	void SetComponent(Vec3& v, const int axis, const float value)
+	{
+		(axis == 0 ? v.x : (axis == 1 ? v.y : v.z)) = value;
+	}
+
+	// Bounds of the part of a triangle between two planes along an axis, empty if it is not between them
+	Aabb ClipTriangleBounds(const Vec3 vertices[3], const int axis, const float lower, const float upper)
+	{
+		Aabb bounds;
+		for (int i = 0; i < 3; i++)
+		{
+			const Vec3& a = vertices[i];
+			const Vec3& b = vertices[(i + 1) % 3];
+			const float pa = Component(a, axis);
+			const float pb = Component(b, axis);
+
+			if (pa >= lower && pa <= upper)
+			{
+				bounds.Grow(a);
+			}
+
+			// Where the edge crosses either plane, snapped onto the plane
+			for (const float plane : { lower, upper })
+			{
+				if ((pa < plane && pb > plane) || (pa > plane && pb < plane))
+				{
+					Vec3 p = a + (b - a) * ((plane - pa) / (pb - pa));
+					SetComponent(p, axis, plane);
+					bounds.Grow(p);
+				}
+			}
+		}
+
+		return bounds;
+	}
+
+	uint32_t SpatialBinIndex(const float p, const float origin, const float width, const uint32_t binCount)
+	{
+		return std::min<uint32_t>(binCount - 1, static_cast<uint32_t>((std::max)(0.f, (p - origin) / width)));
+	}
+
+	struct SpatialBin
+	{
+		Aabb bounds;
+		uint32_t entryCount = 0;	// references that start in the bin
+		uint32_t exitCount = 0;		// references that end in the bin
+	};
+
+	// Subtrees of the treelets the linear builder reorganizes. Karras and Aila use 7 on the GPU, but on the CPU 5 gets
+	// most of the way there in a third of the time, and more passes over smaller treelets do better for the same time.
+	constexpr uint32_t k_treeletSize = 5;
+
+	// Primitives counted and scattered by one task in each pass of the radix sort
+	constexpr size_t k_radixSortBlockSize = 16384;
+	constexpr uint32_t k_radixSortDigitBits = 8;
+	constexpr uint32_t k_radixSortDigitCount = 1u << k_radixSortDigitBits;
+
+	constexpr uint32_t k_noParent = UINT32_MAX;
+
+	struct MortonPrimitive
+	{
+		uint64_t code;
+		uint32_t index;
+	};
+
+	// Binary radix tree over the sorted primitives: primitiveCount - 1 interior nodes, interior node i splitting the
+	// primitives between i and i + 1 at first, followed by a leaf per primitive in Morton order
+	struct LinearNode
+	{
+		Aabb bounds;
+		uint32_t children[2];
+		uint32_t parent;
+		uint32_t primitiveCount;
+		uint32_t interiorCount;	// interior nodes of the subtree once it is flattened, none if it is collapsed
+		float cost;				// SAH cost of the subtree, not divided by the root area, with the subtrees that are cheaper as leaves collapsed
+	};
+
+	void ParallelForRange(TaskScheduler* scheduler, const size_t itemCount, const size_t grainSize, const std::function<void(size_t, size_t)>& body)
+	{
+		if (scheduler)
+		{
+			scheduler->ParallelFor(itemCount, grainSize, body);
+		}
+		else
+		{
+			body(0, itemCount);
+		}
+	}
+
+	// Spreads the low 21 bits of v out to every third bit
+	uint64_t ExpandMortonBits(uint64_t v)
+	{
+		v &= 0x1fffff;
+		v = (v | (v << 32)) & 0x001f00000000ffffull;
+		v = (v | (v << 16)) & 0x001f0000ff0000ffull;
+		v = (v | (v << 8)) & 0x100f00f00f00f00full;
+		v = (v | (v << 4)) & 0x10c30c30c30c30c3ull;
+		v = (v | (v << 2)) & 0x1249249249249249ull;
+		return v;
+	}
+
+	// Stable LSD radix sort of the low keyBits of the codes. Each pass counts the digits of a block of primitives per
+	// task and scatters the blocks in order, and is skipped when every primitive has the same digit.
+	void RadixSortMortonCodes(std::vector<MortonPrimitive>& primitives, const uint32_t keyBits, TaskScheduler* scheduler)
+	{
+		const size_t blockCount = (primitives.size() + k_radixSortBlockSize - 1) / k_radixSortBlockSize;
+		std::vector<MortonPrimitive> sorted(primitives.size());
+		std::vector<uint32_t> offsets(blockCount * k_radixSortDigitCount);
+
+		for (uint32_t shift = 0; shift < keyBits; shift += k_radixSortDigitBits)
+		{
+			ParallelForRange(scheduler, blockCount, 1, [&](const size_t begin, const size_t end)
+			{
+				for (size_t blockIdx = begin; blockIdx < end; blockIdx++)
+				{
+					uint32_t* counts = &offsets[blockIdx * k_radixSortDigitCount];
+					std::fill(counts, counts + k_radixSortDigitCount, 0);
+
+					const size_t blockEnd = (std::min)(primitives.size(), (blockIdx + 1) * k_radixSortBlockSize);
+					for (size_t i = blockIdx * k_radixSortBlockSize; i < blockEnd; i++)
+					{
+						counts[(primitives[i].code >> shift) & (k_radixSortDigitCount - 1)]++;
+					}
+				}
+			});
+
+			// Digit by digit, and block by block within a digit, which keeps the sort stable
+			uint32_t offset = 0;
+			bool bSingleDigit = false;
+			for (uint32_t digit = 0; digit < k_radixSortDigitCount; digit++)
+			{
+				const uint32_t digitBegin = offset;
+				for (size_t blockIdx = 0; blockIdx < blockCount; blockIdx++)
+				{
+					const uint32_t count = offsets[blockIdx * k_radixSortDigitCount + digit];
+					offsets[blockIdx * k_radixSortDigitCount + digit] = offset;
+					offset += count;
+				}
+
+				bSingleDigit |= offset - digitBegin == primitives.size();
+			}
+
+			if (bSingleDigit)
+			{
+				continue;
+			}
+
+			ParallelForRange(scheduler, blockCount, 1, [&](const size_t begin, const size_t end)
+			{
+				for (size_t blockIdx = begin; blockIdx < end; blockIdx++)
+				{
+					uint32_t* blockOffsets = &offsets[blockIdx * k_radixSortDigitCount];
+					const size_t blockEnd = (std::min)(primitives.size(), (blockIdx + 1) * k_radixSortBlockSize);
+					for (size_t i = blockIdx * k_radixSortBlockSize; i < blockEnd; i++)
+					{
+						sorted[blockOffsets[(primitives[i].code >> shift) & (k_radixSortDigitCount - 1)]++] = primitives[i];
+					}
+				}
+			});
+
+			primitives.swap(sorted);
+		}
+	}
+
+	float LeafCost(const LinearNode& node)
+	{
+		return node.bounds.SurfaceArea() * node.primitiveCount;
+	}
+
+	// Bounds and cost of an interior node from those of its children
+	void UpdateLinearNode(const uint32_t nodeIndex, const BvhBuildSettings& settings, std::vector<LinearNode>& nodes)
+	{
+		LinearNode& node = nodes[nodeIndex];
+		const LinearNode& left = nodes[node.children[0]];
+		const LinearNode& right = nodes[node.children[1]];
+
+		node.bounds = left.bounds;
+		node.bounds.Grow(right.bounds);
+		node.primitiveCount = left.primitiveCount + right.primitiveCount;
+		node.cost = settings.traversalCost * node.bounds.SurfaceArea() + left.cost + right.cost;
+		node.interiorCount = 1 + left.interiorCount + right.interiorCount;
+		if (node.primitiveCount <= settings.maxLeafSize && LeafCost(node) <= node.cost)
+		{
+			node.cost = LeafCost(node);
+			node.interiorCount = 0;
+		}
+	}
+
+	// Writes the primitives of a subtree in leaf order, returning the end of what it wrote. Only called on collapsed
+	// subtrees, so it does not recurse deeper than maxLeafSize.
+	uint32_t* GatherLeafPrimitives(
+		const std::vector<LinearNode>& nodes,
+		const std::vector<MortonPrimitive>& sorted,
+		const uint32_t nodeIndex,
+		uint32_t* outPrimitives)
+	{
+		const uint32_t firstLeaf = static_cast<uint32_t>(sorted.size()) - 1;
+		if (nodeIndex >= firstLeaf)
+		{
+			*outPrimitives = sorted[nodeIndex - firstLeaf].index;
+			return outPrimitives + 1;
+		}
+
+		return GatherLeafPrimitives(nodes, sorted, nodes[nodeIndex].children[1], GatherLeafPrimitives(nodes, sorted, nodes[nodeIndex].children[0], outPrimitives));
+	}
+
+	// Whether adjacent primitives a and a + 1 are split lower in the tree than b and b + 1, as they are if their codes
+	// differ in a lower bit. Equal codes are told apart by their positions, as if those were appended to the codes.
+	bool IsSplitLower(const std::vector<MortonPrimitive>& sorted, const uint32_t a, const uint32_t b)
+	{
+		const uint64_t differenceA = sorted[a].code ^ sorted[a + 1].code;
+		const uint64_t differenceB = sorted[b].code ^ sorted[b + 1].code;
+		return differenceA != differenceB ? differenceA < differenceB : (a ^ (a + 1)) < (b ^ (b + 1));
+	}
+
+	// Links up the radix tree over the leaves and sets the bounds and costs of its interior nodes in one pass, as in
+	// Apetrei, "Fast and Simple Agglomerative LBVH Construction". A thread walks up from each leaf, and a subtree covering
+	// a range of primitives becomes a child of the interior node at whichever end of the range is split lower. The first
+	// of the two children to get to a node leaves the end of its range there and stops, the second carries on with the
+	// whole range. Returns the root.
+	uint32_t BuildRadixTree(
+		const std::vector<MortonPrimitive>& sorted,
+		const BvhBuildSettings& settings,
+		std::vector<LinearNode>& nodes)
+	{
+		const uint32_t primitiveCount = static_cast<uint32_t>(sorted.size());
+		const uint32_t firstLeaf = primitiveCount - 1;
+
+		// One more than the end of the range of the child that got there first, zero until then
+		std::unique_ptr<std::atomic<uint32_t>[]> rangeEnds(new std::atomic<uint32_t>[firstLeaf]());
+
+		uint32_t root = 0;
+		ParallelForRange(settings.scheduler, primitiveCount, 1024, [&](const size_t begin, const size_t end)
+		{
+			for (size_t leafIdx = begin; leafIdx < end; leafIdx++)
+			{
+				uint32_t nodeIdx = firstLeaf + static_cast<uint32_t>(leafIdx);
+				uint32_t first = static_cast<uint32_t>(leafIdx);
+				uint32_t last = first;
+				while (first > 0 || last < firstLeaf)
+				{
+					// The left child of the interior node at the end of the range, or the right child of the one
+					// before its start
+					const bool bLeftChild = first == 0 || (last < firstLeaf && IsSplitLower(sorted, last, first - 1));
+					const uint32_t parentIdx = bLeftChild ? last : first - 1;
+					nodes[parentIdx].children[bLeftChild ? 0 : 1] = nodeIdx;
+					nodes[nodeIdx].parent = parentIdx;
+
+					const uint32_t otherEnd = rangeEnds[parentIdx].exchange((bLeftChild ? first : last) + 1, std::memory_order_acq_rel);
+					if (otherEnd == 0)
+					{
+						break;
+					}
+
+					if (bLeftChild)
+					{
+						last = otherEnd - 1;
+					}
+					else
+					{
+						first = otherEnd - 1;
+					}
+
+					UpdateLinearNode(parentIdx, settings, nodes);
+					nodeIdx = parentIdx;
+				}
+
+				if (first == 0 && last == firstLeaf)
+				{
+					root = nodeIdx;
+				}
+			}
+		});
+
+		nodes[root].parent = k_noParent;
+		return root;
+	}
+
+	// Calls visit(node) for every interior node of the radix tree after both of its children, in parallel. A thread
+	// walks up from each leaf and stops at the first node whose other child has not been visited yet, which is left
+	// to the thread that gets there second.
+	void VisitRadixTreeBottomUp(
+		std::vector<LinearNode>& nodes,
+		const uint32_t primitiveCount,
+		TaskScheduler* scheduler,
+		const std::function<void(uint32_t)>& visit)
+	{
+		const uint32_t firstLeaf = primitiveCount - 1;
+		std::unique_ptr<std::atomic<uint32_t>[]> arrivals(new std::atomic<uint32_t>[firstLeaf]());
+
+		ParallelForRange(scheduler, primitiveCount, 1024, [&](const size_t begin, const size_t end)
+		{
+			for (size_t leafIdx = begin; leafIdx < end; leafIdx++)
+			{
+				uint32_t nodeIdx = nodes[firstLeaf + leafIdx].parent;
+				while (nodeIdx != k_noParent && arrivals[nodeIdx].fetch_add(1, std::memory_order_acq_rel) == 1)
+				{
+					visit(nodeIdx);
+					nodeIdx = nodes[nodeIdx].parent;
+				}
+			}
+		});
+	}
+
+	// Replaces the treelet below root, the root and its descendants down to k_treeletSize subtrees, with the arrangement
+	// of the same subtrees that has the lowest SAH cost, found by dynamic programming over the subsets of the subtrees.
+	// The subtrees and the nodes above them are left as they are, the interior nodes of the treelet are reused.
+	void RestructureTreelet(const uint32_t root, const uint32_t firstLeaf, const BvhBuildSettings& settings, std::vector<LinearNode>& nodes)
+	{
+		// Grown from the root by opening up the largest subtree, which has the most to gain from a better arrangement
+		uint32_t subtrees[k_treeletSize] = { nodes[root].children[0], nodes[root].children[1] };
+		uint32_t interiors[k_treeletSize - 1] = { root };
+		uint32_t subtreeCount = 2;
+		uint32_t interiorCount = 1;
+		while (subtreeCount < k_treeletSize)
+		{
+			uint32_t largest = k_treeletSize;
+			float largestArea = -1.f;
+			for (uint32_t subtree = 0; subtree < subtreeCount; subtree++)
+			{
+				const float area = nodes[subtrees[subtree]].bounds.SurfaceArea();
+				if (subtrees[subtree] < firstLeaf && area > largestArea)
+				{
+					largest = subtree;
+					largestArea = area;
+				}
+			}
+
+			if (largest == k_treeletSize)
+			{
+				break;
+			}
+
+			const LinearNode& opened = nodes[subtrees[largest]];
+			interiors[interiorCount++] = subtrees[largest];
+			subtrees[largest] = opened.children[0];
+			subtrees[subtreeCount++] = opened.children[1];
+		}
+
+		if (subtreeCount < 3)
+		{
+			return;
+		}
+
+		// Subsets in increasing order, so that every subset comes after the ones it can be split into
+		const uint32_t subsetCount = 1u << subtreeCount;
+		Aabb bounds[1u << k_treeletSize];
+		float costs[1u << k_treeletSize];
+		uint32_t primitiveCounts[1u << k_treeletSize];
+		uint8_t partitions[1u << k_treeletSize];
+		for (uint32_t subset = 1; subset < subsetCount; subset++)
+		{
+			uint32_t lowest = 0;
+			while ((subset & (1u << lowest)) == 0)
+			{
+				lowest++;
+			}
+
+			const LinearNode& lowestSubtree = nodes[subtrees[lowest]];
+			const uint32_t rest = subset & (subset - 1);
+			if (rest == 0)
+			{
+				bounds[subset] = lowestSubtree.bounds;
+				costs[subset] = lowestSubtree.cost;
+				primitiveCounts[subset] = lowestSubtree.primitiveCount;
+				continue;
+			}
+
+			bounds[subset] = bounds[rest];
+			bounds[subset].Grow(lowestSubtree.bounds);
+			primitiveCounts[subset] = primitiveCounts[rest] + lowestSubtree.primitiveCount;
+
+			// Every split in two, once each by keeping the lowest subtree on the left
+			float bestCost = std::numeric_limits<float>::max();
+			for (uint32_t others = (rest - 1) & rest; ; others = (others - 1) & rest)
+			{
+				const uint32_t left = (1u << lowest) | others;
+				if (costs[left] + costs[subset ^ left] < bestCost)
+				{
+					bestCost = costs[left] + costs[subset ^ left];
+					partitions[subset] = static_cast<uint8_t>(left);
+				}
+
+				if (others == 0)
+				{
+					break;
+				}
+			}
+
+			const float area = bounds[subset].SurfaceArea();
+			costs[subset] = settings.traversalCost * area + bestCost;
+			if (primitiveCounts[subset] <= settings.maxLeafSize)
+			{
+				costs[subset] = (std::min)(costs[subset], area * primitiveCounts[subset]);
+			}
+		}
+
+		if (!(costs[subsetCount - 1] < nodes[root].cost))
+		{
+			return;
+		}
+
+		// Top down, taking the interior nodes in the order they were opened up, then bottom up for the new bounds
+		struct Pending
+		{
+			uint32_t subset;
+			uint32_t node;
+		};
+
+		Pending stack[k_treeletSize];
+		uint32_t stackSize = 0;
+		uint32_t order[k_treeletSize - 1];
+		uint32_t usedInteriorCount = 1;
+		stack[stackSize++] = { subsetCount - 1, root };
+		for (uint32_t orderIdx = 0; stackSize > 0; orderIdx++)
+		{
+			const Pending pending = stack[--stackSize];
+			order[orderIdx] = pending.node;
+
+			const uint32_t left = partitions[pending.subset];
+			const uint32_t sides[2] = { left, pending.subset ^ left };
+			for (uint32_t side = 0; side < 2; side++)
+			{
+				uint32_t child;
+				if ((sides[side] & (sides[side] - 1)) == 0)
+				{
+					uint32_t subtree = 0;
+					while (sides[side] != (1u << subtree))
+					{
+						subtree++;
+					}
+
+					child = subtrees[subtree];
+				}
+				else
+				{
+					child = interiors[usedInteriorCount++];
+					stack[stackSize++] = { sides[side], child };
+				}
+
+				nodes[pending.node].children[side] = child;
+				nodes[child].parent = pending.node;
+			}
+		}
+
+		for (uint32_t orderIdx = interiorCount; orderIdx-- > 0;)
+		{
+			UpdateLinearNode(order[orderIdx], settings, nodes);
+		}
+	}
+}
+
+void Bvh::Build(const std::vector<Aabb>& primitiveBounds, const BvhBuildSettings& settings)
+{
+	const uint32_t primitiveCount = static_cast<uint32_t>(primitiveBounds.size());
+
+	m_nodes.clear();
+	m_primitiveIndices.clear();
+
+	if (primitiveCount == 0)
+	{
+		return;
+	}
+
+	if (settings.builder == BvhBuilder::Linear)
+	{
+		BuildLinear(primitiveBounds, settings);
+		return;
+	}
+
+	// Partitioned in place of an index list, so that the passes over a node read memory in order
+	std::vector<BuildPrimitive> primitives(primitiveCount);
+	for (uint32_t i = 0; i < primitiveCount; i++)
+	{
+		primitives[i] = { primitiveBounds[i], primitiveBounds[i].Center(), i };
+	}
+
+	m_nodes.reserve(2 * primitiveCount);
+	m_nodes.push_back({});
+
+	const uint32_t threadCount = settings.scheduler != nullptr ? settings.scheduler->GetThreadCount() : 1;
+	if (threadCount == 1 || primitiveCount < 2 * k_minParallelSubtreeSize)
+	{
+		BuildSubtree({ 0, 0, primitiveCount }, settings, primitives, m_nodes);
+		StorePrimitiveIndices(primitives);
+		return;
+	}
+
+	// Split the top of the tree serially, largest node first, until there are enough subtrees to keep every thread
+	// busy. The subtrees are independent from there on since each one only touches its own range of primitives.
+	std::vector<Bin> bins(3 * settings.binCount);
+	std::vector<Aabb> rightBounds(settings.binCount);
+	std::vector<BuildTask> subtrees = { { 0, 0, primitiveCount } };
+	const size_t targetSubtreeCount = k_subtreesPerThread * threadCount;
+
+	auto bySize = [](const BuildTask& a, const BuildTask& b)
+	{
+		return a.end - a.begin < b.end - b.begin;
+	};
+
+	while (subtrees.size() < targetSubtreeCount)
+	{
+		auto largestIt = std::max_element(subtrees.begin(), subtrees.end(), bySize);
+		if (largestIt->end - largestIt->begin < k_minParallelSubtreeSize)
+		{
+			break;
+		}
+
+		const BuildTask task = *largestIt;
+		subtrees.erase(largestIt);
+
+		uint32_t mid;
+		if (SplitNode(task, settings, bins, rightBounds, primitives, m_nodes, mid))
+		{
+			const uint32_t leftIndex = m_nodes[task.nodeIndex].firstChildOrPrimitive;
+			subtrees.push_back({ leftIndex, task.begin, mid });
+			subtrees.push_back({ leftIndex + 1, mid, task.end });
+		}
+	}
+
+	// Build the biggest subtrees first so that the small ones fill in at the end
+	std::sort(subtrees.begin(), subtrees.end(), [&bySize](const BuildTask& a, const BuildTask& b) { return bySize(b, a); });
+
+	std::vector<std::vector<BvhNode>> subtreeNodes(subtrees.size());
+	settings.scheduler->ParallelFor(subtrees.size(), 1, [&](const size_t begin, const size_t end)
+	{
+		for (size_t subtreeIdx = begin; subtreeIdx < end; subtreeIdx++)
+		{
+			std::vector<BvhNode>& nodes = subtreeNodes[subtreeIdx];
+			nodes.reserve(2 * (subtrees[subtreeIdx].end - subtrees[subtreeIdx].begin));
+			nodes.push_back({});
+			BuildSubtree({ 0, subtrees[subtreeIdx].begin, subtrees[subtreeIdx].end }, settings, primitives, nodes);
+		}
+	});
+
+	// Splice the subtrees in. Each root takes the slot its parent reserved and the rest of its nodes are appended,
+	// so local node i > 0 ends up at base + i - 1.
+	for (size_t subtreeIdx = 0; subtreeIdx < subtrees.size(); subtreeIdx++)
+	{
+		const std::vector<BvhNode>& nodes = subtreeNodes[subtreeIdx];
+		const uint32_t base = static_cast<uint32_t>(m_nodes.size());
+
+		auto relocate = [base](BvhNode node)
+		{
+			if (!node.IsLeaf())
+			{
+				node.firstChildOrPrimitive += base - 1;
+			}
+
+			return node;
+		};
+
+		m_nodes[subtrees[subtreeIdx].nodeIndex] = relocate(nodes[0]);
+		for (size_t nodeIdx = 1; nodeIdx < nodes.size(); nodeIdx++)
+		{
+			m_nodes.push_back(relocate(nodes[nodeIdx]));
+		}
+	}
+
+	StorePrimitiveIndices(primitives);
+}
+
+void Bvh::Build(const std::vector<Vec3>& positions, const std::vector<uint32_t>& indices, const BvhBuildSettings& settings)
+{
+	if (settings.bSpatialSplits && settings.builder == BvhBuilder::BinnedSah)
+	{
+		BuildSpatial(positions, indices, settings);
+	}
+	else
+	{
+		Build(ComputeTriangleBounds(positions, indices), settings);
+	}
+}
+
+void Bvh::BuildSpatial(const std::vector<Vec3>& positions, const std::vector<uint32_t>& indices, const BvhBuildSettings& settings)
+{
+	m_nodes.clear();
+	m_primitiveIndices.clear();
+
+	const std::vector<Aabb> triangleBounds = ComputeTriangleBounds(positions, indices);
+	const uint32_t triangleCount = static_cast<uint32_t>(triangleBounds.size());
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// References are triangles, or the part of one on a side of the spatial splits above it. Each node owns a list of
+	// them, since a split can put the same triangle on both sides.
+	struct SpatialBuildTask
+	{
+		uint32_t nodeIndex;
+		std::vector<BuildPrimitive> references;
+	};
+
+	std::vector<SpatialBuildTask> stack(1);
+	stack[0].nodeIndex = 0;
+	stack[0].references.resize(triangleCount);
+	for (uint32_t i = 0; i < triangleCount; i++)
+	{
+		stack[0].references[i] = { triangleBounds[i], triangleBounds[i].Center(), i };
+	}
+
+	m_nodes.reserve(2 * triangleCount);
+	m_nodes.push_back({});
+	m_primitiveIndices.reserve(triangleCount);
+
+	Aabb rootBounds;
+	for (const Aabb& bounds : triangleBounds)
+	{
+		rootBounds.Grow(bounds);
+	}
+
+	const float rootArea = rootBounds.SurfaceArea();
+	size_t remainingDuplicates = static_cast<size_t>(settings.spatialSplitMaxGrowth * triangleCount);
+
+	const uint32_t binCount = settings.binCount;
+	std::vector<Bin> bins(3 * binCount);
+	std::vector<Aabb> rightBounds(binCount);
+	std::vector<SpatialBin> spatialBins(binCount);
+	std::vector<uint32_t> rightCounts(binCount);
+
+	auto getVertices = [&](const uint32_t triangle, Vec3 outVertices[3])
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			outVertices[k] = positions[indices[3 * triangle + k]];
+		}
+	};
+
+	while (!stack.empty())
+	{
+		SpatialBuildTask task = std::move(stack.back());
+		stack.pop_back();
+		std::vector<BuildPrimitive>& references = task.references;
+		const uint32_t referenceCount = static_cast<uint32_t>(references.size());
+
+		Aabb bounds;
+		Aabb centroidBounds;
+		for (const BuildPrimitive& reference : references)
+		{
+			bounds.Grow(reference.bounds);
+			centroidBounds.Grow(reference.centroid);
+		}
+
+		auto makeLeaf = [&]()
+		{
+			BvhNode& node = m_nodes[task.nodeIndex];
+			node.bounds = bounds;
+			node.firstChildOrPrimitive = static_cast<uint32_t>(m_primitiveIndices.size());
+			node.primitiveCount = referenceCount;
+			for (const BuildPrimitive& reference : references)
+			{
+				m_primitiveIndices.push_back(reference.index);
+			}
+		};
+
+		if (referenceCount <= 1)
+		{
+			makeLeaf();
+			continue;
+		}
+
+		const float leafCost = static_cast<float>(referenceCount) * bounds.SurfaceArea();
+		const ObjectSplit objectSplit = FindObjectSplit(references.data(), referenceCount, bounds, centroidBounds, settings, bins, rightBounds);
+
+		// Spatial splits only pay off where the children of an object split would overlap a lot, and cost a pass that
+		// clips every reference, so only try them there
+		float spatialCost = FLT_MAX;
+		int spatialAxis = -1;
+		uint32_t spatialBin = 0;
+		float binOrigin[3];
+		float binWidth[3];
+		const float overlapArea = objectSplit.axis >= 0 ? Intersection(objectSplit.leftBounds, objectSplit.rightBounds).SurfaceArea() : bounds.SurfaceArea();
+		if (remainingDuplicates > 0 && overlapArea > settings.spatialSplitMinOverlap * rootArea)
+		{
+			for (int axis = 0; axis < 3; axis++)
+			{
+				binOrigin[axis] = Component(bounds.lower, axis);
+				binWidth[axis] = (Component(bounds.upper, axis) - binOrigin[axis]) / binCount;
+				if (!(binWidth[axis] > 0.f))
+				{
+					continue;
+				}
+
+				std::fill(spatialBins.begin(), spatialBins.end(), SpatialBin{});
+				for (const BuildPrimitive& reference : references)
+				{
+					const uint32_t firstBin = SpatialBinIndex(Component(reference.bounds.lower, axis), binOrigin[axis], binWidth[axis], binCount);
+					const uint32_t lastBin = (std::max)(firstBin, SpatialBinIndex(Component(reference.bounds.upper, axis), binOrigin[axis], binWidth[axis], binCount));
+
+					Vec3 vertices[3];
+					getVertices(reference.index, vertices);
+					for (uint32_t b = firstBin; b <= lastBin; b++)
+					{
+						// Only the inner planes cut, the outer ones of the first and last bin are those of the reference
+						const float lower = b == firstBin ? -FLT_MAX : binOrigin[axis] + b * binWidth[axis];
+						const float upper = b == lastBin ? FLT_MAX : binOrigin[axis] + (b + 1) * binWidth[axis];
+						const Aabb part = Intersection(ClipTriangleBounds(vertices, axis, lower, upper), reference.bounds);
+						if (!part.IsEmpty())
+						{
+							spatialBins[b].bounds.Grow(part);
+						}
+					}
+
+					spatialBins[firstBin].entryCount++;
+					spatialBins[lastBin].exitCount++;
+				}
+
+				Aabb accumulated;
+				uint32_t rightCount = 0;
+				for (uint32_t b = binCount - 1; b > 0; b--)
+				{
+					accumulated.Grow(spatialBins[b].bounds);
+					rightCount += spatialBins[b].exitCount;
+					rightBounds[b] = accumulated;
+					rightCounts[b] = rightCount;
+				}
+
+				accumulated = Aabb{};
+				uint32_t leftCount = 0;
+				for (uint32_t b = 0; b + 1 < binCount; b++)
+				{
+					accumulated.Grow(spatialBins[b].bounds);
+					leftCount += spatialBins[b].entryCount;
+					if (leftCount == 0 || rightCounts[b + 1] == 0)
+					{
+						continue;
+					}
+
+					const float cost = settings.traversalCost * bounds.SurfaceArea() + leftCount * accumulated.SurfaceArea() + rightCounts[b + 1] * rightBounds[b + 1].SurfaceArea();
+					if (cost < spatialCost)
+					{
+						spatialCost = cost;
+						spatialAxis = axis;
+						spatialBin = b;
+					}
+				}
+			}
+		}
+
+		const bool bObjectSplit = objectSplit.axis >= 0 && objectSplit.cost < leafCost && objectSplit.cost <= spatialCost;
+		const bool bSpatialSplit = !bObjectSplit && spatialAxis >= 0 && spatialCost < leafCost;
+
+		// Keep a leaf if no split beats it, unless it is too big
+		if (!bObjectSplit && !bSpatialSplit && referenceCount <= settings.maxLeafSize)
+		{
+			makeLeaf();
+			continue;
+		}
+
+		std::vector<BuildPrimitive> leftReferences;
+		std::vector<BuildPrimitive> rightReferences;
+		size_t duplicateCount = 0;
+		if (bSpatialSplit)
+		{
+			const int axis = spatialAxis;
+			const float plane = binOrigin[axis] + (spatialBin + 1) * binWidth[axis];
+
+			// References on one side go there whole. Those across the plane are sorted out after, once the bounds of
+			// both sides are known.
+			Aabb leftChildBounds;
+			Aabb rightChildBounds;
+			std::vector<BuildPrimitive> straddling;
+			for (const BuildPrimitive& reference : references)
+			{
+				if (SpatialBinIndex(Component(reference.bounds.upper, axis), binOrigin[axis], binWidth[axis], binCount) <= spatialBin)
+				{
+					leftReferences.push_back(reference);
+					leftChildBounds.Grow(reference.bounds);
+				}
+				else if (SpatialBinIndex(Component(reference.bounds.lower, axis), binOrigin[axis], binWidth[axis], binCount) > spatialBin)
+				{
+					rightReferences.push_back(reference);
+					rightChildBounds.Grow(reference.bounds);
+				}
+				else
+				{
+					straddling.push_back(reference);
+				}
+			}
+
+			// Clipping a reference costs memory, and a duplicate is not always worth it. Like the paper, compare the
+			// split with moving the whole reference to either side and take the cheapest.
+			uint32_t leftCount = static_cast<uint32_t>(leftReferences.size() + straddling.size());
+			uint32_t rightCount = static_cast<uint32_t>(rightReferences.size() + straddling.size());
+			std::vector<Aabb> leftParts(straddling.size());
+			std::vector<Aabb> rightParts(straddling.size());
+			for (size_t i = 0; i < straddling.size(); i++)
+			{
+				Vec3 vertices[3];
+				getVertices(straddling[i].index, vertices);
+				leftParts[i] = Intersection(ClipTriangleBounds(vertices, axis, -FLT_MAX, plane), straddling[i].bounds);
+				rightParts[i] = Intersection(ClipTriangleBounds(vertices, axis, plane, FLT_MAX), straddling[i].bounds);
+				if (!leftParts[i].IsEmpty() && !rightParts[i].IsEmpty())
+				{
+					leftChildBounds.Grow(leftParts[i]);
+					rightChildBounds.Grow(rightParts[i]);
+				}
+			}
+
+			for (size_t i = 0; i < straddling.size(); i++)
+			{
+				const BuildPrimitive& reference = straddling[i];
+				const float splitCost = leftChildBounds.SurfaceArea() * leftCount + rightChildBounds.SurfaceArea() * rightCount;
+				const float leftOnlyCost = Union(leftChildBounds, reference.bounds).SurfaceArea() * leftCount + rightChildBounds.SurfaceArea() * (rightCount - 1);
+				const float rightOnlyCost = leftChildBounds.SurfaceArea() * (leftCount - 1) + Union(rightChildBounds, reference.bounds).SurfaceArea() * rightCount;
+
+				const bool bCanSplit = duplicateCount < remainingDuplicates && !leftParts[i].IsEmpty() && !rightParts[i].IsEmpty();
+				if (bCanSplit && splitCost < leftOnlyCost && splitCost < rightOnlyCost)
+				{
+					leftReferences.push_back({ leftParts[i], leftParts[i].Center(), reference.index });
+					rightReferences.push_back({ rightParts[i], rightParts[i].Center(), reference.index });
+					duplicateCount++;
+				}
+				else if (leftOnlyCost <= rightOnlyCost)
+				{
+					leftReferences.push_back(reference);
+					leftChildBounds.Grow(reference.bounds);
+					rightCount--;
+				}
+				else
+				{
+					rightReferences.push_back(reference);
+					rightChildBounds.Grow(reference.bounds);
+					leftCount--;
+				}
+			}
+		}
+
+		// A spatial split that leaves a side with everything has not made progress, so fall back to an object split
+		if (!bSpatialSplit || leftReferences.size() == referenceCount || rightReferences.size() == referenceCount)
+		{
+			duplicateCount = 0;
+			leftReferences.clear();
+			rightReferences.clear();
+			if (objectSplit.axis >= 0 && (bObjectSplit || bSpatialSplit))
+			{
+				for (const BuildPrimitive& reference : references)
+				{
+					(objectSplit.IsLeft(reference.centroid, binCount) ? leftReferences : rightReferences).push_back(reference);
+				}
+			}
+			else
+			{
+				// All centroids coincide, or splitting doesn't pay off but the leaf is too large. Split in the middle.
+				leftReferences.assign(references.begin(), references.begin() + referenceCount / 2);
+				rightReferences.assign(references.begin() + referenceCount / 2, references.end());
+			}
+		}
+
+		remainingDuplicates -= duplicateCount;
+
+		const uint32_t leftIndex = static_cast<uint32_t>(m_nodes.size());
+		BvhNode& node = m_nodes[task.nodeIndex];
+		node.bounds = bounds;
+		node.firstChildOrPrimitive = leftIndex;
+		node.primitiveCount = 0;
+		m_nodes.push_back({});
+		m_nodes.push_back({});
+
+		references.clear();
+		references.shrink_to_fit();
+		stack.push_back({ leftIndex + 1, std::move(rightReferences) });
+		stack.push_back({ leftIndex, std::move(leftReferences) });
+	}
+}
+
+void Bvh::BuildLinear(const std::vector<Aabb>& primitiveBounds, const BvhBuildSettings& settings)
+{
+	const uint32_t primitiveCount = static_cast<uint32_t>(primitiveBounds.size());
+	const uint32_t firstLeaf = primitiveCount - 1;
+	TaskScheduler* scheduler = settings.scheduler;
+	const size_t blockCount = (primitiveCount + k_radixSortBlockSize - 1) / k_radixSortBlockSize;
+
+	// Morton codes of the centroids within their bounds
+	std::vector<Aabb> blockCentroidBounds(blockCount);
+	ParallelForRange(scheduler, blockCount, 1, [&](const size_t begin, const size_t end)
+	{
+		for (size_t blockIdx = begin; blockIdx < end; blockIdx++)
+		{
+			const size_t blockEnd = (std::min<size_t>)(primitiveCount, (blockIdx + 1) * k_radixSortBlockSize);
+			for (size_t i = blockIdx * k_radixSortBlockSize; i < blockEnd; i++)
+			{
+				blockCentroidBounds[blockIdx].Grow(primitiveBounds[i].Center());
+			}
+		}
+	});
+
+	Aabb centroidBounds;
+	for (const Aabb& bounds : blockCentroidBounds)
+	{
+		centroidBounds.Grow(bounds);
+	}
+
+	const uint32_t bitsPerAxis = settings.bWideMortonCodes ? 21 : 10;
+	const float cellCount = static_cast<float>(1u << bitsPerAxis);
+	const Vec3 extent = centroidBounds.Extent();
+	const Vec3 scale = {
+		extent.x > 0.f ? cellCount / extent.x : 0.f,
+		extent.y > 0.f ? cellCount / extent.y : 0.f,
+		extent.z > 0.f ? cellCount / extent.z : 0.f };
+
+	auto quantize = [cellCount](const float p, const float lower, const float axisScale)
+	{
+		const float q = (p - lower) * axisScale;
+		return q > 0.f ? static_cast<uint64_t>((std::min)(q, cellCount - 1.f)) : 0;
+	};
+
+	std::vector<MortonPrimitive> sorted(primitiveCount);
+	ParallelForRange(scheduler, primitiveCount, 4096, [&](const size_t begin, const size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const Vec3 centroid = primitiveBounds[i].Center();
+			sorted[i].code =
+				ExpandMortonBits(quantize(centroid.x, centroidBounds.lower.x, scale.x)) |
+				(ExpandMortonBits(quantize(centroid.y, centroidBounds.lower.y, scale.y)) << 1) |
+				(ExpandMortonBits(quantize(centroid.z, centroidBounds.lower.z, scale.z)) << 2);
+			sorted[i].index = static_cast<uint32_t>(i);
+		}
+	});
+
+	RadixSortMortonCodes(sorted, 3 * bitsPerAxis, scheduler);
+
+	// Leaves, then the interior nodes from the bottom up
+	std::vector<LinearNode> nodes(2 * static_cast<size_t>(primitiveCount) - 1);
+	ParallelForRange(scheduler, primitiveCount, 4096, [&](const size_t begin, const size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			LinearNode& leaf = nodes[firstLeaf + i];
+			leaf.bounds = primitiveBounds[sorted[i].index];
+			leaf.primitiveCount = 1;
+			leaf.interiorCount = 0;
+			leaf.cost = LeafCost(leaf);
+		}
+	});
+
+	const uint32_t root = BuildRadixTree(sorted, settings, nodes);
+
+	// Each pass only reorganizes the treelets of subtrees with twice as many primitives as the last, which leaves the
+	// bottom of the tree, where there is the least to gain, to the first pass
+	for (uint32_t pass = 0; pass < settings.treeletPassCount && primitiveCount > 2; pass++)
+	{
+		const uint32_t minPrimitiveCount = k_treeletSize << pass;
+		VisitRadixTreeBottomUp(nodes, primitiveCount, scheduler, [&](const uint32_t nodeIdx)
+		{
+			if (nodes[nodeIdx].primitiveCount >= minPrimitiveCount)
+			{
+				RestructureTreelet(nodeIdx, firstLeaf, settings, nodes);
+			}
+		});
+	}
+
+	// Into the layout of the binned build, children next to each other and primitives in leaf order. The descendants
+	// of a node come right after its children, first those of the left child and then those of the right, so every
+	// subtree knows where its nodes and primitives go and they can be written in parallel.
+	struct FlattenTask
+	{
+		uint32_t linearNode;
+		uint32_t node;
+		uint32_t firstDescendant;
+		uint32_t firstPrimitive;
+	};
+
+	m_nodes.resize(1 + 2 * static_cast<size_t>(nodes[root].interiorCount));
+	m_primitiveIndices.resize(primitiveCount);
+
+	// Writes the node of a task, and returns false if it is a leaf or the tasks of its children otherwise
+	auto flattenNode = [&](const FlattenTask& task, FlattenTask outChildren[2])
+	{
+		const LinearNode& linearNode = nodes[task.linearNode];
+		if (linearNode.interiorCount == 0)
+		{
+			m_nodes[task.node] = { linearNode.bounds, task.firstPrimitive, linearNode.primitiveCount };
+			GatherLeafPrimitives(nodes, sorted, task.linearNode, &m_primitiveIndices[task.firstPrimitive]);
+			return false;
+		}
+
+		const LinearNode& left = nodes[linearNode.children[0]];
+		m_nodes[task.node] = { linearNode.bounds, task.firstDescendant, 0 };
+		outChildren[0] = { linearNode.children[0], task.firstDescendant, task.firstDescendant + 2, task.firstPrimitive };
+		outChildren[1] = {
+			linearNode.children[1],
+			task.firstDescendant + 1,
+			task.firstDescendant + 2 + 2 * left.interiorCount,
+			task.firstPrimitive + left.primitiveCount };
+		return true;
+	};
+
+	// Split serially, largest subtree first, until there are enough to keep every thread busy
+	const uint32_t threadCount = scheduler != nullptr ? scheduler->GetThreadCount() : 1;
+	std::vector<FlattenTask> subtrees = { { root, 0, 1, 0 } };
+	auto bySize = [&nodes](const FlattenTask& a, const FlattenTask& b)
+	{
+		return nodes[a.linearNode].primitiveCount < nodes[b.linearNode].primitiveCount;
+	};
+
+	while (threadCount > 1 && subtrees.size() < k_subtreesPerThread * threadCount)
+	{
+		auto largestIt = std::max_element(subtrees.begin(), subtrees.end(), bySize);
+		if (nodes[largestIt->linearNode].primitiveCount < k_minParallelSubtreeSize)
+		{
+			break;
+		}
+
+		const FlattenTask task = *largestIt;
+		subtrees.erase(largestIt);
+
+		FlattenTask children[2];
+		if (flattenNode(task, children))
+		{
+			subtrees.push_back(children[0]);
+			subtrees.push_back(children[1]);
+		}
+	}
+
+	ParallelForRange(scheduler, subtrees.size(), 1, [&](const size_t begin, const size_t end)
+	{
+		std::vector<FlattenTask> stack;
+		for (size_t subtreeIdx = begin; subtreeIdx < end; subtreeIdx++)
+		{
+			stack.push_back(subtrees[subtreeIdx]);
+			while (!stack.empty())
+			{
+				const FlattenTask task = stack.back();
+				stack.pop_back();
+
+				FlattenTask children[2];
+				if (flattenNode(task, children))
+				{
+					stack.push_back(children[1]);
+					stack.push_back(children[0]);
+				}
+			}
+		}
+	});
+}
+
+void Bvh::StorePrimitiveIndices(const std::vector<BuildPrimitive>& primitives)
+{
+	m_primitiveIndices.resize(primitives.size());
+	for (size_t i = 0; i < primitives.size(); i++)
+	{
+		m_primitiveIndices[i] = primitives[i].index;
+	}
+}
+
+void Bvh::BuildSubtree(
+	const BuildTask& root, 
+	const BvhBuildSettings& settings, 
+	std::vector<BuildPrimitive>& primitives, 
+	std::vector<BvhNode>& nodes)
+{
+	std::vector<BuildTask> stack = { root };
+	std::vector<Bin> bins(3 * settings.binCount);
+	std::vector<Aabb> rightBounds(settings.binCount);
+
+	while (!stack.empty())
+	{
+		const BuildTask task = stack.back();
+		stack.pop_back();
+
+		uint32_t mid;
+		if (SplitNode(task, settings, bins, rightBounds, primitives, nodes, mid))
+		{
+			const uint32_t leftIndex = nodes[task.nodeIndex].firstChildOrPrimitive;
+			stack.push_back({ leftIndex + 1, mid, task.end });
+			stack.push_back({ leftIndex, task.begin, mid });
+		}
+	}
+}
+
+bool Bvh::SplitNode(
+	const BuildTask& task, 
+	const BvhBuildSettings& settings, 
+	std::vector<Bin>& bins, 
+	std::vector<Aabb>& rightBounds, 
+	std::vector<BuildPrimitive>& primitives, 
+	std::vector<BvhNode>& nodes, 
+	uint32_t& outMid)
+{
+	Aabb bounds;
+	Aabb centroidBounds;
+	for (uint32_t i = task.begin; i < task.end; i++)
+	{
+		bounds.Grow(primitives[i].bounds);
+		centroidBounds.Grow(primitives[i].centroid);
+	}
+
+	BvhNode& node = nodes[task.nodeIndex];
+	node.bounds = bounds;
+	node.firstChildOrPrimitive = task.begin;
+	node.primitiveCount = task.end - task.begin;
+
+	if (node.primitiveCount <= 1)
+	{
+		return false;
+	}
+
+	const float leafCost = static_cast<float>(node.primitiveCount) * bounds.SurfaceArea();
+	const ObjectSplit split = FindObjectSplit(&primitives[task.begin], node.primitiveCount, bounds, centroidBounds, settings, bins, rightBounds);
+	const bool bSplit = split.axis >= 0 && split.cost < leafCost;
+
+	// Keep a leaf if no split beats it, unless it is too big
+	if (!bSplit && node.primitiveCount <= settings.maxLeafSize)
+	{
+		return false;
+	}
+
+	if (bSplit)
+	{
+		auto midIt = std::partition(primitives.begin() + task.begin, primitives.begin() + task.end, [&](const BuildPrimitive& primitive)
+		{
+			return split.IsLeft(primitive.centroid, settings.binCount);
+		});
+
+		outMid = static_cast<uint32_t>(midIt - primitives.begin());
+	}
+	else
+	{
+		// All centroids coincide, or splitting doesn't pay off but the leaf is too large. Split in the middle.
+		outMid = task.begin + node.primitiveCount / 2;
+	}
+
+	const uint32_t leftIndex = static_cast<uint32_t>(nodes.size());
+	node.firstChildOrPrimitive = leftIndex;
+	node.primitiveCount = 0;
+	nodes.push_back({});
+	nodes.push_back({});
+	return true;
+}
+
+bool Bvh::ObjectSplit::IsLeft(const Vec3& centroid, const uint32_t binCount) const
+{
+	const uint32_t binIndex = std::min<uint32_t>(binCount - 1, static_cast<uint32_t>((Component(centroid, axis) - axisMin[axis]) * binScale[axis]));
+	return binIndex <= bin;
+}
+
+Bvh::ObjectSplit Bvh::FindObjectSplit(
+	const BuildPrimitive* primitives, 
+	const uint32_t primitiveCount, 
+	const Aabb& bounds, 
+	const Aabb& centroidBounds, 
+	const BvhBuildSettings& settings, 
+	std::vector<Bin>& bins, 
+	std::vector<Aabb>& rightBounds) const
+{
+	ObjectSplit split;
+	split.cost = FLT_MAX;
+
+	// Bin along all three axes in a single pass over the primitives
+	const uint32_t binCount = settings.binCount;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		const float axisExtent = Component(centroidBounds.upper, axis) - Component(centroidBounds.lower, axis);
+		split.axisMin[axis] = Component(centroidBounds.lower, axis);
+		split.binScale[axis] = axisExtent > 0.f ? binCount / axisExtent : 0.f;
+	}
+
+	std::fill(bins.begin(), bins.end(), Bin{});
+	for (uint32_t i = 0; i < primitiveCount; i++)
+	{
+		const Aabb& primBounds = primitives[i].bounds;
+		const Vec3& centroid = primitives[i].centroid;
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const uint32_t binIndex = std::min<uint32_t>(binCount - 1, static_cast<uint32_t>((Component(centroid, axis) - split.axisMin[axis]) * split.binScale[axis]));
+			Bin& bin = bins[axis * binCount + binIndex];
+			bin.bounds.Grow(primBounds);
+			bin.count++;
+		}
+	}
+
+	// Find the cheapest split plane across all axes
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (split.binScale[axis] <= 0.f)
+		{
+			continue;
+		}
+
+		const Bin* axisBins = &bins[axis * binCount];
+
+		Aabb accumulated;
+		for (uint32_t b = binCount - 1; b > 0; b--)
+		{
+			accumulated.Grow(axisBins[b].bounds);
+			rightBounds[b] = accumulated;
+		}
+
+		accumulated = Aabb{};
+		uint32_t leftCount = 0;
+		for (uint32_t b = 0; b + 1 < binCount; b++)
+		{
+			accumulated.Grow(axisBins[b].bounds);
+			leftCount += axisBins[b].count;
+
+			const uint32_t rightCount = primitiveCount - leftCount;
+			if (leftCount == 0 || rightCount == 0)
+			{
+				continue;
+			}
+
+			const float cost = settings.traversalCost * bounds.SurfaceArea() + leftCount * accumulated.SurfaceArea() + rightCount * rightBounds[b + 1].SurfaceArea();
+			if (cost < split.cost)
+			{
+				split.cost = cost;
+				split.axis = axis;
+				split.bin = b;
+				split.leftBounds = accumulated;
+				split.rightBounds = rightBounds[b + 1];
+			}
+		}
+	}
+
+	return split;
+}
+
+float Bvh::ComputeSahCost(const float traversalCost) const
+{
+	return ComputeSahCost(traversalCost, {});
+}
+
+float Bvh::ComputeSahCost(const float traversalCost, const std::vector<float>& primitiveCosts) const
+{
+	if (m_nodes.empty())
+	{
+		return 0.f;
+	}
+
+	auto leafCost = [&](const BvhNode& node)
+	{
+		if (primitiveCosts.empty())
+		{
+			return static_cast<double>(node.primitiveCount);
+		}
+
+		double cost = 0.0;
+		for (uint32_t i = node.firstChildOrPrimitive; i < node.firstChildOrPrimitive + node.primitiveCount; i++)
+		{
+			cost += primitiveCosts[m_primitiveIndices[i]];
+		}
+
+		return cost;
+	};
+
+	const float rootArea = m_nodes[0].bounds.SurfaceArea();
+	if (rootArea <= 0.f)
+	{
+		return static_cast<float>(m_nodes[0].IsLeaf() ? leafCost(m_nodes[0]) : traversalCost);
+	}
+
+	double cost = 0.0;
+	for (const BvhNode& node : m_nodes)
+	{
+		const double probability = node.bounds.SurfaceArea() / rootArea;
+		cost += probability * (node.IsLeaf() ? leafCost(node) : traversalCost);
+	}
+
+	return static_cast<float>(cost);
+}
+
+const std::vector<BvhNode>& Bvh::GetNodes() const
+{
+	return m_nodes;
+}
+
+const std::vector<uint32_t>& Bvh::GetPrimitiveIndices() const
+{
+	return m_primitiveIndices;
+}
+
+std::vector<Aabb> ComputeTriangleBounds(const std::vector<Vec3>& positions, const std::vector<uint32_t>& indices)
+{
+	std::vector<Aabb> bounds(indices.size() / 3);
+	for (size_t triIdx = 0; triIdx < bounds.size(); triIdx++)
+	{
+		bounds[triIdx].Grow(positions[indices[3 * triIdx]]);
+		bounds[triIdx].Grow(positions[indices[3 * triIdx + 1]]);
+		bounds[triIdx].Grow(positions[indices[3 * triIdx + 2]]);
+	}
+
+	return bounds;
+}
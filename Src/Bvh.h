@@ -0,0 +1,145 @@
+#pragma once
+
+#include "CpuMath.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class TaskScheduler;
+
+struct BvhNode
+{
+	Aabb bounds;
+	uint32_t firstChildOrPrimitive;	// the two children of an interior node are stored next to each other
+	uint32_t primitiveCount;		// zero for interior nodes
+
+	bool IsLeaf() const
+	{
+		return primitiveCount > 0;
+	}
+};
+
+enum class BvhBuilder
+{
+	BinnedSah,		// top down with binned SAH splits, the best trees to trace
+	Linear			// LBVH over Morton codes, many times faster to build, for BVHs that are rebuilt every frame
+};
+
+struct BvhBuildSettings
+{
+	BvhBuilder builder = BvhBuilder::BinnedSah;
+	uint32_t binCount = 16;
+	uint32_t maxLeafSize = 4;
+	float traversalCost = 1.f;		// relative to the cost of one primitive intersection
+	TaskScheduler* scheduler = nullptr;	// subtrees are built on it once the top of the tree has been split, if set
+
+	// Spatial splits as in Stich et al., "Spatial Splits in Bounding Volume Hierarchies": a node may also be split by a
+	// plane that cuts triangles in two, with each half referenced from its own side. Only the build over triangles
+	// does them, and it is serial.
+	bool bSpatialSplits = false;
+	float spatialSplitMinOverlap = 1e-5f;	// area the children of the best object split overlap by, relative to the root, before spatial splits are tried
+	float spatialSplitMaxGrowth = 0.3f;		// references that spatial splits may add, relative to the triangle count
+
+	// The linear builder sorts the centroids along a Morton curve, 10 bits per axis by default. 21 bits tell apart
+	// primitives that are closer than a thousandth of the bounds, eg. small details in a large scene, for twice the
+	// sort passes. Treelet passes then reorganize the tree as in Karras and Aila, "Fast Parallel Construction of
+	// High-Quality Bounding Volume Hierarchies", which wins back much of the SAH cost of the binned build.
+	bool bWideMortonCodes = false;
+	uint32_t treeletPassCount = 0;
+};
+
+// Binary bounding volume hierarchy over primitive bounds, built top down with binned SAH splits, or bottom up from
+// Morton codes with the linear builder. The tree does not depend on the thread count, only the order of its nodes does.
+class Bvh
+{
+public:
+	void Build(const std::vector<Aabb>& primitiveBounds, const BvhBuildSettings& settings);
+
+	// Over the triangles of an index buffer, with spatial splits if the settings ask for them and the builder is the
+	// binned one. A triangle can then be referenced by more than one leaf.
+	void Build(const std::vector<Vec3>& positions, const std::vector<uint32_t>& indices, const BvhBuildSettings& settings);
+
+	// Expected cost of a ray that hits the root, in units of primitive intersections
+	float ComputeSahCost(const float traversalCost) const;
+
+	// Same, with a cost per primitive instead of one intersection each, eg. for a BVH over instances
+	float ComputeSahCost(const float traversalCost, const std::vector<float>& primitiveCosts) const;
+
+	const std::vector<BvhNode>& GetNodes() const;
+	const std::vector<uint32_t>& GetPrimitiveIndices() const;
+
+private:
+	struct Bin
+	{
+		Aabb bounds;
+		uint32_t count = 0;
+	};
+
+	struct BuildPrimitive
+	{
+		Aabb bounds;
+		Vec3 centroid;
+		uint32_t index;
+	};
+
+	struct BuildTask
+	{
+		uint32_t nodeIndex;
+		uint32_t begin;
+		uint32_t end;
+	};
+
+	// Best binned split of a range of primitives by their centroids
+	struct ObjectSplit
+	{
+		float cost;
+		int axis = -1;				// -1 if there is no split, eg. because all centroids coincide
+		uint32_t bin;
+		float axisMin[3];
+		float binScale[3];
+		Aabb leftBounds;
+		Aabb rightBounds;
+
+		bool IsLeft(const Vec3& centroid, const uint32_t binCount) const;
+	};
+
+	// Builds the subtree below root into nodes, which already holds its root
+	void BuildSubtree(
+		const BuildTask& root, 
+		const BvhBuildSettings& settings, 
+		std::vector<BuildPrimitive>& primitives, 
+		std::vector<BvhNode>& nodes);
+
+	// Sets the bounds of the task's node and, unless it is better off as a leaf, partitions its primitives and
+	// appends its two children. Returns false for a leaf.
+	bool SplitNode(
+		const BuildTask& task, 
+		const BvhBuildSettings& settings, 
+		std::vector<Bin>& bins, 
+		std::vector<Aabb>& rightBounds, 
+		std::vector<BuildPrimitive>& primitives, 
+		std::vector<BvhNode>& nodes, 
+		uint32_t& outMid);
+
+	ObjectSplit FindObjectSplit(
+		const BuildPrimitive* primitives, 
+		const uint32_t primitiveCount, 
+		const Aabb& bounds, 
+		const Aabb& centroidBounds, 
+		const BvhBuildSettings& settings, 
+		std::vector<Bin>& bins, 
+		std::vector<Aabb>& rightBounds) const;
+
+	void BuildSpatial(const std::vector<Vec3>& positions, const std::vector<uint32_t>& indices, const BvhBuildSettings& settings);
+
+	void BuildLinear(const std::vector<Aabb>& primitiveBounds, const BvhBuildSettings& settings);
+
+	void StorePrimitiveIndices(const std::vector<BuildPrimitive>& primitives);
+
+private:
+	std::vector<BvhNode> m_nodes;
+	std::vector<uint32_t> m_primitiveIndices;	// leaves refer to ranges of this, which may repeat primitives after spatial splits
+};
+
+std::vector<Aabb> ComputeTriangleBounds(const std::vector<Vec3>& positions, const std::vector<uint32_t>& indices);
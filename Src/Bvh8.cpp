@@ -0,0 +1,383 @@
+#include "Bvh8.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if SIMD_ISA_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	uint32_t IntersectChildrenScalar(const Bvh8Node& node, const Bvh8Ray& ray, const float tMin, const float tMax, float outEntries[8])
+	{
+		uint32_t hitMask = 0;
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			const float nearX = (node.planes[ray.nearPlane[0]][slot] - ray.origin.x) * ray.invDirection.x;
+			const float nearY = (node.planes[ray.nearPlane[1]][slot] - ray.origin.y) * ray.invDirection.y;
+			const float nearZ = (node.planes[ray.nearPlane[2]][slot] - ray.origin.z) * ray.invDirection.z;
+			const float farX = (node.planes[ray.farPlane[0]][slot] - ray.origin.x) * ray.invDirection.x;
+			const float farY = (node.planes[ray.farPlane[1]][slot] - ray.origin.y) * ray.invDirection.y;
+			const float farZ = (node.planes[ray.farPlane[2]][slot] - ray.origin.z) * ray.invDirection.z;
+
+			const float entry = (std::max)({ nearX, nearY, nearZ, tMin });
+			const float exit = (std::min)((std::min)({ farX, farY, farZ }) * k_bvh8RobustExitScale, tMax);
+			outEntries[slot] = entry;
+			hitMask |= (entry <= exit ? 1u : 0u) << slot;
+		}
+
+		return hitMask;
+	}
+
+#if SIMD_ISA_X86
+	uint32_t IntersectChildrenSse(const Bvh8Node& node, const Bvh8Ray& ray, const float tMin, const float tMax, float outEntries[8])
+	{
+		const __m128 originX = _mm_set1_ps(ray.origin.x);
+		const __m128 originY = _mm_set1_ps(ray.origin.y);
+		const __m128 originZ = _mm_set1_ps(ray.origin.z);
+		const __m128 invDirX = _mm_set1_ps(ray.invDirection.x);
+		const __m128 invDirY = _mm_set1_ps(ray.invDirection.y);
+		const __m128 invDirZ = _mm_set1_ps(ray.invDirection.z);
+		const __m128 rayMin = _mm_set1_ps(tMin);
+		const __m128 rayMax = _mm_set1_ps(tMax);
+		const __m128 exitScale = _mm_set1_ps(k_bvh8RobustExitScale);
+
+		uint32_t hitMask = 0;
+		for (uint32_t half = 0; half < 8; half += 4)
+		{
+			const __m128 nearX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.planes[ray.nearPlane[0]][half]), originX), invDirX);
+			const __m128 nearY = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.planes[ray.nearPlane[1]][half]), originY), invDirY);
+			const __m128 nearZ = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.planes[ray.nearPlane[2]][half]), originZ), invDirZ);
+			const __m128 farX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.planes[ray.farPlane[0]][half]), originX), invDirX);
+			const __m128 farY = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.planes[ray.farPlane[1]][half]), originY), invDirY);
+			const __m128 farZ = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(&node.planes[ray.farPlane[2]][half]), originZ), invDirZ);
+
+			const __m128 entry = _mm_max_ps(_mm_max_ps(nearX, nearY), _mm_max_ps(nearZ, rayMin));
+			const __m128 exit = _mm_min_ps(_mm_mul_ps(_mm_min_ps(_mm_min_ps(farX, farY), farZ), exitScale), rayMax);
+			_mm_storeu_ps(outEntries + half, entry);
+			hitMask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(entry, exit))) << half;
+		}
+
+		return hitMask;
+	}
+
+	SIMD_TARGET_AVX2 uint32_t IntersectChildrenAvx2(const Bvh8Node& node, const Bvh8Ray& ray, const float tMin, const float tMax, float outEntries[8])
+	{
+		const __m256 originX = _mm256_set1_ps(ray.origin.x);
+		const __m256 originY = _mm256_set1_ps(ray.origin.y);
+		const __m256 originZ = _mm256_set1_ps(ray.origin.z);
+		const __m256 invDirX = _mm256_set1_ps(ray.invDirection.x);
+		const __m256 invDirY = _mm256_set1_ps(ray.invDirection.y);
+		const __m256 invDirZ = _mm256_set1_ps(ray.invDirection.z);
+
+		const __m256 nearX = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.planes[ray.nearPlane[0]]), originX), invDirX);
+		const __m256 nearY = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.planes[ray.nearPlane[1]]), originY), invDirY);
+		const __m256 nearZ = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.planes[ray.nearPlane[2]]), originZ), invDirZ);
+		const __m256 farX = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.planes[ray.farPlane[0]]), originX), invDirX);
+		const __m256 farY = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.planes[ray.farPlane[1]]), originY), invDirY);
+		const __m256 farZ = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(node.planes[ray.farPlane[2]]), originZ), invDirZ);
+
+		const __m256 entry = _mm256_max_ps(_mm256_max_ps(nearX, nearY), _mm256_max_ps(nearZ, _mm256_set1_ps(tMin)));
+		const __m256 exit = _mm256_min_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_min_ps(farX, farY), farZ), _mm256_set1_ps(k_bvh8RobustExitScale)), _mm256_set1_ps(tMax));
+		_mm256_storeu_ps(outEntries, entry);
+		return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ)));
+	}
+#endif
+
+	void SetChildBounds(Bvh8Node& node, const uint32_t slot, const Aabb& bounds)
+	{
+		node.planes[0][slot] = bounds.lower.x;
+		node.planes[1][slot] = bounds.upper.x;
+		node.planes[2][slot] = bounds.lower.y;
+		node.planes[3][slot] = bounds.upper.y;
+		node.planes[4][slot] = bounds.lower.z;
+		node.planes[5][slot] = bounds.upper.z;
+	}
+
+	Bvh8Node MakeEmptyNode()
+	{
+		Bvh8Node node;
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			SetChildBounds(node, slot, Aabb{});
+			node.child[slot] = 0;
+			node.primitiveCount[slot] = 0;
+		}
+
+		return node;
+	}
+}
+
+Bvh8Ray Bvh8Ray::Make(const Vec3& origin, const Vec3& direction)
+{
+	Bvh8Ray ray;
+	ray.origin = origin;
+	ray.invDirection = { 1.f / direction.x, 1.f / direction.y, 1.f / direction.z };
+
+	// Testing the near and far planes instead of taking the min and max of both also rejects the inverted boxes of
+	// unused slots
+	const float invDirection[3] = { ray.invDirection.x, ray.invDirection.y, ray.invDirection.z };
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		const uint32_t negative = std::signbit(invDirection[axis]) ? 1 : 0;
+		ray.nearPlane[axis] = 2 * axis + negative;
+		ray.farPlane[axis] = 2 * axis + 1 - negative;
+	}
+
+	return ray;
+}
+
+Bvh8IntersectChildrenFunc GetBvh8IntersectChildren(const SimdIsa isa)
+{
+	assert(IsSimdIsaSupported(isa));
+
+	switch (isa)
+	{
+#if SIMD_ISA_X86
+	case SimdIsa::Sse:
+		return IntersectChildrenSse;
+	case SimdIsa::Avx2:
+		return IntersectChildrenAvx2;
+#endif
+	default:
+		return IntersectChildrenScalar;
+	}
+}
+
+void Bvh8::Build(const Bvh& bvh)
+{
+	m_nodes.clear();
+
+	const std::vector<BvhNode>& binaryNodes = bvh.GetNodes();
+	if (binaryNodes.empty())
+	{
+		return;
+	}
+
+	m_nodes.push_back(MakeEmptyNode());
+
+	// A single leaf still gets a root node, with the leaf in its first slot
+	if (binaryNodes[0].IsLeaf())
+	{
+		SetChildBounds(m_nodes[0], 0, binaryNodes[0].bounds);
+		m_nodes[0].child[0] = binaryNodes[0].firstChildOrPrimitive;
+		m_nodes[0].primitiveCount[0] = binaryNodes[0].primitiveCount;
+		return;
+	}
+
+	struct CollapseTask
+	{
+		uint32_t binaryIndex;
+		uint32_t nodeIndex;
+	};
+
+	std::vector<CollapseTask> stack;
+	stack.push_back({ 0, 0 });
+
+	while (!stack.empty())
+	{
+		const CollapseTask task = stack.back();
+		stack.pop_back();
+
+		// Open up the largest interior child until there are eight or only leaves are left
+		uint32_t children[8];
+		uint32_t childCount = 2;
+		children[0] = binaryNodes[task.binaryIndex].firstChildOrPrimitive;
+		children[1] = children[0] + 1;
+
+		while (childCount < 8)
+		{
+			int32_t largest = -1;
+			float largestArea = -1.f;
+			for (uint32_t i = 0; i < childCount; i++)
+			{
+				const BvhNode& child = binaryNodes[children[i]];
+				if (!child.IsLeaf() && child.bounds.SurfaceArea() > largestArea)
+				{
+					largest = static_cast<int32_t>(i);
+					largestArea = child.bounds.SurfaceArea();
+				}
+			}
+
+			if (largest < 0)
+			{
+				break;
+			}
+
+			const uint32_t grandChild = binaryNodes[children[largest]].firstChildOrPrimitive;
+			children[largest] = grandChild;
+			children[childCount++] = grandChild + 1;
+		}
+
+		for (uint32_t slot = 0; slot < childCount; slot++)
+		{
+			const BvhNode& child = binaryNodes[children[slot]];
+			uint32_t childIndex = child.firstChildOrPrimitive;
+			if (!child.IsLeaf())
+			{
+				childIndex = static_cast<uint32_t>(m_nodes.size());
+				m_nodes.push_back(MakeEmptyNode());
+				stack.push_back({ children[slot], childIndex });
+			}
+
+			Bvh8Node& node = m_nodes[task.nodeIndex];
+			SetChildBounds(node, slot, child.bounds);
+			node.child[slot] = childIndex;
+			node.primitiveCount[slot] = child.primitiveCount;
+		}
+	}
+}
+
+const std::vector<Bvh8Node>& Bvh8::GetNodes() const
+{
+	return m_nodes;
+}
+
+void ReorderBvh8Nodes(std::vector<Bvh8Node>& nodes, const Bvh8NodeLayout layout, const uint32_t clusterNodeCount)
+{
+	if (layout == Bvh8NodeLayout::Collapse || nodes.size() <= 1)
+	{
+		return;
+	}
+
+	// Unused slots have neither primitives nor a child, since the root is nobody's child
+	auto isInterior = [](const Bvh8Node& node, const uint32_t slot) { return node.primitiveCount[slot] == 0 && node.child[slot] != 0; };
+
+	// Group of the interior children of a node, whose own box has the given area
+	struct Candidate
+	{
+		float area;
+		uint32_t node;
+
+		bool operator<(const Candidate& other) const { return area < other.area; }
+	};
+
+	// Clusters are grown a group of children at a time, by the group of the largest box on their edge as long as it fits
+	std::vector<uint32_t> order;
+	order.reserve(nodes.size());
+	order.push_back(0);
+	std::vector<uint32_t> clusterRoots = { 0 };
+	std::vector<Candidate> frontier;
+	while (!clusterRoots.empty())
+	{
+		frontier.assign(1, { 0.f, clusterRoots.back() });
+		clusterRoots.pop_back();
+
+		uint32_t clusterSize = 0;
+		while (!frontier.empty())
+		{
+			const Bvh8Node& parent = nodes[frontier.front().node];
+			uint32_t groupSize = 0;
+			for (uint32_t slot = 0; slot < 8; slot++)
+			{
+				groupSize += isInterior(parent, slot) ? 1 : 0;
+			}
+
+			if (clusterSize > 0 && clusterSize + groupSize > clusterNodeCount)
+			{
+				break;
+			}
+
+			std::pop_heap(frontier.begin(), frontier.end());
+			frontier.pop_back();
+			clusterSize += groupSize;
+
+			for (uint32_t slot = 0; slot < 8; slot++)
+			{
+				if (!isInterior(parent, slot))
+				{
+					continue;
+				}
+
+				const uint32_t childIdx = parent.child[slot];
+				order.push_back(childIdx);
+
+				const Bvh8Node& child = nodes[childIdx];
+				for (uint32_t childSlot = 0; childSlot < 8; childSlot++)
+				{
+					if (isInterior(child, childSlot))
+					{
+						frontier.push_back({ GetBvh8ChildBounds(parent, slot).SurfaceArea(), childIdx });
+						std::push_heap(frontier.begin(), frontier.end());
+						break;
+					}
+				}
+			}
+		}
+
+		// The groups left start clusters of their own, the largest right after this one
+		std::sort(frontier.begin(), frontier.end());
+		for (const Candidate& candidate : frontier)
+		{
+			clusterRoots.push_back(candidate.node);
+		}
+	}
+
+	assert(order.size() == nodes.size() && order[0] == 0);
+
+	std::vector<uint32_t> newIndices(nodes.size());
+	for (size_t newIdx = 0; newIdx < order.size(); newIdx++)
+	{
+		newIndices[order[newIdx]] = static_cast<uint32_t>(newIdx);
+	}
+
+	std::vector<Bvh8Node> reordered(nodes.size());
+	for (size_t newIdx = 0; newIdx < order.size(); newIdx++)
+	{
+		Bvh8Node& node = reordered[newIdx];
+		node = nodes[order[newIdx]];
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			if (isInterior(node, slot))
+			{
+				node.child[slot] = newIndices[node.child[slot]];
+			}
+		}
+	}
+
+	nodes.swap(reordered);
+}
+
+void SetBvh8ChildBounds(Bvh8Node& node, const Aabb childBounds[8])
+{
+	for (uint32_t slot = 0; slot < 8; slot++)
+	{
+		SetChildBounds(node, slot, childBounds[slot]);
+	}
+}
+
+Aabb GetBvh8ChildBounds(const Bvh8Node& node, const uint32_t slot)
+{
+	return {
+		{ node.planes[0][slot], node.planes[2][slot], node.planes[4][slot] },
+		{ node.planes[1][slot], node.planes[3][slot], node.planes[5][slot] } };
+}
+
+float ComputeBvh8SahCost(const std::vector<Bvh8Node>& nodes, const float traversalCost)
+{
+	if (nodes.empty())
+	{
+		return 0.f;
+	}
+
+	double cost = 0.0;
+	float rootArea = 0.f;
+	for (size_t nodeIdx = 0; nodeIdx < nodes.size(); nodeIdx++)
+	{
+		const Bvh8Node& node = nodes[nodeIdx];
+
+		Aabb bounds;
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			const Aabb childBounds = GetBvh8ChildBounds(node, slot);
+			bounds.Grow(childBounds);
+			cost += static_cast<double>(childBounds.SurfaceArea()) * node.primitiveCount[slot];
+		}
+
+		cost += static_cast<double>(bounds.SurfaceArea()) * traversalCost;
+		rootArea = nodeIdx == 0 ? bounds.SurfaceArea() : rootArea;
+	}
+
+	return rootArea > 0.f ? static_cast<float>(cost / rootArea) : traversalCost;
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include "Bvh.h"
+#include "CpuMath.h"
+#include "SimdIsa.h"
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+// Eight children per node, stored as structure of arrays so that a ray can be tested against all of their boxes at
+// once. Slots that are not used have an inverted box and are never hit.
+struct Bvh8Node
+{
+	float planes[6][8];				// lower x, upper x, lower y, upper y, lower z, upper z of each child
+	uint32_t child[8];				// node index of interior children, first primitive of leaves
+	uint32_t primitiveCount[8];		// zero for interior children
+};
+
+static_assert(sizeof(Bvh8Node) == 256, "Bvh8Node is expected to span four cache lines");
+
+struct Bvh8Ray
+{
+	Vec3 origin;
+	Vec3 invDirection;
+	uint32_t nearPlane[3];			// row of Bvh8Node::planes the ray enters through on each axis
+	uint32_t farPlane[3];
+
+	static Bvh8Ray Make(const Vec3& origin, const Vec3& direction);
+};
+
+// The box kernels scale the exit distance by this, since rounding in the slab distances can otherwise miss a box that a
+// watertight triangle test would hit on its edge. 1 + 2 * gamma(3) from Ize, "Robust BVH Ray Traversal".
+constexpr float k_bvh8RobustExitScale = 1.0000004f;
+
+// Box test kernel, which writes the entry distance of each child and returns a bit mask of the children hit within
+// [tMin, tMax]
+using Bvh8IntersectChildrenFunc = uint32_t (*)(const Bvh8Node& node, const Bvh8Ray& ray, const float tMin, const float tMax, float outEntries[8]);
+
+Bvh8IntersectChildrenFunc GetBvh8IntersectChildren(const SimdIsa isa);
+
+// Collapses a binary BVH into an 8-wide one by repeatedly opening up the interior child with the largest surface
+// area. The leaves keep the primitive ranges of the binary tree, so GetPrimitiveIndices of the source still applies.
+class Bvh8
+{
+public:
+	void Build(const Bvh& bvh);
+
+	const std::vector<Bvh8Node>& GetNodes() const;
+
+private:
+	std::vector<Bvh8Node> m_nodes;
+};
+
+// Order of the nodes in memory. Traversal works with any order in which children come after their parent.
+enum class Bvh8NodeLayout
+{
+	Collapse,		// as Bvh8::Build emits them, depth-first
+	Clustered		// in clusters that fill a page, to miss the TLB less deep in the tree
+};
+
+// Moves the nodes into another layout and updates the child indices, keeping the root first. The interior children of
+// a node are always kept next to each other, since they are tested together. Rays are more likely to enter a child
+// the larger its box is, so each cluster is grown from its first children by those of the largest box on its edge,
+// and the children left on the edge start clusters of their own, largest first. clusterNodeCount is the number of
+// nodes in a cluster, eg. a 4 KB page of the nodes as they are finally stored. Leaves are left as they are.
+void ReorderBvh8Nodes(std::vector<Bvh8Node>& nodes, const Bvh8NodeLayout layout, const uint32_t clusterNodeCount);
+
+// Sets the boxes of all of the children of a node, with empty boxes for the unused slots
+void SetBvh8ChildBounds(Bvh8Node& node, const Aabb childBounds[8]);
+
+// Box of one child, empty for an unused slot
+Aabb GetBvh8ChildBounds(const Bvh8Node& node, const uint32_t slot);
+
+// Same as Bvh::ComputeSahCost, counting each 8-wide node once instead of the binary nodes it was collapsed from
+float ComputeBvh8SahCost(const std::vector<Bvh8Node>& nodes, const float traversalCost);
+
+struct Bvh8RefitResult
+{
+	float sahCost;
+	Aabb bounds;		// of the root
+};
+
+// Recomputes the boxes of the nodes bottom up for primitives that have moved, keeping the topology. leafBounds(
+// firstPrimitive, primitiveCount) returns the bounds of a leaf. Children always come after their parent, so the nodes
+// can be grouped by depth and refit deepest level first, with the nodes of each level in parallel. The SAH cost of the
+// refit tree is the same as ComputeBvh8SahCost, to compare against that of the last build. Node is a Bvh8Node or a
+// Bvh8QuantizedNode.
+template<typename Node, typename LeafBounds>
+Bvh8RefitResult RefitBvh8(
+	Node* nodes,
+	const size_t nodeCount,
+	const float traversalCost,
+	TaskScheduler& scheduler,
+	LeafBounds&& leafBounds)
+{
+	if (nodeCount == 0)
+	{
+		return { 0.f, Aabb{} };
+	}
+
+	// Unused slots have neither primitives nor a child, since the root is nobody's child
+	auto isInterior = [](const Node& node, const uint32_t slot) { return node.primitiveCount[slot] == 0 && node.child[slot] != 0; };
+
+	std::vector<uint32_t> depths(nodeCount, 0);
+	uint32_t maxDepth = 0;
+	for (size_t nodeIdx = 0; nodeIdx < nodeCount; nodeIdx++)
+	{
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			if (isInterior(nodes[nodeIdx], slot))
+			{
+				assert(nodes[nodeIdx].child[slot] > nodeIdx);
+				depths[nodes[nodeIdx].child[slot]] = depths[nodeIdx] + 1;
+				maxDepth = (std::max)(maxDepth, depths[nodeIdx] + 1);
+			}
+		}
+	}
+
+	std::vector<uint32_t> levelOffsets(maxDepth + 2, 0);
+	for (const uint32_t depth : depths)
+	{
+		levelOffsets[depth + 1]++;
+	}
+
+	for (uint32_t depth = 0; depth <= maxDepth; depth++)
+	{
+		levelOffsets[depth + 1] += levelOffsets[depth];
+	}
+
+	std::vector<uint32_t> levelNodes(nodeCount);
+	std::vector<uint32_t> levelEnds(levelOffsets.begin(), levelOffsets.end() - 1);
+	for (size_t nodeIdx = 0; nodeIdx < nodeCount; nodeIdx++)
+	{
+		levelNodes[levelEnds[depths[nodeIdx]]++] = static_cast<uint32_t>(nodeIdx);
+	}
+
+	// Bounds of each node for its parent, and its share of the cost before dividing by the area of the root
+	std::vector<Aabb> nodeBounds(nodeCount);
+	std::vector<double> nodeCosts(nodeCount);
+	for (uint32_t depth = maxDepth + 1; depth-- > 0;)
+	{
+		const uint32_t levelBegin = levelOffsets[depth];
+		scheduler.ParallelFor(levelOffsets[depth + 1] - levelBegin, 64, [&](const size_t begin, const size_t end)
+		{
+			for (size_t i = begin; i < end; i++)
+			{
+				const uint32_t nodeIdx = levelNodes[levelBegin + i];
+				Node& node = nodes[nodeIdx];
+
+				Aabb childBounds[8];
+				Aabb bounds;
+				double cost = 0.0;
+				for (uint32_t slot = 0; slot < 8; slot++)
+				{
+					if (node.primitiveCount[slot] > 0)
+					{
+						childBounds[slot] = leafBounds(node.child[slot], node.primitiveCount[slot]);
+						cost += static_cast<double>(childBounds[slot].SurfaceArea()) * node.primitiveCount[slot];
+					}
+					else if (node.child[slot] != 0)
+					{
+						childBounds[slot] = nodeBounds[node.child[slot]];
+					}
+
+					bounds.Grow(childBounds[slot]);
+				}
+
+				SetBvh8ChildBounds(node, childBounds);
+				nodeBounds[nodeIdx] = bounds;
+				nodeCosts[nodeIdx] = cost + static_cast<double>(bounds.SurfaceArea()) * traversalCost;
+			}
+		});
+	}
+
+	const float rootArea = nodeBounds[0].SurfaceArea();
+	if (rootArea <= 0.f)
+	{
+		return { traversalCost, nodeBounds[0] };
+	}
+
+	double cost = 0.0;
+	for (const double nodeCost : nodeCosts)
+	{
+		cost += nodeCost;
+	}
+
+	return { static_cast<float>(cost / rootArea), nodeBounds[0] };
+}
+
+// Starts loading a node into the cache, eg. a child pushed on the traversal stack that will be visited later
+template<typename Node>
+inline void PrefetchBvh8Node(const Node& node)
+{
+	const char* bytes = reinterpret_cast<const char*>(&node);
+	for (size_t offset = 0; offset < sizeof(Node); offset += 64)
+	{
+#if defined(__GNUC__) || defined(__clang__)
+		__builtin_prefetch(bytes + offset);
+#elif defined(_M_X64) || defined(_M_IX86)
+		_mm_prefetch(bytes + offset, _MM_HINT_T0);
+#else
+		(void)bytes;
+#endif
+	}
+}
+
+// Walks the nodes hit by a ray. The children hit are visited nearest first and skipped when popped if a closer hit
+// has been found since. intersectLeaf is called with the first primitive and count of every leaf reached and is
+// expected to lower closestT on a hit. Ray can also be a ray packet, with a matching intersectChildren kernel and
+// closestT the farthest hit of the packet. Nodes is a std::vector or an ArrayView of any node with the child and
+// primitiveCount arrays of Bvh8Node, eg. a Bvh8QuantizedNode. With bPrefetch the interior children hit are prefetched
+// as they are pushed, so that their nodes are on their way in while the nearest subtree is traversed.
+template<typename Nodes, typename Ray, typename IntersectChildren, typename IntersectLeaf>
+void TraverseBvh8(
+	const Nodes& nodes,
+	const Ray& ray,
+	const float tMin,
+	const float& closestT,
+	const IntersectChildren intersectChildren,
+	IntersectLeaf&& intersectLeaf,
+	const bool bPrefetch = true)
+{
+	if (nodes.empty())
+	{
+		return;
+	}
+
+	struct StackEntry
+	{
+		uint32_t child;
+		uint32_t primitiveCount;
+		float entry;
+	};
+
+	constexpr size_t k_stackSize = 256;
+	StackEntry stack[k_stackSize];
+	size_t stackSize = 0;
+	stack[stackSize++] = { 0, 0, tMin };
+
+	while (stackSize > 0)
+	{
+		const StackEntry item = stack[--stackSize];
+		if (item.entry > closestT)
+		{
+			continue;
+		}
+
+		if (item.primitiveCount > 0)
+		{
+			intersectLeaf(item.child, item.primitiveCount);
+			continue;
+		}
+
+		const auto& node = nodes[item.child];
+		float entries[8];
+		uint32_t hitMask = intersectChildren(node, ray, tMin, closestT, entries);
+
+		// Insertion sort of the children hit, farthest first, so that the nearest is popped next
+		assert(stackSize + 8 <= k_stackSize && "BVH too deep for the traversal stack");
+		const size_t firstPushed = stackSize;
+		while (hitMask != 0)
+		{
+			uint32_t slot = 0;
+			while ((hitMask & (1u << slot)) == 0)
+			{
+				slot++;
+			}
+
+			hitMask &= hitMask - 1;
+
+			const StackEntry pushed = { node.child[slot], node.primitiveCount[slot], entries[slot] };
+			if (bPrefetch && pushed.primitiveCount == 0)
+			{
+				PrefetchBvh8Node(nodes[pushed.child]);
+			}
+
+			size_t pos = stackSize++;
+			while (pos > firstPushed && stack[pos - 1].entry < pushed.entry)
+			{
+				stack[pos] = stack[pos - 1];
+				pos--;
+			}
+
+			stack[pos] = pushed;
+		}
+	}
+}
@@ -0,0 +1,270 @@
+#include "Bvh8Quantized.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#if SIMD_ISA_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	// Exactly what the kernels compute for a stored plane
+	float DecodePlane(const uint8_t q, const float origin, const float scale)
+	{
+		return origin + static_cast<float>(q) * scale;
+	}
+
+	// Smallest power of two step that reaches from origin to upper in 255 steps
+	float ComputeScale(const float origin, const float upper)
+	{
+		if (!(upper > origin))
+		{
+			return std::ldexp(1.f, -126);
+		}
+
+		int exponent;
+		std::frexp((upper - origin) / 255.f, &exponent);
+		exponent = (std::max)(exponent, -126);
+		while (DecodePlane(255, origin, std::ldexp(1.f, exponent)) < upper)
+		{
+			exponent++;
+		}
+
+		assert(exponent <= 127);
+		return std::ldexp(1.f, exponent);
+	}
+
+	uint8_t QuantizeLower(const float plane, const float origin, const float scale)
+	{
+		uint32_t q = static_cast<uint32_t>((std::min)(255.f, (std::max)(0.f, std::floor((plane - origin) / scale))));
+		while (q > 0 && DecodePlane(static_cast<uint8_t>(q), origin, scale) > plane)
+		{
+			q--;
+		}
+
+		assert(DecodePlane(static_cast<uint8_t>(q), origin, scale) <= plane);
+		return static_cast<uint8_t>(q);
+	}
+
+	uint8_t QuantizeUpper(const float plane, const float origin, const float scale)
+	{
+		uint32_t q = static_cast<uint32_t>((std::min)(255.f, (std::max)(0.f, std::ceil((plane - origin) / scale))));
+		while (q < 255 && DecodePlane(static_cast<uint8_t>(q), origin, scale) < plane)
+		{
+			q++;
+		}
+
+		assert(DecodePlane(static_cast<uint8_t>(q), origin, scale) >= plane);
+		return static_cast<uint8_t>(q);
+	}
+
+	uint32_t IntersectQuantizedChildrenScalar(const Bvh8QuantizedNode& node, const Bvh8Ray& ray, const float tMin, const float tMax, float outEntries[8])
+	{
+		const float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+		const float invDirection[3] = { ray.invDirection.x, ray.invDirection.y, ray.invDirection.z };
+
+		uint32_t hitMask = 0;
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			float entry = tMin;
+			float exit = FLT_MAX;
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				const float nearPlane = DecodePlane(node.planes[ray.nearPlane[axis]][slot], node.origin[axis], node.scale[axis]);
+				const float farPlane = DecodePlane(node.planes[ray.farPlane[axis]][slot], node.origin[axis], node.scale[axis]);
+				entry = (std::max)(entry, (nearPlane - origin[axis]) * invDirection[axis]);
+				exit = (std::min)(exit, (farPlane - origin[axis]) * invDirection[axis]);
+			}
+
+			exit = (std::min)(exit * k_bvh8RobustExitScale, tMax);
+			outEntries[slot] = entry;
+			hitMask |= (entry <= exit ? 1u : 0u) << slot;
+		}
+
+		return hitMask & node.childMask;
+	}
+
+#if SIMD_ISA_X86
+	// Four planes of a row, starting at slot half
+	__m128 DecodePlanesSse(const uint8_t planes[8], const uint32_t half, const float origin, const float scale)
+	{
+		const __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(planes)), _mm_setzero_si128());
+		const __m128i dwords = half == 0 ? _mm_unpacklo_epi16(words, _mm_setzero_si128()) : _mm_unpackhi_epi16(words, _mm_setzero_si128());
+		return _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(dwords), _mm_set1_ps(scale)), _mm_set1_ps(origin));
+	}
+
+	uint32_t IntersectQuantizedChildrenSse(const Bvh8QuantizedNode& node, const Bvh8Ray& ray, const float tMin, const float tMax, float outEntries[8])
+	{
+		const __m128 originX = _mm_set1_ps(ray.origin.x);
+		const __m128 originY = _mm_set1_ps(ray.origin.y);
+		const __m128 originZ = _mm_set1_ps(ray.origin.z);
+		const __m128 invDirX = _mm_set1_ps(ray.invDirection.x);
+		const __m128 invDirY = _mm_set1_ps(ray.invDirection.y);
+		const __m128 invDirZ = _mm_set1_ps(ray.invDirection.z);
+		const __m128 rayMin = _mm_set1_ps(tMin);
+		const __m128 rayMax = _mm_set1_ps(tMax);
+		const __m128 exitScale = _mm_set1_ps(k_bvh8RobustExitScale);
+
+		uint32_t hitMask = 0;
+		for (uint32_t half = 0; half < 8; half += 4)
+		{
+			const __m128 nearX = _mm_mul_ps(_mm_sub_ps(DecodePlanesSse(node.planes[ray.nearPlane[0]], half, node.origin[0], node.scale[0]), originX), invDirX);
+			const __m128 nearY = _mm_mul_ps(_mm_sub_ps(DecodePlanesSse(node.planes[ray.nearPlane[1]], half, node.origin[1], node.scale[1]), originY), invDirY);
+			const __m128 nearZ = _mm_mul_ps(_mm_sub_ps(DecodePlanesSse(node.planes[ray.nearPlane[2]], half, node.origin[2], node.scale[2]), originZ), invDirZ);
+			const __m128 farX = _mm_mul_ps(_mm_sub_ps(DecodePlanesSse(node.planes[ray.farPlane[0]], half, node.origin[0], node.scale[0]), originX), invDirX);
+			const __m128 farY = _mm_mul_ps(_mm_sub_ps(DecodePlanesSse(node.planes[ray.farPlane[1]], half, node.origin[1], node.scale[1]), originY), invDirY);
+			const __m128 farZ = _mm_mul_ps(_mm_sub_ps(DecodePlanesSse(node.planes[ray.farPlane[2]], half, node.origin[2], node.scale[2]), originZ), invDirZ);
+
+			const __m128 entry = _mm_max_ps(_mm_max_ps(nearX, nearY), _mm_max_ps(nearZ, rayMin));
+			const __m128 exit = _mm_min_ps(_mm_mul_ps(_mm_min_ps(_mm_min_ps(farX, farY), farZ), exitScale), rayMax);
+			_mm_storeu_ps(outEntries + half, entry);
+			hitMask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(entry, exit))) << half;
+		}
+
+		return hitMask & node.childMask;
+	}
+
+	SIMD_TARGET_AVX2 __m256 DecodePlanesAvx2(const uint8_t planes[8], const float origin, const float scale)
+	{
+		const __m256i dwords = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(planes)));
+		return _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(dwords), _mm256_set1_ps(scale)), _mm256_set1_ps(origin));
+	}
+
+	SIMD_TARGET_AVX2 uint32_t IntersectQuantizedChildrenAvx2(const Bvh8QuantizedNode& node, const Bvh8Ray& ray, const float tMin, const float tMax, float outEntries[8])
+	{
+		const __m256 originX = _mm256_set1_ps(ray.origin.x);
+		const __m256 originY = _mm256_set1_ps(ray.origin.y);
+		const __m256 originZ = _mm256_set1_ps(ray.origin.z);
+		const __m256 invDirX = _mm256_set1_ps(ray.invDirection.x);
+		const __m256 invDirY = _mm256_set1_ps(ray.invDirection.y);
+		const __m256 invDirZ = _mm256_set1_ps(ray.invDirection.z);
+
+		const __m256 nearX = _mm256_mul_ps(_mm256_sub_ps(DecodePlanesAvx2(node.planes[ray.nearPlane[0]], node.origin[0], node.scale[0]), originX), invDirX);
+		const __m256 nearY = _mm256_mul_ps(_mm256_sub_ps(DecodePlanesAvx2(node.planes[ray.nearPlane[1]], node.origin[1], node.scale[1]), originY), invDirY);
+		const __m256 nearZ = _mm256_mul_ps(_mm256_sub_ps(DecodePlanesAvx2(node.planes[ray.nearPlane[2]], node.origin[2], node.scale[2]), originZ), invDirZ);
+		const __m256 farX = _mm256_mul_ps(_mm256_sub_ps(DecodePlanesAvx2(node.planes[ray.farPlane[0]], node.origin[0], node.scale[0]), originX), invDirX);
+		const __m256 farY = _mm256_mul_ps(_mm256_sub_ps(DecodePlanesAvx2(node.planes[ray.farPlane[1]], node.origin[1], node.scale[1]), originY), invDirY);
+		const __m256 farZ = _mm256_mul_ps(_mm256_sub_ps(DecodePlanesAvx2(node.planes[ray.farPlane[2]], node.origin[2], node.scale[2]), originZ), invDirZ);
+
+		const __m256 entry = _mm256_max_ps(_mm256_max_ps(nearX, nearY), _mm256_max_ps(nearZ, _mm256_set1_ps(tMin)));
+		const __m256 exit = _mm256_min_ps(_mm256_mul_ps(_mm256_min_ps(_mm256_min_ps(farX, farY), farZ), _mm256_set1_ps(k_bvh8RobustExitScale)), _mm256_set1_ps(tMax));
+		_mm256_storeu_ps(outEntries, entry);
+		return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ))) & node.childMask;
+	}
+
+#endif
+
+}
+
+void QuantizeBvh8Nodes(const std::vector<Bvh8Node>& nodes, std::vector<Bvh8QuantizedNode>& outNodes)
+{
+	outNodes.resize(nodes.size());
+	for (size_t nodeIdx = 0; nodeIdx < nodes.size(); nodeIdx++)
+	{
+		const Bvh8Node& node = nodes[nodeIdx];
+		Bvh8QuantizedNode& quantized = outNodes[nodeIdx];
+
+		Aabb childBounds[8];
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			quantized.child[slot] = node.child[slot];
+
+			assert(node.primitiveCount[slot] <= 0xff && "Leaf too large for a quantized node");
+			quantized.primitiveCount[slot] = static_cast<uint8_t>(node.primitiveCount[slot]);
+
+			childBounds[slot] = GetBvh8ChildBounds(node, slot);
+		}
+
+		SetBvh8ChildBounds(quantized, childBounds);
+	}
+}
+
+void SetBvh8ChildBounds(Bvh8QuantizedNode& node, const Aabb childBounds[8])
+{
+	node.childMask = 0;
+	std::memset(node.origin, 0, sizeof(node.origin));
+	std::memset(node.scale, 0, sizeof(node.scale));
+	std::memset(node.planes, 0, sizeof(node.planes));
+	std::memset(node.padding, 0, sizeof(node.padding));
+
+	// Unused slots have an inverted box
+	for (uint32_t slot = 0; slot < 8; slot++)
+	{
+		if (childBounds[slot].lower.x <= childBounds[slot].upper.x)
+		{
+			node.childMask |= static_cast<uint8_t>(1u << slot);
+		}
+	}
+
+	Aabb bounds = { { 0.f, 0.f, 0.f }, { 0.f, 0.f, 0.f } };
+	for (uint32_t slot = 0; slot < 8; slot++)
+	{
+		if (node.childMask & (1u << slot))
+		{
+			bounds = node.childMask & ((1u << slot) - 1) ? Union(bounds, childBounds[slot]) : childBounds[slot];
+		}
+	}
+
+	const float lower[3] = { bounds.lower.x, bounds.lower.y, bounds.lower.z };
+	const float upper[3] = { bounds.upper.x, bounds.upper.y, bounds.upper.z };
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		node.origin[axis] = lower[axis];
+		node.scale[axis] = ComputeScale(lower[axis], upper[axis]);
+	}
+
+	for (uint32_t slot = 0; slot < 8; slot++)
+	{
+		if ((node.childMask & (1u << slot)) == 0)
+		{
+			continue;
+		}
+
+		const float childLower[3] = { childBounds[slot].lower.x, childBounds[slot].lower.y, childBounds[slot].lower.z };
+		const float childUpper[3] = { childBounds[slot].upper.x, childBounds[slot].upper.y, childBounds[slot].upper.z };
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			node.planes[2 * axis][slot] = QuantizeLower(childLower[axis], node.origin[axis], node.scale[axis]);
+			node.planes[2 * axis + 1][slot] = QuantizeUpper(childUpper[axis], node.origin[axis], node.scale[axis]);
+		}
+	}
+}
+
+Aabb GetBvh8ChildBounds(const Bvh8QuantizedNode& node, const uint32_t slot)
+{
+	if ((node.childMask & (1u << slot)) == 0)
+	{
+		return Aabb{};
+	}
+
+	return {
+		{
+			DecodePlane(node.planes[0][slot], node.origin[0], node.scale[0]),
+			DecodePlane(node.planes[2][slot], node.origin[1], node.scale[1]),
+			DecodePlane(node.planes[4][slot], node.origin[2], node.scale[2]) },
+		{
+			DecodePlane(node.planes[1][slot], node.origin[0], node.scale[0]),
+			DecodePlane(node.planes[3][slot], node.origin[1], node.scale[1]),
+			DecodePlane(node.planes[5][slot], node.origin[2], node.scale[2]) } };
+}
+
+Bvh8QuantizedIntersectChildrenFunc GetBvh8QuantizedIntersectChildren(const SimdIsa isa)
+{
+	assert(IsSimdIsaSupported(isa));
+
+	switch (isa)
+	{
+#if SIMD_ISA_X86
+	case SimdIsa::Sse:
+		return IntersectQuantizedChildrenSse;
+	case SimdIsa::Avx2:
+		return IntersectQuantizedChildrenAvx2;
+#endif
+	default:
+		return IntersectQuantizedChildrenScalar;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "Bvh8.h"
+#include "SimdIsa.h"
+
+#include <cstdint>
+#include <vector>
+
+// Bvh8Node in half the memory. The child planes are stored as 8-bit offsets from the lower corner of the node in
+// steps of a power of two per axis, lower planes rounded down and upper planes rounded up, so that a decoded box
+// always contains the exact one. The step being a power of two makes origin + q * scale round only once, in the
+// same way in every kernel.
+struct Bvh8QuantizedNode
+{
+	float origin[3];
+	float scale[3];
+	uint8_t planes[6][8];			// in the order of Bvh8Node::planes
+	uint32_t child[8];				// as in Bvh8Node
+	uint8_t primitiveCount[8];
+	uint8_t childMask;				// slots in use, the planes of the others are zero
+	uint8_t padding[15];
+};
+
+static_assert(sizeof(Bvh8QuantizedNode) == 128, "Bvh8QuantizedNode is expected to span two cache lines");
+
+// Leaves have to have fewer than 256 primitives
+void QuantizeBvh8Nodes(const std::vector<Bvh8Node>& nodes, std::vector<Bvh8QuantizedNode>& outNodes);
+
+// Quantizes the boxes of all of the children of a node, eg. after RefitBvh8. Empty boxes mark the unused slots.
+void SetBvh8ChildBounds(Bvh8QuantizedNode& node, const Aabb childBounds[8]);
+
+// Decoded box of one child, as the kernels see it. Empty for an unused slot.
+Aabb GetBvh8ChildBounds(const Bvh8QuantizedNode& node, const uint32_t slot);
+
+// Same contract as Bvh8IntersectChildrenFunc, decoding the child boxes on the fly. The packet kernels are in RayPacket.h.
+using Bvh8QuantizedIntersectChildrenFunc = uint32_t (*)(const Bvh8QuantizedNode& node, const Bvh8Ray& ray, const float tMin, const float tMax, float outEntries[8]);
+
+Bvh8QuantizedIntersectChildrenFunc GetBvh8QuantizedIntersectChildren(const SimdIsa isa);
@@ -0,0 +1,300 @@
+#include "BvhFile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr uint32_t k_bvhFileMagic = 0x38485642;		// "BVH8"
+
+	// Sections start on cache lines, which the mapping itself is aligned to
+	constexpr uint64_t k_sectionAlignment = 64;
+
+	constexpr uint64_t k_fnvOffsetBasis = 14695981039346656037ull;
+	constexpr uint64_t k_fnvPrime = 1099511628211ull;
+
+	uint64_t AlignSection(const uint64_t offset)
+	{
+		return (offset + k_sectionAlignment - 1) & ~(k_sectionAlignment - 1);
+	}
+
+	uint64_t HashBytes(uint64_t hash, const void* data, const size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < size; i++)
+		{
+			hash ^= bytes[i];
+			hash *= k_fnvPrime;
+		}
+
+		return hash;
+	}
+
+	// FNV-1a on 64-bit words in four interleaved lanes, which runs at several times the speed of the byte at a time
+	// version on the tens of megabytes of a large mesh. The lanes and the bytes past the last block are hashed into
+	// hash the usual way.
+	uint64_t HashLargeBytes(const uint64_t hash, const void* data, const size_t size)
+	{
+		const uint8_t* bytes = static_cast<const uint8_t*>(data);
+		const size_t blockCount = size / 32;
+
+		uint64_t lanes[4] = { hash, hash ^ 1, hash ^ 2, hash ^ 3 };
+		for (size_t blockIdx = 0; blockIdx < blockCount; blockIdx++)
+		{
+			uint64_t words[4];
+			memcpy(words, bytes + 32 * blockIdx, sizeof(words));
+			for (uint32_t lane = 0; lane < 4; lane++)
+			{
+				lanes[lane] = (lanes[lane] ^ words[lane]) * k_fnvPrime;
+			}
+		}
+
+		return HashBytes(HashBytes(hash, lanes, sizeof(lanes)), bytes + 32 * blockCount, size - 32 * blockCount);
+	}
+
+	template<typename T>
+	uint64_t HashArray(const uint64_t hash, const std::vector<T>& values)
+	{
+		// The count keeps eg. a vertex moved from the end of positions to uvs from hashing the same
+		const uint64_t count = values.size();
+		return HashLargeBytes(HashBytes(hash, &count, sizeof(count)), values.data(), values.size() * sizeof(T));
+	}
+
+	// Whether a header read from a file describes that file
+	bool IsHeaderValid(const BvhFileHeader& header, const uint64_t fileSize, const uint64_t contentHash)
+	{
+		if (header.magic != k_bvhFileMagic || header.version != k_bvhFileVersion || header.contentHash != contentHash || header.fileSize != fileSize)
+		{
+			return false;
+		}
+
+		for (const BvhFileHeader::SectionRange& range : header.sections)
+		{
+			if (range.offset % k_sectionAlignment != 0 || range.offset < sizeof(BvhFileHeader) || range.offset > fileSize || range.size > fileSize - range.offset)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+BvhFile::~BvhFile()
+{
+#if defined(_WIN32)
+	if (m_mapping)
+	{
+		UnmapViewOfFile(m_mapping);
+	}
+
+	if (m_mappingHandle)
+	{
+		CloseHandle(m_mappingHandle);
+	}
+#else
+	if (m_mapping)
+	{
+		munmap(m_mapping, m_size);
+	}
+#endif
+}
+
+std::unique_ptr<BvhFile> BvhFile::Create(
+	const BvhFileHeader& header,
+	const void* const sectionData[],
+	const size_t sectionSizes[])
+{
+	BvhFileHeader fileHeader = header;
+	fileHeader.magic = k_bvhFileMagic;
+	fileHeader.version = k_bvhFileVersion;
+
+	uint64_t fileSize = sizeof(BvhFileHeader);
+	for (size_t sectionIdx = 0; sectionIdx < static_cast<size_t>(BvhFileSection::Count); sectionIdx++)
+	{
+		fileHeader.sections[sectionIdx].offset = AlignSection(fileSize);
+		fileHeader.sections[sectionIdx].size = sectionSizes[sectionIdx];
+		fileSize = fileHeader.sections[sectionIdx].offset + sectionSizes[sectionIdx];
+	}
+
+	fileHeader.fileSize = fileSize;
+
+	std::unique_ptr<BvhFile> file(new BvhFile());
+	file->m_storage.resize((fileSize + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+	file->m_data = reinterpret_cast<const uint8_t*>(file->m_storage.data());
+	file->m_size = static_cast<size_t>(fileSize);
+
+	uint8_t* bytes = reinterpret_cast<uint8_t*>(file->m_storage.data());
+	memcpy(bytes, &fileHeader, sizeof(fileHeader));
+	for (size_t sectionIdx = 0; sectionIdx < static_cast<size_t>(BvhFileSection::Count); sectionIdx++)
+	{
+		if (sectionSizes[sectionIdx] > 0)
+		{
+			memcpy(bytes + fileHeader.sections[sectionIdx].offset, sectionData[sectionIdx], sectionSizes[sectionIdx]);
+		}
+	}
+
+	return file;
+}
+
+std::unique_ptr<BvhFile> BvhFile::Map(const std::string& path, const uint64_t contentHash)
+{
+	std::unique_ptr<BvhFile> file(new BvhFile());
+
+#if defined(_WIN32)
+	const HANDLE fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return nullptr;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || static_cast<uint64_t>(fileSize.QuadPart) < sizeof(BvhFileHeader))
+	{
+		CloseHandle(fileHandle);
+		return nullptr;
+	}
+
+	// The mapping object keeps the file open
+	file->m_mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	CloseHandle(fileHandle);
+	if (!file->m_mappingHandle)
+	{
+		return nullptr;
+	}
+
+	file->m_mapping = MapViewOfFile(file->m_mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	file->m_size = static_cast<size_t>(fileSize.QuadPart);
+#else
+	const int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return nullptr;
+	}
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || static_cast<uint64_t>(fileStat.st_size) < sizeof(BvhFileHeader))
+	{
+		close(fd);
+		return nullptr;
+	}
+
+	// The mapping stays valid after the descriptor is closed, and after the file is replaced
+	void* mapping = mmap(nullptr, static_cast<size_t>(fileStat.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		return nullptr;
+	}
+
+	file->m_mapping = mapping;
+	file->m_size = static_cast<size_t>(fileStat.st_size);
+#endif
+
+	if (!file->m_mapping)
+	{
+		return nullptr;
+	}
+
+	file->m_data = static_cast<const uint8_t*>(file->m_mapping);
+	if (!IsHeaderValid(file->GetHeader(), file->m_size, contentHash))
+	{
+		return nullptr;
+	}
+
+	return file;
+}
+
+std::unique_ptr<BvhFile> BvhFile::Clone() const
+{
+	std::unique_ptr<BvhFile> file(new BvhFile());
+	file->m_storage.resize((m_size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+	memcpy(file->m_storage.data(), m_data, m_size);
+	file->m_data = reinterpret_cast<const uint8_t*>(file->m_storage.data());
+	file->m_size = m_size;
+	return file;
+}
+
+bool BvhFile::Write(const std::string& path) const
+{
+	// Unique per file object, for builds of the same mesh racing each other
+	char suffix[32];
+	snprintf(suffix, sizeof(suffix), ".%p.tmp", static_cast<const void*>(this));
+	const std::string tempPath = path + suffix;
+
+	{
+		std::ofstream stream(tempPath, std::ios::binary | std::ios::trunc);
+		if (!stream.write(reinterpret_cast<const char*>(m_data), m_size))
+		{
+			stream.close();
+			remove(tempPath.c_str());
+			return false;
+		}
+	}
+
+#if defined(_WIN32)
+	if (!MoveFileExA(tempPath.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING))
+#else
+	if (rename(tempPath.c_str(), path.c_str()) != 0)
+#endif
+	{
+		remove(tempPath.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+const BvhFileHeader& BvhFile::GetHeader() const
+{
+	return *reinterpret_cast<const BvhFileHeader*>(m_data);
+}
+
+bool BvhFile::IsMapped() const
+{
+	return m_mapping != nullptr;
+}
+
+uint64_t HashBvhContent(
+	const std::vector<Vec3>& positions,
+	const std::vector<Vec2>& uvs,
+	const std::vector<uint32_t>& indices,
+	const void* settings,
+	const size_t settingsSize)
+{
+	uint64_t hash = HashBytes(k_fnvOffsetBasis, &k_bvhFileVersion, sizeof(k_bvhFileVersion));
+	hash = HashArray(hash, positions);
+	hash = HashArray(hash, uvs);
+	hash = HashArray(hash, indices);
+	return HashBytes(hash, settings, settingsSize);
+}
+
+std::string GetBvhFilePath(const std::string& directory, const uint64_t contentHash)
+{
+	char name[32];
+	snprintf(name, sizeof(name), "%016llx.bvh8", static_cast<unsigned long long>(contentHash));
+
+	if (directory.empty())
+	{
+		return name;
+	}
+
+	const char last = directory.back();
+	return (last == '/' || last == '\\') ? directory + name : directory + "/" + name;
+}
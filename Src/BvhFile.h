@@ -0,0 +1,133 @@
+#pragma once
+
+#include "CpuMath.h"
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Read-only array that does not own its elements, eg. a section of a BvhFile
+template<typename T>
+class ArrayView
+{
+public:
+	ArrayView() = default;
+	ArrayView(const T* data, const size_t size) : m_data(data), m_size(size) {}
+
+	const T& operator[](const size_t index) const { return m_data[index]; }
+	const T* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	const T* begin() const { return m_data; }
+	const T* end() const { return m_data + m_size; }
+
+private:
+	const T* m_data = nullptr;
+	size_t m_size = 0;
+};
+
+// Bump whenever the layout of the file or of anything stored in it changes, eg. Bvh8Node or TrianglePacket
+constexpr uint32_t k_bvhFileVersion = 2;
+
+enum class BvhFileSection
+{
+	Nodes,				// Bvh8Node
+	QuantizedNodes,		// Bvh8QuantizedNode
+	TrianglePackets,	// TrianglePacket
+	TriangleUvs,		// three Vec2 per packet lane
+	TriangleIndices,	// uint32_t per packet lane, the triangle in the mesh it was filled from, for refitting
+	Count
+};
+
+struct BvhFileHeader
+{
+	struct SectionRange
+	{
+		uint64_t offset;		// from the start of the file
+		uint64_t size;			// in bytes
+	};
+
+	uint32_t magic;
+	uint32_t version;
+	uint64_t contentHash;		// of what the BVH was built from, see HashBvhContent
+	uint64_t fileSize;
+	Aabb bounds;				// of the root
+	float sahCost;				// of the binary BVH
+	float bvh8SahCost;			// of the 8-wide one, which refits are measured against
+	uint32_t referenceCount;	// triangles in the leaves
+	uint32_t padding;
+	SectionRange sections[static_cast<size_t>(BvhFileSection::Count)];
+};
+
+// A mesh BVH in a single block of memory that can be written to disk as it is and mapped back in without any fix-up:
+// nodes refer to each other and to triangle packets by index, and the sections are found by their offsets from the
+// header. Files are only meant to be read on the kind of machine that wrote them, the layout is that of the structs.
+class BvhFile
+{
+public:
+	~BvhFile();
+
+	BvhFile(const BvhFile&) = delete;
+	BvhFile& operator=(const BvhFile&) = delete;
+
+	// Copies the sections after the header. Their offsets and the file size are filled in, the rest of the header is
+	// taken as it is.
+	static std::unique_ptr<BvhFile> Create(
+		const BvhFileHeader& header,
+		const void* const sectionData[],
+		const size_t sectionSizes[]);
+
+	// Maps a file read-only. Returns null if it does not exist, or if it was written by another version or from other
+	// content, in which case the BVH has to be built again.
+	static std::unique_ptr<BvhFile> Map(const std::string& path, const uint64_t contentHash);
+
+	// Copy in memory, eg. of a mapped file that is about to be refit
+	std::unique_ptr<BvhFile> Clone() const;
+
+	// Writes to a temporary file first and renames it, so that a file that is being mapped is never seen half written
+	bool Write(const std::string& path) const;
+
+	const BvhFileHeader& GetHeader() const;
+
+	template<typename T>
+	ArrayView<T> GetSection(const BvhFileSection section) const
+	{
+		const BvhFileHeader::SectionRange& range = GetHeader().sections[static_cast<size_t>(section)];
+		return { reinterpret_cast<const T*>(m_data + range.offset), static_cast<size_t>(range.size / sizeof(T)) };
+	}
+
+	// Only for files in memory, mapped ones are read-only
+	template<typename T>
+	T* GetMutableSection(const BvhFileSection section)
+	{
+		assert(!IsMapped());
+		return const_cast<T*>(GetSection<T>(section).data());
+	}
+
+	bool IsMapped() const;
+
+private:
+	BvhFile() = default;
+
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	std::vector<uint64_t> m_storage;	// when created in memory, 64-bit elements keep the header aligned
+	void* m_mapping = nullptr;			// view of the file otherwise
+	void* m_mappingHandle = nullptr;	// file mapping object, Windows only
+};
+
+// 64-bit FNV-1a based hash of a mesh and everything else the BVH built from it depends on, to key the file it is
+// cached in
+uint64_t HashBvhContent(
+	const std::vector<Vec3>& positions,
+	const std::vector<Vec2>& uvs,
+	const std::vector<uint32_t>& indices,
+	const void* settings,
+	const size_t settingsSize);
+
+// Name of the cache file of a content hash within directory
+std::string GetBvhFilePath(const std::string& directory, const uint64_t contentHash);
@@ -0,0 +1,215 @@
+#include "BvhStats.h"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace
+{
+	template<typename Node>
+	BvhQualityStats ComputeQualityStats(const Node* nodes, const size_t nodeCount, const float traversalCost)
+	{
+		BvhQualityStats stats;
+		stats.nodeCount = nodeCount;
+		if (nodeCount == 0)
+		{
+			return stats;
+		}
+
+		// Children always come after their parent, so depths can be handed down in node order
+		std::vector<uint32_t> depths(nodeCount, 0);
+		double cost = 0.0;
+		double nodeArea = 0.0;
+		double overlapArea = 0.0;
+		double leafDepthSum = 0.0;
+		size_t childCount = 0;
+		float rootArea = 0.f;
+		for (size_t nodeIdx = 0; nodeIdx < nodeCount; nodeIdx++)
+		{
+			const Node& node = nodes[nodeIdx];
+
+			Aabb childBounds[8];
+			Aabb bounds;
+			for (uint32_t slot = 0; slot < 8; slot++)
+			{
+				childBounds[slot] = GetBvh8ChildBounds(node, slot);
+				if (childBounds[slot].IsEmpty())
+				{
+					continue;
+				}
+
+				bounds.Grow(childBounds[slot]);
+				childCount++;
+
+				const uint32_t primitiveCount = node.primitiveCount[slot];
+				if (primitiveCount > 0)
+				{
+					cost += static_cast<double>(childBounds[slot].SurfaceArea()) * primitiveCount;
+
+					stats.leafCount++;
+					stats.primitiveReferenceCount += primitiveCount;
+					stats.maxLeafDepth = (std::max)(stats.maxLeafDepth, depths[nodeIdx] + 1);
+					leafDepthSum += depths[nodeIdx] + 1;
+
+					if (stats.leafSizeHistogram.size() <= primitiveCount)
+					{
+						stats.leafSizeHistogram.resize(primitiveCount + 1, 0);
+					}
+
+					stats.leafSizeHistogram[primitiveCount]++;
+				}
+				else
+				{
+					depths[node.child[slot]] = depths[nodeIdx] + 1;
+				}
+			}
+
+			for (uint32_t slot = 0; slot < 8; slot++)
+			{
+				for (uint32_t other = slot + 1; other < 8; other++)
+				{
+					if (!childBounds[slot].IsEmpty() && !childBounds[other].IsEmpty())
+					{
+						overlapArea += Intersection(childBounds[slot], childBounds[other]).SurfaceArea();
+					}
+				}
+			}
+
+			const float area = bounds.SurfaceArea();
+			cost += static_cast<double>(area) * traversalCost;
+			nodeArea += area;
+			rootArea = nodeIdx == 0 ? area : rootArea;
+		}
+
+		stats.sahCost = rootArea > 0.f ? static_cast<float>(cost / rootArea) : traversalCost;
+		stats.averageLeafDepth = stats.leafCount > 0 ? static_cast<float>(leafDepthSum / stats.leafCount) : 0.f;
+		stats.averageChildCount = static_cast<float>(childCount) / nodeCount;
+		stats.siblingOverlap = nodeArea > 0.0 ? static_cast<float>(overlapArea / nodeArea) : 0.f;
+		return stats;
+	}
+
+	std::string Indent(const uint32_t indent)
+	{
+		return std::string(indent, '\t');
+	}
+
+	// Shortest form that reads back as the same float
+	std::string FormatNumber(const double value)
+	{
+		char text[32];
+		snprintf(text, sizeof(text), "%.9g", value);
+		return text;
+	}
+}
+
+BvhQualityStats ComputeBvhQualityStats(const Bvh8Node* nodes, const size_t nodeCount, const float traversalCost)
+{
+	return ComputeQualityStats(nodes, nodeCount, traversalCost);
+}
+
+BvhQualityStats ComputeBvhQualityStats(const Bvh8QuantizedNode* nodes, const size_t nodeCount, const float traversalCost)
+{
+	return ComputeQualityStats(nodes, nodeCount, traversalCost);
+}
+
+TraversalStats SummarizeTraversalCounters(const std::vector<TraversalCounters>& counters)
+{
+	TraversalStats stats;
+	stats.rayCount = counters.size();
+	if (counters.empty())
+	{
+		return stats;
+	}
+
+	double nodeCount = 0.0;
+	double triangleCount = 0.0;
+	for (const TraversalCounters& pixel : counters)
+	{
+		nodeCount += pixel.nodeCount;
+		triangleCount += pixel.triangleCount;
+		stats.maxNodes = (std::max)(stats.maxNodes, pixel.nodeCount);
+		stats.maxTriangles = (std::max)(stats.maxTriangles, pixel.triangleCount);
+	}
+
+	stats.nodesPerRay = nodeCount / counters.size();
+	stats.trianglesPerRay = triangleCount / counters.size();
+	return stats;
+}
+
+void MakeTraversalHeatmap(
+	const std::vector<TraversalCounters>& counters,
+	const TraversalCounter counter,
+	const uint32_t maxValue,
+	std::vector<Vec3>& outImage)
+{
+	outImage.resize(counters.size());
+	for (size_t pixelIdx = 0; pixelIdx < counters.size(); pixelIdx++)
+	{
+		const uint32_t value = counter == TraversalCounter::Nodes ? counters[pixelIdx].nodeCount : counters[pixelIdx].triangleCount;
+		const float x = maxValue > 0 ? (std::min)(1.f, static_cast<float>(value) / maxValue) : 0.f;
+
+		// Blue to green over the first half, green to red over the second
+		outImage[pixelIdx] = x < 0.5f ?
+			Vec3{ 0.f, 2.f * x, 1.f - 2.f * x } :
+			Vec3{ 2.f * x - 1.f, 2.f - 2.f * x, 0.f };
+	}
+}
+
+std::string FormatJson(const BvhQualityStats& stats, const uint32_t indent)
+{
+	const std::string fieldIndent = Indent(indent + 1);
+
+	std::string histogram;
+	for (size_t size = 0; size < stats.leafSizeHistogram.size(); size++)
+	{
+		histogram += (size > 0 ? ", " : "") + std::to_string(stats.leafSizeHistogram[size]);
+	}
+
+	return "{\n" +
+		fieldIndent + "\"sahCost\": " + FormatNumber(stats.sahCost) + ",\n" +
+		fieldIndent + "\"nodeCount\": " + std::to_string(stats.nodeCount) + ",\n" +
+		fieldIndent + "\"leafCount\": " + std::to_string(stats.leafCount) + ",\n" +
+		fieldIndent + "\"primitiveReferenceCount\": " + std::to_string(stats.primitiveReferenceCount) + ",\n" +
+		fieldIndent + "\"maxLeafDepth\": " + std::to_string(stats.maxLeafDepth) + ",\n" +
+		fieldIndent + "\"averageLeafDepth\": " + FormatNumber(stats.averageLeafDepth) + ",\n" +
+		fieldIndent + "\"averageChildCount\": " + FormatNumber(stats.averageChildCount) + ",\n" +
+		fieldIndent + "\"siblingOverlap\": " + FormatNumber(stats.siblingOverlap) + ",\n" +
+		fieldIndent + "\"leafSizeHistogram\": [" + histogram + "]\n" +
+		Indent(indent) + "}";
+}
+
+std::string FormatJson(const TraversalStats& stats, const uint32_t indent)
+{
+	const std::string fieldIndent = Indent(indent + 1);
+	return "{\n" +
+		fieldIndent + "\"rayCount\": " + std::to_string(stats.rayCount) + ",\n" +
+		fieldIndent + "\"nodesPerRay\": " + FormatNumber(stats.nodesPerRay) + ",\n" +
+		fieldIndent + "\"trianglesPerRay\": " + FormatNumber(stats.trianglesPerRay) + ",\n" +
+		fieldIndent + "\"maxNodes\": " + std::to_string(stats.maxNodes) + ",\n" +
+		fieldIndent + "\"maxTriangles\": " + std::to_string(stats.maxTriangles) + "\n" +
+		Indent(indent) + "}";
+}
+
+std::string QuoteJson(const std::string& value)
+{
+	std::string quoted = "\"";
+	for (const char c : value)
+	{
+		if (c == '"' || c == '\\')
+		{
+			quoted += '\\';
+			quoted += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			char escape[8];
+			snprintf(escape, sizeof(escape), "\\u%04x", c);
+			quoted += escape;
+		}
+		else
+		{
+			quoted += c;
+		}
+	}
+
+	return quoted + "\"";
+}
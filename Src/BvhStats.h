@@ -0,0 +1,67 @@
+#pragma once
+
+#include "Bvh8.h"
+#include "Bvh8Quantized.h"
+#include "CpuMath.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Measures of how good a BVH8 is, for comparing builders and settings
+struct BvhQualityStats
+{
+	float sahCost = 0.f;			// as ComputeBvh8SahCost, of the boxes traversal sees
+	size_t nodeCount = 0;
+	size_t leafCount = 0;			// child slots with primitives
+	size_t primitiveReferenceCount = 0;
+	uint32_t maxLeafDepth = 0;		// leaves in the root are at depth 1
+	float averageLeafDepth = 0.f;
+	float averageChildCount = 0.f;	// slots in use per node, out of 8
+	float siblingOverlap = 0.f;		// surface area of the overlaps of each pair of siblings, relative to that of their parents
+	std::vector<size_t> leafSizeHistogram;	// leaves by primitive count
+};
+
+BvhQualityStats ComputeBvhQualityStats(const Bvh8Node* nodes, const size_t nodeCount, const float traversalCost);
+BvhQualityStats ComputeBvhQualityStats(const Bvh8QuantizedNode* nodes, const size_t nodeCount, const float traversalCost);
+
+// Work done by the rays of a pixel
+struct TraversalCounters
+{
+	uint32_t nodeCount = 0;			// of both levels, each counted when its children are tested
+	uint32_t triangleCount = 0;		// tested, including the ones a leaf holds past the closest hit so far
+};
+
+// Per ray averages and maxima of a render
+struct TraversalStats
+{
+	size_t rayCount = 0;
+	double nodesPerRay = 0.0;
+	double trianglesPerRay = 0.0;
+	uint32_t maxNodes = 0;
+	uint32_t maxTriangles = 0;
+};
+
+TraversalStats SummarizeTraversalCounters(const std::vector<TraversalCounters>& counters);
+
+enum class TraversalCounter
+{
+	Nodes,
+	Triangles
+};
+
+// Heatmap of one of the counters, from blue at zero through green to red at maxValue and above
+void MakeTraversalHeatmap(
+	const std::vector<TraversalCounters>& counters,
+	const TraversalCounter counter,
+	const uint32_t maxValue,
+	std::vector<Vec3>& outImage);
+
+// JSON objects with the fields of the stats, for dashboards. Objects can be nested with the fields of the next level
+// indented by indent tabs.
+std::string FormatJson(const BvhQualityStats& stats, const uint32_t indent);
+std::string FormatJson(const TraversalStats& stats, const uint32_t indent);
+
+// String with the quotes and escapes of a JSON string
+std::string QuoteJson(const std::string& value);
@@ -0,0 +1,54 @@
+#include "stdafx.h"
+#include "CommandQueueFences.h"
+
+CommandQueueFences::~CommandQueueFences()
+{
+	if (m_fenceEvent)
+	{
+		CloseHandle(m_fenceEvent);
+	}
+}
+
+void CommandQueueFences::Init(ID3D12Device5* device, ID3D12CommandQueue* gfxQueue, ID3D12CommandQueue* computeQueue)
+{
+	m_queues[static_cast<size_t>(QueueType::Graphics)] = gfxQueue;
+	m_queues[static_cast<size_t>(QueueType::Compute)] = computeQueue;
+
+	for (auto& fence : m_fences)
+	{
+		CHECK(device->CreateFence(0, D3D12_FENCE_FLAG_NONE, IID_PPV_ARGS(fence.GetAddressOf())));
+	}
+
+	m_fences[static_cast<size_t>(QueueType::Graphics)]->SetName(L"gfx_queue_fence");
+	m_fences[static_cast<size_t>(QueueType::Compute)]->SetName(L"compute_queue_fence");
+
+	m_fenceEvent = CreateEventEx(nullptr, nullptr, 0, EVENT_ALL_ACCESS);
+}
+
+void CommandQueueFences::Signal(const QueueType queue, const uint64_t value)
+{
+	HRESULT hr = m_queues[static_cast<size_t>(queue)]->Signal(m_fences[static_cast<size_t>(queue)].Get(), value);
+	assert(SUCCEEDED(hr));
+}
+
+void CommandQueueFences::Wait(const QueueType waitingQueue, const QueueType signallingQueue, const uint64_t value)
+{
+	HRESULT hr = m_queues[static_cast<size_t>(waitingQueue)]->Wait(m_fences[static_cast<size_t>(signallingQueue)].Get(), value);
+	assert(SUCCEEDED(hr));
+}
+
+uint64_t CommandQueueFences::GetCompletedValue(const QueueType queue) const
+{
+	return m_fences[static_cast<size_t>(queue)]->GetCompletedValue();
+}
+
+void CommandQueueFences::WaitOnCPU(const QueueType queue, const uint64_t value)
+{
+	if (GetCompletedValue(queue) < value)
+	{
+		HRESULT hr = m_fences[static_cast<size_t>(queue)]->SetEventOnCompletion(value, m_fenceEvent);
+		assert(SUCCEEDED(hr));
+
+		WaitForSingleObjectEx(m_fenceEvent, INFINITE, FALSE);
+	}
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Common.h"
+#include "QueueScheduler.h"
+
+// One D3D12 fence per command queue
+class CommandQueueFences : public QueueFences
+{
+public:
+	~CommandQueueFences() override;
+	void Init(ID3D12Device5* device, ID3D12CommandQueue* gfxQueue, ID3D12CommandQueue* computeQueue);
+
+	void Signal(const QueueType queue, const uint64_t value) override;
+	void Wait(const QueueType waitingQueue, const QueueType signallingQueue, const uint64_t value) override;
+	uint64_t GetCompletedValue(const QueueType queue) const override;
+
+	// Blocks the CPU until the queue's fence reaches value
+	void WaitOnCPU(const QueueType queue, const uint64_t value);
+
+private:
+	static constexpr size_t k_queueCount = static_cast<size_t>(QueueType::Count);
+
+	std::array<ID3D12CommandQueue*, k_queueCount> m_queues = {};
+	std::array<Microsoft::WRL::ComPtr<ID3D12Fence>, k_queueCount> m_fences;
+	HANDLE m_fenceEvent = nullptr;
+};
@@ -3,18 +3,31 @@
 constexpr float k_Pi = 3.1415926535f;
 
 constexpr size_t k_gfxBufferCount = 2;
+constexpr char k_sceneFilePath[] = "../Content/Sponza/obj/sponza.obj"; // relative to the working directory
+constexpr char k_sceneTextureDirectory[] = "../Content/Sponza/textures/Compressed/"; // shared by the D3D12 and CPU paths, so forward slashes
 constexpr size_t k_screenWidth = 1280;
 constexpr size_t k_screenHeight = 720;
 constexpr size_t k_materialTextureCount = 128;
 constexpr size_t k_objectCount = 512;
 constexpr size_t k_uploadBufferSize = 40 * 1024 * 1024; // 40 MB
 constexpr size_t k_scratchDataSize = 40 * 1024 * 1024; // 40 MB
+constexpr size_t k_blasScratchArenaSize = 16 * 1024 * 1024; // 16 MB
 constexpr size_t k_geometryDataSize = 100 * 1024 * 1024; // 100 MB
+constexpr size_t k_blasMemoryBudget = 48 * 1024 * 1024; // 48 MB of the geometry heap
 constexpr size_t k_materialConstantsSize = 20 * 1024 * 1024; // 20 MB
 constexpr size_t k_constantBufferAlignment = 256 * 1024; // 256 K
 constexpr size_t k_maxRootSignatureSize = 6 * 2 * sizeof(DWORD); // 6 descriptor tables or 6 root parameters or 12 root constants
 constexpr size_t k_shaderRecordSize = (D3D12_SHADER_IDENTIFIER_SIZE_IN_BYTES + k_maxRootSignatureSize + (D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT - 1)) & ~(D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT - 1);
 constexpr size_t k_maxRtPipelineSubobjectCount = 64;
+constexpr uint32_t k_tlasMaxRefitCount = 120;
+constexpr uint8_t k_opacityAlphaCutoff = 128; // opacity mask texels at or above this pass the alpha test
+constexpr uint32_t k_alphaClipMaxHullVertices = 6;
+constexpr float k_alphaClipMinAreaReduction = 0.25f; // alpha tested triangles are only clipped if they shrink by at least this much
+constexpr bool k_triangleSplitEnabled = true;
+constexpr float k_triangleSplitMinBoundsToAreaRatio = 8.f; // split triangles whose box has more than this much surface area per unit of triangle area
+constexpr float k_triangleSplitBudget = 0.25f; // extra triangles allowed per mesh by the split
+constexpr size_t k_cpuFallbackDownscale = 2; // the CPU ray tracer renders at a fraction of the window resolution
+constexpr float k_tlasMaxQualityDegradation = 1.5f; // rebuild once the swept instance area has grown by 50%
 constexpr DXGI_FORMAT k_backBufferFormat = DXGI_FORMAT_R10G10B10A2_UNORM;
 constexpr DXGI_FORMAT k_backBufferRTVFormat = DXGI_FORMAT_R10G10B10A2_UNORM;
 constexpr DXGI_FORMAT k_depthStencilFormatRaw = DXGI_FORMAT_R24G8_TYPELESS;
@@ -1,3 +1,8 @@
+// Instance mask bits. Must match InstanceMask in SurfaceCategory.h
+#define INSTANCE_MASK_OPAQUE 0x01
+#define INSTANCE_MASK_ALPHA_TESTED 0x02
+#define INSTANCE_MASK_ALL 0xFF
+
 struct ObjectConstants
 {
     uint vertexStride;
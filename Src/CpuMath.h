@@ -0,0 +1,118 @@
+#pragma once
+
+#include <cfloat>
+#include <cmath>
+
+// Minimal vector math for the device independent code, which cannot depend on DirectXMath
+
+struct Vec2
+{
+	float x, y;
+};
+
+struct Vec3
+{
+	float x, y, z;
+};
+
+inline Vec3 operator+(const Vec3& a, const Vec3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline Vec3 operator-(const Vec3& a, const Vec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline Vec3 operator*(const Vec3& a, const float s) { return { a.x * s, a.y * s, a.z * s }; }
+
+inline Vec3 Min(const Vec3& a, const Vec3& b) { return { a.x < b.x ? a.x : b.x, a.y < b.y ? a.y : b.y, a.z < b.z ? a.z : b.z }; }
+inline Vec3 Max(const Vec3& a, const Vec3& b) { return { a.x > b.x ? a.x : b.x, a.y > b.y ? a.y : b.y, a.z > b.z ? a.z : b.z }; }
+
+inline float Dot(const Vec3& a, const Vec3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+inline Vec3 Cross(const Vec3& a, const Vec3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+inline float Length(const Vec3& a) { return std::sqrt(Dot(a, a)); }
+
+struct Aabb
+{
+	Vec3 lower = { FLT_MAX, FLT_MAX, FLT_MAX };
+	Vec3 upper = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+
+	bool IsEmpty() const
+	{
+		return lower.x > upper.x || lower.y > upper.y || lower.z > upper.z;
+	}
+
+	void Grow(const Vec3& p)
+	{
+		lower = Min(lower, p);
+		upper = Max(upper, p);
+	}
+
+	void Grow(const Aabb& box)
+	{
+		lower = Min(lower, box.lower);
+		upper = Max(upper, box.upper);
+	}
+
+	Vec3 Extent() const
+	{
+		return upper - lower;
+	}
+
+	Vec3 Center() const
+	{
+		return (lower + upper) * 0.5f;
+	}
+
+	float SurfaceArea() const
+	{
+		if (IsEmpty())
+		{
+			return 0.f;
+		}
+
+		const Vec3 e = Extent();
+		return 2.f * (e.x * e.y + e.y * e.z + e.z * e.x);
+	}
+};
+
+inline Aabb Union(const Aabb& a, const Aabb& b)
+{
+	Aabb result = a;
+	result.Grow(b);
+	return result;
+}
+
+// Empty if the boxes do not overlap
+inline Aabb Intersection(const Aabb& a, const Aabb& b)
+{
+	Aabb result;
+	result.lower = Max(a.lower, b.lower);
+	result.upper = Min(a.upper, b.upper);
+	return result;
+}
+
+// Transforms a box by a row major 4x4 matrix using the row vector convention (translation in the last row), as
+// stored in a DirectX::XMFLOAT4X4. The result is the tightest box around the transformed box.
+inline Aabb TransformAabb(const Aabb& box, const float m[4][4])
+{
+	if (box.IsEmpty())
+	{
+		return box;
+	}
+
+	const float lower[3] = { box.lower.x, box.lower.y, box.lower.z };
+	const float upper[3] = { box.upper.x, box.upper.y, box.upper.z };
+	float outLower[3] = { m[3][0], m[3][1], m[3][2] };
+	float outUpper[3] = { m[3][0], m[3][1], m[3][2] };
+
+	for (int col = 0; col < 3; col++)
+	{
+		for (int row = 0; row < 3; row++)
+		{
+			const float a = m[row][col] * lower[row];
+			const float b = m[row][col] * upper[row];
+			outLower[col] += a < b ? a : b;
+			outUpper[col] += a < b ? b : a;
+		}
+	}
+
+	Aabb result;
+	result.lower = { outLower[0], outLower[1], outLower[2] };
+	result.upper = { outUpper[0], outUpper[1], outUpper[2] };
+	return result;
+}
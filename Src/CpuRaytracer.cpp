@@ -0,0 +1,1132 @@
+#include "CpuRaytracer.h"
+#include "InstanceTransforms.h"
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+namespace
+{
+	// Matches Raygen.hlsl
+	constexpr float k_imagePlaneOffset = 1.f;
+	constexpr float k_rayTMin = 0.1f;
+	constexpr float k_rayTMax = 1000.f;
+
+	// Matches Miss.hlsl
+	constexpr float k_missColor = 0.2f;
+
+	// Rays of a stream traced breadth-first together. Large enough for the rays to share most of the top of the BVHs,
+	// and small enough for their state to stay in the L2 cache.
+	constexpr size_t k_rayStreamChunkSize = 4096;
+
+	// Cost of moving a ray into object space, relative to a triangle intersection
+	constexpr float k_instanceTransformCost = 1.f;
+
+	// Refit BVHs are rebuilt once their SAH cost has grown by half since their last build. There is no limit on the
+	// number of refits in between.
+	constexpr float k_maxRefitSahGrowth = 1.5f;
+	constexpr uint32_t k_maxRefitCount = UINT32_MAX;
+
+	// BVHs that Update has to rebuild hold up the frame, so they are built with the linear builder instead
+	constexpr uint32_t k_updateTreeletPassCount = 2;
+
+	// Nodes are clustered by the page, so that the nodes a ray visits after entering a cluster miss the TLB once
+	constexpr size_t k_nodeClusterBytes = 4096;
+
+	// Transform in the 3x4 column vector layout of an InstanceRecord
+	Vec3 TransformPoint(const float m[3][4], const Vec3& p)
+	{
+		return {
+			m[0][0] * p.x + m[0][1] * p.y + m[0][2] * p.z + m[0][3],
+			m[1][0] * p.x + m[1][1] * p.y + m[1][2] * p.z + m[1][3],
+			m[2][0] * p.x + m[2][1] * p.y + m[2][2] * p.z + m[2][3] };
+	}
+
+	Vec3 TransformVector(const float m[3][4], const Vec3& v)
+	{
+		return {
+			m[0][0] * v.x + m[0][1] * v.y + m[0][2] * v.z,
+			m[1][0] * v.x + m[1][1] * v.y + m[1][2] * v.z,
+			m[2][0] * v.x + m[2][1] * v.y + m[2][2] * v.z };
+	}
+
+	// Returns false if the transform cannot be inverted, eg. an instance scaled to zero
+	bool InvertTransform(const float m[3][4], float outInverse[3][4])
+	{
+		const float c00 = m[1][1] * m[2][2] - m[1][2] * m[2][1];
+		const float c01 = m[1][2] * m[2][0] - m[1][0] * m[2][2];
+		const float c02 = m[1][0] * m[2][1] - m[1][1] * m[2][0];
+		const float det = m[0][0] * c00 + m[0][1] * c01 + m[0][2] * c02;
+		if (det == 0.f || !std::isfinite(det))
+		{
+			return false;
+		}
+
+		const float invDet = 1.f / det;
+		outInverse[0][0] = c00 * invDet;
+		outInverse[0][1] = (m[0][2] * m[2][1] - m[0][1] * m[2][2]) * invDet;
+		outInverse[0][2] = (m[0][1] * m[1][2] - m[0][2] * m[1][1]) * invDet;
+		outInverse[1][0] = c01 * invDet;
+		outInverse[1][1] = (m[0][0] * m[2][2] - m[0][2] * m[2][0]) * invDet;
+		outInverse[1][2] = (m[0][2] * m[1][0] - m[0][0] * m[1][2]) * invDet;
+		outInverse[2][0] = c02 * invDet;
+		outInverse[2][1] = (m[0][1] * m[2][0] - m[0][0] * m[2][1]) * invDet;
+		outInverse[2][2] = (m[0][0] * m[1][1] - m[0][1] * m[1][0]) * invDet;
+
+		for (int row = 0; row < 3; row++)
+		{
+			outInverse[row][3] = -(outInverse[row][0] * m[0][3] + outInverse[row][1] * m[1][3] + outInverse[row][2] * m[2][3]);
+		}
+
+		return true;
+	}
+
+	Aabb TransformBounds(const float m[3][4], const Aabb& box)
+	{
+		Aabb result;
+		if (box.IsEmpty())
+		{
+			return result;
+		}
+
+		for (int corner = 0; corner < 8; corner++)
+		{
+			const Vec3 p = {
+				(corner & 1) ? box.upper.x : box.lower.x,
+				(corner & 2) ? box.upper.y : box.lower.y,
+				(corner & 4) ? box.upper.z : box.lower.z };
+			result.Grow(TransformPoint(m, p));
+		}
+
+		return result;
+	}
+
+	// HLSL float to uint conversion, which clamps negative values to zero
+	uint32_t ToTexelCoordinate(const float f)
+	{
+		if (!(f > 0.f))
+		{
+			return 0;
+		}
+
+		return f >= 4294967040.f ? UINT32_MAX : static_cast<uint32_t>(f);
+	}
+
+	// Goes through the same instance records Scene::CreateTLAS fills in, so that both paths place instances the same way
+	std::vector<InstanceRecord> MakeInstanceRecords(const SceneData& scene)
+	{
+		const size_t instanceCount = scene.instances.size();
+		InstanceTransforms transforms;
+		transforms.Resize(instanceCount);
+		for (size_t instanceIdx = 0; instanceIdx < instanceCount; instanceIdx++)
+		{
+			transforms.Set(instanceIdx, scene.instances[instanceIdx].localToWorld);
+		}
+
+		std::vector<InstanceRecordAttributes> attributes(instanceCount, InstanceRecordAttributes::Pack(0, 0xFF, 0, 0, 0));
+		std::vector<InstanceRecord> records(instanceCount);
+		WriteInstanceRecords(transforms, attributes.data(), 0, instanceCount, records.data());
+		return records;
+	}
+
+	// Element for element the math in Raygen.hlsl. The shaders are compiled with -Zpr, so viewMatrix._14_24_34
+	// is the last column of the matrix as it is laid out in memory.
+	struct PrimaryRays
+	{
+		Vec3 origin;
+		Vec3 originImagePlane;
+		Vec3 right;
+		Vec3 up;
+		uint32_t width;
+		uint32_t height;
+
+		static PrimaryRays Make(const SceneViewData& view, const uint32_t width, const uint32_t height)
+		{
+			auto column = [&view](const int col)
+			{
+				return Vec3{ view.viewMatrix[0][col], view.viewMatrix[1][col], view.viewMatrix[2][col] };
+			};
+
+			const Vec3 origin = column(3);
+			return { origin, origin + column(2) * k_imagePlaneOffset, column(0) * view.fovScale.x, column(1) * view.fovScale.y, width, height };
+		}
+
+		Vec3 Direction(const uint32_t x, const uint32_t y) const
+		{
+			const float u = x / static_cast<float>(width);
+			const float v = y / static_cast<float>(height);
+			const float ndcX = 2.f * u - 1.f;
+			const float ndcY = -2.f * v + 1.f;
+
+			const Vec3 p = originImagePlane + right * ndcX + up * ndcY;
+			const Vec3 d = p - origin;
+			return d * (1.f / Length(d));
+		}
+	};
+}
+
+void CpuRaytracer::Init(const SceneData& scene, const uint32_t threadCount)
+{
+	m_materials = scene.materials;
+	m_textures = scene.textures;
+
+	const auto startTime = std::chrono::steady_clock::now();
+
+	BvhBuildSettings bvhSettings;
+	bvhSettings.scheduler = &AcquireScheduler(threadCount);
+
+	m_stats = {};
+	m_meshes.clear();
+	m_meshes.resize(scene.meshes.size());
+
+	// Everything the mesh BVHs depend on besides the mesh itself, hashed into the key of their cache files. Only 32-bit
+	// fields, so that there is no padding to hash.
+	struct
+	{
+		uint32_t binCount;
+		uint32_t maxLeafSize;
+		float traversalCost;
+		float spatialSplitMinOverlap;
+		float spatialSplitMaxGrowth;
+		uint32_t bSpatialSplits;
+		uint32_t bCompressedNodes;
+		uint32_t nodeLayout;
+	} fileSettings = {
+		bvhSettings.binCount,
+		bvhSettings.maxLeafSize,
+		bvhSettings.traversalCost,
+		bvhSettings.spatialSplitMinOverlap,
+		bvhSettings.spatialSplitMaxGrowth,
+		0,
+		m_bCompressedNodes ? 1u : 0u,
+		static_cast<uint32_t>(m_nodeLayout) };
+
+	// Meshes are built in parallel, and the subtrees of each one too unless it has spatial splits, so that one large
+	// mesh does not hold up the rest
+	bvhSettings.scheduler->ParallelFor(scene.meshes.size(), 1, [&](const size_t begin, const size_t end)
+	{
+		for (size_t meshIdx = begin; meshIdx < end; meshIdx++)
+		{
+			const SceneMeshData& mesh = scene.meshes[meshIdx];
+
+			BvhBuildSettings meshSettings = bvhSettings;
+			meshSettings.bSpatialSplits = mesh.bSpatialSplits;
+
+			auto meshFileSettings = fileSettings;
+			meshFileSettings.bSpatialSplits = mesh.bSpatialSplits ? 1u : 0u;
+			const uint64_t contentHash = HashBvhContent(mesh.positions, mesh.uvs, mesh.indices, &meshFileSettings, sizeof(meshFileSettings));
+
+			std::unique_ptr<BvhFile> file;
+			if (!m_bvhCacheDirectory.empty())
+			{
+				file = BvhFile::Map(GetBvhFilePath(m_bvhCacheDirectory, contentHash), contentHash);
+			}
+
+			if (!file)
+			{
+				file = BuildMeshBvh(mesh, meshSettings, contentHash);
+
+				// A cache that cannot be written to only costs the next start its time
+				if (!m_bvhCacheDirectory.empty())
+				{
+					file->Write(GetBvhFilePath(m_bvhCacheDirectory, contentHash));
+				}
+			}
+
+			MeshBvh& meshBvh = m_meshes[meshIdx];
+			meshBvh.SetFile(std::move(file));
+			meshBvh.materialIndex = mesh.materialIndex;
+			meshBvh.refitPolicy.Init(k_maxRefitCount, k_maxRefitSahGrowth);
+			meshBvh.refitPolicy.OnRebuild(meshBvh.file->GetHeader().bvh8SahCost);
+		}
+	});
+
+	BuildTlas(scene, MakeInstanceRecords(scene), bvhSettings);
+	UpdateStats(scene);
+
+	m_stats.bvhBuildMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void CpuRaytracer::Update(const SceneData& scene, const std::vector<uint32_t>& deformedMeshes, const uint32_t threadCount)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+
+	TaskScheduler& scheduler = AcquireScheduler(threadCount);
+	BvhBuildSettings bvhSettings;
+	bvhSettings.builder = BvhBuilder::Linear;
+	bvhSettings.treeletPassCount = k_updateTreeletPassCount;
+	bvhSettings.scheduler = &scheduler;
+
+	std::atomic<size_t> rebuiltMeshCount(0);
+	scheduler.ParallelFor(deformedMeshes.size(), 1, [&](const size_t begin, const size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+		{
+			const uint32_t meshIdx = deformedMeshes[i];
+			const SceneMeshData& mesh = scene.meshes[meshIdx];
+			MeshBvh& meshBvh = m_meshes[meshIdx];
+
+			// Mapped files are read-only
+			if (meshBvh.file->IsMapped())
+			{
+				meshBvh.SetFile(meshBvh.file->Clone());
+			}
+
+			BvhFile& file = *meshBvh.file;
+			TrianglePacket* packets = file.GetMutableSection<TrianglePacket>(BvhFileSection::TrianglePackets);
+			const ArrayView<uint32_t> triangleIndices = file.GetSection<uint32_t>(BvhFileSection::TriangleIndices);
+			scheduler.ParallelFor(meshBvh.packets.size(), 1024, [&](const size_t packetBegin, const size_t packetEnd)
+			{
+				for (size_t packetIdx = packetBegin; packetIdx < packetEnd; packetIdx++)
+				{
+					for (uint32_t lane = 0; lane < k_trianglePacketWidth; lane++)
+					{
+						const uint32_t triangleIdx = triangleIndices[packetIdx * k_trianglePacketWidth + lane];
+						if (triangleIdx != UINT32_MAX)
+						{
+							const uint32_t* tri = &mesh.indices[3 * triangleIdx];
+							SetTrianglePacketLane(packets[packetIdx], lane, mesh.positions[tri[0]], mesh.positions[tri[1]], mesh.positions[tri[2]]);
+						}
+					}
+				}
+			});
+
+			auto leafBounds = [packets](const uint32_t firstPacket, const uint32_t triangleCount)
+			{
+				return ComputeTrianglePacketBounds(&packets[firstPacket], triangleCount);
+			};
+
+			Bvh8RefitResult refit;
+			if (meshBvh.quantizedNodes.empty())
+			{
+				Bvh8Node* nodes = file.GetMutableSection<Bvh8Node>(BvhFileSection::Nodes);
+				refit = RefitBvh8(nodes, meshBvh.nodes.size(), bvhSettings.traversalCost, scheduler, leafBounds);
+			}
+			else
+			{
+				Bvh8QuantizedNode* nodes = file.GetMutableSection<Bvh8QuantizedNode>(BvhFileSection::QuantizedNodes);
+				refit = RefitBvh8(nodes, meshBvh.quantizedNodes.size(), bvhSettings.traversalCost, scheduler, leafBounds);
+			}
+
+			if (meshBvh.refitPolicy.Decide(true, refit.sahCost) == AccelerationStructureUpdate::Rebuild)
+			{
+				BvhBuildSettings meshSettings = bvhSettings;
+				meshSettings.bSpatialSplits = mesh.bSpatialSplits;
+
+				// Not cached, the positions are only those of this frame
+				meshBvh.SetFile(BuildMeshBvh(mesh, meshSettings, 0));
+				meshBvh.refitPolicy.OnRebuild(meshBvh.file->GetHeader().bvh8SahCost);
+				rebuiltMeshCount++;
+			}
+			else
+			{
+				meshBvh.bounds = refit.bounds;
+				meshBvh.refitPolicy.OnRefit();
+			}
+		}
+	});
+
+	const std::vector<InstanceRecord> records = MakeInstanceRecords(scene);
+
+	// The top level BVH can only be refit while the same instances are valid, which a transform scaled to zero or a
+	// mesh that has collapsed changes
+	std::vector<Aabb> instanceBounds(m_instances.size());
+	bool bSameInstances = true;
+	for (size_t instanceIdx = 0; instanceIdx < m_instances.size() && bSameInstances; instanceIdx++)
+	{
+		Instance& instance = m_instances[instanceIdx];
+		const InstanceRecord& record = records[instance.sceneInstanceIndex];
+		const Aabb& bounds = m_meshes[instance.meshIndex].bounds;
+
+		bSameInstances = !bounds.IsEmpty() && InvertTransform(record.transform, instance.worldToObject);
+		instanceBounds[instanceIdx] = TransformBounds(record.transform, bounds);
+	}
+
+	for (size_t instanceIdx = 0; instanceIdx < scene.instances.size() && bSameInstances; instanceIdx++)
+	{
+		float worldToObject[3][4];
+		const bool bValid = !m_meshes[scene.instances[instanceIdx].meshIndex].bounds.IsEmpty() && InvertTransform(records[instanceIdx].transform, worldToObject);
+		bSameInstances = bValid == m_validSceneInstances[instanceIdx];
+	}
+
+	float tlasSahCost = 0.f;
+	if (bSameInstances)
+	{
+		tlasSahCost = RefitBvh8(m_tlasNodes.data(), m_tlasNodes.size(), bvhSettings.traversalCost, scheduler,
+			[&instanceBounds](const uint32_t firstInstance, const uint32_t instanceCount)
+			{
+				Aabb bounds;
+				for (uint32_t instanceIdx = firstInstance; instanceIdx < firstInstance + instanceCount; instanceIdx++)
+				{
+					bounds.Grow(instanceBounds[instanceIdx]);
+				}
+
+				return bounds;
+			}).sahCost;
+	}
+
+	m_stats.bTlasRebuilt = !bSameInstances || m_tlasRefitPolicy.Decide(true, tlasSahCost) == AccelerationStructureUpdate::Rebuild;
+	if (m_stats.bTlasRebuilt)
+	{
+		BuildTlas(scene, records, bvhSettings);
+	}
+	else
+	{
+		m_tlasRefitPolicy.OnRefit();
+	}
+
+	UpdateStats(scene);
+
+	m_stats.refitMeshCount = deformedMeshes.size() - rebuiltMeshCount;
+	m_stats.rebuiltMeshCount = rebuiltMeshCount;
+	m_stats.bvhUpdateMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+}
+
+void CpuRaytracer::BuildTlas(const SceneData& scene, const std::vector<InstanceRecord>& records, const BvhBuildSettings& settings)
+{
+	std::vector<Instance> instances;
+	std::vector<Aabb> instanceBounds;
+	std::vector<float> instanceCosts;
+	m_validSceneInstances.assign(scene.instances.size(), false);
+	for (size_t instanceIdx = 0; instanceIdx < scene.instances.size(); instanceIdx++)
+	{
+		Instance instance;
+		instance.meshIndex = scene.instances[instanceIdx].meshIndex;
+		instance.sceneInstanceIndex = static_cast<uint32_t>(instanceIdx);
+
+		const MeshBvh& mesh = m_meshes.at(instance.meshIndex);
+		if (mesh.bounds.IsEmpty() || !InvertTransform(records[instanceIdx].transform, instance.worldToObject))
+		{
+			continue;
+		}
+
+		m_validSceneInstances[instanceIdx] = true;
+		instances.push_back(instance);
+		instanceBounds.push_back(TransformBounds(records[instanceIdx].transform, mesh.bounds));
+		instanceCosts.push_back(k_instanceTransformCost + mesh.file->GetHeader().sahCost);
+	}
+
+	Bvh tlas;
+	tlas.Build(instanceBounds, settings);
+
+	Bvh8 tlas8;
+	tlas8.Build(tlas);
+
+	m_tlasNodes = tlas8.GetNodes();
+	ReorderBvh8Nodes(m_tlasNodes, m_nodeLayout, static_cast<uint32_t>(k_nodeClusterBytes / sizeof(Bvh8Node)));
+	m_instances.clear();
+	m_instances.reserve(instances.size());
+	for (const uint32_t primitiveIndex : tlas.GetPrimitiveIndices())
+	{
+		m_instances.push_back(instances[primitiveIndex]);
+	}
+
+	m_tlasRefitPolicy.Init(k_maxRefitCount, k_maxRefitSahGrowth);
+	m_tlasRefitPolicy.OnRebuild(ComputeBvh8SahCost(m_tlasNodes, settings.traversalCost));
+	m_stats.bvhSahCost = tlas.ComputeSahCost(settings.traversalCost, instanceCosts);
+}
+
+void CpuRaytracer::UpdateStats(const SceneData& scene)
+{
+	m_stats.triangleCount = 0;
+	m_stats.triangleReferenceCount = 0;
+	m_stats.bvhNodeCount = m_tlasNodes.size();
+	m_stats.bvhNodeBytes = m_tlasNodes.size() * sizeof(Bvh8Node);
+	m_stats.bvhCachedMeshCount = 0;
+	for (size_t meshIdx = 0; meshIdx < scene.meshes.size(); meshIdx++)
+	{
+		const MeshBvh& meshBvh = m_meshes[meshIdx];
+		m_stats.triangleCount += scene.meshes[meshIdx].indices.size() / 3;
+		m_stats.triangleReferenceCount += meshBvh.file->GetHeader().referenceCount;
+		m_stats.bvhNodeCount += meshBvh.nodes.size() + meshBvh.quantizedNodes.size();
+		m_stats.bvhNodeBytes += meshBvh.nodes.size() * sizeof(Bvh8Node) + meshBvh.quantizedNodes.size() * sizeof(Bvh8QuantizedNode);
+		m_stats.bvhCachedMeshCount += meshBvh.file->IsMapped() ? 1 : 0;
+	}
+
+	m_stats.instanceCount = m_instances.size();
+}
+
+void CpuRaytracer::MeshBvh::SetFile(std::unique_ptr<BvhFile> newFile)
+{
+	file = std::move(newFile);
+	nodes = file->GetSection<Bvh8Node>(BvhFileSection::Nodes);
+	quantizedNodes = file->GetSection<Bvh8QuantizedNode>(BvhFileSection::QuantizedNodes);
+	packets = file->GetSection<TrianglePacket>(BvhFileSection::TrianglePackets);
+	uvs = file->GetSection<TriangleUvs>(BvhFileSection::TriangleUvs);
+	bounds = file->GetHeader().bounds;
+}
+
+std::unique_ptr<BvhFile> CpuRaytracer::BuildMeshBvh(const SceneMeshData& mesh, const BvhBuildSettings& settings, const uint64_t contentHash) const
+{
+	Bvh bvh;
+	bvh.Build(mesh.positions, mesh.indices, settings);
+
+	Bvh8 bvh8;
+	bvh8.Build(bvh);
+
+	// Before the triangles are packed, so that the packets of the leaves of a cluster end up next to each other too
+	std::vector<Bvh8Node> nodes = bvh8.GetNodes();
+	const size_t storedNodeSize = m_bCompressedNodes ? sizeof(Bvh8QuantizedNode) : sizeof(Bvh8Node);
+	ReorderBvh8Nodes(nodes, m_nodeLayout, static_cast<uint32_t>(k_nodeClusterBytes / storedNodeSize));
+
+	std::vector<TrianglePacket> packets;
+	std::vector<TriangleUvs> uvs;
+	std::vector<uint32_t> triangleIndices;
+
+	// Pack the triangles of each leaf in node order and point the leaf at its first packet
+	const std::vector<uint32_t>& primitiveIndices = bvh.GetPrimitiveIndices();
+	for (Bvh8Node& node : nodes)
+	{
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			if (node.primitiveCount[slot] == 0)
+			{
+				continue;
+			}
+
+			const uint32_t firstPrimitive = node.child[slot];
+			node.child[slot] = static_cast<uint32_t>(packets.size());
+
+			for (uint32_t i = 0; i < node.primitiveCount[slot]; i++)
+			{
+				const uint32_t lane = i % k_trianglePacketWidth;
+				if (lane == 0)
+				{
+					packets.push_back({});
+					uvs.resize(packets.size() * k_trianglePacketWidth);
+					triangleIndices.resize(packets.size() * k_trianglePacketWidth, UINT32_MAX);
+				}
+
+				const uint32_t* tri = &mesh.indices[3 * primitiveIndices[firstPrimitive + i]];
+				SetTrianglePacketLane(packets.back(), lane, mesh.positions[tri[0]], mesh.positions[tri[1]], mesh.positions[tri[2]]);
+				uvs[uvs.size() - k_trianglePacketWidth + lane] = { { mesh.uvs[tri[0]], mesh.uvs[tri[1]], mesh.uvs[tri[2]] } };
+				triangleIndices[triangleIndices.size() - k_trianglePacketWidth + lane] = primitiveIndices[firstPrimitive + i];
+			}
+		}
+	}
+
+	// Before quantizing, which only makes the boxes larger
+	const float bvh8SahCost = ComputeBvh8SahCost(nodes, settings.traversalCost);
+
+	std::vector<Bvh8QuantizedNode> quantizedNodes;
+	if (m_bCompressedNodes)
+	{
+		QuantizeBvh8Nodes(nodes, quantizedNodes);
+		nodes.clear();
+	}
+
+	BvhFileHeader header = {};
+	header.contentHash = contentHash;
+	header.bounds = bvh.GetNodes().empty() ? Aabb{} : bvh.GetNodes()[0].bounds;
+	header.sahCost = bvh.ComputeSahCost(settings.traversalCost);
+	header.bvh8SahCost = bvh8SahCost;
+	header.referenceCount = static_cast<uint32_t>(primitiveIndices.size());
+
+	const void* sectionData[] = { nodes.data(), quantizedNodes.data(), packets.data(), uvs.data(), triangleIndices.data() };
+	const size_t sectionSizes[] = {
+		nodes.size() * sizeof(Bvh8Node),
+		quantizedNodes.size() * sizeof(Bvh8QuantizedNode),
+		packets.size() * sizeof(TrianglePacket),
+		uvs.size() * sizeof(TriangleUvs),
+		triangleIndices.size() * sizeof(uint32_t) };
+	static_assert(sizeof(sectionSizes) / sizeof(sectionSizes[0]) == static_cast<size_t>(BvhFileSection::Count), "One size per section");
+
+	return BvhFile::Create(header, sectionData, sectionSizes);
+}
+
+void CpuRaytracer::Render(
+	const SceneViewData& view,
+	const uint32_t width,
+	const uint32_t height,
+	const uint32_t threadCount,
+	std::vector<Vec3>& outImage) const
+{
+	outImage.resize(static_cast<size_t>(width) * height);
+
+	const PrimaryRays primaryRays = PrimaryRays::Make(view, width, height);
+	const Vec3& origin = primaryRays.origin;
+
+	const Vec3 missColor = { k_missColor, k_missColor, k_missColor };
+
+	// Work is handed out in ranges of tiles in row order, which the scheduler splits further where threads run out
+	const uint32_t tileCountX = (width + k_rayPacketTileSize - 1) / k_rayPacketTileSize;
+	const uint32_t tileCountY = (height + k_rayPacketTileSize - 1) / k_rayPacketTileSize;
+
+	AcquireScheduler(threadCount).ParallelFor(static_cast<size_t>(tileCountX) * tileCountY, 1, [&](const size_t begin, const size_t end)
+	{
+		RayPacket packet;
+		packet.origin = origin;
+		Hit hits[k_rayPacketSize];
+
+		for (size_t tileIdx = begin; tileIdx < end; tileIdx++)
+		{
+			// Tiles on the right and bottom edges are cropped to the image
+			const uint32_t tileX = static_cast<uint32_t>(tileIdx % tileCountX) * k_rayPacketTileSize;
+			const uint32_t tileY = static_cast<uint32_t>(tileIdx / tileCountX) * k_rayPacketTileSize;
+			const uint32_t tileWidth = (std::min)(k_rayPacketTileSize, width - tileX);
+			const uint32_t tileHeight = (std::min)(k_rayPacketTileSize, height - tileY);
+			const uint32_t pixelCount = tileWidth * tileHeight;
+
+			auto pixelIndex = [&](const uint32_t i)
+			{
+				return static_cast<size_t>(tileY + i / tileWidth) * width + tileX + i % tileWidth;
+			};
+
+			if (!m_bPacketTracing)
+			{
+				for (uint32_t i = 0; i < pixelCount; i++)
+				{
+					Hit hit;
+					outImage[pixelIndex(i)] = TraceClosest(origin, primaryRays.Direction(tileX + i % tileWidth, tileY + i / tileWidth), k_rayTMin, k_rayTMax, hit) ?
+						ShadeClosestHit(hit) : missColor;
+				}
+
+				continue;
+			}
+
+			packet.count = pixelCount;
+			for (uint32_t i = 0; i < pixelCount; i++)
+			{
+				const Vec3 direction = primaryRays.Direction(tileX + i % tileWidth, tileY + i / tileWidth);
+				packet.directions[0][i] = direction.x;
+				packet.directions[1][i] = direction.y;
+				packet.directions[2][i] = direction.z;
+			}
+
+			const uint64_t hitMask = TracePacket(packet, k_rayTMin, k_rayTMax, hits);
+			for (uint32_t i = 0; i < pixelCount; i++)
+			{
+				outImage[pixelIndex(i)] = (hitMask >> i) & 1 ? ShadeClosestHit(hits[i]) : missColor;
+			}
+		}
+	});
+}
+
+void CpuRaytracer::RenderTraversalCounts(
+	const SceneViewData& view,
+	const uint32_t width,
+	const uint32_t height,
+	const uint32_t threadCount,
+	std::vector<TraversalCounters>& outCounters) const
+{
+	outCounters.assign(static_cast<size_t>(width) * height, TraversalCounters());
+
+	const PrimaryRays primaryRays = PrimaryRays::Make(view, width, height);
+	AcquireScheduler(threadCount).ParallelFor(height, 1, [&](const size_t begin, const size_t end)
+	{
+		for (size_t y = begin; y < end; y++)
+		{
+			for (uint32_t x = 0; x < width; x++)
+			{
+				Hit hit;
+				TraceClosest(primaryRays.origin, primaryRays.Direction(x, static_cast<uint32_t>(y)), k_rayTMin, k_rayTMax, hit, &outCounters[y * width + x]);
+			}
+		}
+	});
+}
+
+void CpuRaytracer::ComputeBvhQuality(BvhQualityStats& outTlas, std::vector<BvhQualityStats>& outMeshes) const
+{
+	// The same costs the BVHs were built with
+	const float traversalCost = BvhBuildSettings().traversalCost;
+	outTlas = ComputeBvhQualityStats(m_tlasNodes.data(), m_tlasNodes.size(), traversalCost);
+
+	outMeshes.resize(m_meshes.size());
+	for (size_t meshIdx = 0; meshIdx < m_meshes.size(); meshIdx++)
+	{
+		const MeshBvh& mesh = m_meshes[meshIdx];
+		outMeshes[meshIdx] = mesh.quantizedNodes.empty() ?
+			ComputeBvhQualityStats(mesh.nodes.data(), mesh.nodes.size(), traversalCost) :
+			ComputeBvhQualityStats(mesh.quantizedNodes.data(), mesh.quantizedNodes.size(), traversalCost);
+	}
+}
+
+bool CpuRaytracer::CastRay(const Vec3& origin, const Vec3& direction, const float tMin, const float tMax, float& outT) const
+{
+	Hit hit;
+	if (!TraceClosest(origin, direction, tMin, tMax, hit))
+	{
+		return false;
+	}
+
+	outT = hit.t;
+	return true;
+}
+
+void CpuRaytracer::TraceRayStream(const std::vector<StreamRay>& rays, const uint32_t threadCount, std::vector<float>& outHitT) const
+{
+	outHitT.assign(rays.size(), std::numeric_limits<float>::infinity());
+
+	std::vector<uint32_t> order;
+	SortRayStream(rays.data(), rays.size(), order);
+
+	// Indexed by the position of a ray within its chunk, and kept for each thread across the chunks it traces
+	struct ChunkState
+	{
+		std::vector<Bvh8Ray> worldRays;
+		std::vector<Bvh8Ray> objectRays;
+		std::vector<WatertightRay> objectWatertightRays;
+		std::vector<float> closestT;
+		std::vector<uint8_t> hits;
+		std::vector<RayStreamEntry> rootEntries;
+		std::vector<RayStreamEntry> instanceEntries;
+		RayStreamScratch tlasScratch;
+		RayStreamScratch meshScratch;
+	};
+
+	TaskScheduler& scheduler = AcquireScheduler(threadCount);
+	std::vector<ChunkState> threadStates(scheduler.GetThreadCount());
+
+	const size_t chunkCount = (rays.size() + k_rayStreamChunkSize - 1) / k_rayStreamChunkSize;
+	scheduler.ParallelFor(chunkCount, 1, [&](const size_t beginChunk, const size_t endChunk)
+	{
+		ChunkState& state = threadStates[scheduler.GetThreadIndex()];
+		state.worldRays.resize(k_rayStreamChunkSize);
+		state.objectRays.resize(k_rayStreamChunkSize);
+		state.objectWatertightRays.resize(k_rayStreamChunkSize);
+		state.closestT.resize(k_rayStreamChunkSize);
+		state.hits.resize(k_rayStreamChunkSize);
+		state.rootEntries.resize(k_rayStreamChunkSize);
+
+		for (size_t chunkIdx = beginChunk; chunkIdx < endChunk; chunkIdx++)
+		{
+			const size_t chunkBegin = chunkIdx * k_rayStreamChunkSize;
+			const uint32_t* chunkOrder = &order[chunkBegin];
+			const size_t chunkSize = (std::min)(k_rayStreamChunkSize, rays.size() - chunkBegin);
+			for (uint32_t ray = 0; ray < chunkSize; ray++)
+			{
+				const StreamRay& streamRay = rays[chunkOrder[ray]];
+				state.worldRays[ray] = Bvh8Ray::Make(streamRay.origin, streamRay.direction);
+				state.closestT[ray] = streamRay.tMax;
+				state.hits[ray] = 0;
+				state.rootEntries[ray] = { ray, streamRay.tMin };
+			}
+
+			auto intersectWorldChildren = [&](const Bvh8Node& node, const uint32_t ray, const float tMax, float outEntries[8])
+			{
+				return m_intersectChildren(node, state.worldRays[ray], rays[chunkOrder[ray]].tMin, tMax, outEntries);
+			};
+
+			TraverseBvh8Stream(m_tlasNodes, state.rootEntries.data(), chunkSize, state.closestT.data(), state.tlasScratch, intersectWorldChildren, [&](const uint32_t firstInstance, const uint32_t instanceCount, const RayStreamEntry* activeRays, const size_t activeCount)
+			{
+				for (uint32_t instanceIdx = firstInstance; instanceIdx < firstInstance + instanceCount; instanceIdx++)
+				{
+					const Instance& instance = m_instances[instanceIdx];
+					const MeshBvh& mesh = m_meshes[instance.meshIndex];
+
+					state.instanceEntries.clear();
+					for (size_t i = 0; i < activeCount; i++)
+					{
+						const uint32_t ray = activeRays[i].ray;
+						const StreamRay& streamRay = rays[chunkOrder[ray]];
+						const Vec3 objectOrigin = TransformPoint(instance.worldToObject, streamRay.origin);
+						const Vec3 objectDirection = TransformVector(instance.worldToObject, streamRay.direction);
+						state.objectRays[ray] = Bvh8Ray::Make(objectOrigin, objectDirection);
+						state.objectWatertightRays[ray] = WatertightRay::Make(objectOrigin, objectDirection);
+						state.instanceEntries.push_back({ ray, streamRay.tMin });
+					}
+
+					auto intersectObjectChildren = [&](const Bvh8Node& node, const uint32_t ray, const float tMax, float outEntries[8])
+					{
+						return m_intersectChildren(node, state.objectRays[ray], rays[chunkOrder[ray]].tMin, tMax, outEntries);
+					};
+
+					auto intersectQuantizedObjectChildren = [&](const Bvh8QuantizedNode& node, const uint32_t ray, const float tMax, float outEntries[8])
+					{
+						return m_intersectQuantizedChildren(node, state.objectRays[ray], rays[chunkOrder[ray]].tMin, tMax, outEntries);
+					};
+
+					auto intersectLeaf = [&](const uint32_t firstPacket, const uint32_t triangleCount, const RayStreamEntry* leafRays, const size_t leafRayCount)
+					{
+						for (size_t i = 0; i < leafRayCount; i++)
+						{
+							const uint32_t ray = leafRays[i].ray;
+							TrianglePacketHit packetHit;
+							if (m_intersectTriangles(&mesh.packets[firstPacket], triangleCount, state.objectWatertightRays[ray], rays[chunkOrder[ray]].tMin, state.closestT[ray], packetHit))
+							{
+								state.hits[ray] = 1;
+							}
+						}
+					};
+
+					if (mesh.quantizedNodes.empty())
+					{
+						TraverseBvh8Stream(mesh.nodes, state.instanceEntries.data(), state.instanceEntries.size(), state.closestT.data(), state.meshScratch, intersectObjectChildren, intersectLeaf);
+					}
+					else
+					{
+						TraverseBvh8Stream(mesh.quantizedNodes, state.instanceEntries.data(), state.instanceEntries.size(), state.closestT.data(), state.meshScratch, intersectQuantizedObjectChildren, intersectLeaf);
+					}
+				}
+			});
+
+			for (uint32_t ray = 0; ray < chunkSize; ray++)
+			{
+				if (state.hits[ray] != 0)
+				{
+					outHitT[chunkOrder[ray]] = state.closestT[ray];
+				}
+			}
+		}
+	});
+}
+
+void CpuRaytracer::SetTraversalIsa(const SimdIsa isa)
+{
+	m_traversalIsa = isa;
+	m_intersectChildren = GetBvh8IntersectChildren(isa);
+	m_intersectTriangles = GetIntersectTrianglePackets(isa);
+	m_intersectChildrenPacket = GetIntersectChildrenPacket(isa);
+	m_intersectTriangleRays = GetIntersectTriangleRayPacket(isa);
+	m_intersectQuantizedChildren = GetBvh8QuantizedIntersectChildren(isa);
+	m_intersectQuantizedChildrenPacket = GetIntersectQuantizedChildrenPacket(isa);
+}
+
+SimdIsa CpuRaytracer::GetTraversalIsa() const
+{
+	return m_traversalIsa;
+}
+
+void CpuRaytracer::SetPacketTracing(const bool bEnable)
+{
+	m_bPacketTracing = bEnable;
+}
+
+bool CpuRaytracer::GetPacketTracing() const
+{
+	return m_bPacketTracing;
+}
+
+void CpuRaytracer::SetCompressedNodes(const bool bEnable)
+{
+	m_bCompressedNodes = bEnable;
+}
+
+bool CpuRaytracer::GetCompressedNodes() const
+{
+	return m_bCompressedNodes;
+}
+
+void CpuRaytracer::SetNodeLayout(const Bvh8NodeLayout layout)
+{
+	m_nodeLayout = layout;
+}
+
+Bvh8NodeLayout CpuRaytracer::GetNodeLayout() const
+{
+	return m_nodeLayout;
+}
+
+void CpuRaytracer::SetNodePrefetch(const bool bEnable)
+{
+	m_bNodePrefetch = bEnable;
+}
+
+bool CpuRaytracer::GetNodePrefetch() const
+{
+	return m_bNodePrefetch;
+}
+
+void CpuRaytracer::SetBvhCacheDirectory(const std::string& directory)
+{
+	m_bvhCacheDirectory = directory;
+}
+
+const std::string& CpuRaytracer::GetBvhCacheDirectory() const
+{
+	return m_bvhCacheDirectory;
+}
+
+const CpuRaytracerStats& CpuRaytracer::GetStats() const
+{
+	return m_stats;
+}
+
+const TaskScheduler* CpuRaytracer::GetScheduler() const
+{
+	return m_scheduler.get();
+}
+
+TaskScheduler& CpuRaytracer::AcquireScheduler(const uint32_t threadCount) const
+{
+	const uint32_t clampedThreadCount = (std::max)(1u, threadCount);
+	if (!m_scheduler || m_scheduler->GetThreadCount() != clampedThreadCount)
+	{
+		m_scheduler.reset(new TaskScheduler(clampedThreadCount));
+	}
+
+	return *m_scheduler;
+}
+
+bool CpuRaytracer::TraceClosest(
+	const Vec3& origin,
+	const Vec3& direction,
+	const float tMin,
+	const float tMax,
+	Hit& outHit,
+	TraversalCounters* counters) const
+{
+	float closestT = tMax;
+	bool found = false;
+
+	auto intersectChildren = [&](const Bvh8Node& node, const Bvh8Ray& ray, const float nodeTMin, const float nodeTMax, float outEntries[8])
+	{
+		if (counters)
+		{
+			counters->nodeCount++;
+		}
+
+		return m_intersectChildren(node, ray, nodeTMin, nodeTMax, outEntries);
+	};
+
+	TraverseBvh8(m_tlasNodes, Bvh8Ray::Make(origin, direction), tMin, closestT, intersectChildren, [&](const uint32_t firstInstance, const uint32_t instanceCount)
+	{
+		for (uint32_t instanceIdx = firstInstance; instanceIdx < firstInstance + instanceCount; instanceIdx++)
+		{
+			found |= IntersectInstance(instanceIdx, origin, direction, tMin, closestT, outHit, counters);
+		}
+	}, m_bNodePrefetch);
+
+	return found;
+}
+
+uint64_t CpuRaytracer::TracePacket(const RayPacket& packet, const float tMin, const float tMax, Hit outHits[k_rayPacketSize]) const
+{
+	auto direction = [&packet](const uint32_t i)
+	{
+		return Vec3{ packet.directions[0][i], packet.directions[1][i], packet.directions[2][i] };
+	};
+
+	uint64_t hitMask = 0;
+
+	RayPacketSetup worldRays;
+	if (!RayPacketSetup::Make(packet, worldRays))
+	{
+		for (uint32_t i = 0; i < packet.count; i++)
+		{
+			hitMask |= (TraceClosest(packet.origin, direction(i), tMin, tMax, outHits[i]) ? uint64_t(1) : 0) << i;
+		}
+
+		return hitMask;
+	}
+
+	RayPacketHits hits;
+	uint32_t hitInstances[k_rayPacketSize];
+	std::fill(hits.t, hits.t + packet.count, tMax);
+
+	// Nodes are culled against the farthest of the hits, since anything beyond it is of no use to any of the rays
+	float packetT = tMax;
+	auto updatePacketT = [&]()
+	{
+		packetT = *std::max_element(hits.t, hits.t + packet.count);
+	};
+
+	TraverseBvh8(m_tlasNodes, worldRays, tMin, packetT, m_intersectChildrenPacket, [&](const uint32_t firstInstance, const uint32_t instanceCount)
+	{
+		for (uint32_t instanceIdx = firstInstance; instanceIdx < firstInstance + instanceCount; instanceIdx++)
+		{
+			const Instance& instance = m_instances[instanceIdx];
+
+			RayPacket objectPacket;
+			objectPacket.origin = TransformPoint(instance.worldToObject, packet.origin);
+			objectPacket.count = packet.count;
+			for (uint32_t i = 0; i < packet.count; i++)
+			{
+				const Vec3 objectDirection = TransformVector(instance.worldToObject, direction(i));
+				objectPacket.directions[0][i] = objectDirection.x;
+				objectPacket.directions[1][i] = objectDirection.y;
+				objectPacket.directions[2][i] = objectDirection.z;
+			}
+
+			RayPacketSetup objectRays;
+			if (!RayPacketSetup::Make(objectPacket, objectRays))
+			{
+				for (uint32_t i = 0; i < packet.count; i++)
+				{
+					Hit hit;
+					if (IntersectInstance(instanceIdx, packet.origin, direction(i), tMin, hits.t[i], hit))
+					{
+						hitInstances[i] = instanceIdx;
+						hits.triangle[i] = hit.triangleIndex;
+						hits.u[i] = hit.u;
+						hits.v[i] = hit.v;
+						hitMask |= uint64_t(1) << i;
+					}
+				}
+
+				updatePacketT();
+				continue;
+			}
+
+			const MeshBvh& mesh = m_meshes[instance.meshIndex];
+			auto intersectLeaf = [&](const uint32_t firstPacket, const uint32_t triangleCount)
+			{
+				uint64_t updated = 0;
+				for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+				{
+					const uint32_t triangleIndex = firstPacket * k_trianglePacketWidth + triangle;
+					updated |= m_intersectTriangleRays(
+						mesh.packets[triangleIndex / k_trianglePacketWidth], 
+						triangleIndex % k_trianglePacketWidth, 
+						triangleIndex, 
+						objectRays, 
+						tMin, 
+						hits);
+				}
+
+				if (updated == 0)
+				{
+					return;
+				}
+
+				for (uint32_t i = 0; i < packet.count; i++)
+				{
+					if ((updated >> i) & 1)
+					{
+						hitInstances[i] = instanceIdx;
+					}
+				}
+
+				hitMask |= updated;
+				updatePacketT();
+			};
+
+			if (mesh.quantizedNodes.empty())
+			{
+				TraverseBvh8(mesh.nodes, objectRays, tMin, packetT, m_intersectChildrenPacket, intersectLeaf, m_bNodePrefetch);
+			}
+			else
+			{
+				TraverseBvh8(mesh.quantizedNodes, objectRays, tMin, packetT, m_intersectQuantizedChildrenPacket, intersectLeaf, m_bNodePrefetch);
+			}
+		}
+	}, m_bNodePrefetch);
+
+	for (uint32_t i = 0; i < packet.count; i++)
+	{
+		if ((hitMask >> i) & 1)
+		{
+			outHits[i] = { hits.t[i], hits.u[i], hits.v[i], hitInstances[i], hits.triangle[i] };
+		}
+	}
+
+	return hitMask;
+}
+
+bool CpuRaytracer::IntersectInstance(
+	const uint32_t instanceIndex,
+	const Vec3& origin,
+	const Vec3& direction,
+	const float tMin,
+	float& inOutClosestT,
+	Hit& outHit,
+	TraversalCounters* counters) const
+{
+	// The direction is not renormalized, so t is the same in both spaces, as it is for ObjectRayDirection
+	const Instance& instance = m_instances[instanceIndex];
+	const Vec3 objectOrigin = TransformPoint(instance.worldToObject, origin);
+	const Vec3 objectDirection = TransformVector(instance.worldToObject, direction);
+	const MeshBvh& mesh = m_meshes[instance.meshIndex];
+	const WatertightRay objectRay = WatertightRay::Make(objectOrigin, objectDirection);
+
+	bool found = false;
+	auto intersectLeaf = [&](const uint32_t firstPacket, const uint32_t triangleCount)
+	{
+		if (counters)
+		{
+			counters->triangleCount += triangleCount;
+		}
+
+		TrianglePacketHit packetHit;
+		if (m_intersectTriangles(&mesh.packets[firstPacket], triangleCount, objectRay, tMin, inOutClosestT, packetHit))
+		{
+			outHit = { packetHit.t, packetHit.u, packetHit.v, instanceIndex, firstPacket * k_trianglePacketWidth + packetHit.triangle };
+			found = true;
+		}
+	};
+
+	// Either kind of node
+	auto countNode = [counters]()
+	{
+		if (counters)
+		{
+			counters->nodeCount++;
+		}
+	};
+
+	const Bvh8Ray ray = Bvh8Ray::Make(objectOrigin, objectDirection);
+	if (mesh.quantizedNodes.empty())
+	{
+		TraverseBvh8(mesh.nodes, ray, tMin, inOutClosestT, [&](const Bvh8Node& node, const Bvh8Ray& nodeRay, const float nodeTMin, const float nodeTMax, float outEntries[8])
+		{
+			countNode();
+			return m_intersectChildren(node, nodeRay, nodeTMin, nodeTMax, outEntries);
+		}, intersectLeaf, m_bNodePrefetch);
+	}
+	else
+	{
+		TraverseBvh8(mesh.quantizedNodes, ray, tMin, inOutClosestT, [&](const Bvh8QuantizedNode& node, const Bvh8Ray& nodeRay, const float nodeTMin, const float nodeTMax, float outEntries[8])
+		{
+			countNode();
+			return m_intersectQuantizedChildren(node, nodeRay, nodeTMin, nodeTMax, outEntries);
+		}, intersectLeaf, m_bNodePrefetch);
+	}
+
+	return found;
+}
+
+Vec3 CpuRaytracer::ShadeClosestHit(const Hit& hit) const
+{
+	const MeshBvh& mesh = m_meshes[m_instances[hit.instanceIndex].meshIndex];
+	const TriangleUvs& tri = mesh.uvs[hit.triangleIndex];
+	const SceneMaterialData& material = m_materials.at(mesh.materialIndex);
+
+	// UNTEXTURED permutation of ClosestHit.hlsl
+	if (material.baseColorTexture < 0)
+	{
+		return material.baseColor;
+	}
+
+	const float w0 = 1.f - hit.u - hit.v;
+	const float uvX = w0 * tri.uvs[0].x + hit.u * tri.uvs[1].x + hit.v * tri.uvs[2].x;
+	const float uvY = w0 * tri.uvs[0].y + hit.u * tri.uvs[1].y + hit.v * tri.uvs[2].y;
+
+	const SceneTextureData& texture = m_textures.at(material.baseColorTexture);
+	return texture.Load(ToTexelCoordinate(uvX * texture.width), ToTexelCoordinate(uvY * texture.height));
+}
+
+bool WriteImagePpm(const std::string& path, const uint32_t width, const uint32_t height, const std::vector<Vec3>& image)
+{
+	std::ofstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	file << "P6\n" << width << " " << height << "\n255\n";
+
+	auto quantize = [](const float c)
+	{
+		return static_cast<uint8_t>((std::min)((std::max)(c, 0.f), 1.f) * 255.f + 0.5f);
+	};
+
+	std::vector<uint8_t> row(static_cast<size_t>(width) * 3);
+	for (uint32_t y = 0; y < height; y++)
+	{
+		for (uint32_t x = 0; x < width; x++)
+		{
+			const Vec3& c = image[static_cast<size_t>(y) * width + x];
+			row[3 * x] = quantize(c.x);
+			row[3 * x + 1] = quantize(c.y);
+			row[3 * x + 2] = quantize(c.z);
+		}
+
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+
+	return static_cast<bool>(file);
+}
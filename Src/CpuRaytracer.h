@@ -0,0 +1,220 @@
+#pragma once
+
+#include "Bvh8.h"
+#include "Bvh8Quantized.h"
+#include "BvhFile.h"
+#include "BvhStats.h"
+#include "CpuMath.h"
+#include "InstanceTransforms.h"
+#include "RayPacket.h"
+#include "RayStream.h"
+#include "RefitPolicy.h"
+#include "SceneData.h"
+#include "TaskScheduler.h"
+#include "TrianglePacket.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct CpuRaytracerStats
+{
+	size_t triangleCount = 0;		// unique triangles, each mesh is stored once however many instances use it
+	size_t triangleReferenceCount = 0;	// triangles in the leaves of the mesh BVHs, more than triangleCount after spatial splits
+	size_t instanceCount = 0;
+	size_t bvhNodeCount = 0;		// 8-wide nodes of the top level and all of the mesh BVHs
+	size_t bvhNodeBytes = 0;		// memory of those nodes
+	size_t bvhCachedMeshCount = 0;	// meshes whose BVH was mapped from the cache instead of built
+	float bvhSahCost = 0.f;			// of the binary top level BVH, with each instance costing as much as its mesh BVH
+	double bvhBuildMilliseconds = 0.0;
+
+	// Of the last Update
+	size_t refitMeshCount = 0;
+	size_t rebuiltMeshCount = 0;	// deformed so much since their last build that refitting them was not worth it
+	bool bTlasRebuilt = false;
+	double bvhUpdateMilliseconds = 0.0;
+};
+
+// Software implementation of the DXR pipeline, for machines without a DXR capable adapter and as a reference for the
+// GPU output. Rays are generated as in Raygen.hlsl and shaded as in ClosestHit.hlsl and Miss.hlsl, so for the same
+// scene and view constants both produce the same image.
+//
+// Like DXR it has a BVH per mesh in object space and a top level BVH over the instances. Both are binary SAH trees
+// collapsed to BVH8, the mesh nodes with 8-bit child boxes, and leaf triangles are tested in packets by a watertight
+// kernel.
+//
+// Primary rays are traced in 8x8 pixel packets, which fall back to single rays where they diverge. Incoherent rays
+// are better traced in large batches with TraceRayStream.
+class CpuRaytracer
+{
+public:
+	// Builds a BVH per mesh and one over the instances on threadCount threads. The instance transforms are taken from
+	// the same 3x4 records Scene writes into the D3D12 instance descs.
+	void Init(const SceneData& scene, const uint32_t threadCount);
+
+	// Brings the BVHs up to date with a scene that differs from the one given to Init only in its instance transforms
+	// and in the positions of the meshes listed in deformedMeshes, which keep their triangles. Those mesh BVHs and the
+	// top level one are refit bottom up, keeping their topology, and rebuilt instead once refitting has grown their SAH
+	// cost by half since their last build. Rebuilds use the linear builder, which is several times faster.
+	void Update(const SceneData& scene, const std::vector<uint32_t>& deformedMeshes, const uint32_t threadCount);
+
+	// Traces one ray per pixel, in 8x8 pixel tiles that threadCount threads take and steal from each other.
+	void Render(
+		const SceneViewData& view,
+		const uint32_t width,
+		const uint32_t height,
+		const uint32_t threadCount,
+		std::vector<Vec3>& outImage) const;
+
+	// Nodes visited and triangles tested by the primary ray of each pixel of the image Render would make, for heatmaps.
+	// The rays are traced one at a time, since the work of a packet is shared by its rays.
+	void RenderTraversalCounts(
+		const SceneViewData& view,
+		const uint32_t width,
+		const uint32_t height,
+		const uint32_t threadCount,
+		std::vector<TraversalCounters>& outCounters) const;
+
+	// Quality of the top level BVH and of each mesh BVH, in the form the rays traverse them
+	void ComputeBvhQuality(BvhQualityStats& outTlas, std::vector<BvhQualityStats>& outMeshes) const;
+
+	// Distance to the closest hit along a ray, for measuring traversal on its own. Returns false on a miss.
+	bool CastRay(const Vec3& origin, const Vec3& direction, const float tMin, const float tMax, float& outT) const;
+
+	// Closest hit distances of a batch of rays, eg. shadow or ambient occlusion rays, written in the order the rays are
+	// given. Rays that miss get an infinite distance. The rays are sorted with SortRayStream, and chunks of them traced
+	// breadth-first on threadCount threads.
+	void TraceRayStream(const std::vector<StreamRay>& rays, const uint32_t threadCount, std::vector<float>& outHitT) const;
+
+	// Overrides the kernels picked with CPUID. The instruction set has to be supported.
+	void SetTraversalIsa(const SimdIsa isa);
+	SimdIsa GetTraversalIsa() const;
+
+	// Packet tracing of primary rays is on by default. Both ways give the same image.
+	void SetPacketTracing(const bool bEnable);
+	bool GetPacketTracing() const;
+
+	// Whether the next Init stores the mesh BVHs in Bvh8QuantizedNode instead of Bvh8Node. The boxes of the compressed
+	// nodes are a little larger, so rays visit a few more nodes, but the closest hits are the same.
+	void SetCompressedNodes(const bool bEnable);
+	bool GetCompressedNodes() const;
+
+	// Order of the nodes of the BVHs the next Init builds, Bvh8NodeLayout::Clustered by default, with clusters of a
+	// page. Any layout gives the same image.
+	void SetNodeLayout(const Bvh8NodeLayout layout);
+	Bvh8NodeLayout GetNodeLayout() const;
+
+	// Whether traversal prefetches the nodes of the children it pushes on its stack, on by default
+	void SetNodePrefetch(const bool bEnable);
+	bool GetNodePrefetch() const;
+
+	// Directory the mesh BVHs are cached in, none by default. Init maps the file of every mesh whose positions, uvs,
+	// indices and build settings hash the same as when it was written, and builds and writes the rest.
+	void SetBvhCacheDirectory(const std::string& directory);
+	const std::string& GetBvhCacheDirectory() const;
+
+	const CpuRaytracerStats& GetStats() const;
+
+	// Scheduler the work is run on, for its per-thread counters. It is created by the first call that takes a thread
+	// count and again whenever the count changes, so it is null before Init.
+	const TaskScheduler* GetScheduler() const;
+
+private:
+	struct TriangleUvs
+	{
+		Vec2 uvs[3];
+	};
+
+	// The arrays are sections of file, which was either built or mapped from the cache
+	struct MeshBvh
+	{
+		std::unique_ptr<BvhFile> file;
+		ArrayView<Bvh8Node> nodes;			// leaves index packets, empty if the nodes are compressed
+		ArrayView<Bvh8QuantizedNode> quantizedNodes;
+		ArrayView<TrianglePacket> packets;	// each leaf starts a new packet
+		ArrayView<TriangleUvs> uvs;			// one per packet lane
+		Aabb bounds;						// as of the last build or refit
+		uint32_t materialIndex;
+		RefitPolicy refitPolicy;
+
+		// Takes the arrays and bounds from a new file
+		void SetFile(std::unique_ptr<BvhFile> newFile);
+	};
+
+	struct Instance
+	{
+		float worldToObject[3][4];			// column vector convention, like the instance desc transform it inverts
+		uint32_t meshIndex;
+		uint32_t sceneInstanceIndex;
+	};
+
+	struct Hit
+	{
+		float t;
+		float u;
+		float v;
+		uint32_t instanceIndex;
+		uint32_t triangleIndex;				// packet lane
+	};
+
+	std::unique_ptr<BvhFile> BuildMeshBvh(const SceneMeshData& mesh, const BvhBuildSettings& settings, const uint64_t contentHash) const;
+
+	// Over the instances whose transform can be inverted and whose mesh is not empty
+	void BuildTlas(const SceneData& scene, const std::vector<InstanceRecord>& records, const BvhBuildSettings& settings);
+
+	void UpdateStats(const SceneData& scene);
+
+	// Adds the work done to counters if there are any
+	bool TraceClosest(
+		const Vec3& origin,
+		const Vec3& direction,
+		const float tMin,
+		const float tMax,
+		Hit& outHit,
+		TraversalCounters* counters = nullptr) const;
+
+	// Returns a bit mask of the rays of the packet that hit something
+	uint64_t TracePacket(const RayPacket& packet, const float tMin, const float tMax, Hit outHits[k_rayPacketSize]) const;
+
+	// Tests a world space ray against one instance, lowering inOutClosestT on a hit
+	bool IntersectInstance(
+		const uint32_t instanceIndex,
+		const Vec3& origin,
+		const Vec3& direction,
+		const float tMin,
+		float& inOutClosestT,
+		Hit& outHit,
+		TraversalCounters* counters = nullptr) const;
+
+	Vec3 ShadeClosestHit(const Hit& hit) const;
+
+	TaskScheduler& AcquireScheduler(const uint32_t threadCount) const;
+
+private:
+	std::vector<MeshBvh> m_meshes;
+	std::vector<Instance> m_instances;		// in top level BVH leaf order
+	std::vector<Bvh8Node> m_tlasNodes;
+	RefitPolicy m_tlasRefitPolicy;
+	std::vector<bool> m_validSceneInstances;	// which of the scene instances are in m_instances
+	std::vector<SceneMaterialData> m_materials;
+	std::vector<SceneTextureData> m_textures;
+	CpuRaytracerStats m_stats;
+	SimdIsa m_traversalIsa = GetBestSimdIsa();
+	Bvh8IntersectChildrenFunc m_intersectChildren = GetBvh8IntersectChildren(m_traversalIsa);
+	IntersectTrianglePacketsFunc m_intersectTriangles = GetIntersectTrianglePackets(m_traversalIsa);
+	IntersectChildrenPacketFunc m_intersectChildrenPacket = GetIntersectChildrenPacket(m_traversalIsa);
+	IntersectTriangleRayPacketFunc m_intersectTriangleRays = GetIntersectTriangleRayPacket(m_traversalIsa);
+	Bvh8QuantizedIntersectChildrenFunc m_intersectQuantizedChildren = GetBvh8QuantizedIntersectChildren(m_traversalIsa);
+	IntersectQuantizedChildrenPacketFunc m_intersectQuantizedChildrenPacket = GetIntersectQuantizedChildrenPacket(m_traversalIsa);
+	bool m_bPacketTracing = true;
+	bool m_bCompressedNodes = true;
+	Bvh8NodeLayout m_nodeLayout = Bvh8NodeLayout::Clustered;
+	bool m_bNodePrefetch = true;
+	std::string m_bvhCacheDirectory;
+	mutable std::unique_ptr<TaskScheduler> m_scheduler;
+};
+
+// Writes an image as a binary PPM. Values are clamped to [0, 1] and written without any encoding, the same as the
+// R10G10B10A2_UNORM back buffer displays them.
+bool WriteImagePpm(const std::string& path, const uint32_t width, const uint32_t height, const std::vector<Vec3>& image);
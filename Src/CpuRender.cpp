@@ -0,0 +1,957 @@
+// Command line front end for the CPU ray tracer, for machines that cannot run the D3D12 app. It only depends on the
+// device independent sources and assimp, and is excluded from the Windows build, which has its own main. Eg.
+//
+//   g++ -std=c++17 -O2 -pthread CpuRender.cpp CpuRaytracer.cpp SceneData.cpp SceneImport.cpp Bvh.cpp Bvh8.cpp
+//       Bvh8Quantized.cpp BvhFile.cpp TrianglePacket.cpp RayPacket.cpp RayStream.cpp SimdIsa.cpp TaskScheduler.cpp InstanceTransforms.cpp
+//       DirtyTracker.cpp RefitPolicy.cpp BvhStats.cpp OpacityMask.cpp TriangleOpacity.cpp AlphaClip.cpp -lassimp -o CpuRender
+//   ./CpuRender ../Content/Sponza/obj/sponza.obj ../Content/Sponza/textures/Compressed/ sponza.ppm
+//
+// The camera defaults to where FirstPersonCamera starts. --bench measures traversal on a single core, with one
+// primary ray per pixel traced in packets and one at a time, and with the given number of rays between random points
+// in the scene bounds traced one at a time and as a stream. --scaling renders on 1, 2, 4, ... up to --threads threads,
+// which defaults to all of the cores, and prints the speedup and how busy the scheduler kept each thread. --isa forces
+// the box and triangle kernels instead of the ones picked with CPUID. --sbvh builds every mesh BVH with spatial splits,
+// for comparing SAH cost, triangle references and rays per second against a run without it. --full-nodes keeps the
+// mesh BVH nodes uncompressed, likewise for comparing memory and rays per second. --bvh-cache maps the mesh BVHs from
+// files in a directory, writing the ones that are missing or out of date, so that only the first run builds them.
+// --animate moves every instance and ripples every mesh for the given number of frames, and compares refitting the
+// BVHs each frame with building them from scratch. --stats writes the quality of the BVHs and the nodes visited and
+// triangles tested per primary ray to a JSON file, and heatmaps of both next to it. --build-bench builds BVHs over 1K
+// to 1M of the triangles with the binned SAH and the linear builders, and prints their build times and SAH costs.
+// --instance-bench writes the TLAS instance records of 1K to 1M instances in bulk and for only the dirty ones, and
+// prints how long each takes.
+// --layout-bench builds the BVHs with each node layout and traces primary rays and the given number of random rays on
+// a single core, with and without prefetching the nodes, and prints the rays per second and, where the kernel lets
+// perf events be counted, the last level cache and TLB misses per ray.
+
+#include "CpuRaytracer.h"
+#include "DirtyTracker.h"
+#include "SceneImport.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <strings.h>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	constexpr float k_verticalFov = 0.25f * 3.1415926535f;
+
+	void PrintUsage()
+	{
+		printf("Usage : CpuRender <scene> <texture directory> <output.ppm> [--size w h] [--eye x y z] [--look x y z] [--isa scalar|sse|avx2] [--threads n] [--bench rays] [--scaling] [--sbvh] [--full-nodes] [--bvh-cache directory] [--animate frames] [--stats file.json] [--build-bench] [--instance-bench] [--layout-bench rays]\n");
+	}
+
+	size_t MillisecondsSince(const std::chrono::steady_clock::time_point startTime)
+	{
+		return static_cast<size_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+	}
+
+	double MillionRaysPerSecond(const size_t rayCount, const std::chrono::steady_clock::time_point startTime)
+	{
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		return seconds > 0.0 ? rayCount / (1e6 * seconds) : 0.0;
+	}
+
+	// Read misses of a cache, counted by the hardware for the calling thread in user space. Not available outside of
+	// Linux, and often not in virtual machines or with kernel.perf_event_paranoid above 2 either.
+	enum class Cache
+	{
+		LastLevel,
+		DataTlb
+	};
+
+	class CacheMissCounter
+	{
+	public:
+		explicit CacheMissCounter(const Cache cache)
+		{
+#if defined(__linux__)
+			perf_event_attr attr = {};
+			attr.size = sizeof(attr);
+			attr.type = PERF_TYPE_HW_CACHE;
+			attr.config = (cache == Cache::LastLevel ? PERF_COUNT_HW_CACHE_LL : PERF_COUNT_HW_CACHE_DTLB) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			attr.disabled = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			m_fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+			(void)cache;
+#endif
+		}
+
+		~CacheMissCounter()
+		{
+#if defined(__linux__)
+			if (m_fd >= 0)
+			{
+				close(m_fd);
+			}
+#endif
+		}
+
+		CacheMissCounter(const CacheMissCounter&) = delete;
+		CacheMissCounter& operator=(const CacheMissCounter&) = delete;
+
+		bool IsAvailable() const
+		{
+			return m_fd >= 0;
+		}
+
+		void Start()
+		{
+#if defined(__linux__)
+			if (m_fd >= 0)
+			{
+				ioctl(m_fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(m_fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		// Misses since Start
+		uint64_t Stop()
+		{
+			uint64_t count = 0;
+#if defined(__linux__)
+			if (m_fd >= 0)
+			{
+				ioctl(m_fd, PERF_EVENT_IOC_DISABLE, 0);
+				if (read(m_fd, &count, sizeof(count)) != static_cast<ssize_t>(sizeof(count)))
+				{
+					count = 0;
+				}
+			}
+#endif
+			return count;
+		}
+
+	private:
+		int m_fd = -1;
+	};
+
+	Aabb ComputeSceneBounds(const SceneData& scene)
+	{
+		Aabb bounds;
+		for (const SceneInstanceData& instance : scene.instances)
+		{
+			Aabb meshBounds;
+			for (const Vec3& p : scene.meshes[instance.meshIndex].positions)
+			{
+				meshBounds.Grow(p);
+			}
+
+			bounds.Grow(TransformAabb(meshBounds, instance.localToWorld));
+		}
+
+		return bounds;
+	}
+
+	struct RandomRay
+	{
+		Vec3 origin;
+		Vec3 direction;
+		float length;
+	};
+
+	// Rays between two random points in the scene, so most of them are incoherent and many end before a hit
+	std::vector<RandomRay> MakeRandomRays(const SceneData& scene, const size_t rayCount)
+	{
+		std::vector<RandomRay> rays;
+		const Aabb bounds = ComputeSceneBounds(scene);
+		if (bounds.IsEmpty())
+		{
+			return rays;
+		}
+
+		std::mt19937 rng(0);
+		std::uniform_real_distribution<float> x(bounds.lower.x, bounds.upper.x);
+		std::uniform_real_distribution<float> y(bounds.lower.y, bounds.upper.y);
+		std::uniform_real_distribution<float> z(bounds.lower.z, bounds.upper.z);
+
+		rays.reserve(rayCount);
+		while (rays.size() < rayCount)
+		{
+			const Vec3 from = { x(rng), y(rng), z(rng) };
+			const Vec3 to = { x(rng), y(rng), z(rng) };
+			const float length = Length(to - from);
+			if (length > 0.f)
+			{
+				rays.push_back({ from, (to - from) * (1.f / length), length });
+			}
+		}
+
+		return rays;
+	}
+
+	void RunBenchmark(
+		CpuRaytracer& raytracer, 
+		const SceneData& scene, 
+		const SceneViewData& view, 
+		const uint32_t width, 
+		const uint32_t height, 
+		const size_t randomRayCount)
+	{
+		const bool bPacketTracing = raytracer.GetPacketTracing();
+		double primaryRate[2];
+		std::vector<Vec3> image;
+		for (const bool bPackets : { false, true })
+		{
+			raytracer.SetPacketTracing(bPackets);
+			const auto renderStartTime = std::chrono::steady_clock::now();
+			raytracer.Render(view, width, height, 1, image);
+			primaryRate[bPackets] = MillionRaysPerSecond(image.size(), renderStartTime);
+			printf("*** CPU benchmark : primary rays %s %.2f M rays/s per core (including shading)\n", bPackets ? "in packets" : "one at a time", primaryRate[bPackets]);
+		}
+
+		raytracer.SetPacketTracing(bPacketTracing);
+		printf("*** CPU benchmark : packet speedup %.2fx\n", primaryRate[0] > 0.0 ? primaryRate[1] / primaryRate[0] : 0.0);
+
+		const std::vector<RandomRay> rays = MakeRandomRays(scene, randomRayCount);
+		if (rays.empty())
+		{
+			return;
+		}
+
+		size_t hitCount = 0;
+		const auto startTime = std::chrono::steady_clock::now();
+		for (const RandomRay& ray : rays)
+		{
+			float t;
+			hitCount += raytracer.CastRay(ray.origin, ray.direction, 0.f, ray.length, t) ? 1 : 0;
+		}
+
+		const double singleRate = MillionRaysPerSecond(rays.size(), startTime);
+		printf("*** CPU benchmark : random rays one at a time %.2f M rays/s per core, %.1f%% hit\n", singleRate, 100.0 * hitCount / rays.size());
+
+		std::vector<StreamRay> streamRays;
+		streamRays.reserve(rays.size());
+		for (const RandomRay& ray : rays)
+		{
+			streamRays.push_back({ ray.origin, ray.direction, 0.f, ray.length });
+		}
+
+		std::vector<float> hitT;
+		const auto streamStartTime = std::chrono::steady_clock::now();
+		raytracer.TraceRayStream(streamRays, 1, hitT);
+		const double streamRate = MillionRaysPerSecond(streamRays.size(), streamStartTime);
+
+		size_t streamHitCount = 0;
+		for (const float t : hitT)
+		{
+			streamHitCount += std::isinf(t) ? 0 : 1;
+		}
+
+		printf("*** CPU benchmark : random rays as a stream %.2f M rays/s per core (including sorting), %.1f%% hit\n", streamRate, 100.0 * streamHitCount / rays.size());
+		printf("*** CPU benchmark : stream speedup %.2fx\n", singleRate > 0.0 ? streamRate / singleRate : 0.0);
+	}
+
+	// Animates a copy of the scene, with each instance swaying and a wave running through each mesh, and prints how long
+	// updating the BVHs of raytracer takes each frame against building them from scratch, and the render times with both
+	void RunAnimation(
+		CpuRaytracer& raytracer, 
+		const SceneData& scene, 
+		const SceneViewData& view, 
+		const uint32_t width, 
+		const uint32_t height, 
+		const uint32_t threadCount, 
+		const uint32_t frameCount)
+	{
+		const Aabb sceneBounds = ComputeSceneBounds(scene);
+		if (sceneBounds.IsEmpty())
+		{
+			return;
+		}
+
+		const float sceneSize = Length(sceneBounds.Extent());
+
+		SceneData animated = scene;
+		std::vector<uint32_t> deformedMeshes(scene.meshes.size());
+		for (uint32_t meshIdx = 0; meshIdx < deformedMeshes.size(); meshIdx++)
+		{
+			deformedMeshes[meshIdx] = meshIdx;
+		}
+
+		CpuRaytracer rebuiltRaytracer;
+		rebuiltRaytracer.SetCompressedNodes(raytracer.GetCompressedNodes());
+		rebuiltRaytracer.SetTraversalIsa(raytracer.GetTraversalIsa());
+
+		double refitMilliseconds = 0.0;
+		double rebuildMilliseconds = 0.0;
+		double refitRenderMilliseconds = 0.0;
+		double rebuildRenderMilliseconds = 0.0;
+		size_t rebuiltMeshCount = 0;
+		uint32_t rebuiltTlasCount = 0;
+		std::vector<Vec3> image;
+		for (uint32_t frame = 1; frame <= frameCount; frame++)
+		{
+			const float time = 0.25f * frame;
+			for (size_t instanceIdx = 0; instanceIdx < animated.instances.size(); instanceIdx++)
+			{
+				const float sway = 0.02f * sceneSize * std::sin(time + instanceIdx);
+				animated.instances[instanceIdx].localToWorld[3][0] = scene.instances[instanceIdx].localToWorld[3][0] + sway;
+				animated.instances[instanceIdx].localToWorld[3][2] = scene.instances[instanceIdx].localToWorld[3][2] + 0.5f * sway;
+			}
+
+			for (size_t meshIdx = 0; meshIdx < animated.meshes.size(); meshIdx++)
+			{
+				const std::vector<Vec3>& restPositions = scene.meshes[meshIdx].positions;
+				std::vector<Vec3>& positions = animated.meshes[meshIdx].positions;
+				for (size_t vertexIdx = 0; vertexIdx < positions.size(); vertexIdx++)
+				{
+					const Vec3& p = restPositions[vertexIdx];
+					positions[vertexIdx].y = p.y + 0.005f * sceneSize * std::sin(20.f * (p.x + p.z) / sceneSize + 2.f * time);
+				}
+			}
+
+			auto startTime = std::chrono::steady_clock::now();
+			raytracer.Update(animated, deformedMeshes, threadCount);
+			refitMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+			rebuiltMeshCount += raytracer.GetStats().rebuiltMeshCount;
+			rebuiltTlasCount += raytracer.GetStats().bTlasRebuilt ? 1 : 0;
+
+			startTime = std::chrono::steady_clock::now();
+			raytracer.Render(view, width, height, threadCount, image);
+			refitRenderMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+			startTime = std::chrono::steady_clock::now();
+			rebuiltRaytracer.Init(animated, threadCount);
+			rebuildMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+
+			startTime = std::chrono::steady_clock::now();
+			rebuiltRaytracer.Render(view, width, height, threadCount, image);
+			rebuildRenderMilliseconds += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+		}
+
+		printf("*** CPU animation : %u frames, refit %.2f ms per frame (%zu mesh and %u top level rebuilds), rebuild %.2f ms per frame, %.1fx faster\n", 
+			frameCount, refitMilliseconds / frameCount, rebuiltMeshCount, rebuiltTlasCount, rebuildMilliseconds / frameCount, refitMilliseconds > 0.0 ? rebuildMilliseconds / refitMilliseconds : 0.0);
+		printf("*** CPU animation : render %.2f ms per frame after refitting, %.2f ms after rebuilding\n", 
+			refitRenderMilliseconds / frameCount, rebuildRenderMilliseconds / frameCount);
+
+		// Back to the scene as it was loaded for the final image
+		raytracer.Update(scene, deformedMeshes, threadCount);
+	}
+
+	// Renders the view on 1, 2, 4, ... up to maxThreads threads and prints the time, speedup and the utilization of the
+	// scheduler's threads for each count
+	void RunScaling(
+		CpuRaytracer& raytracer, 
+		const SceneViewData& view, 
+		const uint32_t width, 
+		const uint32_t height, 
+		const uint32_t maxThreads)
+	{
+		constexpr uint32_t k_runCount = 3;
+
+		std::vector<uint32_t> threadCounts;
+		for (uint32_t threadCount = 1; threadCount < maxThreads; threadCount *= 2)
+		{
+			threadCounts.push_back(threadCount);
+		}
+
+		threadCounts.push_back(maxThreads);
+
+		double singleThreadMilliseconds = 0.0;
+		std::vector<Vec3> image;
+		for (const uint32_t threadCount : threadCounts)
+		{
+			// The first render creates the scheduler's threads and warms up the caches
+			raytracer.Render(view, width, height, threadCount, image);
+			const TaskScheduler& scheduler = *raytracer.GetScheduler();
+			const std::vector<TaskSchedulerThreadStats> statsBefore = scheduler.GetThreadStats();
+			const uint64_t parallelNanosecondsBefore = scheduler.GetParallelNanoseconds();
+
+			double bestMilliseconds = 0.0;
+			for (uint32_t run = 0; run < k_runCount; run++)
+			{
+				const auto startTime = std::chrono::steady_clock::now();
+				raytracer.Render(view, width, height, threadCount, image);
+				const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+				bestMilliseconds = run == 0 ? milliseconds : (std::min)(bestMilliseconds, milliseconds);
+			}
+
+			if (threadCount == 1)
+			{
+				singleThreadMilliseconds = bestMilliseconds;
+			}
+
+			const std::vector<TaskSchedulerThreadStats> threadStats = scheduler.GetThreadStats();
+			const double parallelNanoseconds = static_cast<double>((std::max<uint64_t>)(1, scheduler.GetParallelNanoseconds() - parallelNanosecondsBefore));
+			double minUtilization = 1.0;
+			double sumUtilization = 0.0;
+			uint64_t rangeCount = 0;
+			uint64_t stealCount = 0;
+			for (size_t threadIdx = 0; threadIdx < threadStats.size(); threadIdx++)
+			{
+				const double utilization = (threadStats[threadIdx].busyNanoseconds - statsBefore[threadIdx].busyNanoseconds) / parallelNanoseconds;
+				minUtilization = (std::min)(minUtilization, utilization);
+				sumUtilization += utilization;
+				rangeCount += threadStats[threadIdx].rangeCount - statsBefore[threadIdx].rangeCount;
+				stealCount += threadStats[threadIdx].stealCount - statsBefore[threadIdx].stealCount;
+			}
+
+			const double speedup = bestMilliseconds > 0.0 ? singleThreadMilliseconds / bestMilliseconds : 0.0;
+			printf("*** CPU scaling : %3u threads %8.2f ms, speedup %6.2fx, efficiency %3.0f%%, utilization min %3.0f%% mean %3.0f%%, %.1f ranges and %.1f steals per frame\n", 
+				threadCount, bestMilliseconds, speedup, 100.0 * speedup / threadCount, 100.0 * minUtilization, 100.0 * sumUtilization / threadStats.size(), 
+				static_cast<double>(rangeCount) / k_runCount, static_cast<double>(stealCount) / k_runCount);
+		}
+	}
+
+	// Builds BVHs over world space triangle bounds with each builder on threadCount threads. Counts up to the number of
+	// triangles in the scene are spread over all of it, larger ones tile copies of the scene along x.
+	void RunBuildBenchmark(const SceneData& scene, const uint32_t threadCount)
+	{
+		constexpr uint32_t k_runCount = 3;
+		const size_t primitiveCounts[] = { 1000, 10000, 100000, 1000000 };
+
+		struct BuilderConfig
+		{
+			const char* name;
+			BvhBuilder builder;
+			bool bWideMortonCodes;
+			uint32_t treeletPassCount;
+		};
+
+		const BuilderConfig configs[] = {
+			{ "binned SAH", BvhBuilder::BinnedSah, false, 0 },
+			{ "linear", BvhBuilder::Linear, false, 0 },
+			{ "linear 63-bit codes", BvhBuilder::Linear, true, 0 },
+			{ "linear 1 treelet pass", BvhBuilder::Linear, false, 1 },
+			{ "linear 3 treelet passes", BvhBuilder::Linear, false, 3 } };
+
+		std::vector<Aabb> sceneTriangles;
+		for (const SceneInstanceData& instance : scene.instances)
+		{
+			const SceneMeshData& mesh = scene.meshes[instance.meshIndex];
+			for (const Aabb& bounds : ComputeTriangleBounds(mesh.positions, mesh.indices))
+			{
+				sceneTriangles.push_back(TransformAabb(bounds, instance.localToWorld));
+			}
+		}
+
+		if (sceneTriangles.empty())
+		{
+			return;
+		}
+
+		const float tileOffset = ComputeSceneBounds(scene).Extent().x;
+		TaskScheduler scheduler(threadCount);
+		for (const size_t primitiveCount : primitiveCounts)
+		{
+			std::vector<Aabb> primitives(primitiveCount);
+			for (size_t i = 0; i < primitiveCount; i++)
+			{
+				if (primitiveCount <= sceneTriangles.size())
+				{
+					primitives[i] = sceneTriangles[i * sceneTriangles.size() / primitiveCount];
+				}
+				else
+				{
+					const Vec3 offset = { tileOffset * (i / sceneTriangles.size()), 0.f, 0.f };
+					const Aabb& bounds = sceneTriangles[i % sceneTriangles.size()];
+					primitives[i] = { bounds.lower + offset, bounds.upper + offset };
+				}
+			}
+
+			for (const BuilderConfig& config : configs)
+			{
+				BvhBuildSettings settings;
+				settings.builder = config.builder;
+				settings.bWideMortonCodes = config.bWideMortonCodes;
+				settings.treeletPassCount = config.treeletPassCount;
+				settings.scheduler = &scheduler;
+
+				Bvh bvh;
+				double bestMilliseconds = 0.0;
+				for (uint32_t run = 0; run < k_runCount; run++)
+				{
+					const auto startTime = std::chrono::steady_clock::now();
+					bvh.Build(primitives, settings);
+					const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+					bestMilliseconds = run == 0 ? milliseconds : (std::min)(bestMilliseconds, milliseconds);
+				}
+
+				printf("*** CPU BVH build : %7zu primitives, %-24s %9.2f ms (%6.2f M primitives/s), SAH cost %.2f\n", 
+					primitiveCount, config.name, bestMilliseconds, bestMilliseconds > 0.0 ? primitiveCount / (1000.0 * bestMilliseconds) : 0.0, 
+					bvh.ComputeSahCost(settings.traversalCost));
+			}
+		}
+	}
+
+	// Writes TLAS instance records for 1K to 1M instances, tiling the instances of the scene, in bulk and for a fraction
+	// of dirty instances only, as Scene::UpdateTLAS does for each buffered frame. The record buffer is ordinary memory
+	// here, not the write combined upload heap the D3D12 path writes to.
+	void RunInstanceBenchmark(const SceneData& scene)
+	{
+		constexpr uint32_t k_runCount = 5;
+		const size_t instanceCounts[] = { 1000, 10000, 100000, 1000000 };
+		const double dirtyFractions[] = { 0.01, 0.02, 0.05, 0.1, 0.25 };
+
+		if (scene.instances.empty())
+		{
+			return;
+		}
+
+		std::mt19937 rng(34);
+		for (const size_t instanceCount : instanceCounts)
+		{
+			InstanceTransforms transforms;
+			transforms.Resize(instanceCount);
+			std::vector<InstanceRecordAttributes> attributes(instanceCount);
+			for (size_t instanceIndex = 0; instanceIndex < instanceCount; instanceIndex++)
+			{
+				const SceneInstanceData& instance = scene.instances[instanceIndex % scene.instances.size()];
+				transforms.Set(instanceIndex, instance.localToWorld);
+				attributes[instanceIndex] = InstanceRecordAttributes::Pack(static_cast<uint32_t>(instanceIndex), 0xFF, 0, 0, instance.meshIndex);
+			}
+
+			std::vector<InstanceRecord> records(instanceCount);
+			double bulkMilliseconds = 0.0;
+			for (uint32_t run = 0; run < k_runCount; run++)
+			{
+				const auto startTime = std::chrono::steady_clock::now();
+				WriteInstanceRecords(transforms, attributes.data(), 0, instanceCount, records.data());
+				const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+				bulkMilliseconds = run == 0 ? milliseconds : (std::min)(bulkMilliseconds, milliseconds);
+			}
+
+			printf("*** CPU instances : %7zu instances, %-19s %9.3f ms (%7.2f M records/s)\n", 
+				instanceCount, "bulk", bulkMilliseconds, bulkMilliseconds > 0.0 ? instanceCount / (1000.0 * bulkMilliseconds) : 0.0);
+
+			DirtyTracker tracker;
+			tracker.Init(instanceCount, 1);
+			std::vector<size_t> dirtyInstances;
+			std::uniform_int_distribution<size_t> instanceDist(0, instanceCount - 1);
+
+			for (const double dirtyFraction : dirtyFractions)
+			{
+				const size_t dirtyCount = (std::max)(size_t(1), static_cast<size_t>(dirtyFraction * instanceCount));
+				double bestMilliseconds = 0.0;
+				for (uint32_t run = 0; run < k_runCount; run++)
+				{
+					// Marking happens as entities move, so it is not part of the update. Random picks may collide.
+					for (size_t i = 0; i < dirtyCount; i++)
+					{
+						tracker.MarkDirty(instanceDist(rng));
+					}
+
+					// The dirty only path of UpdateInstanceRecords, whatever the fraction
+					const auto startTime = std::chrono::steady_clock::now();
+					dirtyInstances.clear();
+					tracker.ConsumeDirty(0, dirtyInstances);
+					for (const size_t instanceIndex : dirtyInstances)
+					{
+						WriteInstanceRecords(transforms, attributes.data(), instanceIndex, 1, records.data() + instanceIndex);
+					}
+
+					const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+					bestMilliseconds = run == 0 ? milliseconds : (std::min)(bestMilliseconds, milliseconds);
+				}
+
+				char name[32];
+				snprintf(name, sizeof(name), "dirty only %.0f%%", 100.0 * dirtyFraction);
+				printf("*** CPU instances : %7zu instances, %-19s %9.3f ms (%7.2f M records/s), %5.2fx the bulk time%s\n", 
+					instanceCount, name, bestMilliseconds, bestMilliseconds > 0.0 ? dirtyInstances.size() / (1000.0 * bestMilliseconds) : 0.0, 
+					bulkMilliseconds > 0.0 ? bestMilliseconds / bulkMilliseconds : 0.0, 
+					k_instanceRecordsBulkDirtyRatio * dirtyInstances.size() > instanceCount ? ", written in bulk by UpdateInstanceRecords" : "");
+			}
+		}
+	}
+
+	// Builds the BVHs of the scene in each node layout and traces primary rays one at a time and in packets and random
+	// rays one at a time on a single core, with and without prefetching, printing the rays per second and the last level
+	// cache and data TLB misses per ray where perf events are available
+	void RunLayoutBenchmark(
+		const CpuRaytracer& raytracer, 
+		const SceneData& scene, 
+		const SceneViewData& view, 
+		const uint32_t width, 
+		const uint32_t height, 
+		const uint32_t threadCount, 
+		const size_t randomRayCount)
+	{
+		constexpr uint32_t k_runCount = 3;
+
+		struct Layout
+		{
+			const char* name;
+			Bvh8NodeLayout layout;
+		};
+
+		const Layout layouts[] = {
+			{ "collapse", Bvh8NodeLayout::Collapse },
+			{ "clustered", Bvh8NodeLayout::Clustered } };
+
+		const char* passNames[] = { "primary rays one at a time", "primary rays in packets", "random rays one at a time" };
+
+		const std::vector<RandomRay> rays = MakeRandomRays(scene, randomRayCount);
+		CacheMissCounter llcMisses(Cache::LastLevel);
+		CacheMissCounter tlbMisses(Cache::DataTlb);
+		if (!llcMisses.IsAvailable() || !tlbMisses.IsAvailable())
+		{
+			printf("*** CPU layout : cache miss counters are not available, only timing\n");
+		}
+
+		auto formatMisses = [](const CacheMissCounter& counter, const uint64_t missCount, const size_t rayCount)
+		{
+			if (!counter.IsAvailable())
+			{
+				return std::string("n/a");
+			}
+
+			char text[32];
+			snprintf(text, sizeof(text), "%.2f", static_cast<double>(missCount) / rayCount);
+			return std::string(text);
+		};
+
+		std::vector<Vec3> image;
+		for (const Layout& layout : layouts)
+		{
+			CpuRaytracer layoutRaytracer;
+			layoutRaytracer.SetCompressedNodes(raytracer.GetCompressedNodes());
+			layoutRaytracer.SetTraversalIsa(raytracer.GetTraversalIsa());
+			layoutRaytracer.SetNodeLayout(layout.layout);
+			layoutRaytracer.Init(scene, threadCount);
+
+			for (const bool bPrefetch : { false, true })
+			{
+				layoutRaytracer.SetNodePrefetch(bPrefetch);
+				for (uint32_t pass = 0; pass < 3; pass++)
+				{
+					const size_t rayCount = pass < 2 ? static_cast<size_t>(width) * height : rays.size();
+					if (rayCount == 0)
+					{
+						continue;
+					}
+
+					double bestMilliseconds = 0.0;
+					uint64_t llcMissCount = 0;
+					uint64_t tlbMissCount = 0;
+					for (uint32_t run = 0; run < k_runCount; run++)
+					{
+						llcMisses.Start();
+						tlbMisses.Start();
+						const auto startTime = std::chrono::steady_clock::now();
+						if (pass < 2)
+						{
+							layoutRaytracer.SetPacketTracing(pass == 1);
+							layoutRaytracer.Render(view, width, height, 1, image);
+						}
+						else
+						{
+							for (const RandomRay& ray : rays)
+							{
+								float t;
+								layoutRaytracer.CastRay(ray.origin, ray.direction, 0.f, ray.length, t);
+							}
+						}
+
+						const double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+						const uint64_t llcMissRun = llcMisses.Stop();
+						const uint64_t tlbMissRun = tlbMisses.Stop();
+						if (run == 0 || milliseconds < bestMilliseconds)
+						{
+							bestMilliseconds = milliseconds;
+							llcMissCount = llcMissRun;
+							tlbMissCount = tlbMissRun;
+						}
+					}
+
+					printf("*** CPU layout : %-9s prefetch %-3s %-26s %6.2f M rays/s, %7s LLC and %7s dTLB misses per ray\n", 
+						layout.name, bPrefetch ? "on" : "off", passNames[pass], bestMilliseconds > 0.0 ? rayCount / (1000.0 * bestMilliseconds) : 0.0, 
+						formatMisses(llcMisses, llcMissCount, rayCount).c_str(), formatMisses(tlbMisses, tlbMissCount, rayCount).c_str());
+				}
+			}
+		}
+	}
+
+	// Writes the BVH quality and traversal counters of the view to path, and heatmaps of the counters to path.nodes.ppm
+	// and path.triangles.ppm, each scaled to the most any pixel needed
+	bool WriteStats(
+		const CpuRaytracer& raytracer, 
+		const char* scenePath, 
+		const SceneViewData& view, 
+		const uint32_t width, 
+		const uint32_t height, 
+		const uint32_t threadCount, 
+		const std::string& path)
+	{
+		BvhQualityStats tlasStats;
+		std::vector<BvhQualityStats> meshStats;
+		raytracer.ComputeBvhQuality(tlasStats, meshStats);
+
+		std::vector<TraversalCounters> counters;
+		raytracer.RenderTraversalCounts(view, width, height, threadCount, counters);
+		const TraversalStats traversalStats = SummarizeTraversalCounters(counters);
+
+		const CpuRaytracerStats& stats = raytracer.GetStats();
+		std::string json = "{\n";
+		json += "\t\"scene\": " + QuoteJson(scenePath) + ",\n";
+		json += "\t\"isa\": " + QuoteJson(GetSimdIsaName(raytracer.GetTraversalIsa())) + ",\n";
+		json += "\t\"compressedNodes\": " + std::string(raytracer.GetCompressedNodes() ? "true" : "false") + ",\n";
+		json += "\t\"width\": " + std::to_string(width) + ",\n";
+		json += "\t\"height\": " + std::to_string(height) + ",\n";
+		json += "\t\"triangleCount\": " + std::to_string(stats.triangleCount) + ",\n";
+		json += "\t\"instanceCount\": " + std::to_string(stats.instanceCount) + ",\n";
+		json += "\t\"tlas\": " + FormatJson(tlasStats, 1) + ",\n";
+		json += "\t\"meshes\": [";
+		for (size_t meshIdx = 0; meshIdx < meshStats.size(); meshIdx++)
+		{
+			json += (meshIdx > 0 ? ",\n\t\t" : "\n\t\t") + FormatJson(meshStats[meshIdx], 2);
+		}
+
+		json += meshStats.empty() ? "],\n" : "\n\t],\n";
+		json += "\t\"traversal\": " + FormatJson(traversalStats, 1) + "\n";
+		json += "}\n";
+
+		FILE* file = fopen(path.c_str(), "wb");
+		if (!file)
+		{
+			return false;
+		}
+
+		const bool bWritten = fwrite(json.data(), 1, json.size(), file) == json.size();
+		if (fclose(file) != 0 || !bWritten)
+		{
+			return false;
+		}
+
+		printf("*** CPU stats : %.1f nodes and %.1f triangles per primary ray, sibling overlap %.3f in the top level BVH\n", 
+			traversalStats.nodesPerRay, traversalStats.trianglesPerRay, tlasStats.siblingOverlap);
+
+		std::vector<Vec3> heatmap;
+		MakeTraversalHeatmap(counters, TraversalCounter::Nodes, traversalStats.maxNodes, heatmap);
+		if (!WriteImagePpm(path + ".nodes.ppm", width, height, heatmap))
+		{
+			return false;
+		}
+
+		MakeTraversalHeatmap(counters, TraversalCounter::Triangles, traversalStats.maxTriangles, heatmap);
+		return WriteImagePpm(path + ".triangles.ppm", width, height, heatmap);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	uint32_t width = 1280;
+	uint32_t height = 720;
+	Vec3 eye = { 0.f, 0.f, 0.f };
+	Vec3 look = { 0.f, 0.f, 1.f };
+	const char* isaName = nullptr;
+	size_t benchRayCount = 0;
+	bool bBenchmark = false;
+	bool bScaling = false;
+	bool bSpatialSplits = false;
+	bool bCompressedNodes = true;
+	const char* bvhCacheDirectory = nullptr;
+	uint32_t animationFrameCount = 0;
+	const char* statsPath = nullptr;
+	bool bBuildBenchmark = false;
+	bool bInstanceBenchmark = false;
+	size_t layoutBenchRayCount = 0;
+	bool bLayoutBenchmark = false;
+	uint32_t threadCount = (std::max)(1u, std::thread::hardware_concurrency());
+
+	for (int argIdx = 4; argIdx < argc; argIdx++)
+	{
+		if (strcmp(argv[argIdx], "--size") == 0 && argIdx + 2 < argc)
+		{
+			width = static_cast<uint32_t>(atoi(argv[argIdx + 1]));
+			height = static_cast<uint32_t>(atoi(argv[argIdx + 2]));
+			argIdx += 2;
+		}
+		else if ((strcmp(argv[argIdx], "--eye") == 0 || strcmp(argv[argIdx], "--look") == 0) && argIdx + 3 < argc)
+		{
+			Vec3& v = argv[argIdx][2] == 'e' ? eye : look;
+			v = { static_cast<float>(atof(argv[argIdx + 1])), static_cast<float>(atof(argv[argIdx + 2])), static_cast<float>(atof(argv[argIdx + 3])) };
+			argIdx += 3;
+		}
+		else if (strcmp(argv[argIdx], "--isa") == 0 && argIdx + 1 < argc)
+		{
+			isaName = argv[++argIdx];
+		}
+		else if (strcmp(argv[argIdx], "--threads") == 0 && argIdx + 1 < argc)
+		{
+			threadCount = static_cast<uint32_t>(atoi(argv[++argIdx]));
+		}
+		else if (strcmp(argv[argIdx], "--scaling") == 0)
+		{
+			bScaling = true;
+		}
+		else if (strcmp(argv[argIdx], "--sbvh") == 0)
+		{
+			bSpatialSplits = true;
+		}
+		else if (strcmp(argv[argIdx], "--full-nodes") == 0)
+		{
+			bCompressedNodes = false;
+		}
+		else if (strcmp(argv[argIdx], "--bvh-cache") == 0 && argIdx + 1 < argc)
+		{
+			bvhCacheDirectory = argv[++argIdx];
+		}
+		else if (strcmp(argv[argIdx], "--animate") == 0 && argIdx + 1 < argc)
+		{
+			animationFrameCount = static_cast<uint32_t>(atoi(argv[++argIdx]));
+		}
+		else if (strcmp(argv[argIdx], "--build-bench") == 0)
+		{
+			bBuildBenchmark = true;
+		}
+		else if (strcmp(argv[argIdx], "--instance-bench") == 0)
+		{
+			bInstanceBenchmark = true;
+		}
+		else if (strcmp(argv[argIdx], "--layout-bench") == 0 && argIdx + 1 < argc)
+		{
+			layoutBenchRayCount = static_cast<size_t>(atoll(argv[++argIdx]));
+			bLayoutBenchmark = true;
+		}
+		else if (strcmp(argv[argIdx], "--stats") == 0 && argIdx + 1 < argc)
+		{
+			statsPath = argv[++argIdx];
+		}
+		else if (strcmp(argv[argIdx], "--bench") == 0 && argIdx + 1 < argc)
+		{
+			benchRayCount = static_cast<size_t>(atoll(argv[++argIdx]));
+			bBenchmark = true;
+		}
+		else
+		{
+			PrintUsage();
+			return 1;
+		}
+	}
+
+	if (width == 0 || height == 0 || threadCount == 0)
+	{
+		PrintUsage();
+		return 1;
+	}
+
+	auto startTime = std::chrono::steady_clock::now();
+	SceneImportSettings importSettings;
+	importSettings.textureDirectory = argv[2];
+	importSettings.threadCount = threadCount;
+
+	SceneData sceneData;
+	if (!LoadSceneData(argv[1], importSettings, sceneData))
+	{
+		printf("ERROR: Failed to load %s\n", argv[1]);
+		return 1;
+	}
+
+	for (SceneMeshData& mesh : sceneData.meshes)
+	{
+		mesh.bSpatialSplits = bSpatialSplits;
+	}
+
+	CpuRaytracer raytracer;
+	raytracer.SetCompressedNodes(bCompressedNodes);
+	if (bvhCacheDirectory)
+	{
+		raytracer.SetBvhCacheDirectory(bvhCacheDirectory);
+	}
+
+	raytracer.Init(sceneData, threadCount);
+
+	if (isaName)
+	{
+		const SimdIsa isas[] = { SimdIsa::Scalar, SimdIsa::Sse, SimdIsa::Avx2 };
+		bool bFound = false;
+		for (const SimdIsa isa : isas)
+		{
+			if (strcasecmp(isaName, GetSimdIsaName(isa)) == 0 && IsSimdIsaSupported(isa))
+			{
+				raytracer.SetTraversalIsa(isa);
+				bFound = true;
+			}
+		}
+
+		if (!bFound)
+		{
+			printf("ERROR: %s traversal is not supported\n", isaName);
+			return 1;
+		}
+	}
+
+	const CpuRaytracerStats& stats = raytracer.GetStats();
+	printf("*** CPU ray tracer : %zu triangles in %zu instances, %zu ms to load\n", stats.triangleCount, stats.instanceCount, MillisecondsSince(startTime));
+	printf("*** CPU BVH : %zu %s nodes (%.2f MB), SAH cost %f, built in %.2f ms (%.2f M triangles/s)\n", stats.bvhNodeCount, bCompressedNodes ? "compressed" : "full", stats.bvhNodeBytes / (1024.0 * 1024.0), stats.bvhSahCost, stats.bvhBuildMilliseconds, 
+		stats.bvhBuildMilliseconds > 0.0 ? stats.triangleCount / (1000.0 * stats.bvhBuildMilliseconds) : 0.0);
+	if (bvhCacheDirectory)
+	{
+		printf("*** CPU BVH : %zu of %zu meshes mapped from %s\n", stats.bvhCachedMeshCount, sceneData.meshes.size(), bvhCacheDirectory);
+	}
+
+	printf("*** CPU BVH : %zu triangle references, %.1f%% more than triangles%s\n", stats.triangleReferenceCount, 
+		stats.triangleCount > 0 ? 100.0 * stats.triangleReferenceCount / stats.triangleCount - 100.0 : 0.0, bSpatialSplits ? " with spatial splits" : "");
+
+	const SceneViewData view = MakeSceneViewData(eye, look, k_verticalFov, static_cast<float>(width) / height);
+	if (bBenchmark)
+	{
+		printf("*** CPU benchmark : %s traversal\n", GetSimdIsaName(raytracer.GetTraversalIsa()));
+		RunBenchmark(raytracer, sceneData, view, width, height, benchRayCount);
+	}
+
+	if (bScaling)
+	{
+		RunScaling(raytracer, view, width, height, threadCount);
+	}
+
+	if (bBuildBenchmark)
+	{
+		RunBuildBenchmark(sceneData, threadCount);
+	}
+
+	if (bInstanceBenchmark)
+	{
+		RunInstanceBenchmark(sceneData);
+	}
+
+	if (bLayoutBenchmark)
+	{
+		RunLayoutBenchmark(raytracer, sceneData, view, width, height, threadCount, layoutBenchRayCount);
+	}
+
+	if (animationFrameCount > 0)
+	{
+		RunAnimation(raytracer, sceneData, view, width, height, threadCount, animationFrameCount);
+	}
+
+	if (statsPath && !WriteStats(raytracer, argv[1], view, width, height, threadCount, statsPath))
+	{
+		printf("ERROR: Failed to write %s\n", statsPath);
+		return 1;
+	}
+
+	startTime = std::chrono::steady_clock::now();
+	std::vector<Vec3> image;
+	raytracer.Render(view, width, height, threadCount, image);
+	printf("*** CPU ray tracer : %ux%u in %zu ms on %u threads with %s traversal\n", width, height, MillisecondsSince(startTime), threadCount, GetSimdIsaName(raytracer.GetTraversalIsa()));
+
+	if (!WriteImagePpm(argv[3], width, height, image))
+	{
+		printf("ERROR: Failed to write %s\n", argv[3]);
+		return 1;
+	}
+
+	return 0;
+}
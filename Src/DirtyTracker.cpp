@@ -0,0 +1,75 @@
+#include "DirtyTracker.h"
+
+#include <cassert>
+
+void DirtyTracker::Init(const size_t itemCount, const uint32_t bufferCount)
+{
+	assert(bufferCount > 0 && bufferCount <= k_maxBufferCount);
+
+	m_bufferMasks.assign(itemCount, 0);
+	m_dirtyItems.clear();
+	m_dirtyCounts.assign(bufferCount, 0);
+	m_allBuffersMask = bufferCount == 32 ? ~0u : (1u << bufferCount) - 1;
+}
+
+void DirtyTracker::MarkDirty(const size_t item)
+{
+	uint32_t& mask = m_bufferMasks[item];
+	if (mask == 0)
+	{
+		m_dirtyItems.push_back(item);
+	}
+
+	for (uint32_t bufferIndex = 0; bufferIndex < m_dirtyCounts.size(); bufferIndex++)
+	{
+		if ((mask & (1u << bufferIndex)) == 0)
+		{
+			m_dirtyCounts[bufferIndex]++;
+		}
+	}
+
+	mask = m_allBuffersMask;
+}
+
+void DirtyTracker::MarkAllDirty()
+{
+	for (size_t item = 0; item < m_bufferMasks.size(); item++)
+	{
+		MarkDirty(item);
+	}
+}
+
+bool DirtyTracker::IsDirty(const uint32_t bufferIndex) const
+{
+	return m_dirtyCounts[bufferIndex] > 0;
+}
+
+void DirtyTracker::ConsumeDirty(const uint32_t bufferIndex, std::vector<size_t>& outItems)
+{
+	if (m_dirtyCounts[bufferIndex] == 0)
+	{
+		return;
+	}
+
+	const uint32_t bufferBit = 1u << bufferIndex;
+
+	// Items that every buffer has now seen drop out of the dirty list
+	size_t writeIndex = 0;
+	for (const size_t item : m_dirtyItems)
+	{
+		uint32_t& mask = m_bufferMasks[item];
+		if (mask & bufferBit)
+		{
+			outItems.push_back(item);
+			mask &= ~bufferBit;
+		}
+
+		if (mask != 0)
+		{
+			m_dirtyItems[writeIndex++] = item;
+		}
+	}
+
+	m_dirtyItems.resize(writeIndex);
+	m_dirtyCounts[bufferIndex] = 0;
+}
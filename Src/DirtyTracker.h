@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Tracks which items have changed since each of several buffered copies was last brought up to date. A change
+// marks the item dirty for every buffer, and each buffer clears only its own bit when it consumes the change.
+class DirtyTracker
+{
+public:
+	static constexpr uint32_t k_maxBufferCount = 32;
+
+	void Init(const size_t itemCount, const uint32_t bufferCount);
+
+	void MarkDirty(const size_t item);
+	void MarkAllDirty();
+
+	bool IsDirty(const uint32_t bufferIndex) const;
+
+	// Appends the items that are dirty for the buffer to outItems and clears them for that buffer only
+	void ConsumeDirty(const uint32_t bufferIndex, std::vector<size_t>& outItems);
+
+private:
+	std::vector<uint32_t> m_bufferMasks;	// per item, one bit per buffer that has yet to see the change
+	std::vector<size_t> m_dirtyItems;		// items with a non zero mask, so that consuming does not scan every item
+	std::vector<size_t> m_dirtyCounts;		// per buffer
+	uint32_t m_allBuffersMask = 0;
+};
@@ -0,0 +1,116 @@
+#include "HeapAllocator.h"
+
+#include <cassert>
+#include <iterator>
+
+void HeapAllocator::Init(const size_t sizeInBytes)
+{
+	m_freeBlocks.clear();
+	m_allocations.clear();
+
+	m_freeBlocks.emplace(0, sizeInBytes);
+	m_totalSize = sizeInBytes;
+	m_allocatedSize = 0;
+}
+
+size_t HeapAllocator::Allocate(const size_t sizeInBytes, const size_t alignment)
+{
+	assert((alignment & (alignment - 1)) == 0 && "Alignment must be a power of two");
+	const size_t alignedSize = (sizeInBytes + (alignment - 1)) & ~(alignment - 1);
+
+	// First fit
+	for (auto it = m_freeBlocks.begin(); it != m_freeBlocks.end(); ++it)
+	{
+		const size_t blockStart = it->first;
+		const size_t blockEnd = it->first + it->second;
+		const size_t alignedStart = (blockStart + (alignment - 1)) & ~(alignment - 1);
+
+		if (alignedStart + alignedSize > blockEnd)
+		{
+			continue;
+		}
+
+		// Split the block, returning the alignment padding and the tail to the free list
+		m_freeBlocks.erase(it);
+
+		if (alignedStart > blockStart)
+		{
+			m_freeBlocks.emplace(blockStart, alignedStart - blockStart);
+		}
+
+		if (alignedStart + alignedSize < blockEnd)
+		{
+			m_freeBlocks.emplace(alignedStart + alignedSize, blockEnd - (alignedStart + alignedSize));
+		}
+
+		m_allocations.emplace(alignedStart, alignedSize);
+		m_allocatedSize += alignedSize;
+		return alignedStart;
+	}
+
+	return k_invalidOffset;
+}
+
+bool HeapAllocator::Free(const size_t offset)
+{
+	auto allocIt = m_allocations.find(offset);
+	if (allocIt == m_allocations.end())
+	{
+		return false;
+	}
+
+	size_t blockStart = allocIt->first;
+	size_t blockSize = allocIt->second;
+	m_allocatedSize -= blockSize;
+	m_allocations.erase(allocIt);
+
+	// Coalesce with the following block
+	auto next = m_freeBlocks.lower_bound(blockStart);
+	if (next != m_freeBlocks.end() && next->first == blockStart + blockSize)
+	{
+		blockSize += next->second;
+		next = m_freeBlocks.erase(next);
+	}
+
+	// Coalesce with the preceding block
+	if (next != m_freeBlocks.begin())
+	{
+		auto prev = std::prev(next);
+		if (prev->first + prev->second == blockStart)
+		{
+			blockStart = prev->first;
+			blockSize += prev->second;
+			m_freeBlocks.erase(prev);
+		}
+	}
+
+	m_freeBlocks.emplace(blockStart, blockSize);
+	return true;
+}
+
+size_t HeapAllocator::GetTotalSize() const
+{
+	return m_totalSize;
+}
+
+size_t HeapAllocator::GetAllocatedSize() const
+{
+	return m_allocatedSize;
+}
+
+size_t HeapAllocator::GetAllocationSize(const size_t offset) const
+{
+	auto it = m_allocations.find(offset);
+	return it != m_allocations.end() ? it->second : 0;
+}
+
+size_t HeapAllocator::GetLargestFreeBlock() const
+{
+	size_t largest = 0;
+	for (const auto& block : m_freeBlocks)
+	{
+		largest = block.second > largest ? block.second : largest;
+	}
+
+	return largest;
+}
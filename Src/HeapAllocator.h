@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <map>
+
+// Offset allocator over a linear range of memory. Does not own any memory itself,
+// so it can back a D3D12 heap as well as any CPU side range.
+class HeapAllocator
+{
+public:
+	static constexpr size_t k_invalidOffset = ~size_t(0);
+
+	void Init(const size_t sizeInBytes);
+
+	// Returns k_invalidOffset if there is no free block large enough
+	size_t Allocate(const size_t sizeInBytes, const size_t alignment);
+
+	// Returns false and leaves the allocator as it was if offset is not an allocation, eg. one that was already freed
+	bool Free(const size_t offset);
+
+	size_t GetTotalSize() const;
+	size_t GetAllocatedSize() const;
+	size_t GetAllocationSize(const size_t offset) const;
+	size_t GetLargestFreeBlock() const;
+
+private:
+	std::map<size_t, size_t> m_freeBlocks;	// offset -> size, sorted so that neighbours can be merged
+	std::map<size_t, size_t> m_allocations;	// offset -> size
+	size_t m_totalSize = 0;
+	size_t m_allocatedSize = 0;
+};
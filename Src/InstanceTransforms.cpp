@@ -0,0 +1,198 @@
+#include "InstanceTransforms.h"
+#include "DirtyTracker.h"
+
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define INSTANCE_TRANSFORMS_SSE 1
+#include <emmintrin.h>
+#endif
+
+void InstanceTransforms::Resize(const size_t instanceCount)
+{
+	for (std::vector<float>& elements : m_elements)
+	{
+		elements.resize(instanceCount);
+	}
+
+	m_count = instanceCount;
+}
+
+void InstanceTransforms::Set(const size_t instanceIndex, const float m[4][4])
+{
+	assert(instanceIndex < m_count);
+
+	for (size_t row = 0; row < 4; row++)
+	{
+		for (size_t col = 0; col < 3; col++)
+		{
+			m_elements[row * 3 + col][instanceIndex] = m[row][col];
+		}
+	}
+}
+
+size_t InstanceTransforms::GetCount() const
+{
+	return m_count;
+}
+
+const float* InstanceTransforms::GetElements(const size_t row, const size_t col) const
+{
+	return m_elements[row * 3 + col].data();
+}
+
+namespace
+{
+	void WriteInstanceRecord(const InstanceTransforms& transforms, const InstanceRecordAttributes& attributes, const size_t instanceIndex, InstanceRecord* out)
+	{
+		// Record row r holds column r of the matrix
+		for (size_t row = 0; row < 3; row++)
+		{
+			for (size_t col = 0; col < 4; col++)
+			{
+				out->transform[row][col] = transforms.GetElements(col, row)[instanceIndex];
+			}
+		}
+
+		out->instanceIdAndMask = attributes.instanceIdAndMask;
+		out->hitGroupOffsetAndFlags = attributes.hitGroupOffsetAndFlags;
+		out->accelerationStructure = attributes.accelerationStructure;
+	}
+
+#if INSTANCE_TRANSFORMS_SSE
+	template<bool streaming>
+	void WriteInstanceRecordsSSE(
+		const InstanceTransforms& transforms, 
+		const InstanceRecordAttributes* attributes, 
+		const size_t firstInstance, 
+		const size_t count, 
+		InstanceRecord* out)
+	{
+		auto store = [](float* dest, const __m128 value)
+		{
+			if constexpr (streaming)
+			{
+				_mm_stream_ps(dest, value);
+			}
+			else
+			{
+				_mm_storeu_ps(dest, value);
+			}
+		};
+
+		auto storeTail = [](InstanceRecord* dest, const __m128i value)
+		{
+			if constexpr (streaming)
+			{
+				_mm_stream_si128(reinterpret_cast<__m128i*>(&dest->instanceIdAndMask), value);
+			}
+			else
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(&dest->instanceIdAndMask), value);
+			}
+		};
+
+		const float* elements[4][3];
+		for (size_t row = 0; row < 4; row++)
+		{
+			for (size_t col = 0; col < 3; col++)
+			{
+				elements[row][col] = transforms.GetElements(row, col) + firstInstance;
+			}
+		}
+
+		size_t i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			// Record row r of four instances is column r of their matrices, so load the column and transpose
+			for (size_t row = 0; row < 3; row++)
+			{
+				__m128 r0 = _mm_loadu_ps(elements[0][row] + i);
+				__m128 r1 = _mm_loadu_ps(elements[1][row] + i);
+				__m128 r2 = _mm_loadu_ps(elements[2][row] + i);
+				__m128 r3 = _mm_loadu_ps(elements[3][row] + i);
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+
+				store(out[i].transform[row], r0);
+				store(out[i + 1].transform[row], r1);
+				store(out[i + 2].transform[row], r2);
+				store(out[i + 3].transform[row], r3);
+			}
+
+			const InstanceRecordAttributes* a = attributes + firstInstance + i;
+			storeTail(out + i, _mm_loadu_si128(reinterpret_cast<const __m128i*>(a)));
+			storeTail(out + i + 1, _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 1)));
+			storeTail(out + i + 2, _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 2)));
+			storeTail(out + i + 3, _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + 3)));
+		}
+
+		for (; i < count; i++)
+		{
+			WriteInstanceRecord(transforms, attributes[firstInstance + i], firstInstance + i, out + i);
+		}
+
+		if constexpr (streaming)
+		{
+			_mm_sfence();
+		}
+	}
+#endif
+}
+
+void WriteInstanceRecords(
+	const InstanceTransforms& transforms, 
+	const InstanceRecordAttributes* attributes, 
+	const size_t firstInstance, 
+	const size_t count, 
+	InstanceRecord* out)
+{
+	assert(firstInstance + count <= transforms.GetCount());
+
+#if INSTANCE_TRANSFORMS_SSE
+	if ((reinterpret_cast<uintptr_t>(out) & 15) == 0)
+	{
+		WriteInstanceRecordsSSE<true>(transforms, attributes, firstInstance, count, out);
+	}
+	else
+	{
+		WriteInstanceRecordsSSE<false>(transforms, attributes, firstInstance, count, out);
+	}
+#else
+	for (size_t i = 0; i < count; i++)
+	{
+		WriteInstanceRecord(transforms, attributes[firstInstance + i], firstInstance + i, out + i);
+	}
+#endif
+}
+
+bool UpdateInstanceRecords(
+	const InstanceTransforms& transforms, 
+	const InstanceRecordAttributes* attributes, 
+	DirtyTracker& dirtyTracker, 
+	const uint32_t bufferIndex, 
+	std::vector<size_t>& dirtyInstances, 
+	InstanceRecord* out)
+{
+	if (!dirtyTracker.IsDirty(bufferIndex))
+	{
+		return false;
+	}
+
+	dirtyInstances.clear();
+	dirtyTracker.ConsumeDirty(bufferIndex, dirtyInstances);
+
+	if (k_instanceRecordsBulkDirtyRatio * dirtyInstances.size() > transforms.GetCount())
+	{
+		// Cheaper to rewrite everything in bulk than to pick out a large fraction of the instances
+		WriteInstanceRecords(transforms, attributes, 0, transforms.GetCount(), out);
+	}
+	else
+	{
+		for (const size_t instanceIndex : dirtyInstances)
+		{
+			WriteInstanceRecords(transforms, attributes, instanceIndex, 1, out + instanceIndex);
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class DirtyTracker;
+
+// Same layout as D3D12_RAYTRACING_INSTANCE_DESC, so that records can be written straight into the instance desc buffer
+struct InstanceRecord
+{
+	float transform[3][4];				// row major 3x4, column vector convention
+	uint32_t instanceIdAndMask;			// InstanceID : 24, InstanceMask : 8
+	uint32_t hitGroupOffsetAndFlags;	// InstanceContributionToHitGroupIndex : 24, Flags : 8
+	uint64_t accelerationStructure;
+};
+
+static_assert(sizeof(InstanceRecord) == 64, "InstanceRecord must match D3D12_RAYTRACING_INSTANCE_DESC");
+
+// Everything in an instance record except for the transform. It rarely changes, so it is prepacked.
+struct InstanceRecordAttributes
+{
+	uint32_t instanceIdAndMask;
+	uint32_t hitGroupOffsetAndFlags;
+	uint64_t accelerationStructure;
+
+	static InstanceRecordAttributes Pack(const uint32_t instanceId, const uint8_t mask, const uint32_t hitGroupOffset, const uint8_t flags, const uint64_t accelerationStructure)
+	{
+		return { (instanceId & 0xFFFFFF) | (static_cast<uint32_t>(mask) << 24), (hitGroupOffset & 0xFFFFFF) | (static_cast<uint32_t>(flags) << 24), accelerationStructure };
+	}
+};
+
+static_assert(sizeof(InstanceRecordAttributes) == 16, "InstanceRecordAttributes must match the tail of an InstanceRecord");
+
+// Instance transforms stored as structure of arrays, one array per matrix element, so that the instance records can be
+// generated four at a time. Takes row major 4x4 matrices in the row vector convention (translation in the last row),
+// as stored in a DirectX::XMFLOAT4X4. The last column is assumed to be (0, 0, 0, 1) and is not stored.
+class InstanceTransforms
+{
+public:
+	void Resize(const size_t instanceCount);
+	void Set(const size_t instanceIndex, const float m[4][4]);
+	size_t GetCount() const;
+
+	// Element m[row][col] of every instance
+	const float* GetElements(const size_t row, const size_t col) const;
+
+private:
+	std::array<std::vector<float>, 12> m_elements;	// [row * 3 + col]
+	size_t m_count = 0;
+};
+
+// Writes count records starting at firstInstance to out[0, count). The transforms are transposed to the 3x4 layout
+// D3D12 expects. Uses SSE where available and non-temporal stores if out is 16 byte aligned, since the destination
+// is usually write combined upload memory that is never read back by the CPU.
+void WriteInstanceRecords(
+	const InstanceTransforms& transforms, 
+	const InstanceRecordAttributes* attributes, 
+	const size_t firstInstance, 
+	const size_t count, 
+	InstanceRecord* out);
+
+// UpdateInstanceRecords rewrites every record once more than one in this many instances are dirty. The transforms of
+// scattered instances miss the cache for each of their arrays, so a bulk rewrite wins early (see CpuRender --instance-bench).
+constexpr size_t k_instanceRecordsBulkDirtyRatio = 20;
+
+// Brings one buffered copy of the records, out[0, transforms.GetCount()), up to date by consuming the instances that
+// are dirty for bufferIndex. Only those are rewritten, unless so many are that a bulk rewrite is cheaper. Call it
+// right before whatever reads the copy, eg. the TLAS build, so that it picks up every change made until then.
+// dirtyInstances is scratch space. Returns false if the copy was already up to date.
+bool UpdateInstanceRecords(
+	const InstanceTransforms& transforms, 
+	const InstanceRecordAttributes* attributes, 
+	DirtyTracker& dirtyTracker, 
+	const uint32_t bufferIndex, 
+	std::vector<size_t>& dirtyInstances, 
+	InstanceRecord* out);
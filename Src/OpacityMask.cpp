@@ -0,0 +1,170 @@
+#include "OpacityMask.h"
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <utility>
+
+namespace
+{
+	constexpr uint32_t MakeFourCC(const char a, const char b, const char c, const char d)
+	{
+		return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+	}
+
+	constexpr uint32_t k_ddsMagic = MakeFourCC('D', 'D', 'S', ' ');
+	constexpr uint32_t k_ddsHeaderSize = 124;
+	constexpr uint32_t k_dx10HeaderSize = 20;
+	constexpr uint32_t k_ddpfFourCC = 0x4;
+	constexpr uint32_t k_dxgiFormatBC4Unorm = 80;
+
+	uint32_t ReadU32(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	void DecodeBC4Block(const uint8_t* block, uint8_t outTexels[16])
+	{
+		const uint32_t r0 = block[0];
+		const uint32_t r1 = block[1];
+
+		uint8_t palette[8];
+		palette[0] = static_cast<uint8_t>(r0);
+		palette[1] = static_cast<uint8_t>(r1);
+
+		if (r0 > r1)
+		{
+			for (uint32_t i = 1; i < 7; i++)
+			{
+				palette[i + 1] = static_cast<uint8_t>(((7 - i) * r0 + i * r1 + 3) / 7);
+			}
+		}
+		else
+		{
+			for (uint32_t i = 1; i < 5; i++)
+			{
+				palette[i + 1] = static_cast<uint8_t>(((5 - i) * r0 + i * r1 + 2) / 5);
+			}
+
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		// 16 3-bit indices packed little endian into the remaining 6 bytes
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; i++)
+		{
+			indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			outTexels[i] = palette[(indices >> (3 * i)) & 0x7];
+		}
+	}
+}
+
+bool LoadOpacityMaskDds(const std::string& path, OpacityMask& outMask)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	const std::vector<uint8_t> data{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	if (data.size() < 4 + k_ddsHeaderSize || ReadU32(&data[0]) != k_ddsMagic || ReadU32(&data[4]) != k_ddsHeaderSize)
+	{
+		return false;
+	}
+
+	const uint8_t* header = &data[4];
+	const uint32_t height = ReadU32(header + 8);
+	const uint32_t width = ReadU32(header + 12);
+
+	const uint8_t* pixelFormat = header + 72;
+	const uint32_t pfFlags = ReadU32(pixelFormat + 4);
+	const uint32_t fourCC = ReadU32(pixelFormat + 8);
+	const uint32_t rgbBitCount = ReadU32(pixelFormat + 12);
+
+	size_t dataOffset = 4 + k_ddsHeaderSize;
+	bool isBC4 = false;
+
+	if (pfFlags & k_ddpfFourCC)
+	{
+		if (fourCC == MakeFourCC('D', 'X', '1', '0'))
+		{
+			if (data.size() < dataOffset + k_dx10HeaderSize || ReadU32(&data[dataOffset]) != k_dxgiFormatBC4Unorm)
+			{
+				return false;
+			}
+
+			dataOffset += k_dx10HeaderSize;
+			isBC4 = true;
+		}
+		else if (fourCC == MakeFourCC('B', 'C', '4', 'U') || fourCC == MakeFourCC('A', 'T', 'I', '1'))
+		{
+			isBC4 = true;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else if (rgbBitCount != 8)
+	{
+		return false;
+	}
+
+	if (width == 0 || height == 0)
+	{
+		return false;
+	}
+
+	// Decoded on the side, so that outMask is left as it was if the file turns out to be truncated
+	OpacityMask mask;
+	mask.width = width;
+	mask.height = height;
+	mask.texels.resize(static_cast<size_t>(width) * height);
+
+	if (!isBC4)
+	{
+		if (data.size() < dataOffset + mask.texels.size())
+		{
+			return false;
+		}
+
+		memcpy(mask.texels.data(), &data[dataOffset], mask.texels.size());
+		outMask = std::move(mask);
+		return true;
+	}
+
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+	if (data.size() < dataOffset + static_cast<size_t>(blocksX) * blocksY * 8)
+	{
+		return false;
+	}
+
+	for (uint32_t by = 0; by < blocksY; by++)
+	{
+		for (uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			uint8_t block[16];
+			DecodeBC4Block(&data[dataOffset + (static_cast<size_t>(by) * blocksX + bx) * 8], block);
+
+			for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+			{
+				for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+				{
+					mask.texels[static_cast<size_t>(by * 4 + y) * width + bx * 4 + x] = block[y * 4 + x];
+				}
+			}
+		}
+	}
+
+	outMask = std::move(mask);
+	return true;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Single channel 8-bit opacity, top mip only
+struct OpacityMask
+{
+	uint32_t width = 0;
+	uint32_t height = 0;
+	std::vector<uint8_t> texels;
+
+	// Wraps like a D3D12_TEXTURE_ADDRESS_MODE_WRAP sampler
+	uint8_t Fetch(const int64_t x, const int64_t y) const
+	{
+		const int64_t wx = ((x % width) + width) % width;
+		const int64_t wy = ((y % height) + height) % height;
+		return texels[static_cast<size_t>(wy * width + wx)];
+	}
+};
+
+// Reads the opacity mask out of a DDS file. Supports BC4 (BC4U, ATI1 or DX10 BC4_UNORM) and uncompressed
+// 8-bit luminance or alpha. Returns false, leaving outMask untouched, for anything else or for a truncated file.
+bool LoadOpacityMaskDds(const std::string& path, OpacityMask& outMask);
@@ -0,0 +1,55 @@
+#include "QueueScheduler.h"
+
+#include <cassert>
+
+void QueueScheduler::Init(QueueFences* fences)
+{
+	m_fences = fences;
+	m_lastSignalled = {};
+	m_lastWaited = {};
+	m_elidedWaitCount = 0;
+}
+
+uint64_t QueueScheduler::Signal(const QueueType queue)
+{
+	const uint64_t value = ++m_lastSignalled[static_cast<size_t>(queue)];
+	m_fences->Signal(queue, value);
+	return value;
+}
+
+bool QueueScheduler::Wait(const QueueType waitingQueue, const QueueType signallingQueue, const uint64_t value)
+{
+	assert(value <= m_lastSignalled[static_cast<size_t>(signallingQueue)] && "Waiting on a fence value that was never signalled");
+
+	// A queue is always ordered after its own work
+	if (waitingQueue == signallingQueue)
+	{
+		return false;
+	}
+
+	uint64_t& lastWaited = m_lastWaited[static_cast<size_t>(waitingQueue)][static_cast<size_t>(signallingQueue)];
+	if (value <= lastWaited || IsComplete(signallingQueue, value))
+	{
+		m_elidedWaitCount++;
+		return false;
+	}
+
+	m_fences->Wait(waitingQueue, signallingQueue, value);
+	lastWaited = value;
+	return true;
+}
+
+bool QueueScheduler::IsComplete(const QueueType queue, const uint64_t value) const
+{
+	return m_fences->GetCompletedValue(queue) >= value;
+}
+
+uint64_t QueueScheduler::GetLastSignalledValue(const QueueType queue) const
+{
+	return m_lastSignalled[static_cast<size_t>(queue)];
+}
+
+size_t QueueScheduler::GetElidedWaitCount() const
+{
+	return m_elidedWaitCount;
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+enum class QueueType
+{
+	Graphics,
+	Compute,
+	Count
+};
+
+// The GPU side of the scheduler: one monotonically increasing fence per queue. Kept behind an interface so that the
+// ordering logic does not depend on D3D12.
+class QueueFences
+{
+public:
+	virtual ~QueueFences() = default;
+
+	// Enqueue a signal of value on the queue's own fence
+	virtual void Signal(const QueueType queue, const uint64_t value) = 0;
+
+	// Make waitingQueue wait on the GPU until signallingQueue's fence reaches value
+	virtual void Wait(const QueueType waitingQueue, const QueueType signallingQueue, const uint64_t value) = 0;
+
+	virtual uint64_t GetCompletedValue(const QueueType queue) const = 0;
+};
+
+// Hands out fence values per queue and inserts cross queue waits only where they are needed. A wait is skipped if
+// the waiting queue already waited on an equal or later value of the same fence, or if that value has already
+// completed. Waiting on a value that has not been signalled yet would deadlock, so it is rejected.
+class QueueScheduler
+{
+public:
+	void Init(QueueFences* fences);
+
+	// Signals the next value on the queue after the work submitted so far and returns it
+	uint64_t Signal(const QueueType queue);
+
+	// Returns true if a wait was actually enqueued
+	bool Wait(const QueueType waitingQueue, const QueueType signallingQueue, const uint64_t value);
+
+	bool IsComplete(const QueueType queue, const uint64_t value) const;
+	uint64_t GetLastSignalledValue(const QueueType queue) const;
+	size_t GetElidedWaitCount() const;
+
+private:
+	static constexpr size_t k_queueCount = static_cast<size_t>(QueueType::Count);
+
+	QueueFences* m_fences = nullptr;
+	std::array<uint64_t, k_queueCount> m_lastSignalled = {};
+	std::array<std::array<uint64_t, k_queueCount>, k_queueCount> m_lastWaited = {};	// [waiting][signalling]
+	size_t m_elidedWaitCount = 0;
+};
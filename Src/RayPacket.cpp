@@ -0,0 +1,504 @@
+#include "RayPacket.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cmath>
+
+#if SIMD_ISA_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	// Each slab is entered by the packet no earlier than the smaller and left no later than the larger of its distances
+	// along the inverse directions at either end of the packet's range
+	uint32_t IntersectChildrenPacketScalar(const Bvh8Node& node, const RayPacketSetup& rays, const float tMin, const float tMax, float outEntries[8])
+	{
+		const float origin[3] = { rays.origin.x, rays.origin.y, rays.origin.z };
+
+		uint32_t hitMask = 0;
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			float entry = tMin;
+			float exit = FLT_MAX;
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				const float nearPlane = node.planes[rays.nearPlane[axis]][slot] - origin[axis];
+				const float farPlane = node.planes[rays.farPlane[axis]][slot] - origin[axis];
+				entry = (std::max)(entry, (std::min)(nearPlane * rays.invDirectionMin[axis], nearPlane * rays.invDirectionMax[axis]));
+				exit = (std::min)(exit, (std::max)(farPlane * rays.invDirectionMin[axis], farPlane * rays.invDirectionMax[axis]));
+			}
+
+			exit = (std::min)(exit * k_bvh8RobustExitScale, tMax);
+			outEntries[slot] = entry;
+			hitMask |= (entry <= exit ? 1u : 0u) << slot;
+		}
+
+		return hitMask;
+	}
+
+	uint32_t IntersectQuantizedChildrenPacketScalar(const Bvh8QuantizedNode& node, const RayPacketSetup& rays, const float tMin, const float tMax, float outEntries[8])
+	{
+		const float origin[3] = { rays.origin.x, rays.origin.y, rays.origin.z };
+
+		uint32_t hitMask = 0;
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			float entry = tMin;
+			float exit = FLT_MAX;
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				const float nearPlane = (node.origin[axis] + static_cast<float>(node.planes[rays.nearPlane[axis]][slot]) * node.scale[axis]) - origin[axis];
+				const float farPlane = (node.origin[axis] + static_cast<float>(node.planes[rays.farPlane[axis]][slot]) * node.scale[axis]) - origin[axis];
+				entry = (std::max)(entry, (std::min)(nearPlane * rays.invDirectionMin[axis], nearPlane * rays.invDirectionMax[axis]));
+				exit = (std::min)(exit, (std::max)(farPlane * rays.invDirectionMin[axis], farPlane * rays.invDirectionMax[axis]));
+			}
+
+			exit = (std::min)(exit * k_bvh8RobustExitScale, tMax);
+			outEntries[slot] = entry;
+			hitMask |= (entry <= exit ? 1u : 0u) << slot;
+		}
+
+		return hitMask & node.childMask;
+	}
+
+	// Records the hits a SIMD test found for rays [first, first + width) and redoes the rays it could not decide in
+	// scalar code
+	uint64_t ResolveRays(
+		const TrianglePacket& packet,
+		const uint32_t lane,
+		const uint32_t triangleId,
+		const RayPacketSetup& rays,
+		const uint32_t first,
+		uint32_t hitMask,
+		uint32_t scalarMask,
+		const float* t,
+		const float* u,
+		const float* v,
+		const float tMin,
+		RayPacketHits& inOutHits)
+	{
+		uint64_t updated = 0;
+		for (uint32_t i = 0; hitMask != 0; i++, hitMask >>= 1)
+		{
+			if ((hitMask & 1) != 0)
+			{
+				const uint32_t ray = first + i;
+				inOutHits.t[ray] = t[i];
+				inOutHits.u[ray] = u[i];
+				inOutHits.v[ray] = v[i];
+				inOutHits.triangle[ray] = triangleId;
+				updated |= uint64_t(1) << ray;
+			}
+		}
+
+		if (scalarMask == 0)
+		{
+			return updated;
+		}
+
+		const Vec3 v0 = { packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane] };
+		const Vec3 v1 = { packet.v1[0][lane], packet.v1[1][lane], packet.v1[2][lane] };
+		const Vec3 v2 = { packet.v2[0][lane], packet.v2[1][lane], packet.v2[2][lane] };
+		for (uint32_t i = 0; scalarMask != 0; i++, scalarMask >>= 1)
+		{
+			if ((scalarMask & 1) == 0)
+			{
+				continue;
+			}
+
+			const uint32_t ray = first + i;
+			const WatertightRay watertightRay = { rays.origin, rays.kx, rays.ky, rays.kz, rays.sx[ray], rays.sy[ray], rays.sz[ray] };
+			float rayT, rayU, rayV;
+			if (IntersectTriangleWatertight(watertightRay, v0, v1, v2, tMin, inOutHits.t[ray], rayT, rayU, rayV))
+			{
+				inOutHits.t[ray] = rayT;
+				inOutHits.u[ray] = rayU;
+				inOutHits.v[ray] = rayV;
+				inOutHits.triangle[ray] = triangleId;
+				updated |= uint64_t(1) << ray;
+			}
+		}
+
+		return updated;
+	}
+
+	uint64_t IntersectTriangleRayPacketScalar(
+		const TrianglePacket& packet,
+		const uint32_t lane,
+		const uint32_t triangleId,
+		const RayPacketSetup& rays,
+		const float tMin,
+		RayPacketHits& inOutHits)
+	{
+		const uint64_t allRays = rays.count == 64 ? ~uint64_t(0) : (uint64_t(1) << rays.count) - 1;
+
+		uint64_t updated = 0;
+		for (uint32_t first = 0; first < rays.count; first += 32)
+		{
+			const uint32_t scalarMask = static_cast<uint32_t>(allRays >> first);
+			updated |= ResolveRays(packet, lane, triangleId, rays, first, 0, scalarMask, nullptr, nullptr, nullptr, tMin, inOutHits);
+		}
+
+		return updated;
+	}
+
+#if SIMD_ISA_X86
+	uint32_t IntersectChildrenPacketSse(const Bvh8Node& node, const RayPacketSetup& rays, const float tMin, const float tMax, float outEntries[8])
+	{
+		const float origin[3] = { rays.origin.x, rays.origin.y, rays.origin.z };
+
+		uint32_t hitMask = 0;
+		for (uint32_t half = 0; half < 8; half += 4)
+		{
+			__m128 entry = _mm_set1_ps(tMin);
+			__m128 exit = _mm_set1_ps(FLT_MAX);
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				const __m128 invMin = _mm_set1_ps(rays.invDirectionMin[axis]);
+				const __m128 invMax = _mm_set1_ps(rays.invDirectionMax[axis]);
+				const __m128 nearPlane = _mm_sub_ps(_mm_loadu_ps(&node.planes[rays.nearPlane[axis]][half]), _mm_set1_ps(origin[axis]));
+				const __m128 farPlane = _mm_sub_ps(_mm_loadu_ps(&node.planes[rays.farPlane[axis]][half]), _mm_set1_ps(origin[axis]));
+				entry = _mm_max_ps(entry, _mm_min_ps(_mm_mul_ps(nearPlane, invMin), _mm_mul_ps(nearPlane, invMax)));
+				exit = _mm_min_ps(exit, _mm_max_ps(_mm_mul_ps(farPlane, invMin), _mm_mul_ps(farPlane, invMax)));
+			}
+
+			exit = _mm_min_ps(_mm_mul_ps(exit, _mm_set1_ps(k_bvh8RobustExitScale)), _mm_set1_ps(tMax));
+			_mm_storeu_ps(outEntries + half, entry);
+			hitMask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(entry, exit))) << half;
+		}
+
+		return hitMask;
+	}
+
+	// Four planes of a row of a compressed node, starting at slot half
+	__m128 DecodePlanesSse(const uint8_t planes[8], const uint32_t half, const float origin, const float scale)
+	{
+		const __m128i words = _mm_unpacklo_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(planes)), _mm_setzero_si128());
+		const __m128i dwords = half == 0 ? _mm_unpacklo_epi16(words, _mm_setzero_si128()) : _mm_unpackhi_epi16(words, _mm_setzero_si128());
+		return _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(dwords), _mm_set1_ps(scale)), _mm_set1_ps(origin));
+	}
+
+	uint32_t IntersectQuantizedChildrenPacketSse(const Bvh8QuantizedNode& node, const RayPacketSetup& rays, const float tMin, const float tMax, float outEntries[8])
+	{
+		const float origin[3] = { rays.origin.x, rays.origin.y, rays.origin.z };
+
+		uint32_t hitMask = 0;
+		for (uint32_t half = 0; half < 8; half += 4)
+		{
+			__m128 entry = _mm_set1_ps(tMin);
+			__m128 exit = _mm_set1_ps(FLT_MAX);
+			for (uint32_t axis = 0; axis < 3; axis++)
+			{
+				const __m128 invMin = _mm_set1_ps(rays.invDirectionMin[axis]);
+				const __m128 invMax = _mm_set1_ps(rays.invDirectionMax[axis]);
+				const __m128 nearPlane = _mm_sub_ps(DecodePlanesSse(node.planes[rays.nearPlane[axis]], half, node.origin[axis], node.scale[axis]), _mm_set1_ps(origin[axis]));
+				const __m128 farPlane = _mm_sub_ps(DecodePlanesSse(node.planes[rays.farPlane[axis]], half, node.origin[axis], node.scale[axis]), _mm_set1_ps(origin[axis]));
+				entry = _mm_max_ps(entry, _mm_min_ps(_mm_mul_ps(nearPlane, invMin), _mm_mul_ps(nearPlane, invMax)));
+				exit = _mm_min_ps(exit, _mm_max_ps(_mm_mul_ps(farPlane, invMin), _mm_mul_ps(farPlane, invMax)));
+			}
+
+			exit = _mm_min_ps(_mm_mul_ps(exit, _mm_set1_ps(k_bvh8RobustExitScale)), _mm_set1_ps(tMax));
+			_mm_storeu_ps(outEntries + half, entry);
+			hitMask |= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmple_ps(entry, exit))) << half;
+		}
+
+		return hitMask & node.childMask;
+	}
+
+	uint64_t IntersectTriangleRayPacketSse(
+		const TrianglePacket& packet,
+		const uint32_t lane,
+		const uint32_t triangleId,
+		const RayPacketSetup& rays,
+		const float tMin,
+		RayPacketHits& inOutHits)
+	{
+		const float origin[3] = { rays.origin.x, rays.origin.y, rays.origin.z };
+		const float a[3] = { packet.v0[0][lane] - origin[0], packet.v0[1][lane] - origin[1], packet.v0[2][lane] - origin[2] };
+		const float b[3] = { packet.v1[0][lane] - origin[0], packet.v1[1][lane] - origin[1], packet.v1[2][lane] - origin[2] };
+		const float c[3] = { packet.v2[0][lane] - origin[0], packet.v2[1][lane] - origin[1], packet.v2[2][lane] - origin[2] };
+
+		const __m128 az = _mm_set1_ps(a[rays.kz]);
+		const __m128 bz = _mm_set1_ps(b[rays.kz]);
+		const __m128 cz = _mm_set1_ps(c[rays.kz]);
+		const __m128 zero = _mm_setzero_ps();
+
+		uint64_t updated = 0;
+		for (uint32_t first = 0; first < rays.count; first += 4)
+		{
+			const __m128 sx = _mm_loadu_ps(rays.sx + first);
+			const __m128 sy = _mm_loadu_ps(rays.sy + first);
+			const __m128 sz = _mm_loadu_ps(rays.sz + first);
+
+			const __m128 ax = _mm_sub_ps(_mm_set1_ps(a[rays.kx]), _mm_mul_ps(sx, az));
+			const __m128 ay = _mm_sub_ps(_mm_set1_ps(a[rays.ky]), _mm_mul_ps(sy, az));
+			const __m128 bx = _mm_sub_ps(_mm_set1_ps(b[rays.kx]), _mm_mul_ps(sx, bz));
+			const __m128 by = _mm_sub_ps(_mm_set1_ps(b[rays.ky]), _mm_mul_ps(sy, bz));
+			const __m128 cx = _mm_sub_ps(_mm_set1_ps(c[rays.kx]), _mm_mul_ps(sx, cz));
+			const __m128 cy = _mm_sub_ps(_mm_set1_ps(c[rays.ky]), _mm_mul_ps(sy, cz));
+
+			const __m128 u = _mm_sub_ps(_mm_mul_ps(cx, by), _mm_mul_ps(cy, bx));
+			const __m128 v = _mm_sub_ps(_mm_mul_ps(ax, cy), _mm_mul_ps(ay, cx));
+			const __m128 w = _mm_sub_ps(_mm_mul_ps(bx, ay), _mm_mul_ps(by, ax));
+
+			const uint32_t remaining = rays.count - first;
+			const uint32_t rayMask = remaining >= 4 ? 0xf : (1u << remaining) - 1;
+			const __m128 anyZero = _mm_or_ps(_mm_or_ps(_mm_cmpeq_ps(u, zero), _mm_cmpeq_ps(v, zero)), _mm_cmpeq_ps(w, zero));
+			const uint32_t scalarMask = static_cast<uint32_t>(_mm_movemask_ps(anyZero)) & rayMask;
+
+			const __m128 anyNegative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmplt_ps(v, zero)), _mm_cmplt_ps(w, zero));
+			const __m128 anyPositive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(u, zero), _mm_cmpgt_ps(v, zero)), _mm_cmpgt_ps(w, zero));
+
+			const __m128 rcpDet = _mm_div_ps(_mm_set1_ps(1.f), _mm_add_ps(_mm_add_ps(u, v), w));
+			const __m128 scaledT = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, _mm_mul_ps(sz, az)), _mm_mul_ps(v, _mm_mul_ps(sz, bz))), _mm_mul_ps(w, _mm_mul_ps(sz, cz)));
+			const __m128 t = _mm_mul_ps(scaledT, rcpDet);
+
+			const __m128 inRange = _mm_and_ps(_mm_cmpge_ps(t, _mm_set1_ps(tMin)), _mm_cmplt_ps(t, _mm_loadu_ps(inOutHits.t + first)));
+			const uint32_t hitMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_andnot_ps(_mm_and_ps(anyNegative, anyPositive), inRange))) & rayMask & ~scalarMask;
+			if (hitMask == 0 && scalarMask == 0)
+			{
+				continue;
+			}
+
+			float rayT[4], rayU[4], rayV[4];
+			_mm_storeu_ps(rayT, t);
+			_mm_storeu_ps(rayU, _mm_mul_ps(v, rcpDet));
+			_mm_storeu_ps(rayV, _mm_mul_ps(w, rcpDet));
+			updated |= ResolveRays(packet, lane, triangleId, rays, first, hitMask, scalarMask, rayT, rayU, rayV, tMin, inOutHits);
+		}
+
+		return updated;
+	}
+
+	SIMD_TARGET_AVX2 uint32_t IntersectChildrenPacketAvx2(const Bvh8Node& node, const RayPacketSetup& rays, const float tMin, const float tMax, float outEntries[8])
+	{
+		const float origin[3] = { rays.origin.x, rays.origin.y, rays.origin.z };
+
+		__m256 entry = _mm256_set1_ps(tMin);
+		__m256 exit = _mm256_set1_ps(FLT_MAX);
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			const __m256 invMin = _mm256_set1_ps(rays.invDirectionMin[axis]);
+			const __m256 invMax = _mm256_set1_ps(rays.invDirectionMax[axis]);
+			const __m256 nearPlane = _mm256_sub_ps(_mm256_loadu_ps(node.planes[rays.nearPlane[axis]]), _mm256_set1_ps(origin[axis]));
+			const __m256 farPlane = _mm256_sub_ps(_mm256_loadu_ps(node.planes[rays.farPlane[axis]]), _mm256_set1_ps(origin[axis]));
+			entry = _mm256_max_ps(entry, _mm256_min_ps(_mm256_mul_ps(nearPlane, invMin), _mm256_mul_ps(nearPlane, invMax)));
+			exit = _mm256_min_ps(exit, _mm256_max_ps(_mm256_mul_ps(farPlane, invMin), _mm256_mul_ps(farPlane, invMax)));
+		}
+
+		exit = _mm256_min_ps(_mm256_mul_ps(exit, _mm256_set1_ps(k_bvh8RobustExitScale)), _mm256_set1_ps(tMax));
+		_mm256_storeu_ps(outEntries, entry);
+		return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ)));
+	}
+
+	SIMD_TARGET_AVX2 __m256 DecodePlanesAvx2(const uint8_t planes[8], const float origin, const float scale)
+	{
+		const __m256i dwords = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(planes)));
+		return _mm256_add_ps(_mm256_mul_ps(_mm256_cvtepi32_ps(dwords), _mm256_set1_ps(scale)), _mm256_set1_ps(origin));
+	}
+
+	SIMD_TARGET_AVX2 uint32_t IntersectQuantizedChildrenPacketAvx2(const Bvh8QuantizedNode& node, const RayPacketSetup& rays, const float tMin, const float tMax, float outEntries[8])
+	{
+		const float origin[3] = { rays.origin.x, rays.origin.y, rays.origin.z };
+
+		__m256 entry = _mm256_set1_ps(tMin);
+		__m256 exit = _mm256_set1_ps(FLT_MAX);
+		for (uint32_t axis = 0; axis < 3; axis++)
+		{
+			const __m256 invMin = _mm256_set1_ps(rays.invDirectionMin[axis]);
+			const __m256 invMax = _mm256_set1_ps(rays.invDirectionMax[axis]);
+			const __m256 nearPlane = _mm256_sub_ps(DecodePlanesAvx2(node.planes[rays.nearPlane[axis]], node.origin[axis], node.scale[axis]), _mm256_set1_ps(origin[axis]));
+			const __m256 farPlane = _mm256_sub_ps(DecodePlanesAvx2(node.planes[rays.farPlane[axis]], node.origin[axis], node.scale[axis]), _mm256_set1_ps(origin[axis]));
+			entry = _mm256_max_ps(entry, _mm256_min_ps(_mm256_mul_ps(nearPlane, invMin), _mm256_mul_ps(nearPlane, invMax)));
+			exit = _mm256_min_ps(exit, _mm256_max_ps(_mm256_mul_ps(farPlane, invMin), _mm256_mul_ps(farPlane, invMax)));
+		}
+
+		exit = _mm256_min_ps(_mm256_mul_ps(exit, _mm256_set1_ps(k_bvh8RobustExitScale)), _mm256_set1_ps(tMax));
+		_mm256_storeu_ps(outEntries, entry);
+		return static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(entry, exit, _CMP_LE_OQ))) & node.childMask;
+	}
+
+	SIMD_TARGET_AVX2 uint64_t IntersectTriangleRayPacketAvx2(
+		const TrianglePacket& packet,
+		const uint32_t lane,
+		const uint32_t triangleId,
+		const RayPacketSetup& rays,
+		const float tMin,
+		RayPacketHits& inOutHits)
+	{
+		const float origin[3] = { rays.origin.x, rays.origin.y, rays.origin.z };
+		const float a[3] = { packet.v0[0][lane] - origin[0], packet.v0[1][lane] - origin[1], packet.v0[2][lane] - origin[2] };
+		const float b[3] = { packet.v1[0][lane] - origin[0], packet.v1[1][lane] - origin[1], packet.v1[2][lane] - origin[2] };
+		const float c[3] = { packet.v2[0][lane] - origin[0], packet.v2[1][lane] - origin[1], packet.v2[2][lane] - origin[2] };
+
+		const __m256 az = _mm256_set1_ps(a[rays.kz]);
+		const __m256 bz = _mm256_set1_ps(b[rays.kz]);
+		const __m256 cz = _mm256_set1_ps(c[rays.kz]);
+		const __m256 zero = _mm256_setzero_ps();
+
+		uint64_t updated = 0;
+		for (uint32_t first = 0; first < rays.count; first += 8)
+		{
+			const __m256 sx = _mm256_loadu_ps(rays.sx + first);
+			const __m256 sy = _mm256_loadu_ps(rays.sy + first);
+			const __m256 sz = _mm256_loadu_ps(rays.sz + first);
+
+			const __m256 ax = _mm256_sub_ps(_mm256_set1_ps(a[rays.kx]), _mm256_mul_ps(sx, az));
+			const __m256 ay = _mm256_sub_ps(_mm256_set1_ps(a[rays.ky]), _mm256_mul_ps(sy, az));
+			const __m256 bx = _mm256_sub_ps(_mm256_set1_ps(b[rays.kx]), _mm256_mul_ps(sx, bz));
+			const __m256 by = _mm256_sub_ps(_mm256_set1_ps(b[rays.ky]), _mm256_mul_ps(sy, bz));
+			const __m256 cx = _mm256_sub_ps(_mm256_set1_ps(c[rays.kx]), _mm256_mul_ps(sx, cz));
+			const __m256 cy = _mm256_sub_ps(_mm256_set1_ps(c[rays.ky]), _mm256_mul_ps(sy, cz));
+
+			const __m256 u = _mm256_sub_ps(_mm256_mul_ps(cx, by), _mm256_mul_ps(cy, bx));
+			const __m256 v = _mm256_sub_ps(_mm256_mul_ps(ax, cy), _mm256_mul_ps(ay, cx));
+			const __m256 w = _mm256_sub_ps(_mm256_mul_ps(bx, ay), _mm256_mul_ps(by, ax));
+
+			const uint32_t remaining = rays.count - first;
+			const uint32_t rayMask = remaining >= 8 ? 0xff : (1u << remaining) - 1;
+			const __m256 anyZero = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_EQ_OQ), _mm256_cmp_ps(v, zero, _CMP_EQ_OQ)), _mm256_cmp_ps(w, zero, _CMP_EQ_OQ));
+			const uint32_t scalarMask = static_cast<uint32_t>(_mm256_movemask_ps(anyZero)) & rayMask;
+
+			const __m256 anyNegative = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_LT_OQ), _mm256_cmp_ps(v, zero, _CMP_LT_OQ)), _mm256_cmp_ps(w, zero, _CMP_LT_OQ));
+			const __m256 anyPositive = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_GT_OQ), _mm256_cmp_ps(v, zero, _CMP_GT_OQ)), _mm256_cmp_ps(w, zero, _CMP_GT_OQ));
+
+			const __m256 rcpDet = _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_add_ps(_mm256_add_ps(u, v), w));
+			const __m256 scaledT = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(u, _mm256_mul_ps(sz, az)), _mm256_mul_ps(v, _mm256_mul_ps(sz, bz))), _mm256_mul_ps(w, _mm256_mul_ps(sz, cz)));
+			const __m256 t = _mm256_mul_ps(scaledT, rcpDet);
+
+			const __m256 inRange = _mm256_and_ps(_mm256_cmp_ps(t, _mm256_set1_ps(tMin), _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_loadu_ps(inOutHits.t + first), _CMP_LT_OQ));
+			const uint32_t hitMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_andnot_ps(_mm256_and_ps(anyNegative, anyPositive), inRange))) & rayMask & ~scalarMask;
+			if (hitMask == 0 && scalarMask == 0)
+			{
+				continue;
+			}
+
+			float rayT[8], rayU[8], rayV[8];
+			_mm256_storeu_ps(rayT, t);
+			_mm256_storeu_ps(rayU, _mm256_mul_ps(v, rcpDet));
+			_mm256_storeu_ps(rayV, _mm256_mul_ps(w, rcpDet));
+			updated |= ResolveRays(packet, lane, triangleId, rays, first, hitMask, scalarMask, rayT, rayU, rayV, tMin, inOutHits);
+		}
+
+		return updated;
+	}
+#endif
+}
+
+bool RayPacketSetup::Make(const RayPacket& packet, RayPacketSetup& outSetup)
+{
+	assert(packet.count > 0 && packet.count <= k_rayPacketSize);
+
+	outSetup.origin = packet.origin;
+	outSetup.count = packet.count;
+
+	for (uint32_t axis = 0; axis < 3; axis++)
+	{
+		const bool bNegative = std::signbit(packet.directions[axis][0]);
+		float invMin = FLT_MAX;
+		float invMax = -FLT_MAX;
+		for (uint32_t i = 0; i < packet.count; i++)
+		{
+			const float d = packet.directions[axis][i];
+			if (std::signbit(d) != bNegative)
+			{
+				return false;
+			}
+
+			// A zero component gives an infinite inverse, which would turn the plane distances of a ray starting on the
+			// plane into NaN
+			const float inv = (std::max)((std::min)(1.f / d, FLT_MAX), -FLT_MAX);
+			invMin = (std::min)(invMin, inv);
+			invMax = (std::max)(invMax, inv);
+		}
+
+		outSetup.invDirectionMin[axis] = invMin;
+		outSetup.invDirectionMax[axis] = invMax;
+		outSetup.nearPlane[axis] = 2 * axis + (bNegative ? 1 : 0);
+		outSetup.farPlane[axis] = 2 * axis + (bNegative ? 0 : 1);
+	}
+
+	// Every ray is sheared the same way it would be on its own, so that a packet finds the same hits as its rays
+	for (uint32_t i = 0; i < packet.count; i++)
+	{
+		const Vec3 direction = { packet.directions[0][i], packet.directions[1][i], packet.directions[2][i] };
+		const WatertightRay ray = WatertightRay::Make(packet.origin, direction);
+		if (i == 0)
+		{
+			outSetup.kx = ray.kx;
+			outSetup.ky = ray.ky;
+			outSetup.kz = ray.kz;
+		}
+		else if (ray.kz != outSetup.kz)
+		{
+			return false;
+		}
+
+		outSetup.sx[i] = ray.sx;
+		outSetup.sy[i] = ray.sy;
+		outSetup.sz[i] = ray.sz;
+	}
+
+	// The SIMD kernels read whole groups of rays
+	for (uint32_t i = packet.count; i < k_rayPacketSize; i++)
+	{
+		outSetup.sx[i] = 0.f;
+		outSetup.sy[i] = 0.f;
+		outSetup.sz[i] = 0.f;
+	}
+
+	return true;
+}
+
+IntersectChildrenPacketFunc GetIntersectChildrenPacket(const SimdIsa isa)
+{
+	assert(IsSimdIsaSupported(isa));
+
+	switch (isa)
+	{
+#if SIMD_ISA_X86
+	case SimdIsa::Sse:
+		return IntersectChildrenPacketSse;
+	case SimdIsa::Avx2:
+		return IntersectChildrenPacketAvx2;
+#endif
+	default:
+		return IntersectChildrenPacketScalar;
+	}
+}
+
+IntersectQuantizedChildrenPacketFunc GetIntersectQuantizedChildrenPacket(const SimdIsa isa)
+{
+	assert(IsSimdIsaSupported(isa));
+
+	switch (isa)
+	{
+#if SIMD_ISA_X86
+	case SimdIsa::Sse:
+		return IntersectQuantizedChildrenPacketSse;
+	case SimdIsa::Avx2:
+		return IntersectQuantizedChildrenPacketAvx2;
+#endif
+	default:
+		return IntersectQuantizedChildrenPacketScalar;
+	}
+}
+
+IntersectTriangleRayPacketFunc GetIntersectTriangleRayPacket(const SimdIsa isa)
+{
+	assert(IsSimdIsaSupported(isa));
+
+	switch (isa)
+	{
+#if SIMD_ISA_X86
+	case SimdIsa::Sse:
+		return IntersectTriangleRayPacketSse;
+	case SimdIsa::Avx2:
+		return IntersectTriangleRayPacketAvx2;
+#endif
+	default:
+		return IntersectTriangleRayPacketScalar;
+	}
+}
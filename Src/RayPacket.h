@@ -0,0 +1,75 @@
+#pragma once
+
+#include "Bvh8.h"
+#include "Bvh8Quantized.h"
+#include "CpuMath.h"
+#include "SimdIsa.h"
+#include "TrianglePacket.h"
+
+#include <cstdint>
+
+// Primary rays are traced in packets of one 8x8 pixel tile
+constexpr uint32_t k_rayPacketTileSize = 8;
+constexpr uint32_t k_rayPacketSize = k_rayPacketTileSize * k_rayPacketTileSize;
+
+// Rays with a common origin, as the primary rays of a pinhole camera have
+struct RayPacket
+{
+	Vec3 origin;
+	float directions[3][k_rayPacketSize];
+	uint32_t count;
+};
+
+// A packet set up for traversal. Nodes are culled for the whole packet with interval arithmetic over the inverse
+// directions, and triangles are tested with the watertight shear of each ray.
+struct RayPacketSetup
+{
+	Vec3 origin;
+	float invDirectionMin[3];
+	float invDirectionMax[3];
+	uint32_t nearPlane[3];			// row of Bvh8Node::planes the rays enter through on each axis
+	uint32_t farPlane[3];
+	uint32_t kx;
+	uint32_t ky;
+	uint32_t kz;
+	float sx[k_rayPacketSize];
+	float sy[k_rayPacketSize];
+	float sz[k_rayPacketSize];
+	uint32_t count;
+
+	// Returns false if the rays diverge too much to be traced together, which is when their directions differ in
+	// sign or in the axis they are largest along
+	static bool Make(const RayPacket& packet, RayPacketSetup& outSetup);
+};
+
+// Closest hit of each ray of a packet so far. t starts out as the far end of the rays.
+struct RayPacketHits
+{
+	float t[k_rayPacketSize];
+	float u[k_rayPacketSize];
+	float v[k_rayPacketSize];
+	uint32_t triangle[k_rayPacketSize];
+};
+
+// Box test kernel for a packet. Writes a lower bound of the entry distance of each child and returns a bit mask of
+// the children that any of the rays can hit within [tMin, tMax].
+using IntersectChildrenPacketFunc = uint32_t (*)(const Bvh8Node& node, const RayPacketSetup& rays, const float tMin, const float tMax, float outEntries[8]);
+
+IntersectChildrenPacketFunc GetIntersectChildrenPacket(const SimdIsa isa);
+
+// Same, decoding the child boxes of a compressed node on the fly
+using IntersectQuantizedChildrenPacketFunc = uint32_t (*)(const Bvh8QuantizedNode& node, const RayPacketSetup& rays, const float tMin, const float tMax, float outEntries[8]);
+
+IntersectQuantizedChildrenPacketFunc GetIntersectQuantizedChildrenPacket(const SimdIsa isa);
+
+// Tests all the rays of a packet against one triangle of a triangle packet, from both sides, and records the hits
+// closer than the ones found so far under triangleId. Returns a bit mask of the rays whose hit changed.
+using IntersectTriangleRayPacketFunc = uint64_t (*)(
+	const TrianglePacket& packet,
+	const uint32_t lane,
+	const uint32_t triangleId,
+	const RayPacketSetup& rays,
+	const float tMin,
+	RayPacketHits& inOutHits);
+
+IntersectTriangleRayPacketFunc GetIntersectTriangleRayPacket(const SimdIsa isa);
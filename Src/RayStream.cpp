@@ -0,0 +1,65 @@
+#include "RayStream.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace
+{
+	// Spreads the low 10 bits of v out to every third bit
+	uint32_t ExpandBits(uint32_t v)
+	{
+		v &= 0x3ff;
+		v = (v | (v << 16)) & 0x030000ff;
+		v = (v | (v << 8)) & 0x0300f00f;
+		v = (v | (v << 4)) & 0x030c30c3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	}
+
+	uint32_t QuantizeMortonAxis(const float p, const float lower, const float scale)
+	{
+		const float q = (p - lower) * scale;
+		return q > 0.f ? static_cast<uint32_t>((std::min)(q, 1023.f)) : 0;
+	}
+}
+
+void SortRayStream(const StreamRay* rays, const size_t rayCount, std::vector<uint32_t>& outOrder)
+{
+	Aabb originBounds;
+	for (size_t i = 0; i < rayCount; i++)
+	{
+		originBounds.Grow(rays[i].origin);
+	}
+
+	const Vec3 extent = originBounds.Extent();
+	const float scaleX = extent.x > 0.f ? 1024.f / extent.x : 0.f;
+	const float scaleY = extent.y > 0.f ? 1024.f / extent.y : 0.f;
+	const float scaleZ = extent.z > 0.f ? 1024.f / extent.z : 0.f;
+
+	// Octant in the top 3 bits, the 30 bit Morton code below it and the ray index in the low 31 bits, which also makes
+	// the sort stable
+	assert(rayCount <= 0x7fffffff);
+	std::vector<uint64_t> keys(rayCount);
+	for (size_t i = 0; i < rayCount; i++)
+	{
+		const StreamRay& ray = rays[i];
+		const uint32_t octant =
+			(std::signbit(ray.direction.x) ? 1u : 0u) |
+			(std::signbit(ray.direction.y) ? 2u : 0u) |
+			(std::signbit(ray.direction.z) ? 4u : 0u);
+		const uint32_t morton =
+			ExpandBits(QuantizeMortonAxis(ray.origin.x, originBounds.lower.x, scaleX)) |
+			(ExpandBits(QuantizeMortonAxis(ray.origin.y, originBounds.lower.y, scaleY)) << 1) |
+			(ExpandBits(QuantizeMortonAxis(ray.origin.z, originBounds.lower.z, scaleZ)) << 2);
+		keys[i] = (static_cast<uint64_t>(octant) << 61) | (static_cast<uint64_t>(morton) << 31) | i;
+	}
+
+	std::sort(keys.begin(), keys.end());
+
+	outOrder.resize(rayCount);
+	for (size_t i = 0; i < rayCount; i++)
+	{
+		outOrder[i] = static_cast<uint32_t>(keys[i] & 0x7fffffff);
+	}
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#include "Bvh8.h"
+#include "CpuMath.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Ray of a stream, eg. a shadow, reflection or ambient occlusion ray, which can start anywhere and point anywhere
+struct StreamRay
+{
+	Vec3 origin;
+	Vec3 direction;
+	float tMin;
+	float tMax;
+};
+
+// Order in which to trace a stream of rays, so that rays that are likely to visit the same nodes are traced together.
+// Rays are sorted by the octant of their direction, then by the Morton code of their origin within the bounds of all
+// of the origins.
+void SortRayStream(const StreamRay* rays, const size_t rayCount, std::vector<uint32_t>& outOrder);
+
+// Ray still active in a subtree, with a lower bound of where it enters the subtree
+struct RayStreamEntry
+{
+	uint32_t ray;
+	float entry;
+};
+
+// Buffers for TraverseBvh8Stream, kept between calls so that a traversal does not allocate once they have grown. Each
+// level of a nested traversal needs its own.
+struct RayStreamScratch
+{
+	struct Segment
+	{
+		uint32_t child;
+		uint32_t primitiveCount;
+		size_t begin;
+		size_t count;
+	};
+
+	std::vector<RayStreamEntry> entries;	// rays of the pending subtrees, a segment each
+	std::vector<Segment> segments;
+	std::vector<RayStreamEntry> childEntries[8];
+};
+
+// Breadth-first traversal of a stream of rays. Instead of taking each ray down the tree on its own, each node is
+// visited once with all of the rays that reached it, and they are split up between its children. Rays whose closest
+// hit is nearer than a subtree are compacted out when the subtree is popped, and children are visited nearest first
+// on average.
+//
+// intersectChildren(node, ray, closestT, outEntries) tests one ray against the children of a node and returns the bit
+// mask of those hit. intersectLeaf(firstPrimitive, primitiveCount, rays, rayCount) tests the rays active at a leaf,
+// lowering closestT of those that hit. Nodes is a std::vector or an ArrayView of Bvh8Node or Bvh8QuantizedNode.
+template<typename Nodes, typename IntersectChildren, typename IntersectLeaf>
+void TraverseBvh8Stream(
+	const Nodes& nodes,
+	const RayStreamEntry* rays,
+	const size_t rayCount,
+	const float* closestT,
+	RayStreamScratch& scratch,
+	IntersectChildren&& intersectChildren,
+	IntersectLeaf&& intersectLeaf)
+{
+	if (nodes.empty() || rayCount == 0)
+	{
+		return;
+	}
+
+	std::vector<RayStreamEntry>& entries = scratch.entries;
+	std::vector<RayStreamScratch::Segment>& segments = scratch.segments;
+	entries.assign(rays, rays + rayCount);
+	segments.clear();
+	segments.push_back({ 0, 0, 0, rayCount });
+
+	while (!segments.empty())
+	{
+		const RayStreamScratch::Segment segment = segments.back();
+		segments.pop_back();
+
+		size_t activeCount = 0;
+		for (size_t i = segment.begin; i < segment.begin + segment.count; i++)
+		{
+			if (entries[i].entry <= closestT[entries[i].ray])
+			{
+				entries[segment.begin + activeCount++] = entries[i];
+			}
+		}
+
+		if (activeCount > 0 && segment.primitiveCount > 0)
+		{
+			intersectLeaf(segment.child, segment.primitiveCount, &entries[segment.begin], activeCount);
+		}
+
+		if (activeCount == 0 || segment.primitiveCount > 0)
+		{
+			entries.resize(segment.begin);
+			continue;
+		}
+
+		const auto& node = nodes[segment.child];
+		float entrySums[8] = {};
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			scratch.childEntries[slot].clear();
+		}
+
+		for (size_t i = segment.begin; i < segment.begin + activeCount; i++)
+		{
+			const uint32_t ray = entries[i].ray;
+			float childEntries[8];
+			uint32_t hitMask = intersectChildren(node, ray, closestT[ray], childEntries);
+			while (hitMask != 0)
+			{
+				uint32_t slot = 0;
+				while ((hitMask & (1u << slot)) == 0)
+				{
+					slot++;
+				}
+
+				hitMask &= hitMask - 1;
+				scratch.childEntries[slot].push_back({ ray, childEntries[slot] });
+				entrySums[slot] += childEntries[slot];
+			}
+		}
+
+		// Insertion sort of the children hit by their mean entry, farthest first, so that the nearest is popped next
+		uint32_t slots[8];
+		float meanEntries[8];
+		uint32_t slotCount = 0;
+		for (uint32_t slot = 0; slot < 8; slot++)
+		{
+			if (scratch.childEntries[slot].empty())
+			{
+				continue;
+			}
+
+			meanEntries[slot] = entrySums[slot] / scratch.childEntries[slot].size();
+			uint32_t pos = slotCount++;
+			while (pos > 0 && meanEntries[slots[pos - 1]] < meanEntries[slot])
+			{
+				slots[pos] = slots[pos - 1];
+				pos--;
+			}
+
+			slots[pos] = slot;
+		}
+
+		entries.resize(segment.begin);
+		for (uint32_t i = 0; i < slotCount; i++)
+		{
+			const uint32_t slot = slots[i];
+			const std::vector<RayStreamEntry>& childEntries = scratch.childEntries[slot];
+			segments.push_back({ node.child[slot], node.primitiveCount[slot], entries.size(), childEntries.size() });
+			entries.insert(entries.end(), childEntries.begin(), childEntries.end());
+		}
+	}
+}
@@ -6,6 +6,13 @@ ConstantBuffer<ViewConstants> cb_view : register(b0);
 RaytracingAccelerationStructure SceneBVH : register(t0);
 RWTexture2D<float4> RTOutput : register(u0);
 
+// Shadow and visibility rays can pass INSTANCE_MASK_OPAQUE to skip alpha tested geometry.
+// Masked meshes are split into an alpha tested and an opaque geometry that share one hit group, hence the zero geometry multiplier.
+void TraceScene(RayDesc ray, uint instanceMask, inout HitInfo payload)
+{
+    TraceRay(SceneBVH, RAY_FLAG_NONE, instanceMask, 0, 0, 0, ray, payload);
+}
+
 [shader("raygeneration")]
 void Raygen()
 {
@@ -32,7 +39,7 @@ void Raygen()
     payload.color = float3(1.f, 0.f, 0.f);
     payload.hitT = 0.f;
 
-    TraceRay(SceneBVH, RAY_FLAG_NONE, 0xFF, 0, 1, 0, ray, payload);
+    TraceScene(ray, INSTANCE_MASK_ALL, payload);
 
     RTOutput[launchIndex.xy] = float4(payload.color, 1.f);
 }
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "RefitPolicy.h"
+
+void RefitPolicy::Init(const uint32_t maxRefitCount, const float maxQualityDegradation)
+{
+	m_maxRefitCount = maxRefitCount;
+	m_maxQualityDegradation = maxQualityDegradation;
+	m_built = false;
+	m_refitCount = 0;
+	m_baselineQuality = 0.f;
+}
+
+AccelerationStructureUpdate RefitPolicy::Decide(const bool changed, const float qualityMetric) const
+{
+	if (!m_built)
+	{
+		return AccelerationStructureUpdate::Rebuild;
+	}
+
+	if (!changed)
+	{
+		return AccelerationStructureUpdate::None;
+	}
+
+	if (m_refitCount >= m_maxRefitCount)
+	{
+		return AccelerationStructureUpdate::Rebuild;
+	}
+
+	if (qualityMetric > m_baselineQuality * m_maxQualityDegradation)
+	{
+		return AccelerationStructureUpdate::Rebuild;
+	}
+
+	return AccelerationStructureUpdate::Refit;
+}
+
+void RefitPolicy::OnRebuild(const float qualityMetric)
+{
+	m_built = true;
+	m_refitCount = 0;
+	m_baselineQuality = qualityMetric;
+}
+
+void RefitPolicy::OnRefit()
+{
+	m_refitCount++;
+}
+
+uint32_t RefitPolicy::GetRefitCount() const
+{
+	return m_refitCount;
+}
+
+float RefitPolicy::GetBaselineQuality() const
+{
+	return m_baselineQuality;
+}
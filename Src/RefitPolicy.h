@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+
+enum class AccelerationStructureUpdate
+{
+	None,
+	Refit,
+	Rebuild
+};
+
+// Decides between refitting an acceleration structure in place and rebuilding it from scratch. Refitting keeps the
+// topology of the last build, so its quality degrades as primitives move away from where they were at that build.
+// The caller supplies a quality metric (lower is better, e.g. an SAH cost or the summed surface area of the bounds)
+// and the policy asks for a rebuild once it has grown by more than the allowed ratio, or after too many refits.
+class RefitPolicy
+{
+public:
+	void Init(const uint32_t maxRefitCount, const float maxQualityDegradation);
+
+	AccelerationStructureUpdate Decide(const bool changed, const float qualityMetric) const;
+
+	void OnRebuild(const float qualityMetric);
+	void OnRefit();
+
+	uint32_t GetRefitCount() const;
+	float GetBaselineQuality() const;
+
+private:
+	uint32_t m_maxRefitCount = 0;
+	float m_maxQualityDegradation = 1.f;
+
+	bool m_built = false;
+	uint32_t m_refitCount = 0;
+	float m_baselineQuality = 0.f;
+};
@@ -10,22 +10,30 @@ void ResourceHeap::Init(ID3D12Device5* device, const size_t sizeInBytes)
 
 	device->CreateHeap(&heapDesc, IID_PPV_ARGS(m_heap.GetAddressOf()));
 
-	m_totalSize = sizeInBytes;
-	m_allocatedSize = 0;
+	m_allocator.Init(sizeInBytes);
 }
 
 auto ResourceHeap::GetAlloc(const size_t sizeInBytes, const size_t alignment) -> Alloc
 {
-	size_t capacity = m_totalSize - m_allocatedSize;
-	size_t alignedSize = (sizeInBytes + (alignment - 1)) & ~(alignment - 1);
-	assert(alignedSize <= capacity && L"Resource heap is too small. Consider increasing its size!");
-
-	size_t offset = m_allocatedSize ;
-	m_allocatedSize += alignedSize;
+	const size_t offset = m_allocator.Allocate(sizeInBytes, alignment);
+	assert(offset != HeapAllocator::k_invalidOffset && L"Resource heap is too small. Consider increasing its size!");
 	return offset;
 }
 
+void ResourceHeap::Free(const Alloc alloc)
+{
+	// The caller is responsible for making sure that the GPU is no longer using any resource placed here
+	const bool bFreed = m_allocator.Free(alloc);
+	assert(bFreed && L"Freeing a resource heap allocation that was never made or was already freed");
+	(void)bFreed;
+}
+
 ID3D12Heap* ResourceHeap::GetHeap() const
 {
 	return m_heap.Get();
+}
+
+HeapAllocator* ResourceHeap::GetAllocator()
+{
+	return &m_allocator;
 }
\ No newline at end of file
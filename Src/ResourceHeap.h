@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Common.h"
+#include "HeapAllocator.h"
 
 class ResourceHeap
 {
@@ -9,10 +10,11 @@ public:
 
 	void Init(ID3D12Device5* device, const size_t sizeInBytes);
 	Alloc GetAlloc(const size_t sizeInBytes, const size_t alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+	void Free(const Alloc alloc);
 	ID3D12Heap* GetHeap() const;
+	HeapAllocator* GetAllocator();
 
 private:
 	Microsoft::WRL::ComPtr<ID3D12Heap> m_heap;
-	size_t m_totalSize;
-	size_t m_allocatedSize;
+	HeapAllocator m_allocator;
 };
\ No newline at end of file
@@ -1,630 +1,1158 @@
-#include "stdafx.h"
-#include "Scene.h"
-#include "View.h"
-
-Scene::~Scene()
-{
-	m_objectConstantBuffer->Unmap(0, nullptr);
-	m_lightConstantBuffer->Unmap(0, nullptr);
-}
-
-void Scene::LoadMeshes(
-	const aiScene* loader, 
-	ID3D12Device5* device, 
-	ID3D12GraphicsCommandList4* cmdList, 
-	UploadBuffer* uploadBuffer,
-	ResourceHeap* scratchHeap,
-	ResourceHeap* resourceHeap, 
-	ID3D12DescriptorHeap* srvHeap, 
-	const size_t srvStartOffset, 
-	const size_t srvDescriptorSize)
-{
-	for (auto meshIdx = 0u; meshIdx < loader->mNumMeshes; meshIdx++)
-	{
-		const aiMesh* srcMesh = loader->mMeshes[meshIdx];
-
-		// vertex data
-		std::vector<StaticMesh::VertexType> vertexData;
-		for (auto vertIdx = 0u; vertIdx < srcMesh->mNumVertices; vertIdx++)
-		{
-			const aiVector3D& vertPos = srcMesh->mVertices[vertIdx];
-			const aiVector3D& vertNormal = srcMesh->mNormals[vertIdx];
-			const aiVector3D& vertTangent = srcMesh->mTangents[vertIdx];
-			const aiVector3D& vertBitangent = srcMesh->mBitangents[vertIdx];
-			const aiVector3D& vertUV = srcMesh->mTextureCoords[0][vertIdx];
-
-			vertexData.emplace_back(
-				DirectX::XMFLOAT3(vertPos.x, vertPos.y, vertPos.z),
-				DirectX::XMFLOAT3(vertNormal.x, vertNormal.y, vertNormal.z),
-				DirectX::XMFLOAT3(vertTangent.x, vertTangent.y, vertTangent.z),
-				DirectX::XMFLOAT3(vertBitangent.x, vertBitangent.y, vertBitangent.z),
-				DirectX::XMFLOAT2(vertUV.x, vertUV.y)
-			);
-		}
-
-		// index data
-		std::vector<StaticMesh::IndexType> indexData;
-		for (auto primIdx = 0u; primIdx<srcMesh->mNumFaces; primIdx++)
-		{
-			const aiFace& primitive = srcMesh->mFaces[primIdx];
-			for (auto index = 0u; index < primitive.mNumIndices; index++)
-			{
-				indexData.push_back(primitive.mIndices[index]);
-			}
-		}
-
-		auto mesh = std::make_unique<StaticMesh>();
-		mesh->Init(device, cmdList, uploadBuffer, scratchHeap, resourceHeap, std::move(vertexData), std::move(indexData), srcMesh->mMaterialIndex, srvHeap, srvStartOffset + 2 * meshIdx, srvDescriptorSize);
-		m_meshes.push_back(std::move(mesh));
-	}
-}
-
-D3D12_GPU_DESCRIPTOR_HANDLE Scene::LoadTexture(const std::string& textureName, ID3D12Device5* device, ID3D12DescriptorHeap* srvHeap, const size_t srvOffset, const size_t srvDescriptorSize, DirectX::ResourceUploadBatch& resourceUpload)
-{
-	Texture* tex;
-	auto texIter = std::find_if(m_textures.cbegin(), m_textures.cend(),
-		[&textureName](const std::unique_ptr<Texture>& tex) { return tex->GetName() == textureName; });
-
-	if (texIter == m_textures.cend())
-	{
-		auto newTexture = std::make_unique<Texture>();
-		newTexture->Init(device, resourceUpload, textureName);
-		tex = newTexture.get();
-		m_textures.push_back(std::move(newTexture));
-	}
-	else
-	{
-		tex = texIter->get();
-	}
-
-	const auto gpuDescriptorHandle = tex->CreateShaderResourceView(device, srvHeap, srvOffset, srvDescriptorSize);
-
-	return gpuDescriptorHandle;
-}
-
-void Scene::LoadMaterials(
-	const aiScene* loader, 
-	ID3D12Device5* device,
-	ID3D12GraphicsCommandList4* cmdList,
-	ID3D12CommandQueue* cmdQueue,
-	UploadBuffer* uploadBuffer, 
-	ResourceHeap* mtlConstantsHeap,
-	ID3D12DescriptorHeap* srvHeap, 
-	const size_t srvStartOffset, 
-	const size_t srvDescriptorSize)
-{
-	// Used to batch texture uploads
-	DirectX::ResourceUploadBatch resourceUpload(device);
-	resourceUpload.Begin();
-
-	auto descriptorIdx = 0;
-
-	for (auto matIdx = 0u; matIdx < loader->mNumMaterials; matIdx++)
-	{
-		const aiMaterial* srcMat = loader->mMaterials[matIdx];
-
-		aiString materialName;
-		srcMat->Get(AI_MATKEY_NAME, materialName);
-
-		aiString baseColorTextureNameStr;
-		aiReturn bHasBaseColorTexture = srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), baseColorTextureNameStr);
-
-		// roughness mapped to gloss 
-		aiString roughnessTextureNameStr;
-		aiReturn bHasRoughnessTexture = srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_SHININESS, 0), roughnessTextureNameStr);
-
-		// metallic mapped to ambient
-		aiString metallicTextureNameStr;
-		aiReturn bHasMetallicTexture = srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_AMBIENT, 0), metallicTextureNameStr);
-
-		aiString normalmapTextureNameStr;
-		aiReturn bHasNormalmapTexture = srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_HEIGHT, 0), normalmapTextureNameStr);
-
-		aiString opacityMaskTextureNameStr;
-		aiReturn bHasOpacityMaskTexture = srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_OPACITY, 0), opacityMaskTextureNameStr);
-
-		if (bHasBaseColorTexture == aiReturn_SUCCESS &&
-			bHasRoughnessTexture == aiReturn_SUCCESS &&
-			bHasMetallicTexture == aiReturn_SUCCESS &&
-			bHasNormalmapTexture == aiReturn_SUCCESS && 
-			bHasOpacityMaskTexture == aiReturn_SUCCESS)
-		{
-			const auto headDescriptor = LoadTexture(baseColorTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
-			LoadTexture(roughnessTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
-			LoadTexture(metallicTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
-			LoadTexture(normalmapTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
-			const auto opacityMaskDescriptor = LoadTexture(opacityMaskTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
-			m_materials.push_back(std::make_unique<DefaultMaskedMaterial>(std::string(materialName.C_Str()), headDescriptor, opacityMaskDescriptor));
-		}
-		else if (bHasBaseColorTexture == aiReturn_SUCCESS &&
-				bHasRoughnessTexture == aiReturn_SUCCESS &&
-				bHasMetallicTexture == aiReturn_SUCCESS &&
-				bHasNormalmapTexture == aiReturn_SUCCESS)
-		{
-			const auto headDescriptor = LoadTexture(baseColorTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
-			LoadTexture(roughnessTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
-			LoadTexture(metallicTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
-			LoadTexture(normalmapTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
-			m_materials.push_back(std::make_unique<DefaultOpaqueMaterial>(std::string(materialName.C_Str()), headDescriptor));
-		}
-		else
-		{
-			// Use untextured material
-
-			UntexturedMaterial::Constants mtlConstantData;
-			mtlConstantData.baseColor = DirectX::XMFLOAT3{ 0.75, 0.75, 0.75 };
-			mtlConstantData.metallic = 0.f;
-			mtlConstantData.roughness = 0.5;
-
-			D3D12_RESOURCE_DESC cbDesc = {};
-			cbDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-			cbDesc.Width = sizeof(UntexturedMaterial::Constants);
-			cbDesc.Height = 1;
-			cbDesc.DepthOrArraySize = 1;
-			cbDesc.MipLevels = 1;
-			cbDesc.Format = DXGI_FORMAT_UNKNOWN;
-			cbDesc.SampleDesc.Count = 1;
-			cbDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-			size_t offsetInHeap = mtlConstantsHeap->GetAlloc(cbDesc.Width, k_constantBufferAlignment);
-
-			Microsoft::WRL::ComPtr<ID3D12Resource> mtlCb;
-			HRESULT hr = device->CreatePlacedResource(
-				mtlConstantsHeap->GetHeap(),
-				offsetInHeap,
-				&cbDesc,
-				D3D12_RESOURCE_STATE_COPY_DEST,
-				nullptr,
-				IID_PPV_ARGS(mtlCb.GetAddressOf())
-			);
-
-			assert(SUCCEEDED(hr));
-			mtlCb->SetName(L"mtl_constant_buffer_untextured");
-
-			// copy constant data to upload buffer
-			uint64_t cbSizeInBytes;
-			D3D12_PLACED_SUBRESOURCE_FOOTPRINT cbLayout;
-			device->GetCopyableFootprints(
-				&cbDesc,
-				0 /*subresource index*/, 1 /* num subresources */, 0 /*offset*/,
-				&cbLayout, nullptr, &cbSizeInBytes, nullptr);
-
-			auto[uploadPtr, uploadOffset] = uploadBuffer->GetAlloc(cbSizeInBytes);
-			const auto* pSrc = reinterpret_cast<const uint8_t*>(&mtlConstantData);
-			memcpy(uploadPtr, pSrc, cbSizeInBytes);
-
-			// schedule copy to default vertex buffer
-			cmdList->CopyBufferRegion(
-				mtlCb.Get(),
-				0,
-				uploadBuffer->GetResource(),
-				uploadOffset,
-				cbLayout.Footprint.Width
-			);
-
-			// transition to constant buffer
-			D3D12_RESOURCE_BARRIER cbBarrierDesc = {};
-			cbBarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
-			cbBarrierDesc.Transition.pResource = mtlCb.Get();
-			cbBarrierDesc.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
-			cbBarrierDesc.Transition.StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
-			cbBarrierDesc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
-			cmdList->ResourceBarrier(1, &cbBarrierDesc);
-
-			m_materials.push_back(std::make_unique<UntexturedMaterial>(std::string("untextured_mtl"), mtlCb));
-		}
-	}
-
-	// Upload the resources to the GPU.
-	auto uploadResourcesFinished = resourceUpload.End(cmdQueue);
-
-	// Wait for the upload thread to terminate
-	uploadResourcesFinished.wait();
-}
-
-void Scene::LoadEntities(const aiNode* node)
-{
-	const aiMatrix4x4& parentTransform = node->mTransformation;
-
-	for (auto childIdx = 0u; childIdx < node->mNumChildren; childIdx++)
-	{
-		const aiNode* childNode = node->mChildren[childIdx];
-
-		if (childNode->mChildren == nullptr)
-		{
-			const aiMatrix4x4& localTransform = childNode->mTransformation;
-			aiMatrix4x4 localToWorldTransform = parentTransform * localTransform;
-			DirectX::XMFLOAT4X4 localToWorld(reinterpret_cast<float*>(&localToWorldTransform));
-
-			for (auto meshIdx = 0u; meshIdx < childNode->mNumMeshes; meshIdx++)
-			{
-				const uint64_t sceneMeshIndex = childNode->mMeshes[meshIdx];
-
-				m_meshEntities.push_back(std::make_unique<StaticMeshEntity>(
-					std::string(childNode->mName.C_Str()), 
-					sceneMeshIndex,
-					localToWorld));
-			}
-		}
-		else
-		{
-			LoadEntities(childNode);
-		}
-	}
-}
-
-void Scene::CreateTLAS(
-	ID3D12Device5* device,
-	ID3D12GraphicsCommandList4* cmdList,
-	UploadBuffer* uploadBuffer,
-	ResourceHeap* scratchHeap,
-	ResourceHeap* resourceHeap,
-	ID3D12DescriptorHeap* srvHeap,
-	const size_t srvHeapOffset,
-	const size_t srvDescriptorSize)
-{
-	// Instance description for top level acceleration structure
-	std::vector<D3D12_RAYTRACING_INSTANCE_DESC> sceneEntities;
-	sceneEntities.reserve(m_meshEntities.size());
-
-	for (size_t entityIndex = 0; entityIndex < m_meshEntities.size(); entityIndex++)
-	{
-		const StaticMeshEntity* meshEntity = m_meshEntities[entityIndex].get();
-		const StaticMesh* mesh = m_meshes[meshEntity->GetMeshIndex()].get();
-
-		D3D12_RAYTRACING_INSTANCE_DESC instanceDesc;
-		instanceDesc.InstanceID = entityIndex;
-		instanceDesc.InstanceContributionToHitGroupIndex = 0;
-		instanceDesc.InstanceMask = 1;
-		instanceDesc.Flags = D3D12_RAYTRACING_INSTANCE_FLAG_NONE;
-		instanceDesc.AccelerationStructure = mesh->GetBLASAddress();
-
-		// Transpose and convert to 3x4 matrix
-		const DirectX::XMFLOAT4X4& localToWorld = meshEntity->GetLocalToWorldMatrix();
-		decltype(instanceDesc.Transform)& dest = instanceDesc.Transform;
-		dest[0][0] = localToWorld._11;	dest[1][0] = localToWorld._12;	dest[2][0] = localToWorld._13;
-		dest[0][1] = localToWorld._21;	dest[1][1] = localToWorld._22;	dest[2][1] = localToWorld._23;
-		dest[0][2] = localToWorld._31;	dest[1][2] = localToWorld._32;	dest[2][2] = localToWorld._33;
-		dest[0][3] = localToWorld._41;	dest[1][3] = localToWorld._42;	dest[2][3] = localToWorld._43;
-
-		sceneEntities.emplace_back(instanceDesc);
-	}
-
-	// Copy instance desc to GPU-side buffer
-	const size_t instanceDescBufferSize = sceneEntities.size() * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
-	auto[destPtr, offset] = uploadBuffer->GetAlloc(instanceDescBufferSize);
-	memcpy(destPtr, sceneEntities.data(), instanceDescBufferSize);
-
-	// Compute size for top level acceleration structure buffers
-	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS asInputs{};
-	asInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
-	asInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
-	asInputs.InstanceDescs = uploadBuffer->GetResource()->GetGPUVirtualAddress() + offset;
-	asInputs.NumDescs = static_cast<UINT>(sceneEntities.size());
-	asInputs.Flags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE;
-
-	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO asPrebuildInfo{};
-	device->GetRaytracingAccelerationStructurePrebuildInfo(&asInputs, &asPrebuildInfo);
-
-	const size_t alignedScratchSize = (asPrebuildInfo.ScratchDataSizeInBytes + D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT - 1) & ~D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT;
-	const size_t alignedTLASBufferSize = (asPrebuildInfo.ResultDataMaxSizeInBytes + D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT - 1) & ~D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT;
-
-	// Create scratch buffer
-	D3D12_RESOURCE_DESC scratchBufDesc = {};
-	scratchBufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-	scratchBufDesc.Alignment = max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
-	scratchBufDesc.Width = alignedScratchSize;
-	scratchBufDesc.Height = 1;
-	scratchBufDesc.DepthOrArraySize = 1;
-	scratchBufDesc.MipLevels = 1;
-	scratchBufDesc.Format = DXGI_FORMAT_UNKNOWN;
-	scratchBufDesc.SampleDesc.Count = 1;
-	scratchBufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-	scratchBufDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-
-	auto offsetInHeap = scratchHeap->GetAlloc(scratchBufDesc.Width);
-
-	ID3D12Resource* scratchBuffer;
-	HRESULT hr = device->CreatePlacedResource(
-		scratchHeap->GetHeap(),
-		offsetInHeap,
-		&scratchBufDesc,
-		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
-		nullptr,
-		IID_PPV_ARGS(&scratchBuffer)
-	);
-
-	assert(SUCCEEDED(hr));
-	scratchBuffer->SetName(L"tlas_scratch_buffer");
-
-	// Create TLAS buffer
-	D3D12_RESOURCE_DESC tlasBufDesc = {};
-	tlasBufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-	tlasBufDesc.Alignment = std::max<UINT64>(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
-	tlasBufDesc.Width = alignedTLASBufferSize;
-	tlasBufDesc.Height = 1;
-	tlasBufDesc.DepthOrArraySize = 1;
-	tlasBufDesc.MipLevels = 1;
-	tlasBufDesc.Format = DXGI_FORMAT_UNKNOWN;
-	tlasBufDesc.SampleDesc.Count = 1;
-	tlasBufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-	tlasBufDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
-
-	offsetInHeap = resourceHeap->GetAlloc(tlasBufDesc.Width);
-
-	hr = device->CreatePlacedResource(
-		resourceHeap->GetHeap(),
-		offsetInHeap,
-		&tlasBufDesc,
-		D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
-		nullptr,
-		IID_PPV_ARGS(m_tlasBuffer.GetAddressOf())
-	);
-
-	assert(SUCCEEDED(hr));
-	m_tlasBuffer->SetName(L"tlas_buffer");
-
-	// Now, build the top level acceleration structure
-	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc{};
-	buildDesc.Inputs = asInputs;
-	buildDesc.ScratchAccelerationStructureData = scratchBuffer->GetGPUVirtualAddress();
-	buildDesc.DestAccelerationStructureData = m_tlasBuffer->GetGPUVirtualAddress();
-
-	cmdList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
-
-	// Insert UAV barrier 
-	D3D12_RESOURCE_BARRIER uavBarrier{};
-	uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
-	uavBarrier.UAV.pResource = m_tlasBuffer.Get();
-
-	cmdList->ResourceBarrier(1, &uavBarrier);
-
-	// TLAS SRV
-	D3D12_SHADER_RESOURCE_VIEW_DESC tlasSrvDesc{};
-	tlasSrvDesc.Format = DXGI_FORMAT_UNKNOWN;
-	tlasSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
-	tlasSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
-	tlasSrvDesc.RaytracingAccelerationStructure.Location = m_tlasBuffer->GetGPUVirtualAddress();
-
-	D3D12_CPU_DESCRIPTOR_HANDLE cpuHnd;
-	cpuHnd.ptr = srvHeap->GetCPUDescriptorHandleForHeapStart().ptr + srvHeapOffset * srvDescriptorSize;
-	m_tlasSrv.ptr = srvHeap->GetGPUDescriptorHandleForHeapStart().ptr + srvHeapOffset * srvDescriptorSize;
-
-	device->CreateShaderResourceView(nullptr, &tlasSrvDesc, cpuHnd);
-}
-
-void Scene::CreateShaderBindingTable(ID3D12Device5* device)
-{
-	const size_t numEntities = m_meshEntities.size();
-	size_t sbtSize = k_shaderRecordSize * (1 + 2 * numEntities); // 1 for RGS. CHS and MS params are unique per material
-	sbtSize = (sbtSize + (D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT - 1)) & ~(D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT - 1);
-
-	D3D12_RESOURCE_DESC resDesc = {};
-	resDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-	resDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
-	resDesc.Width = sbtSize * k_gfxBufferCount;
-	resDesc.Height = 1;
-	resDesc.DepthOrArraySize = 1;
-	resDesc.MipLevels = 1;
-	resDesc.Format = DXGI_FORMAT_UNKNOWN;
-	resDesc.SampleDesc.Count = 1;
-	resDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-	D3D12_HEAP_PROPERTIES heapDesc = {};
-	heapDesc.Type = D3D12_HEAP_TYPE_UPLOAD;
-	heapDesc.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
-
-	// Create a shader binding table
-	HRESULT hr = device->CreateCommittedResource(
-		&heapDesc,
-		D3D12_HEAP_FLAG_NONE,
-		&resDesc,
-		D3D12_RESOURCE_STATE_GENERIC_READ,
-		nullptr,
-		IID_PPV_ARGS(m_shaderBindingTable.GetAddressOf())
-	);
-
-	assert(SUCCEEDED(hr));
-	m_shaderBindingTable->SetName(L"shader_binding_table");
-
-	D3D12_RANGE readRange = { 0 };
-	hr = m_shaderBindingTable->Map(0, &readRange, &reinterpret_cast<void*>(m_sbtPtr));
-	assert(SUCCEEDED(hr));
-}
-
-void Scene::InitLights(ID3D12Device5* device)
-{
-	m_light = std::make_unique<Light>(DirectX::XMFLOAT3{ 0.57735f, 1.57735f, 0.57735f }, DirectX::XMFLOAT3{ 1.f, 1.f, 1.f }, 10000.f);
-}
-
-void Scene::InitResources(
-	ID3D12Device5* device, 
-	ID3D12CommandQueue* cmdQueue, 
-	ID3D12GraphicsCommandList4* cmdList, 
-	UploadBuffer* uploadBuffer,
-	ResourceHeap* scratchHeap,
-	ResourceHeap* meshDataHeap,
-	ResourceHeap* mtlConstantsHeap,
-	ID3D12DescriptorHeap* srvHeap, 
-	const size_t srvDescriptorSize)
-{
-	// Load scene
-	{
-		Assimp::Importer importer;
-		const aiScene* scene = importer.ReadFile(R"(..\Content\sponza\obj\sponza.obj)",
-			aiProcess_CalcTangentSpace |
-			aiProcess_Triangulate |
-			aiProcess_JoinIdenticalVertices |
-			aiProcess_SortByPType |
-			aiProcess_MakeLeftHanded |
-			aiProcess_FlipWindingOrder |
-			aiProcess_FlipUVs
-		);
-
-		assert(scene != nullptr && L"Failed to load scene");
-		assert(scene->mNumMeshes < k_objectCount && L"Increase k_objectCount");
-
-		LoadMeshes(scene, device, cmdList, uploadBuffer, scratchHeap, meshDataHeap, srvHeap, SrvUav::MeshdataBegin, srvDescriptorSize);
-		LoadMaterials(scene, device, cmdList, cmdQueue, uploadBuffer, mtlConstantsHeap, srvHeap, SrvUav::MaterialTexturesBegin, srvDescriptorSize);
-		LoadEntities(scene->mRootNode);
-		CreateTLAS(device, cmdList, uploadBuffer, scratchHeap, meshDataHeap, srvHeap, SrvUav::TLASBegin, srvDescriptorSize);
-		CreateShaderBindingTable(device);
-		InitLights(device);
-	}
-
-	// Object Constant Buffer
-	if(!m_meshEntities.empty())
-	{
-		D3D12_RESOURCE_DESC resDesc = {};
-		resDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-		resDesc.Width = sizeof(ObjectConstants) * m_meshEntities.size() * k_gfxBufferCount;
-		resDesc.Height = 1;
-		resDesc.DepthOrArraySize = 1;
-		resDesc.MipLevels = 1;
-		resDesc.Format = DXGI_FORMAT_UNKNOWN;
-		resDesc.SampleDesc.Count = 1;
-		resDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-		D3D12_HEAP_PROPERTIES heapDesc = {};
-		heapDesc.Type = D3D12_HEAP_TYPE_UPLOAD; // must be CPU accessible
-		heapDesc.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN; // GPU or system mem
-
-		HRESULT hr = device->CreateCommittedResource(
-			&heapDesc,
-			D3D12_HEAP_FLAG_NONE,
-			&resDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(m_objectConstantBuffer.GetAddressOf())
-		);
-
-		assert(SUCCEEDED(hr));
-		m_objectConstantBuffer->SetName(L"object_constant_buffer");
-
-		// Get ptr to mapped resource
-		auto** ptr = reinterpret_cast<void**>(&m_objectConstantBufferPtr);
-		m_objectConstantBuffer->Map(0, nullptr, ptr);
-
-	}
-
-	// Light Constant Buffer
-	{
-		D3D12_RESOURCE_DESC resDesc = {};
-		resDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
-		resDesc.Width = sizeof(LightConstants) * k_gfxBufferCount;
-		resDesc.Height = 1;
-		resDesc.DepthOrArraySize = 1;
-		resDesc.MipLevels = 1;
-		resDesc.Format = DXGI_FORMAT_UNKNOWN;
-		resDesc.SampleDesc.Count = 1;
-		resDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
-
-		D3D12_HEAP_PROPERTIES heapDesc = {};
-		heapDesc.Type = D3D12_HEAP_TYPE_UPLOAD; // must be CPU accessible
-		heapDesc.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN; // GPU or system mem
-
-
-		HRESULT hr = device->CreateCommittedResource(
-			&heapDesc,
-			D3D12_HEAP_FLAG_NONE,
-			&resDesc,
-			D3D12_RESOURCE_STATE_GENERIC_READ,
-			nullptr,
-			IID_PPV_ARGS(m_lightConstantBuffer.GetAddressOf())
-		);
-
-		assert(SUCCEEDED(hr));
-		m_lightConstantBuffer->SetName(L"light_constant_buffer");
-
-		// Get ptr to mapped resource
-		auto** ptr = reinterpret_cast<void**>(&m_lightConstantBufferPtr);
-		m_lightConstantBuffer->Map(0, nullptr, ptr);
-	}
-}
-
-void Scene::Update(float dt)
-{
-	m_light->Update(dt, m_sceneBounds);
-}
-
-void Scene::UpdateRenderResources(uint32_t bufferIndex)
-{
-	// mesh entities
-	ObjectConstants* o = m_objectConstantBufferPtr + bufferIndex * m_meshEntities.size();
-	for (const auto& meshEntity : m_meshEntities)
-	{
-		meshEntity->FillConstants(o++);
-	}
-
-	// light(s)
-	if (m_light)
-	{
-		LightConstants* l = m_lightConstantBufferPtr + bufferIndex;
-		m_light->FillConstants(l);
-	}
-}
-
-void Scene::Render(
-	ID3D12Device5* device, 
-	ID3D12GraphicsCommandList4* cmdList, 
-	uint32_t bufferIndex, 
-	const View& view, 
-	const RaytraceMaterialPipeline* pipeline, 
-	D3D12_GPU_DESCRIPTOR_HANDLE outputUAV
-)
-{
-	const size_t sbtSize = k_shaderRecordSize * ( 1 + 2 * m_meshEntities.size());
-	uint8_t* pData = m_sbtPtr + bufferIndex * sbtSize;
-	D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = m_shaderBindingTable->GetGPUVirtualAddress() + bufferIndex * sbtSize;
-
-	D3D12_GPU_VIRTUAL_ADDRESS viewConstants = view.GetConstantBuffer()->GetGPUVirtualAddress() + bufferIndex * sizeof(ViewConstants);
-	D3D12_GPU_VIRTUAL_ADDRESS lightConstants = m_lightConstantBuffer->GetGPUVirtualAddress() + bufferIndex * sizeof(LightConstants);
-
-	// Bind pipeline
-	pipeline->Bind(cmdList, pData, viewConstants, m_tlasSrv, outputUAV);
-	pData += k_shaderRecordSize;
-
-	// Populate SBT
-	int entityId = 0;
-	for (const auto& meshEntity : m_meshEntities)
-	{
-		PIXScopedEvent(cmdList, 0, meshEntity->GetName().c_str());
-
-		StaticMesh* sm = m_meshes.at(meshEntity->GetMeshIndex()).get();
-		uint32_t materialIndex = sm->GetMaterialIndex();
-		Material* mat = m_materials.at(materialIndex).get();
-
-		D3D12_GPU_VIRTUAL_ADDRESS objConstants = m_objectConstantBuffer->GetGPUVirtualAddress() + (bufferIndex * m_meshEntities.size() + entityId) * sizeof(ObjectConstants);
-
-		uint8_t* materialData = pData + materialIndex * k_shaderRecordSize;
-
-		mat->BindConstants(
-			materialData, 
-			pipeline, 
-			sm->GetVertexAndIndexBufferSRVHandle(), 
-			objConstants,
-			viewConstants, 
-			lightConstants);
-
-		++entityId;
-	}
-
-	// Dispatch rays!
-	D3D12_DISPATCH_RAYS_DESC desc = {};
-	desc.RayGenerationShaderRecord.StartAddress = gpuAddress;
-	desc.RayGenerationShaderRecord.SizeInBytes = k_shaderRecordSize;
-
-	desc.MissShaderTable.StartAddress = desc.RayGenerationShaderRecord.StartAddress + k_shaderRecordSize;
-	desc.MissShaderTable.SizeInBytes = 2 * k_shaderRecordSize * m_meshEntities.size();
-	desc.MissShaderTable.StrideInBytes = 2 * k_shaderRecordSize; // miss and hit shaders are interleaved
-
-	desc.HitGroupTable.StartAddress = desc.MissShaderTable.StartAddress + k_shaderRecordSize;
-	desc.HitGroupTable.SizeInBytes = 2 * k_shaderRecordSize * m_meshEntities.size() - k_shaderRecordSize;
-	desc.HitGroupTable.StrideInBytes = 2 * k_shaderRecordSize; // miss and hit shaders are interleaved
-
-	desc.Width = k_screenWidth;
-	desc.Height = k_screenHeight;
-	desc.Depth = 1;
-
-	cmdList->DispatchRays(&desc);
+#include "stdafx.h"
+#include "Scene.h"
+#include "View.h"
+#include "BlasCompaction.h"
+#include "SceneImport.h"
+#include "TaskScheduler.h"
+
+static_assert(AccelerationStructureBuildFlags::AllowUpdate == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE, "Build flags out of sync with d3d12.h");
+static_assert(AccelerationStructureBuildFlags::AllowCompaction == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION, "Build flags out of sync with d3d12.h");
+static_assert(AccelerationStructureBuildFlags::PreferFastTrace == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_TRACE, "Build flags out of sync with d3d12.h");
+static_assert(AccelerationStructureBuildFlags::PreferFastBuild == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PREFER_FAST_BUILD, "Build flags out of sync with d3d12.h");
+static_assert(AccelerationStructureBuildFlags::MinimizeMemory == D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_MINIMIZE_MEMORY, "Build flags out of sync with d3d12.h");
+static_assert(InstanceFlags::TriangleCullDisable == D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_CULL_DISABLE, "Instance flags out of sync with d3d12.h");
+static_assert(InstanceFlags::FrontCounterClockwise == D3D12_RAYTRACING_INSTANCE_FLAG_TRIANGLE_FRONT_COUNTERCLOCKWISE, "Instance flags out of sync with d3d12.h");
+static_assert(InstanceFlags::ForceOpaque == D3D12_RAYTRACING_INSTANCE_FLAG_FORCE_OPAQUE, "Instance flags out of sync with d3d12.h");
+static_assert(InstanceFlags::ForceNonOpaque == D3D12_RAYTRACING_INSTANCE_FLAG_FORCE_NON_OPAQUE, "Instance flags out of sync with d3d12.h");
+static_assert(sizeof(InstanceRecord) == sizeof(D3D12_RAYTRACING_INSTANCE_DESC), "Instance record out of sync with d3d12.h");
+static_assert(offsetof(InstanceRecord, accelerationStructure) == offsetof(D3D12_RAYTRACING_INSTANCE_DESC, AccelerationStructure), "Instance record out of sync with d3d12.h");
+
+Scene::~Scene()
+{
+	// Never initialized when the app falls back to the CPU ray tracer
+	if (m_instanceDescBuffer)
+	{
+		m_instanceDescBuffer->Unmap(0, nullptr);
+		m_objectConstantBuffer->Unmap(0, nullptr);
+		m_lightConstantBuffer->Unmap(0, nullptr);
+	}
+}
+
+void Scene::LoadMeshes(
+	const aiScene* loader, 
+	ID3D12Device5* device, 
+	ID3D12GraphicsCommandList4* cmdList, 
+	UploadBuffer* uploadBuffer,
+	ResourceHeap* scratchHeap,
+	ResourceHeap* resourceHeap, 
+	ID3D12DescriptorHeap* srvHeap, 
+	const size_t srvStartOffset, 
+	const size_t srvDescriptorSize)
+{
+	CreateBLASCompactedSizeBuffers(device, loader->mNumMeshes);
+	m_blasBuilder.Init(scratchHeap, k_blasScratchArenaSize);
+	const D3D12_GPU_VIRTUAL_ADDRESS compactedSizeQueryBase = m_blasCompactedSizeBuffer->GetGPUVirtualAddress();
+
+	std::unordered_map<std::string, OpacityMask> opacityMasks;
+	OpacityBakeStats opacityBakeStats;
+	TriangleSplitStats triangleSplitStats;
+
+	// One set of threads for the opacity bake of every mesh, rather than one per masked mesh
+	TaskScheduler scheduler((std::max)(1u, std::thread::hardware_concurrency()));
+
+	// Geometry is prepared for every mesh before any is uploaded, since the opacity bake and the pre-split change
+	// the triangle counts that the build flags are picked from
+	struct PreparedMesh
+	{
+		std::vector<StaticMesh::VertexType> vertexData;
+		std::vector<StaticMesh::IndexType> indexData;
+		size_t alphaTestedTriangleCount;
+	};
+
+	std::vector<PreparedMesh> preparedMeshes(loader->mNumMeshes);
+	for (auto meshIdx = 0u; meshIdx < loader->mNumMeshes; meshIdx++)
+	{
+		const aiMesh* srcMesh = loader->mMeshes[meshIdx];
+
+		// vertex data
+		std::vector<StaticMesh::VertexType> vertexData;
+		for (auto vertIdx = 0u; vertIdx < srcMesh->mNumVertices; vertIdx++)
+		{
+			const aiVector3D& vertPos = srcMesh->mVertices[vertIdx];
+			const aiVector3D& vertNormal = srcMesh->mNormals[vertIdx];
+			const aiVector3D& vertTangent = srcMesh->mTangents[vertIdx];
+			const aiVector3D& vertBitangent = srcMesh->mBitangents[vertIdx];
+			const aiVector3D& vertUV = srcMesh->mTextureCoords[0][vertIdx];
+
+			vertexData.emplace_back(
+				DirectX::XMFLOAT3(vertPos.x, vertPos.y, vertPos.z),
+				DirectX::XMFLOAT3(vertNormal.x, vertNormal.y, vertNormal.z),
+				DirectX::XMFLOAT3(vertTangent.x, vertTangent.y, vertTangent.z),
+				DirectX::XMFLOAT3(vertBitangent.x, vertBitangent.y, vertBitangent.z),
+				DirectX::XMFLOAT2(vertUV.x, vertUV.y)
+			);
+		}
+
+		// index data
+		std::vector<StaticMesh::IndexType> indexData;
+		for (auto primIdx = 0u; primIdx<srcMesh->mNumFaces; primIdx++)
+		{
+			const aiFace& primitive = srcMesh->mFaces[primIdx];
+			for (auto index = 0u; index < primitive.mNumIndices; index++)
+			{
+				indexData.push_back(primitive.mIndices[index]);
+			}
+		}
+
+		// Materials are loaded first so that the BLAS knows whether its geometry can be marked opaque. Masked meshes
+		// drop their transparent triangles, and only the ones that straddle the mask are left out of the opaque
+		// geometry. There is no any-hit shader yet, so those are traced as solid like the rest.
+		const SurfaceTraits& surfaceTraits = GetSurfaceTraits(m_materials.at(srcMesh->mMaterialIndex)->GetSurfaceCategory());
+		size_t alphaTestedTriangleCount = 0;
+		if (!surfaceTraits.opaqueGeometry)
+		{
+			alphaTestedTriangleCount = BakeTriangleOpacity(loader->mMaterials[srcMesh->mMaterialIndex], vertexData, indexData, opacityMasks, scheduler, opacityBakeStats);
+		}
+
+		if (k_triangleSplitEnabled)
+		{
+			PreSplitTriangles(vertexData, indexData, alphaTestedTriangleCount, triangleSplitStats);
+		}
+
+		preparedMeshes[meshIdx] = { std::move(vertexData), std::move(indexData), alphaTestedTriangleCount };
+	}
+
+	// Pick the BLAS build flags for each mesh from the triangles it is built with. Every mesh in the scene is static; 
+	// entities only move rigidly, which the TLAS handles.
+	std::vector<MeshBuildInfo> meshBuildInfos;
+	meshBuildInfos.reserve(preparedMeshes.size());
+	for (const PreparedMesh& preparedMesh : preparedMeshes)
+	{
+		meshBuildInfos.push_back({ preparedMesh.indexData.size() / 3, MeshMobility::Static });
+	}
+
+	AccelerationStructurePolicySettings policySettings;
+	policySettings.memoryBudget = k_blasMemoryBudget;
+	const AccelerationStructurePolicyReport buildPolicy = PlanBottomLevelBuilds(meshBuildInfos, policySettings);
+	ReportBuildPolicy(buildPolicy);
+
+	for (auto meshIdx = 0u; meshIdx < loader->mNumMeshes; meshIdx++)
+	{
+		PreparedMesh& preparedMesh = preparedMeshes[meshIdx];
+
+		auto mesh = std::make_unique<StaticMesh>();
+		const D3D12_GPU_VIRTUAL_ADDRESS compactedSizeQuery = compactedSizeQueryBase + meshIdx * sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC);
+		mesh->Init(device, cmdList, uploadBuffer, &m_blasBuilder, resourceHeap, std::move(preparedMesh.vertexData), std::move(preparedMesh.indexData), loader->mMeshes[meshIdx]->mMaterialIndex, 
+			srvHeap, srvStartOffset + 2 * meshIdx, srvDescriptorSize, static_cast<D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS>(buildPolicy.meshPlans[meshIdx].buildFlags), 
+			preparedMesh.alphaTestedTriangleCount, compactedSizeQuery);
+		m_meshes.push_back(std::move(mesh));
+	}
+
+	if (opacityBakeStats.triangleCount > 0)
+	{
+		const size_t percent = 100 * opacityBakeStats.alphaTestedCount / opacityBakeStats.triangleCount;
+		std::wstring out = L"*** Opacity bake : " + std::to_wstring(opacityBakeStats.alphaTestedCount) + L"/" + std::to_wstring(opacityBakeStats.triangleCount) + 
+			L" masked triangles still alpha tested (" + std::to_wstring(percent) + L"%), " + std::to_wstring(opacityBakeStats.culledCount) + L" culled, " + 
+			std::to_wstring(opacityBakeStats.milliseconds) + L" ms\n";
+		OutputDebugString(out.c_str());
+
+		for (const auto& [materialName, clipStats] : opacityBakeStats.alphaClipByMaterial)
+		{
+			const double areaReduction = clipStats.areaBefore > 0.0 ? 100.0 * (1.0 - clipStats.areaAfter / clipStats.areaBefore) : 0.0;
+			std::wstring clipOut = L"*** Alpha clip : " + std::wstring(materialName.begin(), materialName.end()) + L" : " + std::to_wstring(clipStats.trianglesBefore) + L" -> " + 
+				std::to_wstring(clipStats.trianglesAfter) + L" alpha tested triangles, area -" + std::to_wstring(static_cast<size_t>(areaReduction + 0.5)) + L"%\n";
+			OutputDebugString(clipOut.c_str());
+		}
+	}
+
+	if (triangleSplitStats.triangleCountBefore > 0)
+	{
+		std::wstring out = L"*** Triangle split : " + std::to_wstring(triangleSplitStats.triangleCountBefore) + L" -> " + std::to_wstring(triangleSplitStats.triangleCountAfter) + 
+			L" triangles, summed SAH cost " + std::to_wstring(triangleSplitStats.sahCostBefore) + L" -> " + std::to_wstring(triangleSplitStats.sahCostAfter) + L", " + 
+			std::to_wstring(triangleSplitStats.milliseconds) + L" ms\n";
+		OutputDebugString(out.c_str());
+	}
+
+	m_blasBuilder.Flush(device, cmdList);
+
+	// Schedule the readback of the compacted sizes written by the BLAS builds
+	D3D12_RESOURCE_BARRIER queryBarrierDesc = {};
+	queryBarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+	queryBarrierDesc.Transition.pResource = m_blasCompactedSizeBuffer.Get();
+	queryBarrierDesc.Transition.StateBefore = D3D12_RESOURCE_STATE_UNORDERED_ACCESS;
+	queryBarrierDesc.Transition.StateAfter = D3D12_RESOURCE_STATE_COPY_SOURCE;
+	queryBarrierDesc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+	cmdList->ResourceBarrier(1, &queryBarrierDesc);
+
+	cmdList->CopyResource(m_blasCompactedSizeReadback.Get(), m_blasCompactedSizeBuffer.Get());
+}
+
+size_t Scene::BakeTriangleOpacity(
+	const aiMaterial* srcMat, 
+	std::vector<StaticMesh::VertexType>& vertexData, 
+	std::vector<StaticMesh::IndexType>& indexData, 
+	std::unordered_map<std::string, OpacityMask>& opacityMasks, 
+	TaskScheduler& scheduler, 
+	OpacityBakeStats& stats)
+{
+	const size_t triangleCount = indexData.size() / 3;
+	stats.triangleCount += triangleCount;
+
+	aiString opacityMaskTextureNameStr;
+	if (srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_OPACITY, 0), opacityMaskTextureNameStr) != aiReturn_SUCCESS)
+	{
+		stats.alphaTestedCount += triangleCount;
+		return triangleCount;
+	}
+
+	const std::string maskName = opacityMaskTextureNameStr.C_Str();
+	auto maskIter = opacityMasks.find(maskName);
+	if (maskIter == opacityMasks.end())
+	{
+		// An empty mask classifies every triangle as alpha tested if the file cannot be read
+		OpacityMask mask;
+		LoadOpacityMaskDds(m_textureDirectory + maskName + ".dds", mask);
+		maskIter = opacityMasks.emplace(maskName, std::move(mask)).first;
+	}
+
+	const auto startTime = std::chrono::steady_clock::now();
+
+	std::vector<Vec2> uvs;
+	uvs.reserve(vertexData.size());
+	for (const StaticMesh::VertexType& vert : vertexData)
+	{
+		uvs.push_back({ vert.uv.x, vert.uv.y });
+	}
+
+	const TriangleOpacityResult opacity = ClassifyTriangleOpacity(maskIter->second, uvs, indexData, k_opacityAlphaCutoff, scheduler);
+	size_t alphaTestedTriangleCount = PartitionTrianglesByOpacity(indexData, opacity.triangles);
+	stats.alphaTestedCount += alphaTestedTriangleCount;
+
+	// Shrink what is left to the opaque part of the mask, which takes the transparent area out of the BLAS
+	aiString materialNameStr;
+	srcMat->Get(AI_MATKEY_NAME, materialNameStr);
+	AlphaClipStats& clipStats = stats.alphaClipByMaterial[materialNameStr.C_Str()];
+	clipStats.trianglesBefore += alphaTestedTriangleCount;
+
+	if (alphaTestedTriangleCount > 0)
+	{
+		std::vector<Vec3> positions;
+		positions.reserve(vertexData.size());
+		for (const StaticMesh::VertexType& vert : vertexData)
+		{
+			positions.push_back({ vert.position.x, vert.position.y, vert.position.z });
+		}
+
+		AlphaClipSettings clipSettings;
+		clipSettings.alphaCutoff = k_opacityAlphaCutoff;
+		clipSettings.maxHullVertices = k_alphaClipMaxHullVertices;
+		clipSettings.minAreaReduction = k_alphaClipMinAreaReduction;
+		const AlphaClipResult clip = ClipAlphaTestedTriangles(maskIter->second, uvs, positions, indexData, alphaTestedTriangleCount, clipSettings);
+
+		// Reserved up front since the source vertices are referenced while appending
+		vertexData.reserve(vertexData.size() + clip.newVertices.size());
+		for (const AlphaClipVertex& clipVert : clip.newVertices)
+		{
+			const StaticMesh::VertexType& v0 = vertexData[indexData[3 * clipVert.sourceTriangle]];
+			const StaticMesh::VertexType& v1 = vertexData[indexData[3 * clipVert.sourceTriangle + 1]];
+			const StaticMesh::VertexType& v2 = vertexData[indexData[3 * clipVert.sourceTriangle + 2]];
+			const Vec3& w = clipVert.barycentrics;
+
+			auto blend3 = [&w](const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b, const DirectX::XMFLOAT3& c)
+			{
+				return DirectX::XMFLOAT3(w.x * a.x + w.y * b.x + w.z * c.x, w.x * a.y + w.y * b.y + w.z * c.y, w.x * a.z + w.y * b.z + w.z * c.z);
+			};
+
+			// The tangent frame is left unnormalized, the same as it would be after rasterizer interpolation
+			StaticMesh::VertexType newVert(
+				blend3(v0.position, v1.position, v2.position),
+				blend3(v0.normal, v1.normal, v2.normal),
+				blend3(v0.tangent, v1.tangent, v2.tangent),
+				blend3(v0.bitangent, v1.bitangent, v2.bitangent),
+				DirectX::XMFLOAT2(w.x * v0.uv.x + w.y * v1.uv.x + w.z * v2.uv.x, w.x * v0.uv.y + w.y * v1.uv.y + w.z * v2.uv.y));
+
+			vertexData.push_back(newVert);
+		}
+
+		indexData.erase(indexData.begin(), indexData.begin() + 3 * alphaTestedTriangleCount);
+		indexData.insert(indexData.begin(), clip.alphaTestedIndices.begin(), clip.alphaTestedIndices.end());
+		alphaTestedTriangleCount = clip.alphaTestedIndices.size() / 3;
+
+		clipStats.areaBefore += clip.areaBefore;
+		clipStats.areaAfter += clip.areaAfter;
+	}
+
+	clipStats.trianglesAfter += alphaTestedTriangleCount;
+	stats.culledCount += opacity.counts[static_cast<size_t>(TriangleOpacity::Transparent)];
+	stats.milliseconds += static_cast<size_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+
+	return alphaTestedTriangleCount;
+}
+
+void Scene::PreSplitTriangles(
+	std::vector<StaticMesh::VertexType>& vertexData, 
+	std::vector<StaticMesh::IndexType>& indexData, 
+	size_t& alphaTestedTriangleCount, 
+	TriangleSplitStats& stats)
+{
+	const auto startTime = std::chrono::steady_clock::now();
+
+	std::vector<Vec3> positions;
+	positions.reserve(vertexData.size());
+	for (const StaticMesh::VertexType& vert : vertexData)
+	{
+		positions.push_back({ vert.position.x, vert.position.y, vert.position.z });
+	}
+
+	TriangleSplitSettings splitSettings;
+	splitSettings.minBoundsToAreaRatio = k_triangleSplitMinBoundsToAreaRatio;
+	splitSettings.triangleBudget = k_triangleSplitBudget;
+	const TriangleSplitResult split = SplitOversizedTriangles(positions, indexData, splitSettings);
+
+	// The SAH cost of a CPU BVH over the triangles, before and after, as a measure of what the split bought
+	const BvhBuildSettings bvhSettings;
+	Bvh bvh;
+	bvh.Build(ComputeTriangleBounds(positions, indexData), bvhSettings);
+	stats.sahCostBefore += bvh.ComputeSahCost(bvhSettings.traversalCost);
+	stats.triangleCountBefore += indexData.size() / 3;
+
+	// Split vertices are midpoints of earlier vertices, so they can be appended in order
+	vertexData.reserve(vertexData.size() + split.newVertices.size());
+	for (const SplitVertex& splitVert : split.newVertices)
+	{
+		const StaticMesh::VertexType& v0 = vertexData[splitVert.a];
+		const StaticMesh::VertexType& v1 = vertexData[splitVert.b];
+
+		auto mid3 = [](const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+		{
+			return DirectX::XMFLOAT3(0.5f * (a.x + b.x), 0.5f * (a.y + b.y), 0.5f * (a.z + b.z));
+		};
+
+		StaticMesh::VertexType newVert(
+			mid3(v0.position, v1.position),
+			mid3(v0.normal, v1.normal),
+			mid3(v0.tangent, v1.tangent),
+			mid3(v0.bitangent, v1.bitangent),
+			DirectX::XMFLOAT2(0.5f * (v0.uv.x + v1.uv.x), 0.5f * (v0.uv.y + v1.uv.y)));
+
+		vertexData.push_back(newVert);
+		positions.push_back({ newVert.position.x, newVert.position.y, newVert.position.z });
+	}
+
+	// The pieces of each triangle stay where it was, so the alpha tested triangles still come first
+	alphaTestedTriangleCount = std::lower_bound(split.sourceTriangles.begin(), split.sourceTriangles.end(), static_cast<uint32_t>(alphaTestedTriangleCount)) - split.sourceTriangles.begin();
+	indexData = split.indices;
+
+	bvh.Build(ComputeTriangleBounds(positions, indexData), bvhSettings);
+	stats.sahCostAfter += bvh.ComputeSahCost(bvhSettings.traversalCost);
+	stats.triangleCountAfter += indexData.size() / 3;
+	stats.milliseconds += static_cast<size_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+void Scene::ReportBuildPolicy(const AccelerationStructurePolicyReport& report)
+{
+	std::wstring out = L"*** AS build policy :";
+	for (size_t classIdx = 0; classIdx < static_cast<size_t>(MeshClass::Count); classIdx++)
+	{
+		const std::string className = GetMeshClassName(static_cast<MeshClass>(classIdx));
+		out += L" " + std::to_wstring(report.classCounts[classIdx]) + L" " + std::wstring(className.begin(), className.end()) + L",";
+	}
+
+	out += L" est. " + std::to_wstring(report.estimatedBytes / 1024) + L" KB of " + std::to_wstring(k_blasMemoryBudget / 1024) + L" KB budget";
+	out += report.overBudget ? L" (minimizing background memory)\n" : L"\n";
+	OutputDebugString(out.c_str());
+}
+
+void Scene::CreateBLASCompactedSizeBuffers(ID3D12Device5* device, const size_t meshCount)
+{
+	D3D12_RESOURCE_DESC resDesc = {};
+	resDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	resDesc.Width = std::max<size_t>(meshCount, 1) * sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC);
+	resDesc.Height = 1;
+	resDesc.DepthOrArraySize = 1;
+	resDesc.MipLevels = 1;
+	resDesc.Format = DXGI_FORMAT_UNKNOWN;
+	resDesc.SampleDesc.Count = 1;
+	resDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	resDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+	// GPU side query results
+	D3D12_HEAP_PROPERTIES heapDesc = {};
+	heapDesc.Type = D3D12_HEAP_TYPE_DEFAULT;
+	heapDesc.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+
+	HRESULT hr = device->CreateCommittedResource(
+		&heapDesc,
+		D3D12_HEAP_FLAG_NONE,
+		&resDesc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		nullptr,
+		IID_PPV_ARGS(m_blasCompactedSizeBuffer.GetAddressOf())
+	);
+
+	assert(SUCCEEDED(hr));
+	m_blasCompactedSizeBuffer->SetName(L"blas_compacted_size_buffer");
+
+	// CPU readable copy
+	resDesc.Flags = D3D12_RESOURCE_FLAG_NONE;
+	heapDesc.Type = D3D12_HEAP_TYPE_READBACK;
+
+	hr = device->CreateCommittedResource(
+		&heapDesc,
+		D3D12_HEAP_FLAG_NONE,
+		&resDesc,
+		D3D12_RESOURCE_STATE_COPY_DEST,
+		nullptr,
+		IID_PPV_ARGS(m_blasCompactedSizeReadback.GetAddressOf())
+	);
+
+	assert(SUCCEEDED(hr));
+	m_blasCompactedSizeReadback->SetName(L"blas_compacted_size_readback");
+}
+
+void Scene::CompactBLAS(
+	ID3D12Device5* device, 
+	ID3D12GraphicsCommandList4* cmdList, 
+	UploadBuffer* uploadBuffer, 
+	ResourceHeap* resourceHeap)
+{
+	// Submit and wait for the BLAS builds so that the compacted sizes can be read back
+	uploadBuffer->Flush();
+	m_blasBuilder.ReleaseScratch();
+
+	std::vector<BlasCompactionEntry> entries;
+	entries.reserve(m_meshes.size());
+
+	{
+		const D3D12_RANGE readRange = { 0, m_meshes.size() * sizeof(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC) };
+		D3D12_RAYTRACING_ACCELERATION_STRUCTURE_POSTBUILD_INFO_COMPACTED_SIZE_DESC* compactedSizes = nullptr;
+		HRESULT hr = m_blasCompactedSizeReadback->Map(0, &readRange, reinterpret_cast<void**>(&compactedSizes));
+		assert(SUCCEEDED(hr));
+
+		for (size_t meshIdx = 0; meshIdx < m_meshes.size(); meshIdx++)
+		{
+			const StaticMesh* mesh = m_meshes[meshIdx].get();
+			const size_t allocatedSize = resourceHeap->GetAllocator()->GetAllocationSize(mesh->GetBLASOffsetInHeap());
+
+			// The size query was only issued for BLASes that allow compaction. A zero size leaves the others alone.
+			const bool allowCompaction = (mesh->GetBLASBuildFlags() & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_COMPACTION) != 0;
+			entries.push_back({ mesh->GetBLASOffsetInHeap(), allocatedSize, allowCompaction ? compactedSizes[meshIdx].CompactedSizeInBytes : 0 });
+		}
+
+		const D3D12_RANGE writeRange = { 0, 0 };
+		m_blasCompactedSizeReadback->Unmap(0, &writeRange);
+	}
+
+	const BlasCompactionPlan plan = PlanBlasCompaction(entries, *resourceHeap->GetAllocator(), D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+
+	for (const BlasRelocation& relocation : plan.relocations)
+	{
+		m_meshes[relocation.entryIndex]->CompactBLAS(device, cmdList, resourceHeap, relocation.newOffset, relocation.newSize);
+	}
+
+	// Wait for the compaction copies before releasing the original placements
+	D3D12_RESOURCE_BARRIER uavBarrier{};
+	uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+	uavBarrier.UAV.pResource = nullptr;
+	cmdList->ResourceBarrier(1, &uavBarrier);
+
+	uploadBuffer->Flush();
+
+	for (const BlasRelocation& relocation : plan.relocations)
+	{
+		m_meshes[relocation.entryIndex]->ReleaseUncompactedBLAS(resourceHeap);
+	}
+
+	m_blasCompactedSizeBuffer.Reset();
+	m_blasCompactedSizeReadback.Reset();
+
+	std::wstring out = L"*** BLAS compaction : " + std::to_wstring(plan.relocations.size()) + L"/" + std::to_wstring(m_meshes.size()) + L" compacted, " +
+		std::to_wstring(plan.bytesBefore / 1024) + L" KB -> " + std::to_wstring(plan.bytesAfter / 1024) + L" KB\n";
+	OutputDebugString(out.c_str());
+}
+
+D3D12_GPU_DESCRIPTOR_HANDLE Scene::LoadTexture(const std::string& textureName, ID3D12Device5* device, ID3D12DescriptorHeap* srvHeap, const size_t srvOffset, const size_t srvDescriptorSize, DirectX::ResourceUploadBatch& resourceUpload)
+{
+	Texture* tex;
+	auto texIter = std::find_if(m_textures.cbegin(), m_textures.cend(),
+		[&textureName](const std::unique_ptr<Texture>& tex) { return tex->GetName() == textureName; });
+
+	if (texIter == m_textures.cend())
+	{
+		auto newTexture = std::make_unique<Texture>();
+		newTexture->Init(device, resourceUpload, m_textureDirectory, textureName);
+		tex = newTexture.get();
+		m_textures.push_back(std::move(newTexture));
+	}
+	else
+	{
+		tex = texIter->get();
+	}
+
+	const auto gpuDescriptorHandle = tex->CreateShaderResourceView(device, srvHeap, srvOffset, srvDescriptorSize);
+
+	return gpuDescriptorHandle;
+}
+
+void Scene::LoadMaterials(
+	const aiScene* loader, 
+	ID3D12Device5* device,
+	ID3D12GraphicsCommandList4* cmdList,
+	ID3D12CommandQueue* cmdQueue,
+	UploadBuffer* uploadBuffer, 
+	ResourceHeap* mtlConstantsHeap,
+	ID3D12DescriptorHeap* srvHeap, 
+	const size_t srvStartOffset, 
+	const size_t srvDescriptorSize)
+{
+	// Used to batch texture uploads
+	DirectX::ResourceUploadBatch resourceUpload(device);
+	resourceUpload.Begin();
+
+	auto descriptorIdx = 0;
+
+	for (auto matIdx = 0u; matIdx < loader->mNumMaterials; matIdx++)
+	{
+		const aiMaterial* srcMat = loader->mMaterials[matIdx];
+
+		aiString materialName;
+		srcMat->Get(AI_MATKEY_NAME, materialName);
+
+		aiString baseColorTextureNameStr;
+		aiReturn bHasBaseColorTexture = srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), baseColorTextureNameStr);
+
+		// roughness mapped to gloss 
+		aiString roughnessTextureNameStr;
+		aiReturn bHasRoughnessTexture = srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_SHININESS, 0), roughnessTextureNameStr);
+
+		// metallic mapped to ambient
+		aiString metallicTextureNameStr;
+		aiReturn bHasMetallicTexture = srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_AMBIENT, 0), metallicTextureNameStr);
+
+		aiString normalmapTextureNameStr;
+		aiReturn bHasNormalmapTexture = srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_HEIGHT, 0), normalmapTextureNameStr);
+
+		aiString opacityMaskTextureNameStr;
+		aiReturn bHasOpacityMaskTexture = srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_OPACITY, 0), opacityMaskTextureNameStr);
+
+		if (bHasBaseColorTexture == aiReturn_SUCCESS &&
+			bHasRoughnessTexture == aiReturn_SUCCESS &&
+			bHasMetallicTexture == aiReturn_SUCCESS &&
+			bHasNormalmapTexture == aiReturn_SUCCESS && 
+			bHasOpacityMaskTexture == aiReturn_SUCCESS)
+		{
+			const auto headDescriptor = LoadTexture(baseColorTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
+			LoadTexture(roughnessTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
+			LoadTexture(metallicTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
+			LoadTexture(normalmapTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
+			const auto opacityMaskDescriptor = LoadTexture(opacityMaskTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
+			m_materials.push_back(std::make_unique<DefaultMaskedMaterial>(std::string(materialName.C_Str()), headDescriptor, opacityMaskDescriptor));
+		}
+		else if (bHasBaseColorTexture == aiReturn_SUCCESS &&
+				bHasRoughnessTexture == aiReturn_SUCCESS &&
+				bHasMetallicTexture == aiReturn_SUCCESS &&
+				bHasNormalmapTexture == aiReturn_SUCCESS)
+		{
+			const auto headDescriptor = LoadTexture(baseColorTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
+			LoadTexture(roughnessTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
+			LoadTexture(metallicTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
+			LoadTexture(normalmapTextureNameStr.C_Str(), device, srvHeap, srvStartOffset + descriptorIdx++, srvDescriptorSize, resourceUpload);
+			m_materials.push_back(std::make_unique<DefaultOpaqueMaterial>(std::string(materialName.C_Str()), headDescriptor));
+		}
+		else
+		{
+			// Use untextured material
+
+			UntexturedMaterial::Constants mtlConstantData;
+			mtlConstantData.baseColor = DirectX::XMFLOAT3{ 0.75, 0.75, 0.75 };
+			mtlConstantData.metallic = 0.f;
+			mtlConstantData.roughness = 0.5;
+
+			D3D12_RESOURCE_DESC cbDesc = {};
+			cbDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+			cbDesc.Width = sizeof(UntexturedMaterial::Constants);
+			cbDesc.Height = 1;
+			cbDesc.DepthOrArraySize = 1;
+			cbDesc.MipLevels = 1;
+			cbDesc.Format = DXGI_FORMAT_UNKNOWN;
+			cbDesc.SampleDesc.Count = 1;
+			cbDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+			size_t offsetInHeap = mtlConstantsHeap->GetAlloc(cbDesc.Width, k_constantBufferAlignment);
+
+			Microsoft::WRL::ComPtr<ID3D12Resource> mtlCb;
+			HRESULT hr = device->CreatePlacedResource(
+				mtlConstantsHeap->GetHeap(),
+				offsetInHeap,
+				&cbDesc,
+				D3D12_RESOURCE_STATE_COPY_DEST,
+				nullptr,
+				IID_PPV_ARGS(mtlCb.GetAddressOf())
+			);
+
+			assert(SUCCEEDED(hr));
+			mtlCb->SetName(L"mtl_constant_buffer_untextured");
+
+			// copy constant data to upload buffer
+			uint64_t cbSizeInBytes;
+			D3D12_PLACED_SUBRESOURCE_FOOTPRINT cbLayout;
+			device->GetCopyableFootprints(
+				&cbDesc,
+				0 /*subresource index*/, 1 /* num subresources */, 0 /*offset*/,
+				&cbLayout, nullptr, &cbSizeInBytes, nullptr);
+
+			auto[uploadPtr, uploadOffset] = uploadBuffer->GetAlloc(cbSizeInBytes);
+			const auto* pSrc = reinterpret_cast<const uint8_t*>(&mtlConstantData);
+			memcpy(uploadPtr, pSrc, cbSizeInBytes);
+
+			// schedule copy to default vertex buffer
+			cmdList->CopyBufferRegion(
+				mtlCb.Get(),
+				0,
+				uploadBuffer->GetResource(),
+				uploadOffset,
+				cbLayout.Footprint.Width
+			);
+
+			// transition to constant buffer
+			D3D12_RESOURCE_BARRIER cbBarrierDesc = {};
+			cbBarrierDesc.Type = D3D12_RESOURCE_BARRIER_TYPE_TRANSITION;
+			cbBarrierDesc.Transition.pResource = mtlCb.Get();
+			cbBarrierDesc.Transition.StateBefore = D3D12_RESOURCE_STATE_COPY_DEST;
+			cbBarrierDesc.Transition.StateAfter = D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE;
+			cbBarrierDesc.Transition.Subresource = D3D12_RESOURCE_BARRIER_ALL_SUBRESOURCES;
+			cmdList->ResourceBarrier(1, &cbBarrierDesc);
+
+			m_materials.push_back(std::make_unique<UntexturedMaterial>(std::string("untextured_mtl"), mtlCb));
+		}
+	}
+
+	// Upload the resources to the GPU.
+	auto uploadResourcesFinished = resourceUpload.End(cmdQueue);
+
+	// Wait for the upload thread to terminate
+	uploadResourcesFinished.wait();
+}
+
+void Scene::LoadEntities(const aiNode* node)
+{
+	const aiMatrix4x4& parentTransform = node->mTransformation;
+
+	for (auto childIdx = 0u; childIdx < node->mNumChildren; childIdx++)
+	{
+		const aiNode* childNode = node->mChildren[childIdx];
+
+		if (childNode->mChildren == nullptr)
+		{
+			const aiMatrix4x4& localTransform = childNode->mTransformation;
+			aiMatrix4x4 localToWorldTransform = parentTransform * localTransform;
+			DirectX::XMFLOAT4X4 localToWorld(reinterpret_cast<float*>(&localToWorldTransform));
+
+			for (auto meshIdx = 0u; meshIdx < childNode->mNumMeshes; meshIdx++)
+			{
+				const uint64_t sceneMeshIndex = childNode->mMeshes[meshIdx];
+
+				m_meshEntities.push_back(std::make_unique<StaticMeshEntity>(
+					std::string(childNode->mName.C_Str()), 
+					sceneMeshIndex,
+					localToWorld));
+			}
+		}
+		else
+		{
+			LoadEntities(childNode);
+		}
+	}
+}
+
+void Scene::CreateTLAS(
+	ID3D12Device5* device,
+	ID3D12GraphicsCommandList4* cmdList,
+	ResourceHeap* scratchHeap,
+	ResourceHeap* resourceHeap,
+	ID3D12DescriptorHeap* srvHeap,
+	const size_t srvHeapOffset,
+	const size_t srvDescriptorSize)
+{
+	const size_t entityCount = m_meshEntities.size();
+
+	// Any entity can be moved with SetEntityTransform, so the TLAS has to allow refits
+	AccelerationStructurePolicySettings policySettings;
+	m_tlasBuildFlags = static_cast<D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS>(PlanTopLevelBuild(entityCount, true, policySettings));
+
+	// Instance descs are buffered per frame so that moving entities can be updated while the GPU reads the previous copy
+	{
+		D3D12_RESOURCE_DESC resDesc = {};
+		resDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		resDesc.Width = sizeof(D3D12_RAYTRACING_INSTANCE_DESC) * entityCount * k_gfxBufferCount;
+		resDesc.Height = 1;
+		resDesc.DepthOrArraySize = 1;
+		resDesc.MipLevels = 1;
+		resDesc.Format = DXGI_FORMAT_UNKNOWN;
+		resDesc.SampleDesc.Count = 1;
+		resDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+		D3D12_HEAP_PROPERTIES heapDesc = {};
+		heapDesc.Type = D3D12_HEAP_TYPE_UPLOAD;
+		heapDesc.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+
+		HRESULT hr = device->CreateCommittedResource(
+			&heapDesc,
+			D3D12_HEAP_FLAG_NONE,
+			&resDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(m_instanceDescBuffer.GetAddressOf())
+		);
+
+		assert(SUCCEEDED(hr));
+		m_instanceDescBuffer->SetName(L"tlas_instance_desc_buffer");
+
+		D3D12_RANGE readRange = { 0 };
+		hr = m_instanceDescBuffer->Map(0, &readRange, reinterpret_cast<void**>(&m_instanceDescPtr));
+		assert(SUCCEEDED(hr));
+	}
+
+	m_entityDirtyTracker.Init(entityCount, k_gfxBufferCount);
+	m_entityWorldBounds.resize(entityCount);
+	m_instanceTransforms.Resize(entityCount);
+	m_instanceAttributes.resize(entityCount);
+
+	for (size_t entityIndex = 0; entityIndex < entityCount; entityIndex++)
+	{
+		const StaticMeshEntity* meshEntity = m_meshEntities[entityIndex].get();
+		const StaticMesh* mesh = m_meshes[meshEntity->GetMeshIndex()].get();
+		const SurfaceTraits& surfaceTraits = GetSurfaceTraits(m_materials.at(mesh->GetMaterialIndex())->GetSurfaceCategory());
+
+		m_instanceTransforms.Set(entityIndex, meshEntity->GetLocalToWorldMatrix().m);
+		m_instanceAttributes[entityIndex] = InstanceRecordAttributes::Pack(static_cast<uint32_t>(entityIndex), surfaceTraits.instanceMask, 0, surfaceTraits.instanceFlags, mesh->GetBLASAddress());
+		m_entityWorldBounds[entityIndex] = ComputeEntityWorldBounds(entityIndex);
+	}
+
+	for (uint32_t bufferIndex = 0; bufferIndex < k_gfxBufferCount; bufferIndex++)
+	{
+		WriteInstanceRecords(m_instanceTransforms, m_instanceAttributes.data(), 0, entityCount, reinterpret_cast<InstanceRecord*>(m_instanceDescPtr + bufferIndex * entityCount));
+	}
+
+	m_entityBoundsAtBuild = m_entityWorldBounds;
+
+	// Compute size for top level acceleration structure buffers
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_INPUTS asInputs{};
+	asInputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+	asInputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+	asInputs.InstanceDescs = m_instanceDescBuffer->GetGPUVirtualAddress();
+	asInputs.NumDescs = static_cast<UINT>(entityCount);
+	asInputs.Flags = m_tlasBuildFlags;
+
+	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_PREBUILD_INFO asPrebuildInfo{};
+	device->GetRaytracingAccelerationStructurePrebuildInfo(&asInputs, &asPrebuildInfo);
+
+	// The scratch buffer is kept around for the per frame refits and rebuilds, so size it for both
+	const size_t scratchSize = std::max<UINT64>(asPrebuildInfo.ScratchDataSizeInBytes, asPrebuildInfo.UpdateScratchDataSizeInBytes);
+	const size_t alignedScratchSize = (scratchSize + D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT - 1) & ~(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT - 1);
+	const size_t alignedTLASBufferSize = (asPrebuildInfo.ResultDataMaxSizeInBytes + D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT - 1) & ~(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT - 1);
+
+	// Create scratch buffer
+	D3D12_RESOURCE_DESC scratchBufDesc = {};
+	scratchBufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	scratchBufDesc.Alignment = max(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+	scratchBufDesc.Width = alignedScratchSize;
+	scratchBufDesc.Height = 1;
+	scratchBufDesc.DepthOrArraySize = 1;
+	scratchBufDesc.MipLevels = 1;
+	scratchBufDesc.Format = DXGI_FORMAT_UNKNOWN;
+	scratchBufDesc.SampleDesc.Count = 1;
+	scratchBufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	scratchBufDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+	auto offsetInHeap = scratchHeap->GetAlloc(scratchBufDesc.Width);
+
+	HRESULT hr = device->CreatePlacedResource(
+		scratchHeap->GetHeap(),
+		offsetInHeap,
+		&scratchBufDesc,
+		D3D12_RESOURCE_STATE_UNORDERED_ACCESS,
+		nullptr,
+		IID_PPV_ARGS(m_tlasScratchBuffer.GetAddressOf())
+	);
+
+	assert(SUCCEEDED(hr));
+	m_tlasScratchBuffer->SetName(L"tlas_scratch_buffer");
+
+	// Create TLAS buffers
+	D3D12_RESOURCE_DESC tlasBufDesc = {};
+	tlasBufDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	tlasBufDesc.Alignment = std::max<UINT64>(D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BYTE_ALIGNMENT, D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT);
+	tlasBufDesc.Width = alignedTLASBufferSize;
+	tlasBufDesc.Height = 1;
+	tlasBufDesc.DepthOrArraySize = 1;
+	tlasBufDesc.MipLevels = 1;
+	tlasBufDesc.Format = DXGI_FORMAT_UNKNOWN;
+	tlasBufDesc.SampleDesc.Count = 1;
+	tlasBufDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+	tlasBufDesc.Flags = D3D12_RESOURCE_FLAG_ALLOW_UNORDERED_ACCESS;
+
+	for (uint32_t bufferIndex = 0; bufferIndex < k_gfxBufferCount; bufferIndex++)
+	{
+		offsetInHeap = resourceHeap->GetAlloc(tlasBufDesc.Width);
+
+		hr = device->CreatePlacedResource(
+			resourceHeap->GetHeap(),
+			offsetInHeap,
+			&tlasBufDesc,
+			D3D12_RESOURCE_STATE_RAYTRACING_ACCELERATION_STRUCTURE,
+			nullptr,
+			IID_PPV_ARGS(m_tlasBuffers[bufferIndex].GetAddressOf())
+		);
+
+		assert(SUCCEEDED(hr));
+		m_tlasBuffers[bufferIndex]->SetName((L"tlas_buffer_" + std::to_wstring(bufferIndex)).c_str());
+
+		// Now, build the top level acceleration structure
+		D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc{};
+		buildDesc.Inputs = asInputs;
+		buildDesc.Inputs.InstanceDescs = m_instanceDescBuffer->GetGPUVirtualAddress() + bufferIndex * entityCount * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
+		buildDesc.ScratchAccelerationStructureData = m_tlasScratchBuffer->GetGPUVirtualAddress();
+		buildDesc.DestAccelerationStructureData = m_tlasBuffers[bufferIndex]->GetGPUVirtualAddress();
+
+		cmdList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
+
+		// Insert UAV barrier. This also guards the scratch buffer, which the next build reuses.
+		D3D12_RESOURCE_BARRIER uavBarrier{};
+		uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+		uavBarrier.UAV.pResource = m_tlasBuffers[bufferIndex].Get();
+
+		cmdList->ResourceBarrier(1, &uavBarrier);
+
+		// TLAS SRV
+		D3D12_SHADER_RESOURCE_VIEW_DESC tlasSrvDesc{};
+		tlasSrvDesc.Format = DXGI_FORMAT_UNKNOWN;
+		tlasSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_RAYTRACING_ACCELERATION_STRUCTURE;
+		tlasSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+		tlasSrvDesc.RaytracingAccelerationStructure.Location = m_tlasBuffers[bufferIndex]->GetGPUVirtualAddress();
+
+		D3D12_CPU_DESCRIPTOR_HANDLE cpuHnd;
+		cpuHnd.ptr = srvHeap->GetCPUDescriptorHandleForHeapStart().ptr + (srvHeapOffset + bufferIndex) * srvDescriptorSize;
+		m_tlasSrvs[bufferIndex].ptr = srvHeap->GetGPUDescriptorHandleForHeapStart().ptr + (srvHeapOffset + bufferIndex) * srvDescriptorSize;
+
+		device->CreateShaderResourceView(nullptr, &tlasSrvDesc, cpuHnd);
+	}
+
+	m_tlasRefitPolicy.Init(k_tlasMaxRefitCount, k_tlasMaxQualityDegradation);
+	m_tlasRefitPolicy.OnRebuild(ComputeTLASQualityMetric());
+	m_tlasFenceValues.fill(0);
+	m_latestTLASIndex = k_gfxBufferCount - 1;
+}
+
+bool Scene::UpdateTLAS(ID3D12GraphicsCommandList4* computeCmdList, const uint32_t bufferIndex)
+{
+	// The instance descs of this buffer are written here rather than with the other render resources, which are
+	// updated before the frame's entity moves. Otherwise the TLAS would be built from descs one move behind. The
+	// descs and the TLAS of a buffer are brought up to date together, so if the descs were current so is the TLAS.
+	InstanceRecord* instanceRecords = reinterpret_cast<InstanceRecord*>(m_instanceDescPtr + bufferIndex * m_meshEntities.size());
+	if (!UpdateInstanceRecords(m_instanceTransforms, m_instanceAttributes.data(), m_entityDirtyTracker, bufferIndex, m_dirtyEntities, instanceRecords))
+	{
+		return false;
+	}
+
+	PIXScopedEvent(computeCmdList, 0, L"update_tlas");
+
+	const float quality = ComputeTLASQualityMetric();
+	const bool allowUpdate = (m_tlasBuildFlags & D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_ALLOW_UPDATE) != 0;
+	const AccelerationStructureUpdate update = allowUpdate ? m_tlasRefitPolicy.Decide(true, quality) : AccelerationStructureUpdate::Rebuild;
+
+	D3D12_BUILD_RAYTRACING_ACCELERATION_STRUCTURE_DESC buildDesc{};
+	buildDesc.Inputs.Type = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_TYPE_TOP_LEVEL;
+	buildDesc.Inputs.DescsLayout = D3D12_ELEMENTS_LAYOUT_ARRAY;
+	buildDesc.Inputs.InstanceDescs = m_instanceDescBuffer->GetGPUVirtualAddress() + bufferIndex * m_meshEntities.size() * sizeof(D3D12_RAYTRACING_INSTANCE_DESC);
+	buildDesc.Inputs.NumDescs = static_cast<UINT>(m_meshEntities.size());
+	buildDesc.Inputs.Flags = m_tlasBuildFlags;
+	buildDesc.ScratchAccelerationStructureData = m_tlasScratchBuffer->GetGPUVirtualAddress();
+	buildDesc.DestAccelerationStructureData = m_tlasBuffers[bufferIndex]->GetGPUVirtualAddress();
+
+	if (update == AccelerationStructureUpdate::Refit)
+	{
+		// Refit from the most recent TLAS, which the previous frame may still be tracing against. That is only a read.
+		buildDesc.Inputs.Flags |= D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_PERFORM_UPDATE;
+		buildDesc.SourceAccelerationStructureData = m_tlasBuffers[m_latestTLASIndex]->GetGPUVirtualAddress();
+		m_tlasRefitPolicy.OnRefit();
+	}
+	else
+	{
+		m_entityBoundsAtBuild = m_entityWorldBounds;
+		m_tlasRefitPolicy.OnRebuild(ComputeTLASQualityMetric());
+	}
+
+	computeCmdList->BuildRaytracingAccelerationStructure(&buildDesc, 0, nullptr);
+
+	D3D12_RESOURCE_BARRIER uavBarrier{};
+	uavBarrier.Type = D3D12_RESOURCE_BARRIER_TYPE_UAV;
+	uavBarrier.UAV.pResource = m_tlasBuffers[bufferIndex].Get();
+	computeCmdList->ResourceBarrier(1, &uavBarrier);
+
+	m_latestTLASIndex = bufferIndex;
+	return true;
+}
+
+void Scene::OnTLASUpdateSubmitted(const uint32_t bufferIndex, const uint64_t computeFenceValue)
+{
+	m_tlasFenceValues[bufferIndex] = computeFenceValue;
+}
+
+float Scene::ComputeTLASQualityMetric() const
+{
+	// A refit keeps the tree that was built for the bounds at build time, so every node ends up covering both where
+	// its instances were and where they are now. The summed area of that swept volume is a cheap proxy for how much
+	// the tree has degraded. It equals the summed area of the current bounds right after a rebuild.
+	float sweptArea = 0.f;
+	for (size_t entityIndex = 0; entityIndex < m_entityWorldBounds.size(); entityIndex++)
+	{
+		sweptArea += Union(m_entityBoundsAtBuild[entityIndex], m_entityWorldBounds[entityIndex]).SurfaceArea();
+	}
+
+	return sweptArea;
+}
+
+Aabb Scene::ComputeEntityWorldBounds(const size_t entityIndex) const
+{
+	const StaticMeshEntity* meshEntity = m_meshEntities[entityIndex].get();
+	const StaticMesh* mesh = m_meshes[meshEntity->GetMeshIndex()].get();
+	const DirectX::XMFLOAT4X4 localToWorld = meshEntity->GetLocalToWorldMatrix();
+
+	return TransformAabb(mesh->GetLocalBounds(), localToWorld.m);
+}
+
+void Scene::SetEntityTransform(const size_t entityIndex, const DirectX::XMFLOAT4X4& localToWorld)
+{
+	m_meshEntities[entityIndex]->SetLocalToWorldMatrix(localToWorld);
+	m_instanceTransforms.Set(entityIndex, localToWorld.m);
+	m_entityWorldBounds[entityIndex] = ComputeEntityWorldBounds(entityIndex);
+	m_entityDirtyTracker.MarkDirty(entityIndex);
+}
+
+void Scene::CreateShaderBindingTable(ID3D12Device5* device)
+{
+	const size_t numEntities = m_meshEntities.size();
+	size_t sbtSize = k_shaderRecordSize * (1 + 2 * numEntities); // 1 for RGS. CHS and MS params are unique per material
+	sbtSize = (sbtSize + (D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT - 1)) & ~(D3D12_RAYTRACING_SHADER_TABLE_BYTE_ALIGNMENT - 1);
+
+	D3D12_RESOURCE_DESC resDesc = {};
+	resDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+	resDesc.Alignment = D3D12_DEFAULT_RESOURCE_PLACEMENT_ALIGNMENT;
+	resDesc.Width = sbtSize * k_gfxBufferCount;
+	resDesc.Height = 1;
+	resDesc.DepthOrArraySize = 1;
+	resDesc.MipLevels = 1;
+	resDesc.Format = DXGI_FORMAT_UNKNOWN;
+	resDesc.SampleDesc.Count = 1;
+	resDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+	D3D12_HEAP_PROPERTIES heapDesc = {};
+	heapDesc.Type = D3D12_HEAP_TYPE_UPLOAD;
+	heapDesc.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+
+	// Create a shader binding table
+	HRESULT hr = device->CreateCommittedResource(
+		&heapDesc,
+		D3D12_HEAP_FLAG_NONE,
+		&resDesc,
+		D3D12_RESOURCE_STATE_GENERIC_READ,
+		nullptr,
+		IID_PPV_ARGS(m_shaderBindingTable.GetAddressOf())
+	);
+
+	assert(SUCCEEDED(hr));
+	m_shaderBindingTable->SetName(L"shader_binding_table");
+
+	D3D12_RANGE readRange = { 0 };
+	hr = m_shaderBindingTable->Map(0, &readRange, &reinterpret_cast<void*>(m_sbtPtr));
+	assert(SUCCEEDED(hr));
+}
+
+void Scene::InitLights(ID3D12Device5* device)
+{
+	m_light = std::make_unique<Light>(DirectX::XMFLOAT3{ 0.57735f, 1.57735f, 0.57735f }, DirectX::XMFLOAT3{ 1.f, 1.f, 1.f }, 10000.f);
+}
+
+void Scene::InitResources(
+	ID3D12Device5* device, 
+	ID3D12CommandQueue* cmdQueue, 
+	ID3D12GraphicsCommandList4* cmdList, 
+	UploadBuffer* uploadBuffer,
+	ResourceHeap* scratchHeap,
+	ResourceHeap* meshDataHeap,
+	ResourceHeap* mtlConstantsHeap,
+	ID3D12DescriptorHeap* srvHeap, 
+	const size_t srvDescriptorSize, 
+	const std::string& sceneFilePath, 
+	const std::string& textureDirectory)
+{
+	m_textureDirectory = textureDirectory;
+
+	// Load scene
+	{
+		Assimp::Importer importer;
+		const aiScene* scene = importer.ReadFile(sceneFilePath, k_sceneImportFlags);
+
+		assert(scene != nullptr && L"Failed to load scene");
+		assert(scene->mNumMeshes < k_objectCount && L"Increase k_objectCount");
+
+		LoadMaterials(scene, device, cmdList, cmdQueue, uploadBuffer, mtlConstantsHeap, srvHeap, SrvUav::MaterialTexturesBegin, srvDescriptorSize);
+		LoadMeshes(scene, device, cmdList, uploadBuffer, scratchHeap, meshDataHeap, srvHeap, SrvUav::MeshdataBegin, srvDescriptorSize);
+		LoadEntities(scene->mRootNode);
+		CompactBLAS(device, cmdList, uploadBuffer, meshDataHeap);
+		CreateTLAS(device, cmdList, scratchHeap, meshDataHeap, srvHeap, SrvUav::TLASBegin, srvDescriptorSize);
+		CreateShaderBindingTable(device);
+		InitLights(device);
+	}
+
+	// Object Constant Buffer
+	if(!m_meshEntities.empty())
+	{
+		D3D12_RESOURCE_DESC resDesc = {};
+		resDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		resDesc.Width = sizeof(ObjectConstants) * m_meshEntities.size() * k_gfxBufferCount;
+		resDesc.Height = 1;
+		resDesc.DepthOrArraySize = 1;
+		resDesc.MipLevels = 1;
+		resDesc.Format = DXGI_FORMAT_UNKNOWN;
+		resDesc.SampleDesc.Count = 1;
+		resDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+		D3D12_HEAP_PROPERTIES heapDesc = {};
+		heapDesc.Type = D3D12_HEAP_TYPE_UPLOAD; // must be CPU accessible
+		heapDesc.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN; // GPU or system mem
+
+		HRESULT hr = device->CreateCommittedResource(
+			&heapDesc,
+			D3D12_HEAP_FLAG_NONE,
+			&resDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(m_objectConstantBuffer.GetAddressOf())
+		);
+
+		assert(SUCCEEDED(hr));
+		m_objectConstantBuffer->SetName(L"object_constant_buffer");
+
+		// Get ptr to mapped resource
+		auto** ptr = reinterpret_cast<void**>(&m_objectConstantBufferPtr);
+		m_objectConstantBuffer->Map(0, nullptr, ptr);
+
+	}
+
+	// Light Constant Buffer
+	{
+		D3D12_RESOURCE_DESC resDesc = {};
+		resDesc.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+		resDesc.Width = sizeof(LightConstants) * k_gfxBufferCount;
+		resDesc.Height = 1;
+		resDesc.DepthOrArraySize = 1;
+		resDesc.MipLevels = 1;
+		resDesc.Format = DXGI_FORMAT_UNKNOWN;
+		resDesc.SampleDesc.Count = 1;
+		resDesc.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+
+		D3D12_HEAP_PROPERTIES heapDesc = {};
+		heapDesc.Type = D3D12_HEAP_TYPE_UPLOAD; // must be CPU accessible
+		heapDesc.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN; // GPU or system mem
+
+
+		HRESULT hr = device->CreateCommittedResource(
+			&heapDesc,
+			D3D12_HEAP_FLAG_NONE,
+			&resDesc,
+			D3D12_RESOURCE_STATE_GENERIC_READ,
+			nullptr,
+			IID_PPV_ARGS(m_lightConstantBuffer.GetAddressOf())
+		);
+
+		assert(SUCCEEDED(hr));
+		m_lightConstantBuffer->SetName(L"light_constant_buffer");
+
+		// Get ptr to mapped resource
+		auto** ptr = reinterpret_cast<void**>(&m_lightConstantBufferPtr);
+		m_lightConstantBuffer->Map(0, nullptr, ptr);
+	}
+}
+
+void Scene::Update(float dt)
+{
+	m_light->Update(dt, m_sceneBounds);
+}
+
+void Scene::UpdateRenderResources(uint32_t bufferIndex)
+{
+	// mesh entities
+	ObjectConstants* o = m_objectConstantBufferPtr + bufferIndex * m_meshEntities.size();
+	for (const auto& meshEntity : m_meshEntities)
+	{
+		meshEntity->FillConstants(o++);
+	}
+
+	// light(s)
+	if (m_light)
+	{
+		LightConstants* l = m_lightConstantBufferPtr + bufferIndex;
+		m_light->FillConstants(l);
+	}
+}
+
+void Scene::Render(
+	ID3D12Device5* device, 
+	ID3D12GraphicsCommandList4* cmdList, 
+	QueueScheduler* queueScheduler, 
+	uint32_t bufferIndex, 
+	const View& view, 
+	const RaytraceMaterialPipeline* pipeline, 
+	D3D12_GPU_DESCRIPTOR_HANDLE outputUAV
+)
+{
+	const size_t sbtSize = k_shaderRecordSize * ( 1 + 2 * m_meshEntities.size());
+	uint8_t* pData = m_sbtPtr + bufferIndex * sbtSize;
+	D3D12_GPU_VIRTUAL_ADDRESS gpuAddress = m_shaderBindingTable->GetGPUVirtualAddress() + bufferIndex * sbtSize;
+
+	D3D12_GPU_VIRTUAL_ADDRESS viewConstants = view.GetConstantBuffer()->GetGPUVirtualAddress() + bufferIndex * sizeof(ViewConstants);
+	D3D12_GPU_VIRTUAL_ADDRESS lightConstants = m_lightConstantBuffer->GetGPUVirtualAddress() + bufferIndex * sizeof(LightConstants);
+
+	// The TLAS is refit or rebuilt on the compute queue. Rays can't be traced against it before that has finished.
+	queueScheduler->Wait(QueueType::Graphics, QueueType::Compute, m_tlasFenceValues[bufferIndex]);
+
+	// Bind pipeline
+	pipeline->Bind(cmdList, pData, viewConstants, m_tlasSrvs[bufferIndex], outputUAV);
+	pData += k_shaderRecordSize;
+
+	// Populate SBT
+	int entityId = 0;
+	for (const auto& meshEntity : m_meshEntities)
+	{
+		PIXScopedEvent(cmdList, 0, meshEntity->GetName().c_str());
+
+		StaticMesh* sm = m_meshes.at(meshEntity->GetMeshIndex()).get();
+		uint32_t materialIndex = sm->GetMaterialIndex();
+		Material* mat = m_materials.at(materialIndex).get();
+
+		D3D12_GPU_VIRTUAL_ADDRESS objConstants = m_objectConstantBuffer->GetGPUVirtualAddress() + (bufferIndex * m_meshEntities.size() + entityId) * sizeof(ObjectConstants);
+
+		uint8_t* materialData = pData + materialIndex * k_shaderRecordSize;
+
+		mat->BindConstants(
+			materialData, 
+			pipeline, 
+			sm->GetVertexAndIndexBufferSRVHandle(), 
+			objConstants,
+			viewConstants, 
+			lightConstants);
+
+		++entityId;
+	}
+
+	// Dispatch rays!
+	D3D12_DISPATCH_RAYS_DESC desc = {};
+	desc.RayGenerationShaderRecord.StartAddress = gpuAddress;
+	desc.RayGenerationShaderRecord.SizeInBytes = k_shaderRecordSize;
+
+	desc.MissShaderTable.StartAddress = desc.RayGenerationShaderRecord.StartAddress + k_shaderRecordSize;
+	desc.MissShaderTable.SizeInBytes = 2 * k_shaderRecordSize * m_meshEntities.size();
+	desc.MissShaderTable.StrideInBytes = 2 * k_shaderRecordSize; // miss and hit shaders are interleaved
+
+	desc.HitGroupTable.StartAddress = desc.MissShaderTable.StartAddress + k_shaderRecordSize;
+	desc.HitGroupTable.SizeInBytes = 2 * k_shaderRecordSize * m_meshEntities.size() - k_shaderRecordSize;
+	desc.HitGroupTable.StrideInBytes = 2 * k_shaderRecordSize; // miss and hit shaders are interleaved
+
+	desc.Width = k_screenWidth;
+	desc.Height = k_screenHeight;
+	desc.Depth = 1;
+
+	cmdList->DispatchRays(&desc);
 }
\ No newline at end of file
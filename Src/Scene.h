@@ -1,106 +1,198 @@
-#pragma once
-
-#include "Common.h"
-#include "StaticMesh.h"
-#include "Material.h"
-#include "Texture.h"
-#include "View.h"
-#include "Light.h"
-
-class Scene
-{
-public:
-	~Scene();
-
-	void InitResources(
-		ID3D12Device5* device, 
-		ID3D12CommandQueue* cmdQueue, 
-		ID3D12GraphicsCommandList4* cmdList, 
-		UploadBuffer* uploadBuffer, 
-		ResourceHeap* scratchHeap, 
-		ResourceHeap* meshDataHeap, 
-		ResourceHeap* mtlConstantsHeap, 
-		ID3D12DescriptorHeap* srvHeap, 
-		size_t srvDescriptorSize);
-
-	void Update(float dt);
-
-	void UpdateRenderResources(uint32_t bufferIndex);
-
-	void Render(
-		ID3D12Device5* device, 
-		ID3D12GraphicsCommandList4* cmdList, 
-		uint32_t bufferIndex, 
-		const View& view, 
-		const RaytraceMaterialPipeline* pipeline,
-		D3D12_GPU_DESCRIPTOR_HANDLE outputUAV);
-
-private:
-	void LoadMeshes(
-		const aiScene* loader, 
-		ID3D12Device5* device, 
-		ID3D12GraphicsCommandList4* cmdList, 
-		UploadBuffer* uploadBuffer, 
-		ResourceHeap* scratchHeap, 
-		ResourceHeap* resourceHeap, 
-		ID3D12DescriptorHeap* srvHeap, 
-		const size_t srvStartOffset, 
-		const size_t srvDescriptorSize);
-
-	void LoadMaterials(
-		const aiScene* loader, 
-		ID3D12Device5* device, 
-		ID3D12GraphicsCommandList4* cmdList, 
-		ID3D12CommandQueue* cmdQueue, 
-		UploadBuffer* uploadBuffer, 
-		ResourceHeap* mtlConstantsHeap, 
-		ID3D12DescriptorHeap* srvHeap, 
-		const size_t srvStartOffset, 
-		const size_t srvDescriptorSize);
-
-	void LoadEntities(const aiNode* node);
-
-	void CreateTLAS(
-		ID3D12Device5* device, 
-		ID3D12GraphicsCommandList4* cmdList, 
-		UploadBuffer* uploadBuffer, 
-		ResourceHeap* scratchHeap, 
-		ResourceHeap* resourceHeap, 
-		ID3D12DescriptorHeap* srvHeap, 
-		const size_t srvStartOffset, 
-		const size_t srvDescriptorSize);
-
-	void CreateShaderBindingTable(ID3D12Device5* device);
-
-	void InitLights(ID3D12Device5* device);
-
-	D3D12_GPU_DESCRIPTOR_HANDLE LoadTexture(
-		const std::string& textureName, 
-		ID3D12Device5* device, 
-		ID3D12DescriptorHeap* srvHeap, 
-		const size_t srvOffset, 
-		const size_t srvDescriptorSize, 
-		DirectX::ResourceUploadBatch& resourceUpload);
-
-private:
-	std::vector<std::unique_ptr<StaticMesh>> m_meshes;
-	std::vector<std::unique_ptr<StaticMeshEntity>> m_meshEntities;
-	std::vector<DirectX::BoundingBox> m_meshWorldBounds;
-	std::vector<std::unique_ptr<Material>> m_materials;
-	std::vector<std::unique_ptr<Texture>> m_textures;
-	std::unique_ptr<Light> m_light;
-
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_tlasBuffer;
-	D3D12_GPU_DESCRIPTOR_HANDLE m_tlasSrv;
-
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_shaderBindingTable;
-	uint8_t* m_sbtPtr = {};
-
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_objectConstantBuffer;
-	ObjectConstants* m_objectConstantBufferPtr;
-
-	Microsoft::WRL::ComPtr<ID3D12Resource> m_lightConstantBuffer;
-	LightConstants* m_lightConstantBufferPtr;
-
-	DirectX::BoundingBox m_sceneBounds;
-};
+#pragma once
+
+#include "Common.h"
+#include "StaticMesh.h"
+#include "Material.h"
+#include "Texture.h"
+#include "View.h"
+#include "Light.h"
+#include "CpuMath.h"
+#include "DirtyTracker.h"
+#include "RefitPolicy.h"
+#include "AccelerationStructurePolicy.h"
+#include "TriangleOpacity.h"
+#include "AlphaClip.h"
+#include "QueueScheduler.h"
+#include "InstanceTransforms.h"
+#include "Bvh.h"
+#include "TriangleSplit.h"
+
+class Scene
+{
+public:
+	~Scene();
+
+	void InitResources(
+		ID3D12Device5* device, 
+		ID3D12CommandQueue* cmdQueue, 
+		ID3D12GraphicsCommandList4* cmdList, 
+		UploadBuffer* uploadBuffer, 
+		ResourceHeap* scratchHeap, 
+		ResourceHeap* meshDataHeap, 
+		ResourceHeap* mtlConstantsHeap, 
+		ID3D12DescriptorHeap* srvHeap, 
+		size_t srvDescriptorSize, 
+		const std::string& sceneFilePath, 
+		const std::string& textureDirectory);
+
+	void Update(float dt);
+
+	void UpdateRenderResources(uint32_t bufferIndex);
+
+	void SetEntityTransform(const size_t entityIndex, const DirectX::XMFLOAT4X4& localToWorld);
+
+	// Records the refit or rebuild of this buffer's TLAS, if it is out of date, on a compute command list. Returns
+	// false if nothing was recorded. The caller submits the list and passes the compute fence value it signalled
+	// after it to OnTLASUpdateSubmitted.
+	bool UpdateTLAS(ID3D12GraphicsCommandList4* computeCmdList, const uint32_t bufferIndex);
+	void OnTLASUpdateSubmitted(const uint32_t bufferIndex, const uint64_t computeFenceValue);
+
+	void Render(
+		ID3D12Device5* device, 
+		ID3D12GraphicsCommandList4* cmdList, 
+		QueueScheduler* queueScheduler, 
+		uint32_t bufferIndex, 
+		const View& view, 
+		const RaytraceMaterialPipeline* pipeline,
+		D3D12_GPU_DESCRIPTOR_HANDLE outputUAV);
+
+private:
+	void LoadMeshes(
+		const aiScene* loader, 
+		ID3D12Device5* device, 
+		ID3D12GraphicsCommandList4* cmdList, 
+		UploadBuffer* uploadBuffer, 
+		ResourceHeap* scratchHeap, 
+		ResourceHeap* resourceHeap, 
+		ID3D12DescriptorHeap* srvHeap, 
+		const size_t srvStartOffset, 
+		const size_t srvDescriptorSize);
+
+	void LoadMaterials(
+		const aiScene* loader, 
+		ID3D12Device5* device, 
+		ID3D12GraphicsCommandList4* cmdList, 
+		ID3D12CommandQueue* cmdQueue, 
+		UploadBuffer* uploadBuffer, 
+		ResourceHeap* mtlConstantsHeap, 
+		ID3D12DescriptorHeap* srvHeap, 
+		const size_t srvStartOffset, 
+		const size_t srvDescriptorSize);
+
+	struct AlphaClipStats
+	{
+		size_t trianglesBefore = 0;
+		size_t trianglesAfter = 0;
+		double areaBefore = 0.0;
+		double areaAfter = 0.0;
+	};
+
+	struct OpacityBakeStats
+	{
+		size_t triangleCount = 0;
+		size_t alphaTestedCount = 0;
+		size_t culledCount = 0;
+		size_t milliseconds = 0;
+		std::map<std::string, AlphaClipStats> alphaClipByMaterial;
+	};
+
+	size_t BakeTriangleOpacity(
+		const aiMaterial* srcMat, 
+		std::vector<StaticMesh::VertexType>& vertexData, 
+		std::vector<StaticMesh::IndexType>& indexData, 
+		std::unordered_map<std::string, OpacityMask>& opacityMasks, 
+		TaskScheduler& scheduler, 
+		OpacityBakeStats& stats);
+
+	struct TriangleSplitStats
+	{
+		size_t triangleCountBefore = 0;
+		size_t triangleCountAfter = 0;
+		double sahCostBefore = 0.0;
+		double sahCostAfter = 0.0;
+		size_t milliseconds = 0;
+	};
+
+	void PreSplitTriangles(
+		std::vector<StaticMesh::VertexType>& vertexData, 
+		std::vector<StaticMesh::IndexType>& indexData, 
+		size_t& alphaTestedTriangleCount, 
+		TriangleSplitStats& stats);
+
+	void ReportBuildPolicy(const AccelerationStructurePolicyReport& report);
+
+	void CreateBLASCompactedSizeBuffers(ID3D12Device5* device, const size_t meshCount);
+
+	void CompactBLAS(
+		ID3D12Device5* device, 
+		ID3D12GraphicsCommandList4* cmdList, 
+		UploadBuffer* uploadBuffer, 
+		ResourceHeap* resourceHeap);
+
+	void LoadEntities(const aiNode* node);
+
+	void CreateTLAS(
+		ID3D12Device5* device, 
+		ID3D12GraphicsCommandList4* cmdList, 
+		ResourceHeap* scratchHeap, 
+		ResourceHeap* resourceHeap, 
+		ID3D12DescriptorHeap* srvHeap, 
+		const size_t srvStartOffset, 
+		const size_t srvDescriptorSize);
+
+	float ComputeTLASQualityMetric() const;
+	Aabb ComputeEntityWorldBounds(const size_t entityIndex) const;
+
+	void CreateShaderBindingTable(ID3D12Device5* device);
+
+	void InitLights(ID3D12Device5* device);
+
+	D3D12_GPU_DESCRIPTOR_HANDLE LoadTexture(
+		const std::string& textureName, 
+		ID3D12Device5* device, 
+		ID3D12DescriptorHeap* srvHeap, 
+		const size_t srvOffset, 
+		const size_t srvDescriptorSize, 
+		DirectX::ResourceUploadBatch& resourceUpload);
+
+private:
+	std::vector<std::unique_ptr<StaticMesh>> m_meshes;
+	std::vector<std::unique_ptr<StaticMeshEntity>> m_meshEntities;
+	std::vector<std::unique_ptr<Material>> m_materials;
+	std::vector<std::unique_ptr<Texture>> m_textures;
+	std::string m_textureDirectory;
+	std::unique_ptr<Light> m_light;
+
+	BlasBuilder m_blasBuilder;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_blasCompactedSizeBuffer;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_blasCompactedSizeReadback;
+
+	// One TLAS per buffered frame, so that the next one can be updated on the compute queue while rays are traced against the last
+	std::array<Microsoft::WRL::ComPtr<ID3D12Resource>, k_gfxBufferCount> m_tlasBuffers;
+	std::array<D3D12_GPU_DESCRIPTOR_HANDLE, k_gfxBufferCount> m_tlasSrvs;
+	std::array<uint64_t, k_gfxBufferCount> m_tlasFenceValues = {};	// compute fence value after the last update of each TLAS
+	uint32_t m_latestTLASIndex = 0;
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_tlasScratchBuffer;
+	D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAGS m_tlasBuildFlags = D3D12_RAYTRACING_ACCELERATION_STRUCTURE_BUILD_FLAG_NONE;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_instanceDescBuffer;
+	D3D12_RAYTRACING_INSTANCE_DESC* m_instanceDescPtr = nullptr;
+	InstanceTransforms m_instanceTransforms;
+	std::vector<InstanceRecordAttributes> m_instanceAttributes;
+	DirtyTracker m_entityDirtyTracker;		// entities moved since the instance descs and TLAS of each buffer were last updated
+	std::vector<size_t> m_dirtyEntities;
+	std::vector<Aabb> m_entityWorldBounds;
+	std::vector<Aabb> m_entityBoundsAtBuild;
+	RefitPolicy m_tlasRefitPolicy;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_shaderBindingTable;
+	uint8_t* m_sbtPtr = {};
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_objectConstantBuffer;
+	ObjectConstants* m_objectConstantBufferPtr;
+
+	Microsoft::WRL::ComPtr<ID3D12Resource> m_lightConstantBuffer;
+	LightConstants* m_lightConstantBufferPtr;
+
+	DirectX::BoundingBox m_sceneBounds;
+};
@@ -0,0 +1,68 @@
+#include "SceneData.h"
+
+#include <array>
+
+namespace
+{
+	std::array<float, 256> MakeSrgbToLinearTable()
+	{
+		std::array<float, 256> table;
+		for (size_t i = 0; i < table.size(); i++)
+		{
+			const float c = static_cast<float>(i) / 255.f;
+			table[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+		}
+
+		return table;
+	}
+}
+
+Vec3 SceneTextureData::Load(const uint32_t x, const uint32_t y) const
+{
+	if (x >= width || y >= height)
+	{
+		return { 0.f, 0.f, 0.f };
+	}
+
+	static const std::array<float, 256> s_srgbToLinear = MakeSrgbToLinearTable();
+
+	const uint32_t texel = texels[static_cast<size_t>(y) * width + x];
+	const uint32_t r = texel & 0xFF;
+	const uint32_t g = (texel >> 8) & 0xFF;
+	const uint32_t b = (texel >> 16) & 0xFF;
+
+	if (srgb)
+	{
+		return { s_srgbToLinear[r], s_srgbToLinear[g], s_srgbToLinear[b] };
+	}
+
+	return { r / 255.f, g / 255.f, b / 255.f };
+}
+
+SceneViewData MakeSceneViewData(const Vec3& position, const Vec3& look, const float verticalFov, const float aspectRatio)
+{
+	const Vec3 worldUp = { 0.f, 1.f, 0.f };
+	const Vec3 l = look * (1.f / Length(look));
+	const Vec3 r0 = Cross(worldUp, l);
+	const Vec3 r = r0 * (1.f / Length(r0));
+	const Vec3 u = Cross(l, r);
+
+	SceneViewData view;
+	const Vec3 basis[3] = { r, u, l };
+	for (int col = 0; col < 3; col++)
+	{
+		view.viewMatrix[0][col] = basis[col].x;
+		view.viewMatrix[1][col] = basis[col].y;
+		view.viewMatrix[2][col] = basis[col].z;
+		view.viewMatrix[3][col] = -Dot(position, basis[col]);
+	}
+
+	view.viewMatrix[0][3] = 0.f;
+	view.viewMatrix[1][3] = 0.f;
+	view.viewMatrix[2][3] = 0.f;
+	view.viewMatrix[3][3] = 1.f;
+
+	view.fovScale.y = std::tan(verticalFov / 2.f);
+	view.fovScale.x = aspectRatio * view.fovScale.y;
+	return view;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "CpuMath.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Device independent copy of the scene, which is all the CPU ray tracer needs. Mirrors what the DXR path uploads:
+// one mesh per aiMesh, one material per aiMaterial and one instance per mesh entity.
+
+// RGBA8 texels, top mip only
+struct SceneTextureData
+{
+	std::string name;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	bool srgb = false;				// texels are sRGB encoded and are linearized when read, like a *_SRGB format
+	std::vector<uint32_t> texels;	// R in the low byte
+
+	// Behaves like Texture2D.Load on mip 0, which returns zero outside of the texture
+	Vec3 Load(const uint32_t x, const uint32_t y) const;
+};
+
+struct SceneMaterialData
+{
+	std::string name;
+	int32_t baseColorTexture = -1;				// -1 for the untextured material, which uses baseColor instead
+	Vec3 baseColor = { 0.75f, 0.75f, 0.75f };
+};
+
+struct SceneMeshData
+{
+	std::vector<Vec3> positions;
+	std::vector<Vec2> uvs;
+	std::vector<uint32_t> indices;
+	uint32_t materialIndex = 0;
+	bool bSpatialSplits = false;	// the CPU ray tracer builds the BVH of the mesh with spatial splits, which is slower but traces faster
+};
+
+struct SceneInstanceData
+{
+	std::string name;
+	uint32_t meshIndex = 0;
+	float localToWorld[4][4];	// row major, translation in the last row, as in a DirectX::XMFLOAT4X4
+};
+
+struct SceneData
+{
+	std::vector<SceneMeshData> meshes;
+	std::vector<SceneMaterialData> materials;
+	std::vector<SceneTextureData> textures;
+	std::vector<SceneInstanceData> instances;
+};
+
+// Mirrors ViewConstants in Common.hlsli
+struct SceneViewData
+{
+	float viewMatrix[4][4];		// row major, as it is in the constant buffer
+	Vec2 fovScale;
+};
+
+// Builds the same view constants as Camera::UpdateViewMatrix and Camera::Init would for a camera at position
+// looking along look, for callers that have no Camera
+SceneViewData MakeSceneViewData(const Vec3& position, const Vec3& look, const float verticalFov, const float aspectRatio);
@@ -0,0 +1,521 @@
+#include "SceneImport.h"
+#include "AlphaClip.h"
+#include "OpacityMask.h"
+#include "TaskScheduler.h"
+#include "TriangleOpacity.h"
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+
+namespace
+{
+	constexpr uint32_t MakeFourCC(const char a, const char b, const char c, const char d)
+	{
+		return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+	}
+
+	constexpr uint32_t k_ddsMagic = MakeFourCC('D', 'D', 'S', ' ');
+	constexpr uint32_t k_ddsHeaderSize = 124;
+	constexpr uint32_t k_dx10HeaderSize = 20;
+	constexpr uint32_t k_ddpfFourCC = 0x4;
+
+	// DXGI_FORMAT values
+	constexpr uint32_t k_dxgiFormatR8G8B8A8Unorm = 28;
+	constexpr uint32_t k_dxgiFormatR8G8B8A8UnormSrgb = 29;
+	constexpr uint32_t k_dxgiFormatBC1Unorm = 71;
+	constexpr uint32_t k_dxgiFormatBC1UnormSrgb = 72;
+	constexpr uint32_t k_dxgiFormatBC2Unorm = 74;
+	constexpr uint32_t k_dxgiFormatBC2UnormSrgb = 75;
+	constexpr uint32_t k_dxgiFormatBC3Unorm = 77;
+	constexpr uint32_t k_dxgiFormatBC3UnormSrgb = 78;
+	constexpr uint32_t k_dxgiFormatB8G8R8A8Unorm = 87;
+	constexpr uint32_t k_dxgiFormatB8G8R8A8UnormSrgb = 91;
+
+	enum class TexelEncoding
+	{
+		BC1,
+		BC2,
+		BC3,
+		RGBA8,
+		BGRA8
+	};
+
+	uint32_t ReadU32(const uint8_t* p)
+	{
+		uint32_t v;
+		memcpy(&v, p, sizeof(v));
+		return v;
+	}
+
+	uint32_t PackRGBA(const uint32_t r, const uint32_t g, const uint32_t b, const uint32_t a)
+	{
+		return r | (g << 8) | (b << 16) | (a << 24);
+	}
+
+	void DecodeColorBlock(const uint8_t* block, const bool allowTransparent, uint32_t outTexels[16])
+	{
+		const uint32_t c0 = block[0] | (block[1] << 8);
+		const uint32_t c1 = block[2] | (block[3] << 8);
+
+		auto expand565 = [](const uint32_t c, uint32_t rgb[3])
+		{
+			const uint32_t r = (c >> 11) & 0x1F;
+			const uint32_t g = (c >> 5) & 0x3F;
+			const uint32_t b = c & 0x1F;
+			rgb[0] = (r << 3) | (r >> 2);
+			rgb[1] = (g << 2) | (g >> 4);
+			rgb[2] = (b << 3) | (b >> 2);
+		};
+
+		uint32_t endpoints[2][3];
+		expand565(c0, endpoints[0]);
+		expand565(c1, endpoints[1]);
+
+		uint32_t palette[4];
+		palette[0] = PackRGBA(endpoints[0][0], endpoints[0][1], endpoints[0][2], 255);
+		palette[1] = PackRGBA(endpoints[1][0], endpoints[1][1], endpoints[1][2], 255);
+
+		// BC2 and BC3 always use the four color mode
+		if (c0 > c1 || !allowTransparent)
+		{
+			palette[2] = PackRGBA(
+				(2 * endpoints[0][0] + endpoints[1][0] + 1) / 3,
+				(2 * endpoints[0][1] + endpoints[1][1] + 1) / 3,
+				(2 * endpoints[0][2] + endpoints[1][2] + 1) / 3, 255);
+			palette[3] = PackRGBA(
+				(endpoints[0][0] + 2 * endpoints[1][0] + 1) / 3,
+				(endpoints[0][1] + 2 * endpoints[1][1] + 1) / 3,
+				(endpoints[0][2] + 2 * endpoints[1][2] + 1) / 3, 255);
+		}
+		else
+		{
+			palette[2] = PackRGBA(
+				(endpoints[0][0] + endpoints[1][0]) / 2,
+				(endpoints[0][1] + endpoints[1][1]) / 2,
+				(endpoints[0][2] + endpoints[1][2]) / 2, 255);
+			palette[3] = 0;
+		}
+
+		const uint32_t indices = ReadU32(block + 4);
+		for (int i = 0; i < 16; i++)
+		{
+			outTexels[i] = palette[(indices >> (2 * i)) & 0x3];
+		}
+	}
+
+	void DecodeExplicitAlphaBlock(const uint8_t* block, uint32_t texels[16])
+	{
+		for (int i = 0; i < 16; i++)
+		{
+			const uint32_t a = (block[i / 2] >> (4 * (i % 2))) & 0xF;
+			texels[i] = (texels[i] & 0x00FFFFFF) | (((a << 4) | a) << 24);
+		}
+	}
+
+	void DecodeInterpolatedAlphaBlock(const uint8_t* block, uint32_t texels[16])
+	{
+		const uint32_t a0 = block[0];
+		const uint32_t a1 = block[1];
+
+		uint32_t palette[8] = { a0, a1 };
+		if (a0 > a1)
+		{
+			for (uint32_t i = 1; i < 7; i++)
+			{
+				palette[i + 1] = ((7 - i) * a0 + i * a1 + 3) / 7;
+			}
+		}
+		else
+		{
+			for (uint32_t i = 1; i < 5; i++)
+			{
+				palette[i + 1] = ((5 - i) * a0 + i * a1 + 2) / 5;
+			}
+
+			palette[6] = 0;
+			palette[7] = 255;
+		}
+
+		// 16 3-bit indices packed little endian into the remaining 6 bytes
+		uint64_t indices = 0;
+		for (int i = 0; i < 6; i++)
+		{
+			indices |= static_cast<uint64_t>(block[2 + i]) << (8 * i);
+		}
+
+		for (int i = 0; i < 16; i++)
+		{
+			texels[i] = (texels[i] & 0x00FFFFFF) | (palette[(indices >> (3 * i)) & 0x7] << 24);
+		}
+	}
+
+	// Texture names come without an extension and the files may have either case of it
+	std::string FindTextureFile(const std::string& directory, const std::string& name)
+	{
+		for (const char* extension : { ".dds", ".DDS" })
+		{
+			const std::string path = directory + name + extension;
+			if (std::ifstream(path, std::ios::binary))
+			{
+				return path;
+			}
+		}
+
+		return directory + name + ".dds";
+	}
+
+	int32_t FindOrLoadTexture(const std::string& name, const SceneImportSettings& settings, std::unordered_map<std::string, int32_t>& textureIndices, SceneData& outScene)
+	{
+		auto texIter = textureIndices.find(name);
+		if (texIter != textureIndices.end())
+		{
+			return texIter->second;
+		}
+
+		// A texture that cannot be read is left empty, so that it reads as black
+		SceneTextureData texture;
+		LoadSceneTextureDds(FindTextureFile(settings.textureDirectory, name), texture);
+		texture.name = name;
+
+		const int32_t textureIndex = static_cast<int32_t>(outScene.textures.size());
+		outScene.textures.push_back(std::move(texture));
+		textureIndices.emplace(name, textureIndex);
+		return textureIndex;
+	}
+
+	// Same as Scene::BakeTriangleOpacity, on positions and uvs only
+	void BakeTriangleOpacity(const OpacityMask& mask, const SceneImportSettings& settings, TaskScheduler& scheduler, SceneMeshData& mesh)
+	{
+		const TriangleOpacityResult opacity = ClassifyTriangleOpacity(mask, mesh.uvs, mesh.indices, settings.alphaCutoff, scheduler);
+		const size_t alphaTestedTriangleCount = PartitionTrianglesByOpacity(mesh.indices, opacity.triangles);
+		if (alphaTestedTriangleCount == 0)
+		{
+			return;
+		}
+
+		AlphaClipSettings clipSettings;
+		clipSettings.alphaCutoff = settings.alphaCutoff;
+		clipSettings.maxHullVertices = settings.alphaClipMaxHullVertices;
+		clipSettings.minAreaReduction = settings.alphaClipMinAreaReduction;
+		const AlphaClipResult clip = ClipAlphaTestedTriangles(mask, mesh.uvs, mesh.positions, mesh.indices, alphaTestedTriangleCount, clipSettings);
+
+		mesh.positions.reserve(mesh.positions.size() + clip.newVertices.size());
+		mesh.uvs.reserve(mesh.uvs.size() + clip.newVertices.size());
+		for (const AlphaClipVertex& clipVert : clip.newVertices)
+		{
+			const uint32_t* tri = &mesh.indices[3 * clipVert.sourceTriangle];
+			const Vec3& w = clipVert.barycentrics;
+
+			mesh.positions.push_back(mesh.positions[tri[0]] * w.x + mesh.positions[tri[1]] * w.y + mesh.positions[tri[2]] * w.z);
+
+			const Vec2& uv0 = mesh.uvs[tri[0]];
+			const Vec2& uv1 = mesh.uvs[tri[1]];
+			const Vec2& uv2 = mesh.uvs[tri[2]];
+			mesh.uvs.push_back({ w.x * uv0.x + w.y * uv1.x + w.z * uv2.x, w.x * uv0.y + w.y * uv1.y + w.z * uv2.y });
+		}
+
+		mesh.indices.erase(mesh.indices.begin(), mesh.indices.begin() + 3 * alphaTestedTriangleCount);
+		mesh.indices.insert(mesh.indices.begin(), clip.alphaTestedIndices.begin(), clip.alphaTestedIndices.end());
+	}
+
+	// Same traversal as Scene::LoadEntities
+	void ImportEntities(const aiNode* node, SceneData& outScene)
+	{
+		const aiMatrix4x4& parentTransform = node->mTransformation;
+
+		for (auto childIdx = 0u; childIdx < node->mNumChildren; childIdx++)
+		{
+			const aiNode* childNode = node->mChildren[childIdx];
+
+			if (childNode->mChildren == nullptr)
+			{
+				const aiMatrix4x4 localToWorldTransform = parentTransform * childNode->mTransformation;
+
+				for (auto meshIdx = 0u; meshIdx < childNode->mNumMeshes; meshIdx++)
+				{
+					SceneInstanceData instance;
+					instance.name = childNode->mName.C_Str();
+					instance.meshIndex = childNode->mMeshes[meshIdx];
+					static_assert(sizeof(instance.localToWorld) == sizeof(localToWorldTransform), "Transform layout mismatch");
+					memcpy(instance.localToWorld, &localToWorldTransform, sizeof(instance.localToWorld));
+					outScene.instances.push_back(instance);
+				}
+			}
+			else
+			{
+				ImportEntities(childNode, outScene);
+			}
+		}
+	}
+}
+
+bool LoadSceneTextureDds(const std::string& path, SceneTextureData& outTexture)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file)
+	{
+		return false;
+	}
+
+	const std::vector<uint8_t> data{ std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>() };
+	if (data.size() < 4 + k_ddsHeaderSize || ReadU32(&data[0]) != k_ddsMagic || ReadU32(&data[4]) != k_ddsHeaderSize)
+	{
+		return false;
+	}
+
+	const uint8_t* header = &data[4];
+	const uint32_t height = ReadU32(header + 8);
+	const uint32_t width = ReadU32(header + 12);
+
+	const uint8_t* pixelFormat = header + 72;
+	const uint32_t pfFlags = ReadU32(pixelFormat + 4);
+	const uint32_t fourCC = ReadU32(pixelFormat + 8);
+	const uint32_t rgbBitCount = ReadU32(pixelFormat + 12);
+	const uint32_t redMask = ReadU32(pixelFormat + 16);
+
+	size_t dataOffset = 4 + k_ddsHeaderSize;
+	TexelEncoding encoding;
+	bool srgb = false;
+
+	if (pfFlags & k_ddpfFourCC)
+	{
+		if (fourCC == MakeFourCC('D', 'X', '1', '0'))
+		{
+			if (data.size() < dataOffset + k_dx10HeaderSize)
+			{
+				return false;
+			}
+
+			switch (ReadU32(&data[dataOffset]))
+			{
+			case k_dxgiFormatBC1UnormSrgb: srgb = true; // fall through
+			case k_dxgiFormatBC1Unorm: encoding = TexelEncoding::BC1; break;
+			case k_dxgiFormatBC2UnormSrgb: srgb = true; // fall through
+			case k_dxgiFormatBC2Unorm: encoding = TexelEncoding::BC2; break;
+			case k_dxgiFormatBC3UnormSrgb: srgb = true; // fall through
+			case k_dxgiFormatBC3Unorm: encoding = TexelEncoding::BC3; break;
+			case k_dxgiFormatR8G8B8A8UnormSrgb: srgb = true; // fall through
+			case k_dxgiFormatR8G8B8A8Unorm: encoding = TexelEncoding::RGBA8; break;
+			case k_dxgiFormatB8G8R8A8UnormSrgb: srgb = true; // fall through
+			case k_dxgiFormatB8G8R8A8Unorm: encoding = TexelEncoding::BGRA8; break;
+			default: return false;
+			}
+
+			dataOffset += k_dx10HeaderSize;
+		}
+		else if (fourCC == MakeFourCC('D', 'X', 'T', '1'))
+		{
+			encoding = TexelEncoding::BC1;
+		}
+		else if (fourCC == MakeFourCC('D', 'X', 'T', '2') || fourCC == MakeFourCC('D', 'X', 'T', '3'))
+		{
+			encoding = TexelEncoding::BC2;
+		}
+		else if (fourCC == MakeFourCC('D', 'X', 'T', '4') || fourCC == MakeFourCC('D', 'X', 'T', '5'))
+		{
+			encoding = TexelEncoding::BC3;
+		}
+		else
+		{
+			return false;
+		}
+	}
+	else if (rgbBitCount == 32)
+	{
+		encoding = redMask == 0x000000FF ? TexelEncoding::RGBA8 : TexelEncoding::BGRA8;
+	}
+	else
+	{
+		return false;
+	}
+
+	if (width == 0 || height == 0)
+	{
+		return false;
+	}
+
+	outTexture.width = width;
+	outTexture.height = height;
+	outTexture.srgb = srgb;
+	outTexture.texels.resize(static_cast<size_t>(width) * height);
+
+	if (encoding == TexelEncoding::RGBA8 || encoding == TexelEncoding::BGRA8)
+	{
+		if (data.size() < dataOffset + outTexture.texels.size() * 4)
+		{
+			return false;
+		}
+
+		memcpy(outTexture.texels.data(), &data[dataOffset], outTexture.texels.size() * 4);
+
+		if (encoding == TexelEncoding::BGRA8)
+		{
+			for (uint32_t& texel : outTexture.texels)
+			{
+				texel = (texel & 0xFF00FF00) | ((texel >> 16) & 0xFF) | ((texel & 0xFF) << 16);
+			}
+		}
+
+		return true;
+	}
+
+	const size_t blockSize = encoding == TexelEncoding::BC1 ? 8 : 16;
+	const uint32_t blocksX = (width + 3) / 4;
+	const uint32_t blocksY = (height + 3) / 4;
+	if (data.size() < dataOffset + static_cast<size_t>(blocksX) * blocksY * blockSize)
+	{
+		return false;
+	}
+
+	for (uint32_t by = 0; by < blocksY; by++)
+	{
+		for (uint32_t bx = 0; bx < blocksX; bx++)
+		{
+			const uint8_t* block = &data[dataOffset + (static_cast<size_t>(by) * blocksX + bx) * blockSize];
+
+			uint32_t texels[16];
+			switch (encoding)
+			{
+			case TexelEncoding::BC1:
+				DecodeColorBlock(block, true, texels);
+				break;
+			case TexelEncoding::BC2:
+				DecodeColorBlock(block + 8, false, texels);
+				DecodeExplicitAlphaBlock(block, texels);
+				break;
+			default:
+				DecodeColorBlock(block + 8, false, texels);
+				DecodeInterpolatedAlphaBlock(block, texels);
+				break;
+			}
+
+			for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++)
+			{
+				for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+				{
+					outTexture.texels[static_cast<size_t>(by * 4 + y) * width + bx * 4 + x] = texels[y * 4 + x];
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+void ImportSceneData(const aiScene* scene, const SceneImportSettings& settings, SceneData& outScene)
+{
+	std::unordered_map<std::string, int32_t> textureIndices;
+	std::unordered_map<std::string, OpacityMask> opacityMasks;
+	std::vector<const OpacityMask*> materialMasks(scene->mNumMaterials, nullptr);
+
+	// Same rules as Scene::LoadMaterials. Only the base color is read by the closest hit shader.
+	for (auto matIdx = 0u; matIdx < scene->mNumMaterials; matIdx++)
+	{
+		const aiMaterial* srcMat = scene->mMaterials[matIdx];
+
+		aiString materialName;
+		srcMat->Get(AI_MATKEY_NAME, materialName);
+
+		aiString baseColorTextureNameStr;
+		aiString roughnessTextureNameStr;
+		aiString metallicTextureNameStr;
+		aiString normalmapTextureNameStr;
+		aiString opacityMaskTextureNameStr;
+		const bool bHasTextures =
+			srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_DIFFUSE, 0), baseColorTextureNameStr) == aiReturn_SUCCESS &&
+			srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_SHININESS, 0), roughnessTextureNameStr) == aiReturn_SUCCESS &&
+			srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_AMBIENT, 0), metallicTextureNameStr) == aiReturn_SUCCESS &&
+			srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_HEIGHT, 0), normalmapTextureNameStr) == aiReturn_SUCCESS;
+
+		SceneMaterialData material;
+		if (bHasTextures)
+		{
+			material.name = materialName.C_Str();
+			material.baseColorTexture = FindOrLoadTexture(baseColorTextureNameStr.C_Str(), settings, textureIndices, outScene);
+
+			if (srcMat->Get(AI_MATKEY_TEXTURE(aiTextureType_OPACITY, 0), opacityMaskTextureNameStr) == aiReturn_SUCCESS)
+			{
+				const std::string maskName = opacityMaskTextureNameStr.C_Str();
+				auto maskIter = opacityMasks.find(maskName);
+				if (maskIter == opacityMasks.end())
+				{
+					OpacityMask mask;
+					LoadOpacityMaskDds(FindTextureFile(settings.textureDirectory, maskName), mask);
+					maskIter = opacityMasks.emplace(maskName, std::move(mask)).first;
+				}
+
+				materialMasks[matIdx] = &maskIter->second;
+			}
+		}
+		else
+		{
+			material.name = "untextured_mtl";
+		}
+
+		outScene.materials.push_back(std::move(material));
+	}
+
+	for (auto meshIdx = 0u; meshIdx < scene->mNumMeshes; meshIdx++)
+	{
+		const aiMesh* srcMesh = scene->mMeshes[meshIdx];
+
+		SceneMeshData mesh;
+		mesh.materialIndex = srcMesh->mMaterialIndex;
+		mesh.positions.reserve(srcMesh->mNumVertices);
+		mesh.uvs.reserve(srcMesh->mNumVertices);
+		for (auto vertIdx = 0u; vertIdx < srcMesh->mNumVertices; vertIdx++)
+		{
+			const aiVector3D& vertPos = srcMesh->mVertices[vertIdx];
+			const aiVector3D& vertUV = srcMesh->mTextureCoords[0][vertIdx];
+			mesh.positions.push_back({ vertPos.x, vertPos.y, vertPos.z });
+			mesh.uvs.push_back({ vertUV.x, vertUV.y });
+		}
+
+		for (auto primIdx = 0u; primIdx < srcMesh->mNumFaces; primIdx++)
+		{
+			const aiFace& primitive = srcMesh->mFaces[primIdx];
+			for (auto index = 0u; index < primitive.mNumIndices; index++)
+			{
+				mesh.indices.push_back(primitive.mIndices[index]);
+			}
+		}
+
+		outScene.meshes.push_back(std::move(mesh));
+	}
+
+	// The meshes are baked in parallel, and the triangles of each one too, so that a few large masked meshes do not
+	// leave threads idle. An empty mask leaves every triangle alpha tested, as it does on the GPU path.
+	TaskScheduler scheduler(settings.threadCount);
+	scheduler.ParallelFor(outScene.meshes.size(), 1, [&](const size_t begin, const size_t end)
+	{
+		for (size_t meshIdx = begin; meshIdx < end; meshIdx++)
+		{
+			SceneMeshData& mesh = outScene.meshes[meshIdx];
+			const OpacityMask* mask = materialMasks.at(mesh.materialIndex);
+			if (mask != nullptr && !mask->texels.empty())
+			{
+				BakeTriangleOpacity(*mask, settings, scheduler, mesh);
+			}
+		}
+	});
+
+	ImportEntities(scene->mRootNode, outScene);
+}
+
+bool LoadSceneData(const std::string& path, const SceneImportSettings& settings, SceneData& outScene)
+{
+	Assimp::Importer importer;
+	const aiScene* scene = importer.ReadFile(path, k_sceneImportFlags);
+	if (scene == nullptr)
+	{
+		return false;
+	}
+
+	ImportSceneData(scene, settings, outScene);
+	return true;
+}
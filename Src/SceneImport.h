@@ -0,0 +1,41 @@
+#pragma once
+
+#include "SceneData.h"
+
+#include <assimp/postprocess.h>
+
+#include <cstdint>
+#include <string>
+
+struct aiScene;
+
+// Post processing applied to the source asset. Shared by the DXR and CPU paths so that they see the same geometry.
+constexpr unsigned int k_sceneImportFlags =
+	aiProcess_CalcTangentSpace |
+	aiProcess_Triangulate |
+	aiProcess_JoinIdenticalVertices |
+	aiProcess_SortByPType |
+	aiProcess_MakeLeftHanded |
+	aiProcess_FlipWindingOrder |
+	aiProcess_FlipUVs;
+
+struct SceneImportSettings
+{
+	std::string textureDirectory;				// prepended to the texture names, which have no extension
+	uint8_t alphaCutoff = 128;
+	uint32_t alphaClipMaxHullVertices = 6;
+	float alphaClipMinAreaReduction = 0.25f;
+	uint32_t threadCount = 1;
+};
+
+// Reads the top mip of a color texture out of a DDS file. Supports BC1, BC2 and BC3 (legacy FourCC or DX10 header,
+// UNORM or SRGB) and uncompressed 32-bit RGBA or BGRA. Returns false for anything else.
+bool LoadSceneTextureDds(const std::string& path, SceneTextureData& outTexture);
+
+// Converts a loaded scene the same way Scene does for the GPU: materials are picked with the same rules, and the
+// triangles of masked meshes that are fully transparent are dropped and the alpha tested ones are clipped. The
+// pre-split of oversized triangles is skipped since it does not change the surface.
+void ImportSceneData(const aiScene* scene, const SceneImportSettings& settings, SceneData& outScene);
+
+// Loads the asset at path with k_sceneImportFlags and imports it. Returns false if the file cannot be read.
+bool LoadSceneData(const std::string& path, const SceneImportSettings& settings, SceneData& outScene);
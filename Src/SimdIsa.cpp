@@ -0,0 +1,80 @@
+#include "SimdIsa.h"
+
+#if SIMD_ISA_X86 && defined(_MSC_VER)
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace
+{
+#if SIMD_ISA_X86
+	bool CpuSupportsAvx2()
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		if (info[0] < 7)
+		{
+			return false;
+		}
+
+		// AVX2 also needs the OS to save the upper halves of the ymm registers
+		__cpuid(info, 1);
+		const bool osxsave = (info[2] & (1 << 27)) != 0;
+		const bool avx = (info[2] & (1 << 28)) != 0;
+		if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+		{
+			return false;
+		}
+
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		return __builtin_cpu_supports("avx2") != 0;
+#endif
+	}
+#endif
+}
+
+bool IsSimdIsaSupported(const SimdIsa isa)
+{
+	switch (isa)
+	{
+	case SimdIsa::Scalar:
+		return true;
+#if SIMD_ISA_X86
+	case SimdIsa::Sse:
+		return true;
+	case SimdIsa::Avx2:
+	{
+		static const bool bAvx2 = CpuSupportsAvx2();
+		return bAvx2;
+	}
+#endif
+	default:
+		return false;
+	}
+}
+
+SimdIsa GetBestSimdIsa()
+{
+	if (IsSimdIsaSupported(SimdIsa::Avx2))
+	{
+		return SimdIsa::Avx2;
+	}
+
+	return IsSimdIsaSupported(SimdIsa::Sse) ? SimdIsa::Sse : SimdIsa::Scalar;
+}
+
+const char* GetSimdIsaName(const SimdIsa isa)
+{
+	switch (isa)
+	{
+	case SimdIsa::Sse:
+		return "SSE";
+	case SimdIsa::Avx2:
+		return "AVX2";
+	default:
+		return "scalar";
+	}
+}
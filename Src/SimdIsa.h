@@ -0,0 +1,28 @@
+#pragma once
+
+// Set where the x86 kernels can be compiled. They are built with SIMD_TARGET_AVX2 rather than for the whole project,
+// and only called once IsSimdIsaSupported has checked the CPU.
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SIMD_ISA_X86 1
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define SIMD_TARGET_AVX2
+#endif
+
+// Instruction sets the CPU ray tracing kernels are written for, narrowest first
+enum class SimdIsa
+{
+	Scalar,
+	Sse,
+	Avx2
+};
+
+// Checked with CPUID, including OS support for the AVX register state
+bool IsSimdIsaSupported(const SimdIsa isa);
+
+SimdIsa GetBestSimdIsa();
+
+const char* GetSimdIsaName(const SimdIsa isa);
@@ -0,0 +1,23 @@
+#include "SurfaceCategory.h"
+
+#include <cassert>
+
+namespace
+{
+	constexpr SurfaceTraits k_surfaceTraits[] =
+	{
+		// Opaque
+		{ InstanceMask::Opaque, InstanceFlags::ForceOpaque, true },
+
+		// AlphaTested
+		{ InstanceMask::AlphaTested, InstanceFlags::None, false },
+	};
+
+	static_assert(sizeof(k_surfaceTraits) / sizeof(k_surfaceTraits[0]) == static_cast<size_t>(SurfaceCategory::Count), "Missing surface traits");
+}
+
+const SurfaceTraits& GetSurfaceTraits(const SurfaceCategory category)
+{
+	assert(category < SurfaceCategory::Count);
+	return k_surfaceTraits[static_cast<size_t>(category)];
+}
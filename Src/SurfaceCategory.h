@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+enum class SurfaceCategory
+{
+	Opaque,
+	AlphaTested,
+	Count
+};
+
+// Instance mask bits, one per category. Must match INSTANCE_MASK_* in Common.hlsli.
+namespace InstanceMask
+{
+	enum : uint8_t
+	{
+		Opaque			= 0x01,
+		AlphaTested		= 0x02,
+		All				= 0xFF
+	};
+}
+
+// Mirrors D3D12_RAYTRACING_INSTANCE_FLAGS so that the table does not depend on d3d12.h
+namespace InstanceFlags
+{
+	enum : uint32_t
+	{
+		None					= 0x0,
+		TriangleCullDisable		= 0x1,
+		FrontCounterClockwise	= 0x2,
+		ForceOpaque				= 0x4,
+		ForceNonOpaque			= 0x8
+	};
+}
+
+struct SurfaceTraits
+{
+	uint8_t instanceMask;
+	uint32_t instanceFlags;
+	bool opaqueGeometry;		// sets D3D12_RAYTRACING_GEOMETRY_FLAG_OPAQUE so that no any-hit shader runs
+};
+
+const SurfaceTraits& GetSurfaceTraits(const SurfaceCategory category);
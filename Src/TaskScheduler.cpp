@@ -0,0 +1,372 @@
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <chrono>
+
+namespace
+{
+	// Ranges are only pushed onto an empty deque, so a deque holds at most one range per level of nested ParallelFor
+	constexpr int64_t k_dequeCapacity = 256;
+	static_assert((k_dequeCapacity & (k_dequeCapacity - 1)) == 0, "The deque capacity has to be a power of two");
+
+	// Rounds of looking for work before an idle worker goes to sleep
+	constexpr uint32_t k_idleSpinCount = 64;
+
+	thread_local const TaskScheduler* t_scheduler = nullptr;
+	thread_local uint32_t t_threadIndex = 0;
+	thread_local uint32_t t_rangeDepth = 0;
+
+	uint64_t NanosecondsSince(const std::chrono::steady_clock::time_point startTime)
+	{
+		return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count());
+	}
+}
+
+struct TaskScheduler::Job
+{
+	const std::function<void(size_t, size_t)>* body;
+	size_t grainSize;
+	std::atomic<size_t> remainingItems;
+};
+
+struct TaskScheduler::Task
+{
+	Job* job;
+	size_t begin;
+	size_t end;
+};
+
+// Chase-Lev deque following the memory orderings of Le et al., "Correct and Efficient Work-Stealing for Weak Memory
+// Models". The owning thread pushes and pops at the bottom, other threads steal from the top.
+class TaskScheduler::Deque
+{
+public:
+	Deque() : m_top(0), m_bottom(0)
+	{
+		for (std::atomic<Task*>& task : m_tasks)
+		{
+			task.store(nullptr, std::memory_order_relaxed);
+		}
+	}
+
+	// Returns false if the deque is full
+	bool Push(Task* task)
+	{
+		const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+		const int64_t top = m_top.load(std::memory_order_acquire);
+		if (bottom - top >= k_dequeCapacity)
+		{
+			return false;
+		}
+
+		m_tasks[bottom & (k_dequeCapacity - 1)].store(task, std::memory_order_relaxed);
+		m_bottom.store(bottom + 1, std::memory_order_release);
+		return true;
+	}
+
+	Task* Pop()
+	{
+		const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+		m_bottom.store(bottom, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		int64_t top = m_top.load(std::memory_order_relaxed);
+
+		if (top > bottom)
+		{
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+			return nullptr;
+		}
+
+		Task* task = m_tasks[bottom & (k_dequeCapacity - 1)].load(std::memory_order_relaxed);
+		if (top == bottom)
+		{
+			// Last task, which a thief may be taking at the same time
+			if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+			{
+				task = nullptr;
+			}
+
+			m_bottom.store(bottom + 1, std::memory_order_relaxed);
+		}
+
+		return task;
+	}
+
+	Task* Steal()
+	{
+		int64_t top = m_top.load(std::memory_order_acquire);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+		if (top >= bottom)
+		{
+			return nullptr;
+		}
+
+		Task* task = m_tasks[top & (k_dequeCapacity - 1)].load(std::memory_order_relaxed);
+		if (!m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+		{
+			return nullptr;
+		}
+
+		return task;
+	}
+
+	// Only exact when called by the owning thread
+	bool IsEmpty() const
+	{
+		return m_bottom.load(std::memory_order_relaxed) <= m_top.load(std::memory_order_relaxed);
+	}
+
+private:
+	std::atomic<int64_t> m_top;
+	std::atomic<int64_t> m_bottom;
+	std::atomic<Task*> m_tasks[k_dequeCapacity];
+};
+
+struct TaskScheduler::ThreadState
+{
+	Deque deque;
+	TaskSchedulerThreadStats stats;
+	uint32_t victimSeed = 0;
+	char padding[64];		// keeps the deques of neighbouring threads off each other's cache lines
+};
+
+TaskScheduler::TaskScheduler(const uint32_t threadCount) :
+	m_threadCount((std::max)(1u, threadCount)),
+	m_threads(new ThreadState[(std::max)(1u, threadCount)]),
+	m_workEpoch(0),
+	m_sleeperCount(0),
+	m_bShutdown(false),
+	m_parallelNanoseconds(0)
+{
+	for (uint32_t threadIdx = 0; threadIdx < m_threadCount; threadIdx++)
+	{
+		m_threads[threadIdx].victimSeed = 2654435761u * (threadIdx + 1);
+	}
+
+	m_workers.reserve(m_threadCount - 1);
+	for (uint32_t threadIdx = 1; threadIdx < m_threadCount; threadIdx++)
+	{
+		m_workers.emplace_back(&TaskScheduler::WorkerMain, this, threadIdx);
+	}
+}
+
+TaskScheduler::~TaskScheduler()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_sleepMutex);
+		m_bShutdown = true;
+	}
+
+	m_wakeCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+	{
+		worker.join();
+	}
+}
+
+void TaskScheduler::ParallelFor(const size_t itemCount, const size_t grainSize, const std::function<void(size_t, size_t)>& body)
+{
+	if (itemCount == 0)
+	{
+		return;
+	}
+
+	const uint32_t threadIndex = GetThreadIndex();
+	const bool bOutermost = t_rangeDepth == 0;
+	const auto startTime = std::chrono::steady_clock::now();
+
+	Job job;
+	job.body = &body;
+	job.grainSize = (std::max<size_t>)(1, grainSize);
+	job.remainingItems = itemCount;
+
+	RunRange(threadIndex, job, 0, itemCount);
+
+	// Help with whatever is left, which may also be ranges of other jobs
+	while (job.remainingItems.load(std::memory_order_acquire) > 0)
+	{
+		if (Task* task = FindTask(threadIndex))
+		{
+			RunTask(threadIndex, task);
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	if (bOutermost)
+	{
+		m_parallelNanoseconds += NanosecondsSince(startTime);
+	}
+}
+
+uint32_t TaskScheduler::GetThreadCount() const
+{
+	return m_threadCount;
+}
+
+uint32_t TaskScheduler::GetThreadIndex() const
+{
+	return t_scheduler == this ? t_threadIndex : 0;
+}
+
+std::vector<TaskSchedulerThreadStats> TaskScheduler::GetThreadStats() const
+{
+	std::vector<TaskSchedulerThreadStats> stats(m_threadCount);
+	for (uint32_t threadIdx = 0; threadIdx < m_threadCount; threadIdx++)
+	{
+		stats[threadIdx] = m_threads[threadIdx].stats;
+	}
+
+	return stats;
+}
+
+uint64_t TaskScheduler::GetParallelNanoseconds() const
+{
+	return m_parallelNanoseconds;
+}
+
+void TaskScheduler::WorkerMain(const uint32_t threadIndex)
+{
+	t_scheduler = this;
+	t_threadIndex = threadIndex;
+
+	uint32_t idleRounds = 0;
+	while (true)
+	{
+		// Read before looking for work, so that a push after the search changes it and keeps the worker awake
+		const uint64_t epoch = m_workEpoch.load();
+
+		if (Task* task = FindTask(threadIndex))
+		{
+			RunTask(threadIndex, task);
+			idleRounds = 0;
+			continue;
+		}
+
+		if (m_bShutdown)
+		{
+			return;
+		}
+
+		if (++idleRounds < k_idleSpinCount)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		idleRounds = 0;
+		std::unique_lock<std::mutex> lock(m_sleepMutex);
+		m_sleeperCount++;
+		m_wakeCondition.wait(lock, [this, epoch]() { return m_workEpoch.load() != epoch || m_bShutdown; });
+		m_sleeperCount--;
+	}
+}
+
+void TaskScheduler::RunRange(const uint32_t threadIndex, Job& job, size_t begin, size_t end)
+{
+	ThreadState& thread = m_threads[threadIndex];
+	const bool bTimed = t_rangeDepth++ == 0;
+	const auto startTime = std::chrono::steady_clock::now();
+
+	size_t itemCount = 0;
+	while (begin < end)
+	{
+		// Split off half of what is left whenever there is nothing for other threads to steal
+		if (end - begin > job.grainSize && thread.deque.IsEmpty())
+		{
+			const size_t mid = begin + (end - begin) / 2;
+			PushTask(threadIndex, new Task{ &job, mid, end });
+			end = mid;
+			continue;
+		}
+
+		const size_t rangeEnd = begin + (std::min)(job.grainSize, end - begin);
+		(*job.body)(begin, rangeEnd);
+		thread.stats.rangeCount++;
+		itemCount += rangeEnd - begin;
+		begin = rangeEnd;
+	}
+
+	t_rangeDepth--;
+	thread.stats.itemCount += itemCount;
+	if (bTimed)
+	{
+		thread.stats.busyNanoseconds += NanosecondsSince(startTime);
+	}
+
+	// The job may be gone as soon as its last items are accounted for
+	job.remainingItems.fetch_sub(itemCount, std::memory_order_acq_rel);
+}
+
+void TaskScheduler::RunTask(const uint32_t threadIndex, Task* task)
+{
+	Job& job = *task->job;
+	const size_t begin = task->begin;
+	const size_t end = task->end;
+	delete task;
+
+	RunRange(threadIndex, job, begin, end);
+}
+
+TaskScheduler::Task* TaskScheduler::FindTask(const uint32_t threadIndex)
+{
+	ThreadState& thread = m_threads[threadIndex];
+	if (Task* task = thread.deque.Pop())
+	{
+		return task;
+	}
+
+	if (m_threadCount == 1)
+	{
+		return nullptr;
+	}
+
+	// Start at a random victim, so that idle threads do not all go after the same one
+	uint32_t& seed = thread.victimSeed;
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+
+	const uint32_t firstVictim = seed % m_threadCount;
+	for (uint32_t i = 0; i < m_threadCount; i++)
+	{
+		const uint32_t victim = (firstVictim + i) % m_threadCount;
+		if (victim == threadIndex)
+		{
+			continue;
+		}
+
+		if (Task* task = m_threads[victim].deque.Steal())
+		{
+			thread.stats.stealCount++;
+			return task;
+		}
+	}
+
+	return nullptr;
+}
+
+void TaskScheduler::PushTask(const uint32_t threadIndex, Task* task)
+{
+	if (!m_threads[threadIndex].deque.Push(task))
+	{
+		RunTask(threadIndex, task);
+		return;
+	}
+
+	m_workEpoch++;
+	if (m_sleeperCount.load() > 0)
+	{
+		// Taking the lock orders the epoch change against a worker that is about to wait on it
+		{
+			std::lock_guard<std::mutex> lock(m_sleepMutex);
+		}
+
+		m_wakeCondition.notify_one();
+	}
+}
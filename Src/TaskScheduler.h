@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Counters of one thread of a TaskScheduler since it was created. Only read them between ParallelFor calls.
+struct TaskSchedulerThreadStats
+{
+	uint64_t rangeCount = 0;		// ranges of items run, each a call of a ParallelFor body
+	uint64_t itemCount = 0;
+	uint64_t stealCount = 0;		// ranges taken from the deque of another thread
+	uint64_t busyNanoseconds = 0;	// spent running ranges, including any nested ParallelFor they wait on
+};
+
+// Fork-join scheduler with a lock-free work-stealing deque per thread. ParallelFor splits its range of items lazily:
+// a thread only halves the range it is running when its own deque is empty, and pushes the other half there for idle
+// threads to steal. Ranges therefore stay large while every thread has work and are cut down towards grainSize only
+// where threads run out, which adapts the work unit to uneven costs, eg. sky tiles next to foliage.
+//
+// The thread that creates the scheduler takes part as thread 0, and threadCount - 1 workers sleep while there is no
+// work. ParallelFor can be called from one outside thread at a time, and from inside the body of another ParallelFor,
+// in which case the waiting thread runs other ranges in the meantime.
+class TaskScheduler
+{
+public:
+	explicit TaskScheduler(const uint32_t threadCount);
+	~TaskScheduler();
+
+	TaskScheduler(const TaskScheduler&) = delete;
+	TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+	// Calls body(begin, end) for ranges that cover [0, itemCount) once, and returns when all of them have finished
+	void ParallelFor(const size_t itemCount, const size_t grainSize, const std::function<void(size_t, size_t)>& body);
+
+	uint32_t GetThreadCount() const;
+
+	// Index of the calling thread within [0, GetThreadCount()), eg. for per-thread scratch buffers. Outside threads
+	// are thread 0.
+	uint32_t GetThreadIndex() const;
+
+	std::vector<TaskSchedulerThreadStats> GetThreadStats() const;
+
+	// Time spent in outermost ParallelFor calls, which the busy time of each thread can be divided by for its
+	// utilization
+	uint64_t GetParallelNanoseconds() const;
+
+private:
+	struct Job;
+	struct Task;
+	class Deque;
+	struct ThreadState;
+
+	void WorkerMain(const uint32_t threadIndex);
+	void RunRange(const uint32_t threadIndex, Job& job, size_t begin, size_t end);
+	void RunTask(const uint32_t threadIndex, Task* task);
+	Task* FindTask(const uint32_t threadIndex);
+	void PushTask(const uint32_t threadIndex, Task* task);
+
+private:
+	uint32_t m_threadCount;
+	std::unique_ptr<ThreadState[]> m_threads;
+	std::vector<std::thread> m_workers;
+
+	// Sleeping workers wait for the epoch to change, which every push does
+	std::atomic<uint64_t> m_workEpoch;
+	std::atomic<uint32_t> m_sleeperCount;
+	std::mutex m_sleepMutex;
+	std::condition_variable m_wakeCondition;
+	std::atomic<bool> m_bShutdown;
+
+	uint64_t m_parallelNanoseconds;
+};
@@ -0,0 +1,180 @@
+#include "TriangleOpacity.h"
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+bool TriangleOverlapsBox(const Vec2 tri[3], const float minX, const float minY, const float maxX, const float maxY)
+{
+	const float triMinX = std::min(std::min(tri[0].x, tri[1].x), tri[2].x);
+	const float triMinY = std::min(std::min(tri[0].y, tri[1].y), tri[2].y);
+	const float triMaxX = std::max(std::max(tri[0].x, tri[1].x), tri[2].x);
+	const float triMaxY = std::max(std::max(tri[0].y, tri[1].y), tri[2].y);
+
+	if (triMaxX < minX || triMinX > maxX || triMaxY < minY || triMinY > maxY)
+	{
+		return false;
+	}
+
+	for (int edge = 0; edge < 3; edge++)
+	{
+		const Vec2& a = tri[edge];
+		const Vec2& b = tri[(edge + 1) % 3];
+		const Vec2& c = tri[(edge + 2) % 3];
+
+		const float nx = a.y - b.y;
+		const float ny = b.x - a.x;
+
+		const float triA = nx * a.x + ny * a.y;
+		const float triC = nx * c.x + ny * c.y;
+		const float triMin = triA < triC ? triA : triC;
+		const float triMax = triA < triC ? triC : triA;
+
+		const float p0 = nx * minX + ny * minY;
+		const float p1 = nx * maxX + ny * minY;
+		const float p2 = nx * minX + ny * maxY;
+		const float p3 = nx * maxX + ny * maxY;
+		const float boxMin = std::min(std::min(p0, p1), std::min(p2, p3));
+		const float boxMax = std::max(std::max(p0, p1), std::max(p2, p3));
+
+		if (boxMax < triMin || boxMin > triMax)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+namespace
+{
+	TriangleOpacity ClassifyTriangle(const OpacityMask& mask, const Vec2 uv[3], const uint8_t alphaCutoff)
+	{
+		// Texel space, where texel (x, y) covers [x, x + 1) x [y, y + 1)
+		Vec2 tri[3];
+		for (int i = 0; i < 3; i++)
+		{
+			if (!std::isfinite(uv[i].x) || !std::isfinite(uv[i].y))
+			{
+				return TriangleOpacity::Mixed;
+			}
+
+			tri[i] = { uv[i].x * mask.width, uv[i].y * mask.height };
+		}
+
+		bool anyOpaque = false;
+		bool anyTransparent = false;
+
+		const bool scanned = ForEachFootprintTexel(tri, [&](const int64_t x, const int64_t y)
+		{
+			if (mask.Fetch(x, y) >= alphaCutoff)
+			{
+				anyOpaque = true;
+			}
+			else
+			{
+				anyTransparent = true;
+			}
+
+			return !(anyOpaque && anyTransparent);
+		});
+
+		if (!scanned)
+		{
+			return TriangleOpacity::Mixed;
+		}
+
+		if (anyOpaque == anyTransparent)
+		{
+			return TriangleOpacity::Mixed;
+		}
+
+		return anyOpaque ? TriangleOpacity::Opaque : TriangleOpacity::Transparent;
+	}
+}
+
+TriangleOpacityResult ClassifyTriangleOpacity(
+	const OpacityMask& mask, 
+	const std::vector<Vec2>& uvs, 
+	const std::vector<uint32_t>& indices, 
+	const uint8_t alphaCutoff, 
+	const uint32_t threadCount)
+{
+	// Not worth spinning up threads for small meshes
+	constexpr size_t k_minTrianglesPerThread = 256;
+	const size_t triangleCount = indices.size() / 3;
+	const size_t workerCount = std::max<size_t>(1, std::min<size_t>(threadCount, triangleCount / k_minTrianglesPerThread));
+
+	TaskScheduler scheduler(static_cast<uint32_t>(workerCount));
+	return ClassifyTriangleOpacity(mask, uvs, indices, alphaCutoff, scheduler);
+}
+
+TriangleOpacityResult ClassifyTriangleOpacity(
+	const OpacityMask& mask, 
+	const std::vector<Vec2>& uvs, 
+	const std::vector<uint32_t>& indices, 
+	const uint8_t alphaCutoff, 
+	TaskScheduler& scheduler)
+{
+	TriangleOpacityResult result;
+
+	const size_t triangleCount = indices.size() / 3;
+	result.triangles.resize(triangleCount, TriangleOpacity::Mixed);
+
+	if (mask.texels.empty())
+	{
+		result.counts[static_cast<size_t>(TriangleOpacity::Mixed)] = triangleCount;
+		return result;
+	}
+
+	// The cost of a triangle grows with its footprint in the mask, so the ranges are left to the scheduler to balance
+	constexpr size_t k_trianglesPerRange = 64;
+	scheduler.ParallelFor(triangleCount, k_trianglesPerRange, [&](const size_t begin, const size_t end)
+	{
+		for (size_t triIdx = begin; triIdx < end; triIdx++)
+		{
+			const Vec2 uv[3] = { uvs[indices[3 * triIdx]], uvs[indices[3 * triIdx + 1]], uvs[indices[3 * triIdx + 2]] };
+			result.triangles[triIdx] = ClassifyTriangle(mask, uv, alphaCutoff);
+		}
+	});
+
+	for (const TriangleOpacity opacity : result.triangles)
+	{
+		result.counts[static_cast<size_t>(opacity)]++;
+	}
+
+	return result;
+}
+
+size_t PartitionTrianglesByOpacity(std::vector<uint32_t>& indices, const std::vector<TriangleOpacity>& opacity)
+{
+	std::vector<uint32_t> alphaTested;
+	std::vector<uint32_t> opaque;
+	alphaTested.reserve(indices.size());
+	opaque.reserve(indices.size());
+
+	for (size_t triIdx = 0; triIdx < opacity.size(); triIdx++)
+	{
+		std::vector<uint32_t>* dest = nullptr;
+		switch (opacity[triIdx])
+		{
+		case TriangleOpacity::Mixed:
+			dest = &alphaTested;
+			break;
+		case TriangleOpacity::Opaque:
+			dest = &opaque;
+			break;
+		default:
+			continue;
+		}
+
+		dest->insert(dest->end(), indices.begin() + 3 * triIdx, indices.begin() + 3 * triIdx + 3);
+	}
+
+	const size_t alphaTestedCount = alphaTested.size() / 3;
+
+	indices = std::move(alphaTested);
+	indices.insert(indices.end(), opaque.begin(), opaque.end());
+
+	return alphaTestedCount;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "CpuMath.h"
+#include "OpacityMask.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class TaskScheduler;
+
+enum class TriangleOpacity : uint8_t
+{
+	Opaque,			// every texel the triangle can sample passes the alpha test
+	Transparent,	// no texel passes, so the triangle can be dropped
+	Mixed,			// still needs the alpha test
+	Count
+};
+
+struct TriangleOpacityResult
+{
+	std::vector<TriangleOpacity> triangles;
+	size_t counts[static_cast<size_t>(TriangleOpacity::Count)] = {};
+};
+
+// Triangles that cover more texels than this are left to the alpha test rather than scanned
+constexpr int64_t k_maxFootprintTexels = 1 << 22;
+
+// Separating axis test between a triangle and an axis aligned box
+bool TriangleOverlapsBox(const Vec2 tri[3], const float minX, const float minY, const float maxX, const float maxY);
+
+// Calls visit(x, y) for every texel that a bilinear sample inside the triangle can read, given in texel space where
+// texel (x, y) covers [x, x + 1) x [y, y + 1). Coordinates are not wrapped. Stops early if visit returns false.
+// Returns false without visiting anything if the footprint is larger than k_maxFootprintTexels.
+template<class Visitor>
+bool ForEachFootprintTexel(const Vec2 tri[3], Visitor&& visit)
+{
+	const float minX = (std::min)((std::min)(tri[0].x, tri[1].x), tri[2].x);
+	const float minY = (std::min)((std::min)(tri[0].y, tri[1].y), tri[2].y);
+	const float maxX = (std::max)((std::max)(tri[0].x, tri[1].x), tri[2].x);
+	const float maxY = (std::max)((std::max)(tri[0].y, tri[1].y), tri[2].y);
+
+	// A bilinear sample can read any texel within half a texel of the footprint
+	const int64_t beginX = static_cast<int64_t>(std::ceil(minX - 1.5f));
+	const int64_t beginY = static_cast<int64_t>(std::ceil(minY - 1.5f));
+	const int64_t endX = static_cast<int64_t>(std::floor(maxX + 0.5f));
+	const int64_t endY = static_cast<int64_t>(std::floor(maxY + 0.5f));
+
+	if ((endX - beginX + 1) * (endY - beginY + 1) > k_maxFootprintTexels)
+	{
+		return false;
+	}
+
+	for (int64_t y = beginY; y <= endY; y++)
+	{
+		for (int64_t x = beginX; x <= endX; x++)
+		{
+			const float texelX = static_cast<float>(x);
+			const float texelY = static_cast<float>(y);
+			if (TriangleOverlapsBox(tri, texelX - 0.5f, texelY - 0.5f, texelX + 1.5f, texelY + 1.5f) && !visit(x, y))
+			{
+				return true;
+			}
+		}
+	}
+
+	return true;
+}
+
+// Rasterizes the UV footprint of every triangle over the mask and classifies it against the alpha cutoff. The
+// footprint is widened by half a texel so that the result also holds for bilinear filtering. Triangles are
+// split across threadCount threads.
+TriangleOpacityResult ClassifyTriangleOpacity(
+	const OpacityMask& mask, 
+	const std::vector<Vec2>& uvs, 
+	const std::vector<uint32_t>& indices, 
+	const uint8_t alphaCutoff, 
+	const uint32_t threadCount);
+
+// Same, on the threads of a scheduler, eg. from inside a ParallelFor over the meshes of a scene
+TriangleOpacityResult ClassifyTriangleOpacity(
+	const OpacityMask& mask, 
+	const std::vector<Vec2>& uvs, 
+	const std::vector<uint32_t>& indices, 
+	const uint8_t alphaCutoff, 
+	TaskScheduler& scheduler);
+
+// Reorders the triangles of an index list so that the ones needing the alpha test come first, followed by the
+// opaque ones. Transparent triangles are removed. Returns the number of alpha tested triangles.
+size_t PartitionTrianglesByOpacity(std::vector<uint32_t>& indices, const std::vector<TriangleOpacity>& opacity);
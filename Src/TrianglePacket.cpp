@@ -0,0 +1,381 @@
+#include "TrianglePacket.h"
+
+#include <cassert>
+#include <cmath>
+
+#if SIMD_ISA_X86
+#include <immintrin.h>
+#endif
+
+namespace
+{
+	// The edge functions of the sheared triangle, which are the barycentrics scaled by their sum. Falls back to double
+	// precision when one of them is zero, since then the sign that decides which triangle of an edge is hit is lost
+	// to rounding.
+	void ComputeEdgeFunctions(
+		const float ax, const float ay,
+		const float bx, const float by,
+		const float cx, const float cy,
+		float& outU,
+		float& outV,
+		float& outW)
+	{
+		outU = cx * by - cy * bx;
+		outV = ax * cy - ay * cx;
+		outW = bx * ay - by * ax;
+
+		if (outU == 0.f || outV == 0.f || outW == 0.f)
+		{
+			outU = static_cast<float>(static_cast<double>(cx) * by - static_cast<double>(cy) * bx);
+			outV = static_cast<float>(static_cast<double>(ax) * cy - static_cast<double>(ay) * cx);
+			outW = static_cast<float>(static_cast<double>(bx) * ay - static_cast<double>(by) * ax);
+		}
+	}
+
+	bool IntersectLane(
+		const TrianglePacket& packet,
+		const uint32_t lane,
+		const WatertightRay& ray,
+		const float tMin,
+		const float tMax,
+		float& outT,
+		float& outU,
+		float& outV)
+	{
+		const Vec3 v0 = { packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane] };
+		const Vec3 v1 = { packet.v1[0][lane], packet.v1[1][lane], packet.v1[2][lane] };
+		const Vec3 v2 = { packet.v2[0][lane], packet.v2[1][lane], packet.v2[2][lane] };
+		return IntersectTriangleWatertight(ray, v0, v1, v2, tMin, tMax, outT, outU, outV);
+	}
+
+	uint32_t LaneMask(const uint32_t triangleCount, const uint32_t firstTriangle, const uint32_t width)
+	{
+		const uint32_t remaining = triangleCount - firstTriangle;
+		return remaining >= width ? (1u << width) - 1 : (1u << remaining) - 1;
+	}
+
+	// Picks the closest of the lanes a SIMD test hit, and redoes the lanes it could not decide in scalar code
+	bool ResolveLanes(
+		const TrianglePacket* packets,
+		const uint32_t firstTriangle,
+		uint32_t hitMask,
+		uint32_t scalarMask,
+		const float* t,
+		const float* u,
+		const float* v,
+		const WatertightRay& ray,
+		const float tMin,
+		float& inOutTMax,
+		TrianglePacketHit& outHit)
+	{
+		bool bFound = false;
+		for (uint32_t lane = 0; hitMask != 0; lane++, hitMask >>= 1)
+		{
+			if ((hitMask & 1) != 0 && t[lane] < inOutTMax)
+			{
+				inOutTMax = t[lane];
+				outHit = { t[lane], u[lane], v[lane], firstTriangle + lane };
+				bFound = true;
+			}
+		}
+
+		for (uint32_t lane = 0; scalarMask != 0; lane++, scalarMask >>= 1)
+		{
+			if ((scalarMask & 1) == 0)
+			{
+				continue;
+			}
+
+			const uint32_t triangle = firstTriangle + lane;
+			float laneT, laneU, laneV;
+			if (IntersectLane(packets[triangle / k_trianglePacketWidth], triangle % k_trianglePacketWidth, ray, tMin, inOutTMax, laneT, laneU, laneV))
+			{
+				inOutTMax = laneT;
+				outHit = { laneT, laneU, laneV, triangle };
+				bFound = true;
+			}
+		}
+
+		return bFound;
+	}
+
+	bool IntersectTrianglePacketsScalar(
+		const TrianglePacket* packets,
+		const uint32_t triangleCount,
+		const WatertightRay& ray,
+		const float tMin,
+		float& inOutTMax,
+		TrianglePacketHit& outHit)
+	{
+		bool bFound = false;
+		for (uint32_t triangle = 0; triangle < triangleCount; triangle++)
+		{
+			float t, u, v;
+			if (IntersectLane(packets[triangle / k_trianglePacketWidth], triangle % k_trianglePacketWidth, ray, tMin, inOutTMax, t, u, v))
+			{
+				inOutTMax = t;
+				outHit = { t, u, v, triangle };
+				bFound = true;
+			}
+		}
+
+		return bFound;
+	}
+
+#if SIMD_ISA_X86
+	bool IntersectTrianglePacketsSse(
+		const TrianglePacket* packets,
+		const uint32_t triangleCount,
+		const WatertightRay& ray,
+		const float tMin,
+		float& inOutTMax,
+		TrianglePacketHit& outHit)
+	{
+		const float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+		const __m128 originX = _mm_set1_ps(origin[ray.kx]);
+		const __m128 originY = _mm_set1_ps(origin[ray.ky]);
+		const __m128 originZ = _mm_set1_ps(origin[ray.kz]);
+		const __m128 sx = _mm_set1_ps(ray.sx);
+		const __m128 sy = _mm_set1_ps(ray.sy);
+		const __m128 sz = _mm_set1_ps(ray.sz);
+		const __m128 zero = _mm_setzero_ps();
+
+		bool bFound = false;
+		for (uint32_t first = 0; first < triangleCount; first += k_trianglePacketWidth)
+		{
+			const TrianglePacket& packet = packets[first / k_trianglePacketWidth];
+
+			const __m128 az = _mm_sub_ps(_mm_loadu_ps(packet.v0[ray.kz]), originZ);
+			const __m128 bz = _mm_sub_ps(_mm_loadu_ps(packet.v1[ray.kz]), originZ);
+			const __m128 cz = _mm_sub_ps(_mm_loadu_ps(packet.v2[ray.kz]), originZ);
+			const __m128 ax = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(packet.v0[ray.kx]), originX), _mm_mul_ps(sx, az));
+			const __m128 ay = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(packet.v0[ray.ky]), originY), _mm_mul_ps(sy, az));
+			const __m128 bx = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(packet.v1[ray.kx]), originX), _mm_mul_ps(sx, bz));
+			const __m128 by = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(packet.v1[ray.ky]), originY), _mm_mul_ps(sy, bz));
+			const __m128 cx = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(packet.v2[ray.kx]), originX), _mm_mul_ps(sx, cz));
+			const __m128 cy = _mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(packet.v2[ray.ky]), originY), _mm_mul_ps(sy, cz));
+
+			const __m128 u = _mm_sub_ps(_mm_mul_ps(cx, by), _mm_mul_ps(cy, bx));
+			const __m128 v = _mm_sub_ps(_mm_mul_ps(ax, cy), _mm_mul_ps(ay, cx));
+			const __m128 w = _mm_sub_ps(_mm_mul_ps(bx, ay), _mm_mul_ps(by, ax));
+
+			const uint32_t laneMask = LaneMask(triangleCount, first, k_trianglePacketWidth);
+			const __m128 anyZero = _mm_or_ps(_mm_or_ps(_mm_cmpeq_ps(u, zero), _mm_cmpeq_ps(v, zero)), _mm_cmpeq_ps(w, zero));
+			const uint32_t scalarMask = static_cast<uint32_t>(_mm_movemask_ps(anyZero)) & laneMask;
+
+			const __m128 anyNegative = _mm_or_ps(_mm_or_ps(_mm_cmplt_ps(u, zero), _mm_cmplt_ps(v, zero)), _mm_cmplt_ps(w, zero));
+			const __m128 anyPositive = _mm_or_ps(_mm_or_ps(_mm_cmpgt_ps(u, zero), _mm_cmpgt_ps(v, zero)), _mm_cmpgt_ps(w, zero));
+
+			const __m128 rcpDet = _mm_div_ps(_mm_set1_ps(1.f), _mm_add_ps(_mm_add_ps(u, v), w));
+			const __m128 scaledT = _mm_add_ps(_mm_add_ps(_mm_mul_ps(u, _mm_mul_ps(sz, az)), _mm_mul_ps(v, _mm_mul_ps(sz, bz))), _mm_mul_ps(w, _mm_mul_ps(sz, cz)));
+			const __m128 t = _mm_mul_ps(scaledT, rcpDet);
+
+			// A zero determinant gives an infinite or NaN t, which fails the range test
+			const __m128 inRange = _mm_and_ps(_mm_cmpge_ps(t, _mm_set1_ps(tMin)), _mm_cmplt_ps(t, _mm_set1_ps(inOutTMax)));
+			const uint32_t hitMask = static_cast<uint32_t>(_mm_movemask_ps(_mm_andnot_ps(_mm_and_ps(anyNegative, anyPositive), inRange))) & laneMask & ~scalarMask;
+			if (hitMask == 0 && scalarMask == 0)
+			{
+				continue;
+			}
+
+			float laneT[4], laneU[4], laneV[4];
+			_mm_storeu_ps(laneT, t);
+			_mm_storeu_ps(laneU, _mm_mul_ps(v, rcpDet));
+			_mm_storeu_ps(laneV, _mm_mul_ps(w, rcpDet));
+			bFound |= ResolveLanes(packets, first, hitMask, scalarMask, laneT, laneU, laneV, ray, tMin, inOutTMax, outHit);
+		}
+
+		return bFound;
+	}
+
+	SIMD_TARGET_AVX2 inline __m256 LoadPacketPair(const float* low, const float* high)
+	{
+		return _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(low)), _mm_loadu_ps(high), 1);
+	}
+
+	// Two packets at a time. An odd last packet is loaded twice and its second copy masked off.
+	SIMD_TARGET_AVX2 bool IntersectTrianglePacketsAvx2(
+		const TrianglePacket* packets,
+		const uint32_t triangleCount,
+		const WatertightRay& ray,
+		const float tMin,
+		float& inOutTMax,
+		TrianglePacketHit& outHit)
+	{
+		const float origin[3] = { ray.origin.x, ray.origin.y, ray.origin.z };
+		const __m256 originX = _mm256_set1_ps(origin[ray.kx]);
+		const __m256 originY = _mm256_set1_ps(origin[ray.ky]);
+		const __m256 originZ = _mm256_set1_ps(origin[ray.kz]);
+		const __m256 sx = _mm256_set1_ps(ray.sx);
+		const __m256 sy = _mm256_set1_ps(ray.sy);
+		const __m256 sz = _mm256_set1_ps(ray.sz);
+		const __m256 zero = _mm256_setzero_ps();
+
+		constexpr uint32_t k_width = 2 * k_trianglePacketWidth;
+
+		bool bFound = false;
+		for (uint32_t first = 0; first < triangleCount; first += k_width)
+		{
+			const TrianglePacket& lo = packets[first / k_trianglePacketWidth];
+			const TrianglePacket& hi = first + k_trianglePacketWidth < triangleCount ? packets[first / k_trianglePacketWidth + 1] : lo;
+
+			const __m256 az = _mm256_sub_ps(LoadPacketPair(lo.v0[ray.kz], hi.v0[ray.kz]), originZ);
+			const __m256 bz = _mm256_sub_ps(LoadPacketPair(lo.v1[ray.kz], hi.v1[ray.kz]), originZ);
+			const __m256 cz = _mm256_sub_ps(LoadPacketPair(lo.v2[ray.kz], hi.v2[ray.kz]), originZ);
+			const __m256 ax = _mm256_sub_ps(_mm256_sub_ps(LoadPacketPair(lo.v0[ray.kx], hi.v0[ray.kx]), originX), _mm256_mul_ps(sx, az));
+			const __m256 ay = _mm256_sub_ps(_mm256_sub_ps(LoadPacketPair(lo.v0[ray.ky], hi.v0[ray.ky]), originY), _mm256_mul_ps(sy, az));
+			const __m256 bx = _mm256_sub_ps(_mm256_sub_ps(LoadPacketPair(lo.v1[ray.kx], hi.v1[ray.kx]), originX), _mm256_mul_ps(sx, bz));
+			const __m256 by = _mm256_sub_ps(_mm256_sub_ps(LoadPacketPair(lo.v1[ray.ky], hi.v1[ray.ky]), originY), _mm256_mul_ps(sy, bz));
+			const __m256 cx = _mm256_sub_ps(_mm256_sub_ps(LoadPacketPair(lo.v2[ray.kx], hi.v2[ray.kx]), originX), _mm256_mul_ps(sx, cz));
+			const __m256 cy = _mm256_sub_ps(_mm256_sub_ps(LoadPacketPair(lo.v2[ray.ky], hi.v2[ray.ky]), originY), _mm256_mul_ps(sy, cz));
+
+			const __m256 u = _mm256_sub_ps(_mm256_mul_ps(cx, by), _mm256_mul_ps(cy, bx));
+			const __m256 v = _mm256_sub_ps(_mm256_mul_ps(ax, cy), _mm256_mul_ps(ay, cx));
+			const __m256 w = _mm256_sub_ps(_mm256_mul_ps(bx, ay), _mm256_mul_ps(by, ax));
+
+			const uint32_t laneMask = LaneMask(triangleCount, first, k_width);
+			const __m256 anyZero = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_EQ_OQ), _mm256_cmp_ps(v, zero, _CMP_EQ_OQ)), _mm256_cmp_ps(w, zero, _CMP_EQ_OQ));
+			const uint32_t scalarMask = static_cast<uint32_t>(_mm256_movemask_ps(anyZero)) & laneMask;
+
+			const __m256 anyNegative = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_LT_OQ), _mm256_cmp_ps(v, zero, _CMP_LT_OQ)), _mm256_cmp_ps(w, zero, _CMP_LT_OQ));
+			const __m256 anyPositive = _mm256_or_ps(_mm256_or_ps(_mm256_cmp_ps(u, zero, _CMP_GT_OQ), _mm256_cmp_ps(v, zero, _CMP_GT_OQ)), _mm256_cmp_ps(w, zero, _CMP_GT_OQ));
+
+			const __m256 rcpDet = _mm256_div_ps(_mm256_set1_ps(1.f), _mm256_add_ps(_mm256_add_ps(u, v), w));
+			const __m256 scaledT = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(u, _mm256_mul_ps(sz, az)), _mm256_mul_ps(v, _mm256_mul_ps(sz, bz))), _mm256_mul_ps(w, _mm256_mul_ps(sz, cz)));
+			const __m256 t = _mm256_mul_ps(scaledT, rcpDet);
+
+			const __m256 inRange = _mm256_and_ps(_mm256_cmp_ps(t, _mm256_set1_ps(tMin), _CMP_GE_OQ), _mm256_cmp_ps(t, _mm256_set1_ps(inOutTMax), _CMP_LT_OQ));
+			const uint32_t hitMask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_andnot_ps(_mm256_and_ps(anyNegative, anyPositive), inRange))) & laneMask & ~scalarMask;
+			if (hitMask == 0 && scalarMask == 0)
+			{
+				continue;
+			}
+
+			float laneT[8], laneU[8], laneV[8];
+			_mm256_storeu_ps(laneT, t);
+			_mm256_storeu_ps(laneU, _mm256_mul_ps(v, rcpDet));
+			_mm256_storeu_ps(laneV, _mm256_mul_ps(w, rcpDet));
+			bFound |= ResolveLanes(packets, first, hitMask, scalarMask, laneT, laneU, laneV, ray, tMin, inOutTMax, outHit);
+		}
+
+		return bFound;
+	}
+#endif
+}
+
+bool IntersectTriangleWatertight(
+	const WatertightRay& ray,
+	const Vec3& v0,
+	const Vec3& v1,
+	const Vec3& v2,
+	const float tMin,
+	const float tMax,
+	float& outT,
+	float& outU,
+	float& outV)
+{
+	const float a[3] = { v0.x - ray.origin.x, v0.y - ray.origin.y, v0.z - ray.origin.z };
+	const float b[3] = { v1.x - ray.origin.x, v1.y - ray.origin.y, v1.z - ray.origin.z };
+	const float c[3] = { v2.x - ray.origin.x, v2.y - ray.origin.y, v2.z - ray.origin.z };
+
+	float u, v, w;
+	ComputeEdgeFunctions(
+		a[ray.kx] - ray.sx * a[ray.kz], a[ray.ky] - ray.sy * a[ray.kz],
+		b[ray.kx] - ray.sx * b[ray.kz], b[ray.ky] - ray.sy * b[ray.kz],
+		c[ray.kx] - ray.sx * c[ray.kz], c[ray.ky] - ray.sy * c[ray.kz],
+		u, v, w);
+
+	// Both windings are accepted, since the rays are traced with RAY_FLAG_NONE and no culling instance flags
+	if ((u < 0.f || v < 0.f || w < 0.f) && (u > 0.f || v > 0.f || w > 0.f))
+	{
+		return false;
+	}
+
+	const float det = u + v + w;
+	if (det == 0.f)
+	{
+		return false;
+	}
+
+	const float rcpDet = 1.f / det;
+	const float t = (u * (ray.sz * a[ray.kz]) + v * (ray.sz * b[ray.kz]) + w * (ray.sz * c[ray.kz])) * rcpDet;
+	if (!(t >= tMin && t < tMax))
+	{
+		return false;
+	}
+
+	outT = t;
+	outU = v * rcpDet;
+	outV = w * rcpDet;
+	return true;
+}
+
+WatertightRay WatertightRay::Make(const Vec3& origin, const Vec3& direction)
+{
+	const float d[3] = { direction.x, direction.y, direction.z };
+
+	WatertightRay ray;
+	ray.origin = origin;
+	ray.kz = std::fabs(d[0]) > std::fabs(d[1]) ? (std::fabs(d[0]) > std::fabs(d[2]) ? 0 : 2) : (std::fabs(d[1]) > std::fabs(d[2]) ? 1 : 2);
+	ray.kx = (ray.kz + 1) % 3;
+	ray.ky = (ray.kx + 1) % 3;
+
+	// Keep the winding of the sheared triangles the same whichever way the ray points along kz
+	if (d[ray.kz] < 0.f)
+	{
+		const uint32_t k = ray.kx;
+		ray.kx = ray.ky;
+		ray.ky = k;
+	}
+
+	ray.sx = d[ray.kx] / d[ray.kz];
+	ray.sy = d[ray.ky] / d[ray.kz];
+	ray.sz = 1.f / d[ray.kz];
+	return ray;
+}
+
+IntersectTrianglePacketsFunc GetIntersectTrianglePackets(const SimdIsa isa)
+{
+	assert(IsSimdIsaSupported(isa));
+
+	switch (isa)
+	{
+#if SIMD_ISA_X86
+	case SimdIsa::Sse:
+		return IntersectTrianglePacketsSse;
+	case SimdIsa::Avx2:
+		return IntersectTrianglePacketsAvx2;
+#endif
+	default:
+		return IntersectTrianglePacketsScalar;
+	}
+}
+
+void SetTrianglePacketLane(TrianglePacket& packet, const uint32_t lane, const Vec3& v0, const Vec3& v1, const Vec3& v2)
+{
+	assert(lane < k_trianglePacketWidth);
+
+	const Vec3* vertices[3] = { &v0, &v1, &v2 };
+	float (*rows[3])[k_trianglePacketWidth] = { packet.v0, packet.v1, packet.v2 };
+	for (uint32_t vertex = 0; vertex < 3; vertex++)
+	{
+		rows[vertex][0][lane] = vertices[vertex]->x;
+		rows[vertex][1][lane] = vertices[vertex]->y;
+		rows[vertex][2][lane] = vertices[vertex]->z;
+	}
+}
+
+Aabb ComputeTrianglePacketBounds(const TrianglePacket* packets, const uint32_t triangleCount)
+{
+	Aabb bounds;
+	for (uint32_t i = 0; i < triangleCount; i++)
+	{
+		const TrianglePacket& packet = packets[i / k_trianglePacketWidth];
+		const uint32_t lane = i % k_trianglePacketWidth;
+		bounds.Grow(Vec3{ packet.v0[0][lane], packet.v0[1][lane], packet.v0[2][lane] });
+		bounds.Grow(Vec3{ packet.v1[0][lane], packet.v1[1][lane], packet.v1[2][lane] });
+		bounds.Grow(Vec3{ packet.v2[0][lane], packet.v2[1][lane], packet.v2[2][lane] });
+	}
+
+	return bounds;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CpuMath.h"
+#include "SimdIsa.h"
+
+#include <cstdint>
+
+constexpr uint32_t k_trianglePacketWidth = 4;
+
+// Four triangles stored as structure of arrays, one row per vertex and axis, so that a ray can be tested against all of
+// them at once. The lanes past the triangle count of a leaf are never hit.
+struct TrianglePacket
+{
+	float v0[3][k_trianglePacketWidth];
+	float v1[3][k_trianglePacketWidth];
+	float v2[3][k_trianglePacketWidth];
+};
+
+// Ray set up for the watertight test of Woop et al., "Watertight Ray/Triangle Intersection". The triangles are sheared
+// into a space where the ray runs along +z, which gives every edge the same sign test from both of its triangles.
+struct WatertightRay
+{
+	Vec3 origin;
+	uint32_t kx;
+	uint32_t ky;
+	uint32_t kz;			// axis along which the direction is largest
+	float sx;
+	float sy;
+	float sz;
+
+	static WatertightRay Make(const Vec3& origin, const Vec3& direction);
+};
+
+// Closest hit along a ray. u and v are the weights of the second and third vertex, the same as the barycentrics DXR
+// passes to the closest hit shader in BuiltInTriangleIntersectionAttributes.
+struct TrianglePacketHit
+{
+	float t;
+	float u;
+	float v;
+	uint32_t triangle;		// relative to the first triangle of the first packet
+};
+
+// Tests a ray against the first triangleCount triangles of consecutive packets, from both sides. Returns true and
+// lowers inOutTMax if a hit closer than it and not closer than tMin is found.
+using IntersectTrianglePacketsFunc = bool (*)(
+	const TrianglePacket* packets,
+	const uint32_t triangleCount,
+	const WatertightRay& ray,
+	const float tMin,
+	float& inOutTMax,
+	TrianglePacketHit& outHit);
+
+IntersectTrianglePacketsFunc GetIntersectTrianglePackets(const SimdIsa isa);
+
+// Single triangle version of the test, which the SIMD kernels fall back to when an edge function is zero. Returns
+// true if the ray hits the triangle within [tMin, tMax).
+bool IntersectTriangleWatertight(
+	const WatertightRay& ray,
+	const Vec3& v0,
+	const Vec3& v1,
+	const Vec3& v2,
+	const float tMin,
+	const float tMax,
+	float& outT,
+	float& outU,
+	float& outV);
+
+void SetTrianglePacketLane(TrianglePacket& packet, const uint32_t lane, const Vec3& v0, const Vec3& v1, const Vec3& v2);
+
+// Bounds of the first triangleCount triangles of consecutive packets
+Aabb ComputeTrianglePacketBounds(const TrianglePacket* packets, const uint32_t triangleCount);
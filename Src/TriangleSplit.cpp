@@ -0,0 +1,357 @@
+#include "TriangleSplit.h"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <numeric>
+#include <queue>
+#include <unordered_map>
+
+namespace
+{
+	uint64_t EdgeKey(const uint32_t a, const uint32_t b)
+	{
+		return a < b ? (static_cast<uint64_t>(a) << 32) | b : (static_cast<uint64_t>(b) << 32) | a;
+	}
+
+	// Bits of a coordinate, with -0 and +0 the same
+	uint32_t PositionBits(const float value)
+	{
+		const float normalized = value + 0.f;
+		uint32_t bits;
+		memcpy(&bits, &normalized, sizeof(bits));
+		return bits;
+	}
+
+	// Maps every vertex to the lowest index of the vertices at exactly the same position, so that triangles on either
+	// side of a uv or normal seam, which have their own vertices there, still share their edges
+	std::vector<uint32_t> WeldVertices(const std::vector<Vec3>& positions)
+	{
+		auto key = [&positions](const uint32_t v)
+		{
+			return std::array<uint32_t, 3>{ PositionBits(positions[v].x), PositionBits(positions[v].y), PositionBits(positions[v].z) };
+		};
+
+		std::vector<uint32_t> order(positions.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::stable_sort(order.begin(), order.end(), [&key](const uint32_t a, const uint32_t b)
+		{
+			return key(a) < key(b);
+		});
+
+		std::vector<uint32_t> weld(positions.size());
+		for (size_t i = 0; i < order.size(); i++)
+		{
+			weld[order[i]] = (i > 0 && key(order[i]) == key(order[i - 1])) ? weld[order[i - 1]] : order[i];
+		}
+
+		return weld;
+	}
+
+	struct Candidate
+	{
+		float benefit;
+		uint32_t triangle;
+		uint32_t version;
+
+		bool operator<(const Candidate& other) const
+		{
+			// Biggest benefit first, lowest index on ties to stay deterministic
+			return benefit < other.benefit || (benefit == other.benefit && triangle > other.triangle);
+		}
+	};
+
+	class SplitMesh
+	{
+	public:
+		SplitMesh(const std::vector<Vec3>& positions, const std::vector<uint32_t>& indices) :
+			m_positions(positions),
+			m_weld(WeldVertices(positions))
+		{
+			const size_t triangleCount = indices.size() / 3;
+			m_triangles.resize(triangleCount);
+			m_sources.resize(triangleCount);
+			m_versions.resize(triangleCount);
+
+			for (uint32_t triIdx = 0; triIdx < triangleCount; triIdx++)
+			{
+				m_triangles[triIdx] = { indices[3 * triIdx], indices[3 * triIdx + 1], indices[3 * triIdx + 2] };
+				m_sources[triIdx] = triIdx;
+
+				// Triangles with a repeated position have no area and are never split
+				const std::array<uint32_t, 3> tri = { m_weld[indices[3 * triIdx]], m_weld[indices[3 * triIdx + 1]], m_weld[indices[3 * triIdx + 2]] };
+				if (tri[0] == tri[1] || tri[1] == tri[2] || tri[2] == tri[0])
+				{
+					continue;
+				}
+
+				for (int e = 0; e < 3; e++)
+				{
+					AddEdge(m_triangles[triIdx][e], m_triangles[triIdx][(e + 1) % 3], triIdx);
+				}
+			}
+		}
+
+		float BoundsArea(const uint32_t triIdx) const
+		{
+			Aabb box;
+			for (const uint32_t v : m_triangles[triIdx])
+			{
+				box.Grow(m_positions[v]);
+			}
+
+			return box.SurfaceArea();
+		}
+
+		int LongestEdge(const uint32_t triIdx) const
+		{
+			const std::array<uint32_t, 3>& tri = m_triangles[triIdx];
+
+			int longest = 0;
+			float longestLength = -1.f;
+			for (int e = 0; e < 3; e++)
+			{
+				const Vec3 d = m_positions[tri[(e + 1) % 3]] - m_positions[tri[e]];
+				const float length = Dot(d, d);
+				if (length > longestLength)
+				{
+					longestLength = length;
+					longest = e;
+				}
+			}
+
+			return longest;
+		}
+
+		// Reduction in summed box area from bisecting the longest edge, which is what the BVH cost depends on
+		float SplitBenefit(const uint32_t triIdx) const
+		{
+			const std::array<uint32_t, 3>& tri = m_triangles[triIdx];
+			const int e = LongestEdge(triIdx);
+			const Vec3& v0 = m_positions[tri[e]];
+			const Vec3& v1 = m_positions[tri[(e + 1) % 3]];
+			const Vec3& v2 = m_positions[tri[(e + 2) % 3]];
+			const Vec3 m = (v0 + v1) * 0.5f;
+
+			Aabb first;
+			first.Grow(v0);
+			first.Grow(m);
+			first.Grow(v2);
+
+			Aabb second;
+			second.Grow(m);
+			second.Grow(v1);
+			second.Grow(v2);
+
+			return BoundsArea(triIdx) - first.SurfaceArea() - second.SurfaceArea();
+		}
+
+		uint32_t GetVersion(const uint32_t triIdx) const
+		{
+			return m_versions[triIdx];
+		}
+
+		float Area(const uint32_t triIdx) const
+		{
+			const std::array<uint32_t, 3>& tri = m_triangles[triIdx];
+			return 0.5f * Length(Cross(m_positions[tri[1]] - m_positions[tri[0]], m_positions[tri[2]] - m_positions[tri[0]]));
+		}
+
+		// Bisects the longest edge of the triangle, and that edge in every other triangle sharing its positions. Each
+		// pair of vertices the edge is made of gets its own midpoint, all at the same position. Appends the triangles
+		// that were changed or created to outTouched. Does nothing if that would exceed maxTriangleCount.
+		bool SplitLongestEdge(const uint32_t triIdx, std::vector<SplitVertex>& newVertices, const uint32_t vertexBase, const size_t maxTriangleCount, std::vector<uint32_t>& outTouched)
+		{
+			const std::array<uint32_t, 3>& tri = m_triangles[triIdx];
+			const int longest = LongestEdge(triIdx);
+
+			const uint32_t weldA = m_weld[tri[longest]];
+			const uint32_t weldB = m_weld[tri[(longest + 1) % 3]];
+
+			auto edgeIt = m_edges.find(EdgeKey(weldA, weldB));
+			if (edgeIt == m_edges.end() || m_triangles.size() + edgeIt->second.size() > maxTriangleCount)
+			{
+				return false;
+			}
+
+			// Moved out since the edge list changes while splitting
+			const std::vector<uint32_t> sharing = std::move(edgeIt->second);
+			m_edges.erase(edgeIt);
+
+			// Midpoints by the vertex pair they split, in the order the pairs are first seen
+			std::vector<std::pair<uint64_t, uint32_t>> midpoints;
+			for (const uint32_t sharedIdx : sharing)
+			{
+				uint32_t a;
+				uint32_t b;
+				if (!FindEdge(sharedIdx, weldA, weldB, a, b))
+				{
+					continue;
+				}
+
+				auto midpointIt = std::find_if(midpoints.begin(), midpoints.end(), [a, b](const std::pair<uint64_t, uint32_t>& midpoint)
+				{
+					return midpoint.first == EdgeKey(a, b);
+				});
+
+				if (midpointIt == midpoints.end())
+				{
+					const uint32_t m = vertexBase + static_cast<uint32_t>(newVertices.size());
+					newVertices.push_back({ a, b });
+					m_positions.push_back((m_positions[a] + m_positions[b]) * 0.5f);
+					m_weld.push_back(midpoints.empty() ? m : midpoints.front().second);
+					midpointIt = midpoints.insert(midpoints.end(), { EdgeKey(a, b), m });
+				}
+
+				SplitTriangle(sharedIdx, a, b, midpointIt->second, outTouched);
+			}
+
+			return true;
+		}
+
+		std::vector<std::array<uint32_t, 3>> m_triangles;
+		std::vector<uint32_t> m_sources;
+
+	private:
+		// Edges are keyed by the welded ends, so that seams do not separate them
+		void AddEdge(const uint32_t a, const uint32_t b, const uint32_t triIdx)
+		{
+			m_edges[EdgeKey(m_weld[a], m_weld[b])].push_back(triIdx);
+		}
+
+		void ReplaceEdgeOwner(const uint32_t a, const uint32_t b, const uint32_t oldTri, const uint32_t newTri)
+		{
+			std::vector<uint32_t>& owners = m_edges[EdgeKey(m_weld[a], m_weld[b])];
+			std::replace(owners.begin(), owners.end(), oldTri, newTri);
+		}
+
+		// The vertices of a triangle at the welded ends of an edge, in the order the triangle winds them
+		bool FindEdge(const uint32_t triIdx, const uint32_t weldA, const uint32_t weldB, uint32_t& outA, uint32_t& outB) const
+		{
+			const std::array<uint32_t, 3>& tri = m_triangles[triIdx];
+			for (int e = 0; e < 3; e++)
+			{
+				const uint32_t v0 = tri[e];
+				const uint32_t v1 = tri[(e + 1) % 3];
+				if ((m_weld[v0] == weldA && m_weld[v1] == weldB) || (m_weld[v0] == weldB && m_weld[v1] == weldA))
+				{
+					outA = v0;
+					outB = v1;
+					return true;
+				}
+			}
+
+			return false;
+		}
+
+		void SplitTriangle(const uint32_t triIdx, const uint32_t a, const uint32_t b, const uint32_t m, std::vector<uint32_t>& outTouched)
+		{
+			// Rotate so that the split edge comes first, in whichever direction this triangle winds it
+			std::array<uint32_t, 3> tri = m_triangles[triIdx];
+			for (int e = 0; e < 3 && !((tri[0] == a && tri[1] == b) || (tri[0] == b && tri[1] == a)); e++)
+			{
+				std::rotate(tri.begin(), tri.begin() + 1, tri.end());
+			}
+
+			if (!((tri[0] == a && tri[1] == b) || (tri[0] == b && tri[1] == a)))
+			{
+				return;
+			}
+
+			const uint32_t v0 = tri[0];
+			const uint32_t v1 = tri[1];
+			const uint32_t v2 = tri[2];
+			const uint32_t newIdx = static_cast<uint32_t>(m_triangles.size());
+
+			// (v0, v1, v2) becomes (v0, m, v2) and (m, v1, v2)
+			m_triangles[triIdx] = { v0, m, v2 };
+			m_triangles.push_back({ m, v1, v2 });
+			m_sources.push_back(m_sources[triIdx]);
+			m_versions[triIdx]++;
+			m_versions.push_back(0);
+
+			ReplaceEdgeOwner(v1, v2, triIdx, newIdx);
+			AddEdge(v0, m, triIdx);
+			AddEdge(m, v2, triIdx);
+			AddEdge(m, v1, newIdx);
+			AddEdge(m, v2, newIdx);
+
+			outTouched.push_back(triIdx);
+			outTouched.push_back(newIdx);
+		}
+
+		std::vector<uint32_t> m_versions;	// bumped whenever a triangle changes, to tell stale queue entries apart
+		std::vector<Vec3> m_positions;
+		std::vector<uint32_t> m_weld;		// per vertex, including the ones created by splits
+		std::unordered_map<uint64_t, std::vector<uint32_t>> m_edges;
+	};
+}
+
+TriangleSplitResult SplitOversizedTriangles(
+	const std::vector<Vec3>& positions, 
+	const std::vector<uint32_t>& indices, 
+	const TriangleSplitSettings& settings)
+{
+	TriangleSplitResult result;
+	SplitMesh mesh(positions, indices);
+
+	const size_t inputTriangleCount = mesh.m_triangles.size();
+	const size_t maxTriangleCount = inputTriangleCount + static_cast<size_t>(settings.triangleBudget * inputTriangleCount);
+
+	// Triangles are queued again whenever they change, which leaves stale entries behind
+	std::priority_queue<Candidate> queue;
+	auto consider = [&](const uint32_t triIdx)
+	{
+		const float area = mesh.Area(triIdx);
+		if (area > 0.f && mesh.BoundsArea(triIdx) > settings.minBoundsToAreaRatio * area)
+		{
+			queue.push({ mesh.SplitBenefit(triIdx), triIdx, mesh.GetVersion(triIdx) });
+		}
+	};
+
+	for (uint32_t triIdx = 0; triIdx < inputTriangleCount; triIdx++)
+	{
+		consider(triIdx);
+	}
+
+	std::vector<uint32_t> touched;
+	while (!queue.empty() && mesh.m_triangles.size() < maxTriangleCount)
+	{
+		const Candidate candidate = queue.top();
+		queue.pop();
+
+		if (mesh.GetVersion(candidate.triangle) != candidate.version)
+		{
+			continue;
+		}
+
+		touched.clear();
+		if (!mesh.SplitLongestEdge(candidate.triangle, result.newVertices, static_cast<uint32_t>(positions.size()), maxTriangleCount, touched))
+		{
+			continue;
+		}
+
+		for (const uint32_t triIdx : touched)
+		{
+			consider(triIdx);
+		}
+	}
+
+	// Keep the pieces of each input triangle where it was
+	std::vector<uint32_t> order(mesh.m_triangles.size());
+	std::iota(order.begin(), order.end(), 0);
+	std::stable_sort(order.begin(), order.end(), [&mesh](const uint32_t a, const uint32_t b)
+	{
+		return mesh.m_sources[a] < mesh.m_sources[b];
+	});
+
+	result.indices.reserve(3 * order.size());
+	result.sourceTriangles.reserve(order.size());
+	for (const uint32_t triIdx : order)
+	{
+		result.indices.insert(result.indices.end(), mesh.m_triangles[triIdx].begin(), mesh.m_triangles[triIdx].end());
+		result.sourceTriangles.push_back(mesh.m_sources[triIdx]);
+	}
+
+	return result;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "CpuMath.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct TriangleSplitSettings
+{
+	float minBoundsToAreaRatio = 8.f;	// surface area of a triangle's box over the triangle's area, 4 for an axis aligned right triangle
+	float triangleBudget = 0.25f;		// extra triangles allowed, relative to the input count
+};
+
+// A vertex created by a split, halfway along the edge between two earlier vertices. Either of them may itself have
+// been created by a split, but always one that comes earlier in the list. A split across a seam creates one vertex
+// per side, at the same position.
+struct SplitVertex
+{
+	uint32_t a;
+	uint32_t b;
+};
+
+struct TriangleSplitResult
+{
+	// Indices at or past the original vertex count refer to newVertices
+	std::vector<SplitVertex> newVertices;
+	std::vector<uint32_t> indices;
+	std::vector<uint32_t> sourceTriangles;	// per output triangle, sorted, so that ranges of the input stay contiguous
+};
+
+// Repeatedly bisects the longest edge of a triangle whose box is large compared to its area, picking the one whose
+// split shrinks the summed box area the most, until none are left or the budget runs out. Long thin triangles that
+// run diagonally to the axes then no longer bloat the BVH nodes they end up in. Every other triangle with an edge at
+// the same positions is split along with it, including ones across a uv or normal seam that have their own vertices
+// there, so that the mesh stays free of T-junctions. Deterministic for a given input.
+TriangleSplitResult SplitOversizedTriangles(
+	const std::vector<Vec3>& positions, 
+	const std::vector<uint32_t>& indices, 
+	const TriangleSplitSettings& settings);
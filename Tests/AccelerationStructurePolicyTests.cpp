@@ -0,0 +1,95 @@
+#include "Test.h"
+
+#include "AccelerationStructurePolicy.h"
+
+#include <cstring>
+#include <vector>
+
+using namespace AccelerationStructureBuildFlags;
+
+TEST_CASE(AccelerationStructurePolicyClassifiesMeshes)
+{
+	AccelerationStructurePolicySettings settings;
+	settings.heroTriangleCount = 1000;
+
+	const std::vector<MeshBuildInfo> meshes =
+	{
+		{ 999, MeshMobility::Static },
+		{ 1000, MeshMobility::Static },
+		{ 50000, MeshMobility::Deforming },
+		{ 10, MeshMobility::Rebuilt },
+		{ 20, MeshMobility::Static }
+	};
+
+	const AccelerationStructurePolicyReport report = PlanBottomLevelBuilds(meshes, settings);
+	CHECK(report.meshPlans.size() == meshes.size());
+	CHECK(!report.overBudget);
+	CHECK(report.estimatedBytes == (999 + 1000 + 50000 + 10 + 20) * settings.estimatedBytesPerTriangle);
+
+	if (report.meshPlans.size() == meshes.size())
+	{
+		CHECK(report.meshPlans[0].meshClass == MeshClass::StaticBackground);
+		CHECK(report.meshPlans[0].buildFlags == (AllowCompaction | PreferFastTrace));
+		CHECK(report.meshPlans[1].meshClass == MeshClass::StaticHero);
+		CHECK(report.meshPlans[1].buildFlags == (AllowCompaction | PreferFastTrace));
+		CHECK(report.meshPlans[2].meshClass == MeshClass::Deformable);
+		CHECK(report.meshPlans[2].buildFlags == (AllowUpdate | PreferFastBuild));
+		CHECK(report.meshPlans[3].meshClass == MeshClass::FrequentlyRebuilt);
+		CHECK(report.meshPlans[3].buildFlags == PreferFastBuild);
+	}
+
+	CHECK(report.classCounts[static_cast<size_t>(MeshClass::StaticHero)] == 1);
+	CHECK(report.classCounts[static_cast<size_t>(MeshClass::StaticBackground)] == 2);
+	CHECK(report.classCounts[static_cast<size_t>(MeshClass::Deformable)] == 1);
+	CHECK(report.classCounts[static_cast<size_t>(MeshClass::FrequentlyRebuilt)] == 1);
+}
+
+TEST_CASE(AccelerationStructurePolicyOverBudget)
+{
+	AccelerationStructurePolicySettings settings;
+	settings.heroTriangleCount = 1000;
+	settings.estimatedBytesPerTriangle = 100;
+
+	const std::vector<MeshBuildInfo> meshes =
+	{
+		{ 2000, MeshMobility::Static },
+		{ 500, MeshMobility::Static },
+		{ 500, MeshMobility::Deforming },
+		{ 500, MeshMobility::Rebuilt }
+	};
+
+	// Exactly at the budget is still within it
+	settings.memoryBudget = 350000;
+	CHECK(!PlanBottomLevelBuilds(meshes, settings).overBudget);
+
+	settings.memoryBudget = 349999;
+	const AccelerationStructurePolicyReport report = PlanBottomLevelBuilds(meshes, settings);
+	CHECK(report.overBudget);
+
+	// Heroes keep tracing fast, everything else that is kept around gives up memory
+	if (report.meshPlans.size() == meshes.size())
+	{
+		CHECK(report.meshPlans[0].buildFlags == (AllowCompaction | PreferFastTrace));
+		CHECK(report.meshPlans[1].buildFlags == (AllowCompaction | MinimizeMemory));
+		CHECK(report.meshPlans[2].buildFlags == (AllowUpdate | PreferFastBuild | MinimizeMemory));
+		CHECK(report.meshPlans[3].buildFlags == PreferFastBuild);
+	}
+}
+
+TEST_CASE(AccelerationStructurePolicyTopLevel)
+{
+	AccelerationStructurePolicySettings settings;
+	settings.fastBuildInstanceCount = 100;
+
+	CHECK(PlanTopLevelBuild(100, false, settings) == PreferFastTrace);
+	CHECK(PlanTopLevelBuild(101, false, settings) == PreferFastBuild);
+	CHECK(PlanTopLevelBuild(1, true, settings) == (PreferFastTrace | AllowUpdate));
+	CHECK(PlanTopLevelBuild(1000, true, settings) == (PreferFastBuild | AllowUpdate));
+}
+
+TEST_CASE(AccelerationStructurePolicyClassNames)
+{
+	CHECK(std::strcmp(GetMeshClassName(MeshClass::StaticHero), "static hero") == 0);
+	CHECK(std::strcmp(GetMeshClassName(MeshClass::FrequentlyRebuilt), "frequently rebuilt") == 0);
+	CHECK(std::strcmp(GetMeshClassName(MeshClass::Count), "unknown") == 0);
+}
@@ -0,0 +1,323 @@
+#include "Test.h"
+
+#include "AlphaClip.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+	constexpr uint8_t k_alphaCutoff = 128;
+
+	// 32x32 mask with an opaque disc and a few opaque specks around it
+	OpacityMask MakeDiscMask()
+	{
+		std::mt19937 rng(23);
+		OpacityMask mask;
+		mask.width = 32;
+		mask.height = 32;
+		for (uint32_t y = 0; y < mask.height; y++)
+		{
+			for (uint32_t x = 0; x < mask.width; x++)
+			{
+				const float dx = x + 0.5f - 12.f;
+				const float dy = y + 0.5f - 14.f;
+				const bool bOpaque = dx * dx + dy * dy < 36.f || rng() % 97 == 0;
+				mask.texels.push_back(bOpaque ? 200 : static_cast<uint8_t>(rng() % k_alphaCutoff));
+			}
+		}
+
+		return mask;
+	}
+
+	// Affine, so that areas in position space are a fixed multiple of those in uv space
+	Vec3 PositionFromUv(const Vec2& uv)
+	{
+		return { 2.f * uv.x + 0.5f * uv.y, 3.f * uv.y, uv.x - uv.y };
+	}
+
+	double TriangleArea(const Vec3& a, const Vec3& b, const Vec3& c)
+	{
+		return 0.5 * Length(Cross(b - a, c - a));
+	}
+
+	float Cross2(const Vec2& o, const Vec2& a, const Vec2& b)
+	{
+		return (a.x - o.x) * (b.y - o.y) - (a.y - o.y) * (b.x - o.x);
+	}
+
+	// Whether a bilinear sample at p, in texel space, reads a texel that passes the alpha test
+	bool CanPassAlphaTest(const OpacityMask& mask, const Vec2& p)
+	{
+		const int64_t x = static_cast<int64_t>(std::floor(p.x - 0.5f));
+		const int64_t y = static_cast<int64_t>(std::floor(p.y - 0.5f));
+		return mask.Fetch(x, y) >= k_alphaCutoff || mask.Fetch(x + 1, y) >= k_alphaCutoff ||
+			mask.Fetch(x, y + 1) >= k_alphaCutoff || mask.Fetch(x + 1, y + 1) >= k_alphaCutoff;
+	}
+
+	bool IsInsideTriangle(const Vec2 tri[3], const Vec2& p, const float tolerance)
+	{
+		const float area = Cross2(tri[0], tri[1], tri[2]);
+		if (area == 0.f)
+		{
+			return false;
+		}
+
+		for (int edge = 0; edge < 3; edge++)
+		{
+			if (Cross2(tri[edge], tri[(edge + 1) % 3], p) / area < -tolerance)
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	struct ClipTestMesh
+	{
+		std::vector<Vec2> uvs;
+		std::vector<Vec3> positions;
+		std::vector<uint32_t> indices;
+		size_t alphaTestedTriangleCount;
+	};
+
+	// Random triangles of either winding over the mask, followed by a few opaque ones that are not to be touched
+	ClipTestMesh MakeClipTestMesh()
+	{
+		std::mt19937 rng(29);
+		std::uniform_real_distribution<float> corner(0.f, 0.8f), extent(0.05f, 0.5f);
+
+		ClipTestMesh mesh;
+		for (uint32_t triIdx = 0; triIdx < 240; triIdx++)
+		{
+			const Vec2 origin = { corner(rng), corner(rng) };
+			for (int vertex = 0; vertex < 3; vertex++)
+			{
+				const Vec2 uv = { origin.x + extent(rng), origin.y + extent(rng) };
+				mesh.indices.push_back(static_cast<uint32_t>(mesh.uvs.size()));
+				mesh.uvs.push_back(uv);
+				mesh.positions.push_back(PositionFromUv(uv));
+			}
+		}
+
+		mesh.alphaTestedTriangleCount = 200;
+		return mesh;
+	}
+
+	// The triangles each alpha tested triangle became, in uv space
+	struct ClippedTriangle
+	{
+		bool bKept = false;
+		std::vector<std::array<Vec2, 3>> pieces;
+	};
+
+	std::vector<ClippedTriangle> GatherClippedTriangles(const ClipTestMesh& mesh, const AlphaClipResult& result, bool& outOrdered)
+	{
+		const uint32_t vertexCount = static_cast<uint32_t>(mesh.uvs.size());
+		auto uvOf = [&](const uint32_t index)
+		{
+			if (index < vertexCount)
+			{
+				return mesh.uvs[index];
+			}
+
+			const AlphaClipVertex& clipVertex = result.newVertices[index - vertexCount];
+			const Vec2& uv0 = mesh.uvs[mesh.indices[3 * clipVertex.sourceTriangle]];
+			const Vec2& uv1 = mesh.uvs[mesh.indices[3 * clipVertex.sourceTriangle + 1]];
+			const Vec2& uv2 = mesh.uvs[mesh.indices[3 * clipVertex.sourceTriangle + 2]];
+			const Vec3& w = clipVertex.barycentrics;
+			return Vec2{ w.x * uv0.x + w.y * uv1.x + w.z * uv2.x, w.x * uv0.y + w.y * uv1.y + w.z * uv2.y };
+		};
+
+		// Each source triangle is either kept as it is or replaced by a fan over new vertices, in source order
+		outOrdered = true;
+		std::vector<ClippedTriangle> triangles(mesh.alphaTestedTriangleCount);
+		size_t outIdx = 0;
+		const size_t outCount = result.alphaTestedIndices.size() / 3;
+		for (size_t srcIdx = 0; srcIdx < mesh.alphaTestedTriangleCount && outOrdered; srcIdx++)
+		{
+			const uint32_t* out = &result.alphaTestedIndices[3 * outIdx];
+			if (outIdx < outCount && out[0] < vertexCount)
+			{
+				outOrdered = out[0] == mesh.indices[3 * srcIdx] && out[1] == mesh.indices[3 * srcIdx + 1] && out[2] == mesh.indices[3 * srcIdx + 2];
+				triangles[srcIdx].bKept = true;
+				triangles[srcIdx].pieces.push_back({ uvOf(out[0]), uvOf(out[1]), uvOf(out[2]) });
+				outIdx++;
+				continue;
+			}
+
+			while (outIdx < outCount && result.alphaTestedIndices[3 * outIdx] >= vertexCount &&
+				result.newVertices[result.alphaTestedIndices[3 * outIdx] - vertexCount].sourceTriangle == srcIdx)
+			{
+				out = &result.alphaTestedIndices[3 * outIdx];
+				triangles[srcIdx].pieces.push_back({ uvOf(out[0]), uvOf(out[1]), uvOf(out[2]) });
+				outIdx++;
+			}
+
+			outOrdered = !triangles[srcIdx].pieces.empty();
+		}
+
+		outOrdered = outOrdered && outIdx == outCount;
+		return triangles;
+	}
+
+	double UvArea(const std::array<Vec2, 3>& tri)
+	{
+		return 0.5 * Cross2(tri[0], tri[1], tri[2]);
+	}
+}
+
+TEST_CASE(AlphaClipCoversOpaqueTexels)
+{
+	const OpacityMask mask = MakeDiscMask();
+	const ClipTestMesh mesh = MakeClipTestMesh();
+
+	AlphaClipSettings settings;
+	settings.alphaCutoff = k_alphaCutoff;
+	settings.maxHullVertices = 6;
+	settings.minAreaReduction = 0.25f;
+	const AlphaClipResult result = ClipAlphaTestedTriangles(mask, mesh.uvs, mesh.positions, mesh.indices, mesh.alphaTestedTriangleCount, settings);
+	CHECK(result.clippedTriangleCount > 20);
+	CHECK(result.clippedTriangleCount < mesh.alphaTestedTriangleCount);
+
+	bool bOrdered;
+	const std::vector<ClippedTriangle> clipped = GatherClippedTriangles(mesh, result, bOrdered);
+	CHECK(bOrdered);
+	if (!bOrdered)
+	{
+		return;
+	}
+
+	size_t uncoveredCount = 0;
+	size_t windingErrorCount = 0;
+	for (size_t srcIdx = 0; srcIdx < mesh.alphaTestedTriangleCount; srcIdx++)
+	{
+		const Vec2 source[3] = { mesh.uvs[mesh.indices[3 * srcIdx]], mesh.uvs[mesh.indices[3 * srcIdx + 1]], mesh.uvs[mesh.indices[3 * srcIdx + 2]] };
+		const Vec2 sourceTexels[3] = {
+			{ source[0].x * mask.width, source[0].y * mask.height },
+			{ source[1].x * mask.width, source[1].y * mask.height },
+			{ source[2].x * mask.width, source[2].y * mask.height } };
+
+		for (const std::array<Vec2, 3>& tri : clipped[srcIdx].pieces)
+		{
+			windingErrorCount += (UvArea(tri) > 0.0) != (Cross2(source[0], source[1], source[2]) > 0.f);
+		}
+
+		// Every point of the source triangle where the alpha test can pass is covered by one of its pieces
+		const float minX = (std::min)({ sourceTexels[0].x, sourceTexels[1].x, sourceTexels[2].x });
+		const float maxX = (std::max)({ sourceTexels[0].x, sourceTexels[1].x, sourceTexels[2].x });
+		const float minY = (std::min)({ sourceTexels[0].y, sourceTexels[1].y, sourceTexels[2].y });
+		const float maxY = (std::max)({ sourceTexels[0].y, sourceTexels[1].y, sourceTexels[2].y });
+		for (float y = std::floor(minY) + 0.125f; y < maxY; y += 0.25f)
+		{
+			for (float x = std::floor(minX) + 0.125f; x < maxX; x += 0.25f)
+			{
+				const Vec2 p = { x, y };
+				if (!IsInsideTriangle(sourceTexels, p, -1e-3f) || !CanPassAlphaTest(mask, p))
+				{
+					continue;
+				}
+
+				bool bCovered = false;
+				for (const std::array<Vec2, 3>& tri : clipped[srcIdx].pieces)
+				{
+					const Vec2 triTexels[3] = {
+						{ tri[0].x * mask.width, tri[0].y * mask.height },
+						{ tri[1].x * mask.width, tri[1].y * mask.height },
+						{ tri[2].x * mask.width, tri[2].y * mask.height } };
+					bCovered |= IsInsideTriangle(triTexels, p, 1e-4f);
+				}
+
+				uncoveredCount += !bCovered;
+			}
+		}
+	}
+
+	CHECK(uncoveredCount == 0);
+	CHECK(windingErrorCount == 0);
+}
+
+TEST_CASE(AlphaClipRespectsSettings)
+{
+	const OpacityMask mask = MakeDiscMask();
+	const ClipTestMesh mesh = MakeClipTestMesh();
+
+	for (const uint32_t maxHullVertices : { 3u, 4u, 8u })
+	{
+		for (const float minAreaReduction : { 0.f, 0.25f, 0.6f })
+		{
+			AlphaClipSettings settings;
+			settings.alphaCutoff = k_alphaCutoff;
+			settings.maxHullVertices = maxHullVertices;
+			settings.minAreaReduction = minAreaReduction;
+			const AlphaClipResult result = ClipAlphaTestedTriangles(mask, mesh.uvs, mesh.positions, mesh.indices, mesh.alphaTestedTriangleCount, settings);
+
+			bool bOrdered;
+			const std::vector<ClippedTriangle> clipped = GatherClippedTriangles(mesh, result, bOrdered);
+			CHECK(bOrdered);
+			if (!bOrdered)
+			{
+				continue;
+			}
+
+			double areaBefore = 0.0;
+			double areaAfter = 0.0;
+			size_t clippedCount = 0;
+			size_t boundErrorCount = 0;
+			for (size_t srcIdx = 0; srcIdx < mesh.alphaTestedTriangleCount; srcIdx++)
+			{
+				const uint32_t* source = &mesh.indices[3 * srcIdx];
+				const double sourceArea = TriangleArea(mesh.positions[source[0]], mesh.positions[source[1]], mesh.positions[source[2]]);
+				areaBefore += sourceArea;
+
+				double pieceArea = 0.0;
+				for (const std::array<Vec2, 3>& tri : clipped[srcIdx].pieces)
+				{
+					pieceArea += TriangleArea(PositionFromUv(tri[0]), PositionFromUv(tri[1]), PositionFromUv(tri[2]));
+				}
+
+				areaAfter += pieceArea;
+
+				if (clipped[srcIdx].bKept)
+				{
+					continue;
+				}
+
+				// A fan over at most maxHullVertices + 3 vertices, that shrank by at least minAreaReduction
+				clippedCount++;
+				boundErrorCount += clipped[srcIdx].pieces.size() > maxHullVertices + 1;
+				boundErrorCount += pieceArea > (1.0 - minAreaReduction) * sourceArea * (1.0 + 1e-4);
+			}
+
+			CHECK(clippedCount == result.clippedTriangleCount);
+			CHECK(result.clippedTriangleCount > 0);
+			CHECK(boundErrorCount == 0);
+			CHECK(std::abs(result.areaBefore - areaBefore) <= 1e-6 * areaBefore);
+			CHECK(std::abs(result.areaAfter - areaAfter) <= 1e-4 * areaBefore);
+			CHECK(result.areaAfter < result.areaBefore);
+		}
+	}
+}
+
+TEST_CASE(AlphaClipLeavesTrianglesWithoutGain)
+{
+	const ClipTestMesh mesh = MakeClipTestMesh();
+
+	// Nothing can shrink by all of its area, and nothing can be clipped without a mask
+	AlphaClipSettings settings;
+	settings.alphaCutoff = k_alphaCutoff;
+	settings.minAreaReduction = 1.f;
+	for (const OpacityMask& mask : { MakeDiscMask(), OpacityMask{} })
+	{
+		const AlphaClipResult result = ClipAlphaTestedTriangles(mask, mesh.uvs, mesh.positions, mesh.indices, mesh.alphaTestedTriangleCount, settings);
+		CHECK(result.clippedTriangleCount == 0);
+		CHECK(result.newVertices.empty());
+		CHECK(result.alphaTestedIndices == std::vector<uint32_t>(mesh.indices.begin(), mesh.indices.begin() + 3 * mesh.alphaTestedTriangleCount));
+		CHECK(result.areaAfter == result.areaBefore);
+		settings.minAreaReduction = 0.f;
+	}
+}
@@ -0,0 +1,99 @@
+#include "Test.h"
+
+#include "BlasBuildBatch.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+TEST_CASE(BlasBuildBatchFirstFitDecreasing)
+{
+	// Aligned to 512, 768, 512 and 256 bytes
+	const std::vector<uint64_t> scratchSizes = { 300, 700, 500, 200 };
+	const BlasBuildBatchPlan plan = PlanBlasBuildBatches(scratchSizes, 1000, 256);
+
+	CHECK(plan.batches.size() == 3);
+	CHECK(plan.arenaSize == 768);
+
+	if (plan.batches.size() == 3)
+	{
+		CHECK(plan.batches[0].builds.size() == 1);
+		CHECK(plan.batches[0].builds[0].buildIndex == 1);
+		CHECK(plan.batches[0].scratchUsed == 768);
+
+		// The smallest build does not fit next to the largest one, so it fills the gap in the second batch
+		CHECK(plan.batches[1].builds.size() == 2);
+		CHECK(plan.batches[1].builds[0].buildIndex == 2);
+		CHECK(plan.batches[1].builds[0].scratchOffset == 0);
+		CHECK(plan.batches[1].builds[1].buildIndex == 3);
+		CHECK(plan.batches[1].builds[1].scratchOffset == 512);
+
+		CHECK(plan.batches[2].builds.size() == 1);
+		CHECK(plan.batches[2].builds[0].buildIndex == 0);
+	}
+}
+
+TEST_CASE(BlasBuildBatchOversizedBuildGrowsArena)
+{
+	const std::vector<uint64_t> scratchSizes = { 100, 5000, 4000 };
+	const BlasBuildBatchPlan plan = PlanBlasBuildBatches(scratchSizes, 1000, 256);
+
+	// The arena grows to the 5120 bytes of the largest build, which then leaves room for two others in one batch
+	CHECK(plan.batches.size() == 2);
+	CHECK(plan.arenaSize == 5120);
+
+	if (plan.batches.size() == 2 && plan.batches[1].builds.size() == 2)
+	{
+		CHECK(plan.batches[0].builds[0].buildIndex == 1);
+		CHECK(plan.batches[1].builds[0].buildIndex == 2);
+		CHECK(plan.batches[1].builds[1].buildIndex == 0);
+		CHECK(plan.batches[1].builds[1].scratchOffset == 4096);
+	}
+}
+
+TEST_CASE(BlasBuildBatchEmpty)
+{
+	const BlasBuildBatchPlan plan = PlanBlasBuildBatches({}, 1000, 256);
+	CHECK(plan.batches.empty());
+	CHECK(plan.arenaSize == 0);
+}
+
+TEST_CASE(BlasBuildBatchScratchRangesAreDisjoint)
+{
+	constexpr uint64_t k_capacity = 1 << 20;
+	constexpr uint64_t k_alignment = 256;
+
+	std::mt19937 rng(26);
+	std::uniform_int_distribution<uint64_t> sizeDist(1, k_capacity / 3);
+
+	for (int iteration = 0; iteration < 100; iteration++)
+	{
+		std::vector<uint64_t> scratchSizes(1 + rng() % 64);
+		for (uint64_t& size : scratchSizes)
+		{
+			size = sizeDist(rng);
+		}
+
+		const BlasBuildBatchPlan plan = PlanBlasBuildBatches(scratchSizes, k_capacity, k_alignment);
+		CHECK(plan.arenaSize <= k_capacity);
+
+		std::vector<int> buildCounts(scratchSizes.size(), 0);
+		for (const BlasBuildBatch& batch : plan.batches)
+		{
+			CHECK(batch.scratchUsed <= plan.arenaSize);
+
+			// Builds are placed back to back in the order they were added
+			uint64_t end = 0;
+			for (const BlasBuildSlot& slot : batch.builds)
+			{
+				CHECK(slot.scratchOffset % k_alignment == 0);
+				CHECK(slot.scratchOffset >= end);
+				end = slot.scratchOffset + scratchSizes[slot.buildIndex];
+				CHECK(end <= batch.scratchUsed);
+				buildCounts[slot.buildIndex]++;
+			}
+		}
+
+		CHECK(std::all_of(buildCounts.begin(), buildCounts.end(), [](const int count) { return count == 1; }));
+	}
+}
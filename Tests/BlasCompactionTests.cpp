@@ -0,0 +1,59 @@
+#include "Test.h"
+
+#include "BlasCompaction.h"
+#include "HeapAllocator.h"
+
+#include <vector>
+
+TEST_CASE(BlasCompactionPlansBiggestSavingsFirst)
+{
+	constexpr size_t k_alignment = 65536;
+	constexpr size_t k_blasSize = 3 * k_alignment;
+
+	HeapAllocator allocator;
+	allocator.Init(16 * k_alignment);
+
+	std::vector<BlasCompactionEntry> entries;
+	const uint64_t compactedSizes[] = { 70000, 30000, 140000, 0 };
+	for (const uint64_t compactedSize : compactedSizes)
+	{
+		entries.push_back({ allocator.Allocate(k_blasSize, k_alignment), k_blasSize, compactedSize });
+	}
+
+	const BlasCompactionPlan plan = PlanBlasCompaction(entries, allocator, k_alignment);
+
+	// 140000 rounds up to the current size, and a size of zero was never written by the query
+	CHECK(plan.relocations.size() == 2);
+	CHECK(plan.bytesBefore == 4 * k_blasSize);
+	CHECK(plan.bytesAfter == k_alignment + 2 * k_alignment + 2 * k_blasSize);
+
+	if (plan.relocations.size() == 2)
+	{
+		CHECK(plan.relocations[0].entryIndex == 1);
+		CHECK(plan.relocations[0].newSize == k_alignment);
+		CHECK(plan.relocations[0].newOffset == 4 * k_blasSize);
+		CHECK(plan.relocations[1].entryIndex == 0);
+		CHECK(plan.relocations[1].newSize == 2 * k_alignment);
+		CHECK(plan.relocations[1].newOffset == 4 * k_blasSize + k_alignment);
+	}
+
+	// The original placements stay allocated until the caller frees them
+	CHECK(allocator.GetAllocatedSize() == 4 * k_blasSize + 3 * k_alignment);
+}
+
+TEST_CASE(BlasCompactionSkipsWhatDoesNotFit)
+{
+	constexpr size_t k_alignment = 256;
+
+	HeapAllocator allocator;
+	allocator.Init(4 * k_alignment);
+
+	// The heap is full, so no compacted placement can be reserved
+	std::vector<BlasCompactionEntry> entries;
+	entries.push_back({ allocator.Allocate(4 * k_alignment, k_alignment), 4 * k_alignment, k_alignment });
+
+	const BlasCompactionPlan plan = PlanBlasCompaction(entries, allocator, k_alignment);
+	CHECK(plan.relocations.empty());
+	CHECK(plan.bytesBefore == 4 * k_alignment);
+	CHECK(plan.bytesAfter == 4 * k_alignment);
+}
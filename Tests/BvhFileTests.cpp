@@ -0,0 +1,267 @@
+#include "Test.h"
+#include "TemporaryDirectory.h"
+#include "TestScene.h"
+
+#include "BvhFile.h"
+#include "CpuRaytracer.h"
+
+#include <cmath>
+#include <cstring>
+#include <filesystem>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr uint64_t k_testContentHash = 0x0123456789abcdefull;
+
+	// File with a few bytes in every section but the quantized nodes, which is left empty
+	std::unique_ptr<BvhFile> MakeTestFile(std::vector<uint8_t> (&outSections)[static_cast<size_t>(BvhFileSection::Count)])
+	{
+		const size_t sizes[] = { 3 * 64, 0, 100, 36, 12 };
+		static_assert(sizeof(sizes) / sizeof(sizes[0]) == static_cast<size_t>(BvhFileSection::Count), "one size per section");
+
+		const void* data[static_cast<size_t>(BvhFileSection::Count)];
+		for (size_t sectionIdx = 0; sectionIdx < static_cast<size_t>(BvhFileSection::Count); sectionIdx++)
+		{
+			outSections[sectionIdx].resize(sizes[sectionIdx]);
+			for (size_t byteIdx = 0; byteIdx < sizes[sectionIdx]; byteIdx++)
+			{
+				outSections[sectionIdx][byteIdx] = static_cast<uint8_t>(sectionIdx * 31 + byteIdx);
+			}
+
+			data[sectionIdx] = outSections[sectionIdx].data();
+		}
+
+		BvhFileHeader header = {};
+		header.contentHash = k_testContentHash;
+		header.bounds.lower = { -1.f, -2.f, -3.f };
+		header.bounds.upper = { 4.f, 5.f, 6.f };
+		header.sahCost = 12.5f;
+		header.bvh8SahCost = 7.25f;
+		header.referenceCount = 42;
+		return BvhFile::Create(header, data, sizes);
+	}
+
+	bool HasSections(const BvhFile& file, const std::vector<uint8_t> (&sections)[static_cast<size_t>(BvhFileSection::Count)])
+	{
+		for (size_t sectionIdx = 0; sectionIdx < static_cast<size_t>(BvhFileSection::Count); sectionIdx++)
+		{
+			const ArrayView<uint8_t> section = file.GetSection<uint8_t>(static_cast<BvhFileSection>(sectionIdx));
+			const BvhFileHeader::SectionRange& range = file.GetHeader().sections[sectionIdx];
+			if (range.offset % 64 != 0 || section.size() != sections[sectionIdx].size() ||
+				(!section.empty() && std::memcmp(section.data(), sections[sectionIdx].data(), section.size()) != 0))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	bool HasTestHeader(const BvhFile& file)
+	{
+		const BvhFileHeader& header = file.GetHeader();
+		return header.version == k_bvhFileVersion &&
+			header.contentHash == k_testContentHash &&
+			header.bounds.lower.x == -1.f && header.bounds.upper.z == 6.f &&
+			header.sahCost == 12.5f &&
+			header.bvh8SahCost == 7.25f &&
+			header.referenceCount == 42;
+	}
+
+	// Closest hits of the test view and of random segments, to compare tracers by
+	struct TraceResult
+	{
+		std::vector<Vec3> image;
+		std::vector<float> hitT;
+
+		bool operator==(const TraceResult& other) const
+		{
+			return std::memcmp(image.data(), other.image.data(), image.size() * sizeof(Vec3)) == 0 &&
+				std::memcmp(hitT.data(), other.hitT.data(), hitT.size() * sizeof(float)) == 0;
+		}
+	};
+
+	TraceResult Trace(const CpuRaytracer& raytracer)
+	{
+		std::mt19937 rng(9);
+		std::uniform_real_distribution<float> x(-16.f, 16.f), y(-12.f, 12.f), z(14.f, 46.f);
+
+		std::vector<StreamRay> rays;
+		while (rays.size() < 500)
+		{
+			const Vec3 from = { x(rng), y(rng), z(rng) };
+			const Vec3 to = { x(rng), y(rng), z(rng) };
+			const float length = Length(to - from);
+			if (length > 0.f)
+			{
+				rays.push_back({ from, (to - from) * (1.f / length), 0.f, length });
+			}
+		}
+
+		TraceResult result;
+		raytracer.Render(MakeSceneViewData({ 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, 0.8f, 1.5f), 48, 32, 2, result.image);
+		raytracer.TraceRayStream(rays, 2, result.hitT);
+		return result;
+	}
+}
+
+TEST_CASE(BvhFileLaysOutSections)
+{
+	std::vector<uint8_t> sections[static_cast<size_t>(BvhFileSection::Count)];
+	const std::unique_ptr<BvhFile> file = MakeTestFile(sections);
+
+	CHECK(!file->IsMapped());
+	CHECK(HasTestHeader(*file));
+	CHECK(HasSections(*file, sections));
+
+	const std::unique_ptr<BvhFile> clone = file->Clone();
+	CHECK(!clone->IsMapped());
+	CHECK(clone->GetHeader().fileSize == file->GetHeader().fileSize);
+	CHECK(HasTestHeader(*clone));
+	CHECK(HasSections(*clone, sections));
+}
+
+TEST_CASE(BvhFileRoundTrip)
+{
+	const TemporaryDirectory directory("BvhFileRoundTrip");
+	const std::string path = GetBvhFilePath(directory.GetPath(), k_testContentHash);
+
+	std::vector<uint8_t> sections[static_cast<size_t>(BvhFileSection::Count)];
+	CHECK(MakeTestFile(sections)->Write(path));
+
+	// Only the file itself is left behind
+	CHECK(directory.GetFiles().size() == 1);
+
+	const std::unique_ptr<BvhFile> mapped = BvhFile::Map(path, k_testContentHash);
+	CHECK(mapped && mapped->IsMapped());
+	if (mapped)
+	{
+		CHECK(HasTestHeader(*mapped));
+		CHECK(HasSections(*mapped, sections));
+
+		// A clone of a mapped file can be written to
+		const std::unique_ptr<BvhFile> clone = mapped->Clone();
+		CHECK(!clone->IsMapped());
+		clone->GetMutableSection<uint8_t>(BvhFileSection::Nodes)[0] = 0xFF;
+		CHECK(mapped->GetSection<uint8_t>(BvhFileSection::Nodes)[0] == sections[0][0]);
+	}
+
+	// Anything that does not match is left to be rebuilt
+	CHECK(!BvhFile::Map(path, k_testContentHash + 1));
+	CHECK(!BvhFile::Map(GetBvhFilePath(directory.GetPath(), k_testContentHash + 1), k_testContentHash + 1));
+
+	std::filesystem::resize_file(path, std::filesystem::file_size(path) - 1);
+	CHECK(!BvhFile::Map(path, k_testContentHash));
+
+	std::filesystem::resize_file(path, sizeof(BvhFileHeader) / 2);
+	CHECK(!BvhFile::Map(path, k_testContentHash));
+}
+
+TEST_CASE(BvhFileHashesContent)
+{
+	const std::vector<Vec3> positions = { { 0.f, 0.f, 0.f }, { 1.f, 0.f, 0.f }, { 0.f, 1.f, 0.f } };
+	const std::vector<Vec2> uvs = { { 0.f, 0.f }, { 1.f, 0.f }, { 0.f, 1.f } };
+	const std::vector<uint32_t> indices = { 0, 1, 2 };
+	const uint32_t settings = 1;
+
+	const uint64_t hash = HashBvhContent(positions, uvs, indices, &settings, sizeof(settings));
+	CHECK(hash == HashBvhContent(positions, uvs, indices, &settings, sizeof(settings)));
+
+	std::vector<Vec3> movedPositions = positions;
+	movedPositions[2].z = 1e-6f;
+	CHECK(hash != HashBvhContent(movedPositions, uvs, indices, &settings, sizeof(settings)));
+
+	std::vector<Vec2> movedUvs = uvs;
+	movedUvs[0].x = 0.5f;
+	CHECK(hash != HashBvhContent(positions, movedUvs, indices, &settings, sizeof(settings)));
+
+	const std::vector<uint32_t> flippedIndices = { 0, 2, 1 };
+	CHECK(hash != HashBvhContent(positions, uvs, flippedIndices, &settings, sizeof(settings)));
+
+	const uint32_t otherSettings = 2;
+	CHECK(hash != HashBvhContent(positions, uvs, indices, &otherSettings, sizeof(otherSettings)));
+
+	CHECK(GetBvhFilePath("cache", 0xabc) == "cache/0000000000000abc.bvh8");
+	CHECK(GetBvhFilePath("cache/", 0xabc) == "cache/0000000000000abc.bvh8");
+	CHECK(GetBvhFilePath("cache\\", 0xabc) == "cache\\0000000000000abc.bvh8");
+	CHECK(GetBvhFilePath("", 0xabc) == "0000000000000abc.bvh8");
+}
+
+TEST_CASE(CpuRaytracerMapsCachedBvhs)
+{
+	SceneData scene = MakeRandomTriangleScene(13, 30);
+	scene.meshes[2].bSpatialSplits = true;
+	const size_t meshCount = scene.meshes.size();
+
+	for (const bool bCompressedNodes : { false, true })
+	{
+		const TemporaryDirectory directory("CpuRaytracerMapsCachedBvhs");
+
+		CpuRaytracer built;
+		built.SetCompressedNodes(bCompressedNodes);
+		built.Init(scene, 2);
+		const TraceResult builtResult = Trace(built);
+
+		// The first Init with a cache builds and writes every mesh, the second maps them all
+		for (const size_t expectedCachedCount : { size_t(0), meshCount })
+		{
+			CpuRaytracer cached;
+			cached.SetCompressedNodes(bCompressedNodes);
+			cached.SetBvhCacheDirectory(directory.GetPath());
+			cached.Init(scene, 2);
+
+			CHECK(cached.GetStats().bvhCachedMeshCount == expectedCachedCount);
+			CHECK(cached.GetStats().bvhNodeCount == built.GetStats().bvhNodeCount);
+			CHECK(Trace(cached) == builtResult);
+		}
+
+		CHECK(directory.GetFiles().size() == meshCount);
+
+		// The other kind of node is built with other settings, so it does not map these files
+		{
+			CpuRaytracer other;
+			other.SetCompressedNodes(!bCompressedNodes);
+			other.SetBvhCacheDirectory(directory.GetPath());
+			other.Init(scene, 2);
+			CHECK(other.GetStats().bvhCachedMeshCount == 0);
+		}
+
+		// A moved vertex and a damaged file each cost one rebuild, unless the damaged file is that of the edited mesh
+		SceneData edited = scene;
+		edited.meshes[1].positions[0].x += 0.5f;
+
+		const std::filesystem::path damagedPath = directory.GetFiles()[0];
+		std::filesystem::resize_file(damagedPath, std::filesystem::file_size(damagedPath) / 2);
+
+		CpuRaytracer rebuilt;
+		rebuilt.SetCompressedNodes(bCompressedNodes);
+		rebuilt.SetBvhCacheDirectory(directory.GetPath());
+		rebuilt.Init(edited, 2);
+		CHECK(rebuilt.GetStats().bvhCachedMeshCount == meshCount - 2 || rebuilt.GetStats().bvhCachedMeshCount == meshCount - 1);
+
+		CpuRaytracer editedBuilt;
+		editedBuilt.SetCompressedNodes(bCompressedNodes);
+		editedBuilt.Init(edited, 2);
+		CHECK(Trace(rebuilt) == Trace(editedBuilt));
+
+		// Mapped BVHs are copied before they are refit, and refit the same as built ones
+		CpuRaytracer mapped;
+		mapped.SetCompressedNodes(bCompressedNodes);
+		mapped.SetBvhCacheDirectory(directory.GetPath());
+		mapped.Init(scene, 2);
+		CHECK(mapped.GetStats().bvhCachedMeshCount == meshCount);
+
+		SceneData deformed = scene;
+		for (Vec3& position : deformed.meshes[0].positions)
+		{
+			position.y += 0.1f * std::sin(position.x);
+		}
+
+		mapped.Update(deformed, { 0 }, 2);
+		built.Update(deformed, { 0 }, 2);
+		CHECK(Trace(mapped) == Trace(built));
+	}
+}
@@ -0,0 +1,270 @@
+#include "Test.h"
+
+#include "Bvh.h"
+#include "TaskScheduler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <utility>
+#include <vector>
+
+namespace
+{
+	bool Contains(const Aabb& outer, const Aabb& inner)
+	{
+		return outer.lower.x <= inner.lower.x && outer.lower.y <= inner.lower.y && outer.lower.z <= inner.lower.z &&
+			outer.upper.x >= inner.upper.x && outer.upper.y >= inner.upper.y && outer.upper.z >= inner.upper.z;
+	}
+
+	bool operator==(const Aabb& a, const Aabb& b)
+	{
+		return a.lower.x == b.lower.x && a.lower.y == b.lower.y && a.lower.z == b.lower.z &&
+			a.upper.x == b.upper.x && a.upper.y == b.upper.y && a.upper.z == b.upper.z;
+	}
+
+	// Boxes of random sizes scattered through a cube, with a tenth of them piled onto a few points so that some nodes
+	// have centroids that cannot be split
+	std::vector<Aabb> MakeRandomBoxes(const uint32_t seed, const uint32_t count)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> position(-100.f, 100.f);
+		std::uniform_real_distribution<float> size(0.01f, 2.f);
+		std::uniform_int_distribution<int> pile(0, 9);
+
+		std::vector<Aabb> boxes(count);
+		for (Aabb& box : boxes)
+		{
+			const int pileIdx = pile(rng);
+			const Vec3 center = pileIdx == 0 ?
+				Vec3{ 10.f * (rng() % 3), 0.f, 0.f } :
+				Vec3{ position(rng), position(rng), position(rng) };
+			const Vec3 halfSize = { size(rng), size(rng), size(rng) };
+			box.lower = center - halfSize;
+			box.upper = center + halfSize;
+		}
+
+		return boxes;
+	}
+
+	// Every node is reached once from the root, holds the bounds of its children or primitives, and every primitive is
+	// in exactly one leaf
+	bool IsValidBvh(const Bvh& bvh, const std::vector<Aabb>& primitiveBounds)
+	{
+		const std::vector<BvhNode>& nodes = bvh.GetNodes();
+		const std::vector<uint32_t>& primitiveIndices = bvh.GetPrimitiveIndices();
+		if (nodes.empty() || primitiveIndices.size() != primitiveBounds.size())
+		{
+			return false;
+		}
+
+		std::vector<uint32_t> primitiveRefs(primitiveBounds.size(), 0);
+		std::vector<uint32_t> stack = { 0 };
+		size_t visitedCount = 0;
+		while (!stack.empty())
+		{
+			const BvhNode& node = nodes[stack.back()];
+			stack.pop_back();
+			visitedCount++;
+
+			if (node.IsLeaf())
+			{
+				if (node.firstChildOrPrimitive + node.primitiveCount > primitiveIndices.size())
+				{
+					return false;
+				}
+
+				for (uint32_t i = node.firstChildOrPrimitive; i < node.firstChildOrPrimitive + node.primitiveCount; i++)
+				{
+					const uint32_t primitiveIdx = primitiveIndices[i];
+					if (primitiveIdx >= primitiveBounds.size() || !Contains(node.bounds, primitiveBounds[primitiveIdx]))
+					{
+						return false;
+					}
+
+					primitiveRefs[primitiveIdx]++;
+				}
+			}
+			else
+			{
+				for (uint32_t child = node.firstChildOrPrimitive; child < node.firstChildOrPrimitive + 2; child++)
+				{
+					if (child == 0 || child >= nodes.size() || !Contains(node.bounds, nodes[child].bounds))
+					{
+						return false;
+					}
+
+					stack.push_back(child);
+				}
+			}
+		}
+
+		return visitedCount == nodes.size() &&
+			std::all_of(primitiveRefs.begin(), primitiveRefs.end(), [](const uint32_t refs) { return refs == 1; });
+	}
+
+	// Same tree, whatever the order of its nodes and of the primitives within its leaves
+	bool HaveSameTree(const Bvh& a, const Bvh& b)
+	{
+		const std::vector<BvhNode>& nodesA = a.GetNodes();
+		const std::vector<BvhNode>& nodesB = b.GetNodes();
+		if (nodesA.size() != nodesB.size())
+		{
+			return false;
+		}
+
+		std::vector<std::pair<uint32_t, uint32_t>> stack = { { 0, 0 } };
+		while (!stack.empty())
+		{
+			const BvhNode& nodeA = nodesA[stack.back().first];
+			const BvhNode& nodeB = nodesB[stack.back().second];
+			stack.pop_back();
+
+			if (!(nodeA.bounds == nodeB.bounds) || nodeA.primitiveCount != nodeB.primitiveCount)
+			{
+				return false;
+			}
+
+			if (nodeA.IsLeaf())
+			{
+				auto gather = [](const Bvh& bvh, const BvhNode& node)
+				{
+					const uint32_t* first = &bvh.GetPrimitiveIndices()[node.firstChildOrPrimitive];
+					std::vector<uint32_t> primitives(first, first + node.primitiveCount);
+					std::sort(primitives.begin(), primitives.end());
+					return primitives;
+				};
+
+				if (gather(a, nodeA) != gather(b, nodeB))
+				{
+					return false;
+				}
+			}
+			else if (nodeA.firstChildOrPrimitive + 1 >= nodesA.size() || nodeB.firstChildOrPrimitive + 1 >= nodesB.size())
+			{
+				return false;
+			}
+			else
+			{
+				stack.push_back({ nodeA.firstChildOrPrimitive, nodeB.firstChildOrPrimitive });
+				stack.push_back({ nodeA.firstChildOrPrimitive + 1, nodeB.firstChildOrPrimitive + 1 });
+			}
+		}
+
+		return true;
+	}
+
+	bool HaveSameSahCost(const Bvh& a, const Bvh& b, const float traversalCost)
+	{
+		const float costA = a.ComputeSahCost(traversalCost);
+		const float costB = b.ComputeSahCost(traversalCost);
+		return std::abs(costA - costB) <= 1e-5f * costA;
+	}
+
+	// Morton code of the centroid of a box within the bounds of all centroids, as the linear builder quantizes them
+	uint64_t ComputeMortonCode(const Aabb& box, const Aabb& centroidBounds, const uint32_t bitsPerAxis)
+	{
+		const float cellCount = static_cast<float>(1u << bitsPerAxis);
+		const Vec3 offset = box.Center() - centroidBounds.lower;
+		const Vec3 extent = centroidBounds.Extent();
+		const float p[3] = { offset.x, offset.y, offset.z };
+		const float e[3] = { extent.x, extent.y, extent.z };
+
+		uint64_t code = 0;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float q = p[axis] * (e[axis] > 0.f ? cellCount / e[axis] : 0.f);
+			const uint64_t cell = q > 0.f ? static_cast<uint64_t>((std::min)(q, cellCount - 1.f)) : 0;
+			for (uint32_t bit = 0; bit < bitsPerAxis; bit++)
+			{
+				code |= ((cell >> bit) & 1) << (3 * bit + axis);
+			}
+		}
+
+		return code;
+	}
+
+	// Without treelet passes the leaves of a linear build hold the primitives in the order of a stable sort by their
+	// Morton codes
+	bool IsMortonOrdered(const Bvh& bvh, const std::vector<Aabb>& primitiveBounds, const uint32_t bitsPerAxis)
+	{
+		Aabb centroidBounds;
+		for (const Aabb& box : primitiveBounds)
+		{
+			centroidBounds.Grow(box.Center());
+		}
+
+		const std::vector<uint32_t>& primitiveIndices = bvh.GetPrimitiveIndices();
+		for (size_t i = 1; i < primitiveIndices.size(); i++)
+		{
+			const uint64_t previous = ComputeMortonCode(primitiveBounds[primitiveIndices[i - 1]], centroidBounds, bitsPerAxis);
+			const uint64_t current = ComputeMortonCode(primitiveBounds[primitiveIndices[i]], centroidBounds, bitsPerAxis);
+			if (previous > current || (previous == current && primitiveIndices[i - 1] > primitiveIndices[i]))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+// Large enough that the top of the tree is split serially and the subtrees are built on the scheduler and spliced in
+TEST_CASE(BvhBuildThreadCountAgnostic)
+{
+	TaskScheduler scheduler(4);
+
+	for (const uint32_t primitiveCount : { 20000u, 120000u })
+	{
+		const std::vector<Aabb> boxes = MakeRandomBoxes(primitiveCount, primitiveCount);
+
+		BvhBuildSettings settings;
+		Bvh serial;
+		serial.Build(boxes, settings);
+
+		settings.scheduler = &scheduler;
+		Bvh parallel;
+		parallel.Build(boxes, settings);
+
+		CHECK(IsValidBvh(serial, boxes));
+		CHECK(IsValidBvh(parallel, boxes));
+		CHECK(HaveSameTree(serial, parallel));
+		CHECK(HaveSameSahCost(serial, parallel, settings.traversalCost));
+	}
+}
+
+// Enough primitives for several radix sort blocks and for the flatten to split the tree into subtrees for the threads
+TEST_CASE(BvhBuildLinearThreadCountAgnostic)
+{
+	TaskScheduler scheduler(4);
+	const std::vector<Aabb> boxes = MakeRandomBoxes(7, 70000);
+
+	for (const bool bWideMortonCodes : { false, true })
+	{
+		float sahCost = 0.f;
+		for (const uint32_t treeletPassCount : { 0u, 3u })
+		{
+			BvhBuildSettings settings;
+			settings.builder = BvhBuilder::Linear;
+			settings.bWideMortonCodes = bWideMortonCodes;
+			settings.treeletPassCount = treeletPassCount;
+			Bvh serial;
+			serial.Build(boxes, settings);
+
+			settings.scheduler = &scheduler;
+			Bvh parallel;
+			parallel.Build(boxes, settings);
+
+			CHECK(IsValidBvh(serial, boxes));
+			CHECK(IsValidBvh(parallel, boxes));
+			CHECK(HaveSameTree(serial, parallel));
+			CHECK(HaveSameSahCost(serial, parallel, settings.traversalCost));
+			CHECK(treeletPassCount > 0 || IsMortonOrdered(parallel, boxes, bWideMortonCodes ? 21 : 10));
+
+			// Treelets are only reorganized where that lowers their cost
+			const float cost = serial.ComputeSahCost(settings.traversalCost);
+			CHECK(treeletPassCount == 0 || cost <= sahCost);
+			sahCost = cost;
+		}
+	}
+}
@@ -0,0 +1,262 @@
+#include "Test.h"
+#include "TestScene.h"
+
+#include "CpuRaytracer.h"
+
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace
+{
+	// Matches Raygen.hlsl and Miss.hlsl
+	constexpr float k_rayTMin = 0.1f;
+	constexpr float k_rayTMax = 1000.f;
+	const Vec3 k_missColor = { 0.2f, 0.2f, 0.2f };
+
+	constexpr uint32_t k_imageWidth = 48;
+	constexpr uint32_t k_imageHeight = 32;
+	constexpr uint32_t k_threadCount = 2;
+
+	SceneViewData MakeTestView()
+	{
+		return MakeSceneViewData({ 0.f, 0.f, 0.f }, { 0.f, 0.f, 1.f }, 0.25f * 3.14159265f, k_imageWidth / static_cast<float>(k_imageHeight));
+	}
+
+	// Segments between random points of the box the instances are placed in, some of which start inside meshes
+	std::vector<StreamRay> MakeSegmentRays(const uint32_t seed, const size_t count)
+	{
+		std::mt19937 rng(seed);
+		std::uniform_real_distribution<float> x(-16.f, 16.f), y(-12.f, 12.f), z(14.f, 46.f);
+
+		std::vector<StreamRay> rays;
+		while (rays.size() < count)
+		{
+			const Vec3 from = { x(rng), y(rng), z(rng) };
+			const Vec3 to = { x(rng), y(rng), z(rng) };
+			const float length = Length(to - from);
+			if (length > 0.f)
+			{
+				rays.push_back({ from, (to - from) * (1.f / length), 0.f, length });
+			}
+		}
+
+		return rays;
+	}
+
+	bool IsNear(const Vec3& a, const Vec3& b, const float tolerance)
+	{
+		return std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance && std::abs(a.z - b.z) <= tolerance;
+	}
+
+	// Closest hit of the primary ray of each pixel of the test view
+	std::vector<ReferenceHit> TraceReferencePrimaryRays(const std::vector<WorldTriangle>& triangles)
+	{
+		const SceneViewData view = MakeTestView();
+		const Vec3 origin = GetViewPosition(view);
+
+		std::vector<ReferenceHit> hits;
+		for (uint32_t y = 0; y < k_imageHeight; y++)
+		{
+			for (uint32_t x = 0; x < k_imageWidth; x++)
+			{
+				const Vec3 direction = MakePrimaryRayDirection(view, x, y, k_imageWidth, k_imageHeight);
+				hits.push_back(IntersectReference(triangles, origin, direction, k_rayTMin, k_rayTMax));
+			}
+		}
+
+		return hits;
+	}
+
+	std::vector<ReferenceHit> TraceReferenceRays(const std::vector<WorldTriangle>& triangles, const std::vector<StreamRay>& rays)
+	{
+		std::vector<ReferenceHit> hits;
+		for (const StreamRay& ray : rays)
+		{
+			hits.push_back(IntersectReference(triangles, ray.origin, ray.direction, ray.tMin, ray.tMax));
+		}
+
+		return hits;
+	}
+
+	// Number of pixels of the image whose color differs from the closest hit of the reference
+	size_t CountImageMismatches(const SceneData& scene, const std::vector<ReferenceHit>& referenceHits, const std::vector<Vec3>& image)
+	{
+		size_t mismatchCount = 0;
+		for (size_t pixel = 0; pixel < image.size(); pixel++)
+		{
+			const ReferenceHit& hit = referenceHits[pixel];
+			if (hit.bAmbiguous)
+			{
+				continue;
+			}
+
+			const Vec3 expected = hit.materialIndex < 0 ? k_missColor : scene.materials[hit.materialIndex].baseColor;
+			mismatchCount += !IsNear(image[pixel], expected, 1e-5f);
+		}
+
+		return mismatchCount;
+	}
+
+	// Number of rays whose closest hit, as CastRay and TraceRayStream find it, differs from the reference
+	size_t CountRayMismatches(const CpuRaytracer& raytracer, const std::vector<StreamRay>& rays, const std::vector<ReferenceHit>& referenceHits)
+	{
+		std::vector<float> streamHitT;
+		raytracer.TraceRayStream(rays, k_threadCount, streamHitT);
+
+		size_t mismatchCount = 0;
+		for (size_t rayIndex = 0; rayIndex < rays.size(); rayIndex++)
+		{
+			const StreamRay& ray = rays[rayIndex];
+
+			float hitT;
+			if (!raytracer.CastRay(ray.origin, ray.direction, ray.tMin, ray.tMax, hitT))
+			{
+				hitT = INFINITY;
+			}
+
+			// Both trace the same kernels, so they agree to the bit
+			mismatchCount += std::memcmp(&hitT, &streamHitT[rayIndex], sizeof(float)) != 0;
+
+			const ReferenceHit& hit = referenceHits[rayIndex];
+			if (hit.bAmbiguous)
+			{
+				continue;
+			}
+
+			if (hit.materialIndex < 0)
+			{
+				mismatchCount += !std::isinf(hitT);
+			}
+			else
+			{
+				// Relative to the size of the meshes, as moving the ray into object space rounds close hits too
+				mismatchCount += !(std::abs(hitT - hit.t) <= 1e-4 * (hit.t + 1.0));
+			}
+		}
+
+		return mismatchCount;
+	}
+
+	size_t CountTracedInstances(const SceneData& scene)
+	{
+		size_t count = 0;
+		for (size_t instanceIndex = 0; instanceIndex < scene.instances.size(); instanceIndex++)
+		{
+			count += instanceIndex != 13 && !scene.meshes[scene.instances[instanceIndex].meshIndex].indices.empty();
+		}
+
+		return count;
+	}
+
+	std::vector<SimdIsa> GetSupportedIsas()
+	{
+		std::vector<SimdIsa> isas;
+		for (const SimdIsa isa : { SimdIsa::Scalar, SimdIsa::Sse, SimdIsa::Avx2 })
+		{
+			if (IsSimdIsaSupported(isa))
+			{
+				isas.push_back(isa);
+			}
+		}
+
+		return isas;
+	}
+}
+
+TEST_CASE(CpuRaytracerMatchesBruteForce)
+{
+	for (const bool bSpatialSplits : { false, true })
+	{
+		SceneData scene = MakeRandomTriangleScene(7, 30);
+		for (SceneMeshData& mesh : scene.meshes)
+		{
+			mesh.bSpatialSplits = bSpatialSplits;
+		}
+
+		const std::vector<WorldTriangle> triangles = GatherWorldTriangles(scene);
+		const std::vector<ReferenceHit> referencePixels = TraceReferencePrimaryRays(triangles);
+		const std::vector<StreamRay> rays = MakeSegmentRays(3, 500);
+		const std::vector<ReferenceHit> referenceRays = TraceReferenceRays(triangles, rays);
+
+		for (const bool bCompressedNodes : { false, true })
+		{
+			for (const Bvh8NodeLayout layout : { Bvh8NodeLayout::Collapse, Bvh8NodeLayout::Clustered })
+			{
+				CpuRaytracer raytracer;
+				raytracer.SetCompressedNodes(bCompressedNodes);
+				raytracer.SetNodeLayout(layout);
+				raytracer.Init(scene, k_threadCount);
+
+				// The instances of the empty mesh and the zero scaled one are left out of the top level BVH
+				CHECK(raytracer.GetStats().instanceCount == CountTracedInstances(scene));
+
+				for (const SimdIsa isa : GetSupportedIsas())
+				{
+					raytracer.SetTraversalIsa(isa);
+
+					std::vector<Vec3> packetImage, singleImage;
+					raytracer.SetPacketTracing(true);
+					raytracer.Render(MakeTestView(), k_imageWidth, k_imageHeight, k_threadCount, packetImage);
+					raytracer.SetPacketTracing(false);
+					raytracer.Render(MakeTestView(), k_imageWidth, k_imageHeight, k_threadCount, singleImage);
+
+					CHECK(CountImageMismatches(scene, referencePixels, packetImage) == 0);
+					CHECK(std::memcmp(packetImage.data(), singleImage.data(), packetImage.size() * sizeof(Vec3)) == 0);
+					CHECK(CountRayMismatches(raytracer, rays, referenceRays) == 0);
+				}
+			}
+		}
+	}
+}
+
+TEST_CASE(CpuRaytracerUpdateMatchesBruteForce)
+{
+	const SceneData scene = MakeRandomTriangleScene(11, 30);
+	const std::vector<StreamRay> rays = MakeSegmentRays(5, 500);
+	const std::vector<uint32_t> deformedMeshes = { 0, 1, 2, 3 };
+
+	for (const bool bCompressedNodes : { false, true })
+	{
+		CpuRaytracer raytracer;
+		raytracer.SetCompressedNodes(bCompressedNodes);
+		raytracer.Init(scene, k_threadCount);
+
+		SceneData animated = scene;
+		size_t refitMeshCount = 0;
+		size_t rebuiltMeshCount = 0;
+		for (uint32_t frame = 1; frame <= 4; frame++)
+		{
+			for (size_t instanceIndex = 0; instanceIndex < animated.instances.size(); instanceIndex++)
+			{
+				animated.instances[instanceIndex].localToWorld[3][0] = scene.instances[instanceIndex].localToWorld[3][0] + 2.f * std::sin(frame + instanceIndex);
+			}
+
+			// Waves until the last frame, which scatters the vertices so far that refitting no longer pays off
+			const float scatter = frame == 4 ? 2.f : 0.f;
+			for (const uint32_t meshIndex : deformedMeshes)
+			{
+				const std::vector<Vec3>& positions = scene.meshes[meshIndex].positions;
+				for (size_t vertex = 0; vertex < positions.size(); vertex++)
+				{
+					const Vec3& p = positions[vertex];
+					animated.meshes[meshIndex].positions[vertex].y = p.y + 0.2f * frame * std::sin(p.x + p.z) + scatter * std::sin(p.x * 13.1f + p.z * 7.7f);
+				}
+			}
+
+			raytracer.Update(animated, deformedMeshes, k_threadCount);
+			refitMeshCount += raytracer.GetStats().refitMeshCount;
+			rebuiltMeshCount += raytracer.GetStats().rebuiltMeshCount;
+
+			const std::vector<WorldTriangle> triangles = GatherWorldTriangles(animated);
+			std::vector<Vec3> image;
+			raytracer.Render(MakeTestView(), k_imageWidth, k_imageHeight, k_threadCount, image);
+
+			CHECK(CountImageMismatches(animated, TraceReferencePrimaryRays(triangles), image) == 0);
+			CHECK(CountRayMismatches(raytracer, rays, TraceReferenceRays(triangles, rays)) == 0);
+		}
+
+		CHECK(refitMeshCount > 0);
+		CHECK(rebuiltMeshCount > 0);
+	}
+}
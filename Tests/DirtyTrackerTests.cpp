@@ -0,0 +1,77 @@
+#include "Test.h"
+
+#include "DirtyTracker.h"
+
+#include <algorithm>
+#include <vector>
+
+TEST_CASE(DirtyTrackerConsumesPerBuffer)
+{
+	DirtyTracker tracker;
+	tracker.Init(8, 3);
+	CHECK(!tracker.IsDirty(0));
+
+	tracker.MarkDirty(5);
+	tracker.MarkDirty(2);
+	tracker.MarkDirty(5);
+	CHECK(tracker.IsDirty(0) && tracker.IsDirty(1) && tracker.IsDirty(2));
+
+	// Each buffer sees every change once, and consuming one buffer leaves the others dirty
+	std::vector<size_t> items;
+	tracker.ConsumeDirty(1, items);
+	std::sort(items.begin(), items.end());
+	CHECK((items == std::vector<size_t>{ 2, 5 }));
+	CHECK(!tracker.IsDirty(1));
+	CHECK(tracker.IsDirty(0) && tracker.IsDirty(2));
+
+	items.clear();
+	tracker.ConsumeDirty(1, items);
+	CHECK(items.empty());
+
+	// A change after buffer 1 consumed shows up for it again, but only once for the others
+	tracker.MarkDirty(7);
+	items.clear();
+	tracker.ConsumeDirty(0, items);
+	std::sort(items.begin(), items.end());
+	CHECK((items == std::vector<size_t>{ 2, 5, 7 }));
+
+	items.clear();
+	tracker.ConsumeDirty(1, items);
+	CHECK((items == std::vector<size_t>{ 7 }));
+
+	items.clear();
+	tracker.ConsumeDirty(2, items);
+	std::sort(items.begin(), items.end());
+	CHECK((items == std::vector<size_t>{ 2, 5, 7 }));
+	CHECK(!tracker.IsDirty(0) && !tracker.IsDirty(1) && !tracker.IsDirty(2));
+}
+
+TEST_CASE(DirtyTrackerConsumeAppends)
+{
+	DirtyTracker tracker;
+	tracker.Init(4, 2);
+	tracker.MarkDirty(3);
+
+	std::vector<size_t> items = { 100 };
+	tracker.ConsumeDirty(0, items);
+	CHECK((items == std::vector<size_t>{ 100, 3 }));
+}
+
+TEST_CASE(DirtyTrackerMarkAllDirty)
+{
+	DirtyTracker tracker;
+	tracker.Init(5, DirtyTracker::k_maxBufferCount);
+	tracker.MarkDirty(1);
+	tracker.MarkAllDirty();
+
+	for (uint32_t bufferIndex = 0; bufferIndex < DirtyTracker::k_maxBufferCount; bufferIndex++)
+	{
+		std::vector<size_t> items;
+		tracker.ConsumeDirty(bufferIndex, items);
+		std::sort(items.begin(), items.end());
+		CHECK((items == std::vector<size_t>{ 0, 1, 2, 3, 4 }));
+	}
+
+	CHECK(!tracker.IsDirty(0));
+	CHECK(!tracker.IsDirty(DirtyTracker::k_maxBufferCount - 1));
+}
@@ -0,0 +1,86 @@
+#include "Test.h"
+
+#include "HeapAllocator.h"
+
+TEST_CASE(HeapAllocatorAlignsAndSplitsBlocks)
+{
+	HeapAllocator allocator;
+	allocator.Init(1000);
+
+	const size_t a = allocator.Allocate(100, 64);
+	const size_t b = allocator.Allocate(100, 64);
+	const size_t c = allocator.Allocate(300, 64);
+	CHECK(a == 0);
+	CHECK(b == 128);
+	CHECK(c == 256);
+	CHECK(allocator.GetAllocationSize(a) == 128);
+	CHECK(allocator.GetAllocationSize(c) == 320);
+	CHECK(allocator.GetAllocatedSize() == 576);
+	CHECK(allocator.GetLargestFreeBlock() == 424);
+	CHECK(allocator.GetTotalSize() == 1000);
+
+	// Nothing left that is big enough
+	CHECK(allocator.Allocate(500, 64) == HeapAllocator::k_invalidOffset);
+	CHECK(allocator.GetAllocatedSize() == 576);
+}
+
+TEST_CASE(HeapAllocatorCoalescesFreedNeighbours)
+{
+	HeapAllocator allocator;
+	allocator.Init(1024);
+
+	const size_t a = allocator.Allocate(256, 256);
+	const size_t b = allocator.Allocate(256, 256);
+	const size_t c = allocator.Allocate(256, 256);
+	CHECK(allocator.GetLargestFreeBlock() == 256);
+
+	// Freeing b then a merges them with each other, and c then merges them with the tail
+	CHECK(allocator.Free(b));
+	CHECK(allocator.GetLargestFreeBlock() == 256);
+	CHECK(allocator.Free(a));
+	CHECK(allocator.GetLargestFreeBlock() == 512);
+	CHECK(allocator.Free(c));
+	CHECK(allocator.GetLargestFreeBlock() == 1024);
+	CHECK(allocator.GetAllocatedSize() == 0);
+
+	// The whole range is usable again
+	CHECK(allocator.Allocate(1024, 256) == 0);
+}
+
+TEST_CASE(HeapAllocatorReusesAlignmentPadding)
+{
+	HeapAllocator allocator;
+	allocator.Init(1024);
+
+	const size_t small = allocator.Allocate(16, 16);
+	const size_t aligned = allocator.Allocate(256, 256);
+	CHECK(small == 0);
+	CHECK(aligned == 256);
+
+	// The padding in front of the aligned block was returned to the free list
+	CHECK(allocator.Allocate(200, 16) == 16);
+}
+
+TEST_CASE(HeapAllocatorIgnoresUnknownFrees)
+{
+	HeapAllocator allocator;
+	allocator.Init(1024);
+
+	const size_t a = allocator.Allocate(256, 256);
+	const size_t b = allocator.Allocate(256, 256);
+
+	// Neither an offset inside an allocation nor a double free may touch the free list
+	CHECK(!allocator.Free(a + 16));
+	CHECK(!allocator.Free(2048));
+	CHECK(allocator.Free(a));
+	CHECK(!allocator.Free(a));
+	CHECK(allocator.GetAllocatedSize() == 256);
+	CHECK(allocator.GetLargestFreeBlock() == 512);
+	CHECK(allocator.GetAllocationSize(b) == 256);
+
+	// If the double free had been added to the free list, both of these would get offset 0
+	const size_t c = allocator.Allocate(256, 256);
+	const size_t d = allocator.Allocate(256, 256);
+	CHECK(c == 0);
+	CHECK(d == 512);
+}
@@ -0,0 +1,204 @@
+#include "Test.h"
+
+#include "DirtyTracker.h"
+#include "InstanceTransforms.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t k_bufferCount = 3;
+
+	// A transform whose elements identify the instance, and a translation that identifies the move
+	void MakeTransform(const size_t instanceIndex, const int move, float m[4][4])
+	{
+		for (size_t row = 0; row < 4; row++)
+		{
+			for (size_t col = 0; col < 4; col++)
+			{
+				m[row][col] = col == 3 ? (row == 3 ? 1.f : 0.f) : static_cast<float>(instanceIndex * 100 + row * 10 + col);
+			}
+		}
+
+		m[3][0] = static_cast<float>(move);
+	}
+
+	bool RecordMatches(const InstanceRecord& record, const size_t instanceIndex, const int move)
+	{
+		float m[4][4];
+		MakeTransform(instanceIndex, move, m);
+
+		for (size_t row = 0; row < 3; row++)
+		{
+			for (size_t col = 0; col < 4; col++)
+			{
+				if (record.transform[row][col] != m[col][row])
+				{
+					return false;
+				}
+			}
+		}
+
+		return record.instanceIdAndMask == (instanceIndex | 0xFF000000) && record.accelerationStructure == 0x1000 * instanceIndex;
+	}
+
+	struct Instances
+	{
+		InstanceTransforms transforms;
+		std::vector<InstanceRecordAttributes> attributes;
+		std::vector<int> moves;
+
+		explicit Instances(const size_t instanceCount)
+		{
+			transforms.Resize(instanceCount);
+			attributes.resize(instanceCount);
+			moves.assign(instanceCount, 0);
+
+			for (size_t instanceIndex = 0; instanceIndex < instanceCount; instanceIndex++)
+			{
+				Move(instanceIndex, 0);
+				attributes[instanceIndex] = InstanceRecordAttributes::Pack(static_cast<uint32_t>(instanceIndex), 0xFF, 0, 0, 0x1000 * instanceIndex);
+			}
+		}
+
+		void Move(const size_t instanceIndex, const int move)
+		{
+			float m[4][4];
+			MakeTransform(instanceIndex, move, m);
+			transforms.Set(instanceIndex, m);
+			moves[instanceIndex] = move;
+		}
+
+		size_t CountCurrentRecords(const InstanceRecord* records) const
+		{
+			size_t currentCount = 0;
+			for (size_t instanceIndex = 0; instanceIndex < moves.size(); instanceIndex++)
+			{
+				currentCount += RecordMatches(records[instanceIndex], instanceIndex, moves[instanceIndex]) ? 1 : 0;
+			}
+
+			return currentCount;
+		}
+	};
+}
+
+TEST_CASE(InstanceRecordsTransposeTransforms)
+{
+	constexpr size_t k_instanceCount = 13;
+	Instances instances(k_instanceCount);
+
+	// Both the aligned (streaming) and unaligned paths, and counts that are not a multiple of four
+	alignas(16) uint8_t storage[(k_instanceCount + 1) * sizeof(InstanceRecord) + 8] = {};
+	for (const size_t offset : { size_t(0), size_t(8) })
+	{
+		InstanceRecord* records = reinterpret_cast<InstanceRecord*>(storage + offset);
+		std::memset(storage, 0, sizeof(storage));
+		WriteInstanceRecords(instances.transforms, instances.attributes.data(), 2, 11, records);
+
+		size_t matchCount = 0;
+		for (size_t i = 0; i < 11; i++)
+		{
+			matchCount += RecordMatches(records[i], 2 + i, 0) ? 1 : 0;
+		}
+
+		CHECK(matchCount == 11);
+		CHECK(records[11].accelerationStructure == 0);
+	}
+}
+
+TEST_CASE(InstanceRecordsUpdateOnlyDirty)
+{
+	constexpr size_t k_instanceCount = 64;
+	Instances instances(k_instanceCount);
+
+	DirtyTracker tracker;
+	tracker.Init(k_instanceCount, k_bufferCount);
+
+	std::vector<InstanceRecord> records(k_instanceCount);
+	std::vector<size_t> dirtyInstances;
+	WriteInstanceRecords(instances.transforms, instances.attributes.data(), 0, k_instanceCount, records.data());
+	CHECK(!UpdateInstanceRecords(instances.transforms, instances.attributes.data(), tracker, 0, dirtyInstances, records.data()));
+
+	// Clobber a record that did not move, to tell a dirty only update from a bulk one
+	records[40].accelerationStructure = 0;
+	instances.Move(3, 1);
+	instances.Move(17, 1);
+	tracker.MarkDirty(3);
+	tracker.MarkDirty(17);
+
+	CHECK(UpdateInstanceRecords(instances.transforms, instances.attributes.data(), tracker, 0, dirtyInstances, records.data()));
+	CHECK(RecordMatches(records[3], 3, 1));
+	CHECK(RecordMatches(records[17], 17, 1));
+	CHECK(records[40].accelerationStructure == 0);
+	CHECK(!UpdateInstanceRecords(instances.transforms, instances.attributes.data(), tracker, 0, dirtyInstances, records.data()));
+
+	// The other buffers still have to pick up the moves
+	CHECK(tracker.IsDirty(1) && tracker.IsDirty(2));
+}
+
+TEST_CASE(InstanceRecordsUpdateInBulk)
+{
+	constexpr size_t k_instanceCount = 64;
+	Instances instances(k_instanceCount);
+
+	DirtyTracker tracker;
+	tracker.Init(k_instanceCount, k_bufferCount);
+
+	std::vector<InstanceRecord> records(k_instanceCount);
+	std::vector<size_t> dirtyInstances;
+	WriteInstanceRecords(instances.transforms, instances.attributes.data(), 0, k_instanceCount, records.data());
+
+	// More than a quarter of the instances moved, so everything is rewritten
+	records[40].accelerationStructure = 0;
+	for (size_t instanceIndex = 0; instanceIndex < 20; instanceIndex++)
+	{
+		instances.Move(instanceIndex, 2);
+		tracker.MarkDirty(instanceIndex);
+	}
+
+	CHECK(UpdateInstanceRecords(instances.transforms, instances.attributes.data(), tracker, 1, dirtyInstances, records.data()));
+	CHECK(instances.CountCurrentRecords(records.data()) == k_instanceCount);
+}
+
+TEST_CASE(InstanceRecordsCurrentAtBuild)
+{
+	// Mirrors the frame loop: the buffer's render resources are updated once its previous frame has completed,
+	// then entities move, then the buffer's TLAS is built from its instance records. Every build has to see every
+	// move made before it, whichever buffer the move was made under.
+	constexpr size_t k_instanceCount = 32;
+	Instances instances(k_instanceCount);
+
+	DirtyTracker tracker;
+	tracker.Init(k_instanceCount, k_bufferCount);
+
+	std::vector<InstanceRecord> records(k_instanceCount * k_bufferCount);
+	std::vector<size_t> dirtyInstances;
+	for (uint32_t bufferIndex = 0; bufferIndex < k_bufferCount; bufferIndex++)
+	{
+		WriteInstanceRecords(instances.transforms, instances.attributes.data(), 0, k_instanceCount, records.data() + bufferIndex * k_instanceCount);
+	}
+
+	size_t staleBuildCount = 0;
+	for (int frame = 1; frame < 50; frame++)
+	{
+		const uint32_t bufferIndex = frame % k_bufferCount;
+		InstanceRecord* bufferRecords = records.data() + bufferIndex * k_instanceCount;
+
+		// Update: move a few entities, on some frames none
+		if (frame % 4 != 0)
+		{
+			for (size_t instanceIndex = frame % 5; instanceIndex < k_instanceCount; instanceIndex += 7)
+			{
+				instances.Move(instanceIndex, frame);
+				tracker.MarkDirty(instanceIndex);
+			}
+		}
+
+		// Render: the TLAS build reads the records right after they are updated
+		UpdateInstanceRecords(instances.transforms, instances.attributes.data(), tracker, bufferIndex, dirtyInstances, bufferRecords);
+		staleBuildCount += instances.CountCurrentRecords(bufferRecords) == k_instanceCount ? 0 : 1;
+	}
+
+	CHECK(staleBuildCount == 0);
+}
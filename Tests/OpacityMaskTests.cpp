@@ -0,0 +1,177 @@
+#include "Test.h"
+#include "TemporaryDirectory.h"
+
+#include "OpacityMask.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace
+{
+	constexpr uint32_t MakeFourCC(const char a, const char b, const char c, const char d)
+	{
+		return static_cast<uint32_t>(a) | (static_cast<uint32_t>(b) << 8) | (static_cast<uint32_t>(c) << 16) | (static_cast<uint32_t>(d) << 24);
+	}
+
+	void WriteU32(std::vector<uint8_t>& data, const size_t offset, const uint32_t value)
+	{
+		memcpy(&data[offset], &value, sizeof(value));
+	}
+
+	// DDS magic and header, followed by a DX10 header if fourCC is DX10, and then the texel data
+	std::vector<uint8_t> MakeDds(const uint32_t width, const uint32_t height, const uint32_t fourCC, const uint32_t rgbBitCount, const std::vector<uint8_t>& texelData)
+	{
+		std::vector<uint8_t> data(4 + 124, 0);
+		WriteU32(data, 0, MakeFourCC('D', 'D', 'S', ' '));
+		WriteU32(data, 4, 124);
+		WriteU32(data, 4 + 8, height);
+		WriteU32(data, 4 + 12, width);
+		WriteU32(data, 4 + 72, 32);
+		WriteU32(data, 4 + 72 + 4, fourCC ? 0x4 : 0x20000);
+		WriteU32(data, 4 + 72 + 8, fourCC);
+		WriteU32(data, 4 + 72 + 12, rgbBitCount);
+
+		if (fourCC == MakeFourCC('D', 'X', '1', '0'))
+		{
+			std::vector<uint8_t> dx10Header(20, 0);
+			WriteU32(dx10Header, 0, 80);	// DXGI_FORMAT_BC4_UNORM
+			data.insert(data.end(), dx10Header.begin(), dx10Header.end());
+		}
+
+		data.insert(data.end(), texelData.begin(), texelData.end());
+		return data;
+	}
+
+	bool WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+	{
+		std::ofstream file(path, std::ios::binary | std::ios::trunc);
+		return static_cast<bool>(file.write(reinterpret_cast<const char*>(data.data()), data.size()));
+	}
+
+	// BC4 block whose 16 texels pick the given palette entries, in rows of four
+	std::vector<uint8_t> MakeBC4Block(const uint8_t r0, const uint8_t r1, const uint8_t (&paletteIndices)[16])
+	{
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; i++)
+		{
+			bits |= static_cast<uint64_t>(paletteIndices[i] & 0x7) << (3 * i);
+		}
+
+		std::vector<uint8_t> block = { r0, r1 };
+		for (int i = 0; i < 6; i++)
+		{
+			block.push_back(static_cast<uint8_t>(bits >> (8 * i)));
+		}
+
+		return block;
+	}
+
+	OpacityMask MakeSentinelMask()
+	{
+		OpacityMask mask;
+		mask.width = 1;
+		mask.height = 1;
+		mask.texels = { 42 };
+		return mask;
+	}
+
+	bool IsSentinelMask(const OpacityMask& mask)
+	{
+		return mask.width == 1 && mask.height == 1 && mask.texels.size() == 1 && mask.texels[0] == 42;
+	}
+}
+
+TEST_CASE(OpacityMaskLoadsLuminance)
+{
+	const TemporaryDirectory directory("OpacityMaskLoadsLuminance");
+	const std::string path = directory.GetFilePath("mask.dds");
+
+	const std::vector<uint8_t> texels = { 0, 10, 20, 30, 40, 50 };
+	CHECK(WriteFile(path, MakeDds(3, 2, 0, 8, texels)));
+
+	OpacityMask mask;
+	CHECK(LoadOpacityMaskDds(path, mask));
+	CHECK(mask.width == 3 && mask.height == 2);
+	CHECK(mask.texels == texels);
+
+	// Sampling wraps in both directions
+	CHECK(mask.Fetch(4, 0) == 10);
+	CHECK(mask.Fetch(-1, -1) == 50);
+}
+
+TEST_CASE(OpacityMaskDecodesBC4)
+{
+	const TemporaryDirectory directory("OpacityMaskDecodesBC4");
+	const std::string path = directory.GetFilePath("mask.dds");
+
+	// 5x3 texels take two blocks. With r0 > r1 the palette interpolates six steps between them, otherwise four,
+	// followed by 0 and 255.
+	const uint8_t indices[16] = { 0, 1, 2, 3, 4, 5, 6, 7, 0, 1, 2, 3, 4, 5, 6, 7 };
+	std::vector<uint8_t> blocks = MakeBC4Block(210, 70, indices);
+	const std::vector<uint8_t> secondBlock = MakeBC4Block(50, 100, indices);
+	blocks.insert(blocks.end(), secondBlock.begin(), secondBlock.end());
+
+	const uint8_t eightStepPalette[8] = { 210, 70, 190, 170, 150, 130, 110, 90 };
+	const uint8_t sixStepPalette[8] = { 50, 100, 60, 70, 80, 90, 0, 255 };
+
+	for (const uint32_t fourCC : { MakeFourCC('B', 'C', '4', 'U'), MakeFourCC('A', 'T', 'I', '1'), MakeFourCC('D', 'X', '1', '0') })
+	{
+		CHECK(WriteFile(path, MakeDds(5, 3, fourCC, 0, blocks)));
+
+		OpacityMask mask;
+		CHECK(LoadOpacityMaskDds(path, mask));
+		CHECK(mask.width == 5 && mask.height == 3);
+		CHECK(mask.texels.size() == 15);
+		if (mask.texels.size() != 15)
+		{
+			continue;
+		}
+
+		bool bMatches = true;
+		for (uint32_t y = 0; y < 3; y++)
+		{
+			for (uint32_t x = 0; x < 5; x++)
+			{
+				const uint8_t paletteIndex = indices[y * 4 + x % 4];
+				const uint8_t expected = x < 4 ? eightStepPalette[paletteIndex] : sixStepPalette[paletteIndex];
+				bMatches &= mask.texels[y * 5 + x] == expected;
+			}
+		}
+
+		CHECK(bMatches);
+	}
+}
+
+TEST_CASE(OpacityMaskRejectsBadFiles)
+{
+	const TemporaryDirectory directory("OpacityMaskRejectsBadFiles");
+	const std::string path = directory.GetFilePath("mask.dds");
+
+	OpacityMask mask = MakeSentinelMask();
+	CHECK(!LoadOpacityMaskDds(directory.GetFilePath("missing.dds"), mask));
+	CHECK(IsSentinelMask(mask));
+
+	// Truncated texel data of either kind leaves the mask as it was
+	CHECK(WriteFile(path, MakeDds(4, 4, 0, 8, std::vector<uint8_t>(15, 255))));
+	CHECK(!LoadOpacityMaskDds(path, mask));
+	CHECK(IsSentinelMask(mask));
+
+	CHECK(WriteFile(path, MakeDds(8, 4, MakeFourCC('B', 'C', '4', 'U'), 0, std::vector<uint8_t>(15, 255))));
+	CHECK(!LoadOpacityMaskDds(path, mask));
+	CHECK(IsSentinelMask(mask));
+
+	// Formats other than BC4 and 8-bit
+	CHECK(WriteFile(path, MakeDds(4, 4, MakeFourCC('D', 'X', 'T', '1'), 0, std::vector<uint8_t>(8, 0))));
+	CHECK(!LoadOpacityMaskDds(path, mask));
+	CHECK(WriteFile(path, MakeDds(2, 2, 0, 32, std::vector<uint8_t>(16, 0))));
+	CHECK(!LoadOpacityMaskDds(path, mask));
+
+	// Cut off in the header
+	std::vector<uint8_t> header = MakeDds(4, 4, 0, 8, {});
+	header.resize(64);
+	CHECK(WriteFile(path, header));
+	CHECK(!LoadOpacityMaskDds(path, mask));
+	CHECK(IsSentinelMask(mask));
+}
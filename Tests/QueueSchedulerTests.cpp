@@ -0,0 +1,272 @@
+#include "Test.h"
+
+#include "DirtyTracker.h"
+#include "InstanceTransforms.h"
+#include "QueueScheduler.h"
+
+#include <array>
+#include <deque>
+#include <functional>
+#include <vector>
+
+namespace
+{
+	// Queues that only run when the CPU waits on them, so that GPU work reads memory as late as it possibly could
+	class FakeQueueFences : public QueueFences
+	{
+	public:
+		void Signal(const QueueType queue, const uint64_t value) override
+		{
+			m_queues[static_cast<size_t>(queue)].push_back({ queue, value, nullptr });
+		}
+
+		void Wait(const QueueType waitingQueue, const QueueType signallingQueue, const uint64_t value) override
+		{
+			m_queues[static_cast<size_t>(waitingQueue)].push_back({ signallingQueue, value, nullptr });
+			m_waitCount++;
+		}
+
+		uint64_t GetCompletedValue(const QueueType queue) const override
+		{
+			return m_completedValues[static_cast<size_t>(queue)];
+		}
+
+		void Execute(const QueueType queue, std::function<void()> work)
+		{
+			m_queues[static_cast<size_t>(queue)].push_back({ queue, 0, std::move(work) });
+		}
+
+		// Runs the queues until the fence reaches value. Returns false if they deadlock first.
+		bool WaitOnCPU(const QueueType queue, const uint64_t value)
+		{
+			while (GetCompletedValue(queue) < value)
+			{
+				if (!Step())
+				{
+					return false;
+				}
+			}
+
+			return true;
+		}
+
+		// Returns false if the queues deadlock before running dry
+		bool Flush()
+		{
+			while (Step()) {}
+			return m_queues[0].empty() && m_queues[1].empty();
+		}
+
+		size_t GetWaitCount() const
+		{
+			return m_waitCount;
+		}
+
+	private:
+		// A signal on the queue's own fence, a wait on another queue's fence, or some work
+		struct Command
+		{
+			QueueType fence;
+			uint64_t value;
+			std::function<void()> work;
+		};
+
+		bool Step()
+		{
+			bool bProgress = false;
+			for (size_t queueIndex = 0; queueIndex < m_queues.size(); queueIndex++)
+			{
+				std::deque<Command>& commands = m_queues[queueIndex];
+				while (!commands.empty())
+				{
+					Command& command = commands.front();
+					if (command.work)
+					{
+						command.work();
+					}
+					else if (static_cast<size_t>(command.fence) == queueIndex)
+					{
+						m_completedValues[queueIndex] = command.value;
+					}
+					else if (GetCompletedValue(command.fence) < command.value)
+					{
+						break;
+					}
+
+					commands.pop_front();
+					bProgress = true;
+				}
+			}
+
+			return bProgress;
+		}
+
+		std::array<std::deque<Command>, static_cast<size_t>(QueueType::Count)> m_queues;
+		std::array<uint64_t, static_cast<size_t>(QueueType::Count)> m_completedValues = {};
+		size_t m_waitCount = 0;
+	};
+}
+
+TEST_CASE(QueueSchedulerSignalsPerQueue)
+{
+	FakeQueueFences fences;
+	QueueScheduler scheduler;
+	scheduler.Init(&fences);
+
+	CHECK(scheduler.Signal(QueueType::Graphics) == 1);
+	CHECK(scheduler.Signal(QueueType::Graphics) == 2);
+	CHECK(scheduler.Signal(QueueType::Compute) == 1);
+	CHECK(scheduler.GetLastSignalledValue(QueueType::Graphics) == 2);
+	CHECK(scheduler.GetLastSignalledValue(QueueType::Compute) == 1);
+
+	// Nothing runs until the CPU waits
+	CHECK(scheduler.IsComplete(QueueType::Graphics, 0));
+	CHECK(!scheduler.IsComplete(QueueType::Graphics, 1));
+	CHECK(fences.WaitOnCPU(QueueType::Graphics, 2));
+	CHECK(scheduler.IsComplete(QueueType::Graphics, 2));
+}
+
+TEST_CASE(QueueSchedulerElidesRedundantWaits)
+{
+	FakeQueueFences fences;
+	QueueScheduler scheduler;
+	scheduler.Init(&fences);
+
+	const uint64_t first = scheduler.Signal(QueueType::Compute);
+	const uint64_t second = scheduler.Signal(QueueType::Compute);
+
+	CHECK(scheduler.Wait(QueueType::Graphics, QueueType::Compute, first));
+	CHECK(!scheduler.Wait(QueueType::Graphics, QueueType::Compute, first));
+	CHECK(scheduler.Wait(QueueType::Graphics, QueueType::Compute, second));
+	CHECK(!scheduler.Wait(QueueType::Graphics, QueueType::Compute, first));
+	CHECK(scheduler.GetElidedWaitCount() == 2);
+	CHECK(fences.GetWaitCount() == 2);
+
+	// A queue is ordered after its own work, which is not counted as an elided wait
+	const uint64_t graphics = scheduler.Signal(QueueType::Graphics);
+	CHECK(!scheduler.Wait(QueueType::Graphics, QueueType::Graphics, graphics));
+	CHECK(scheduler.GetElidedWaitCount() == 2);
+
+	// Waits in the other direction are tracked separately, and a completed value needs no wait at all
+	CHECK(scheduler.Wait(QueueType::Compute, QueueType::Graphics, graphics));
+	const uint64_t third = scheduler.Signal(QueueType::Compute);
+	CHECK(fences.Flush());
+	CHECK(!scheduler.Wait(QueueType::Graphics, QueueType::Compute, third));
+	CHECK(scheduler.GetElidedWaitCount() == 3);
+	CHECK(fences.GetWaitCount() == 3);
+}
+
+TEST_CASE(QueueSchedulerOrdersCrossQueueWork)
+{
+	FakeQueueFences fences;
+	QueueScheduler scheduler;
+	scheduler.Init(&fences);
+
+	// The fake steps the graphics queue first, but its work has to wait for the compute work
+	std::vector<int> order;
+	const uint64_t computeValue = scheduler.GetLastSignalledValue(QueueType::Compute) + 1;
+	fences.Execute(QueueType::Compute, [&order]() { order.push_back(1); });
+	CHECK(scheduler.Signal(QueueType::Compute) == computeValue);
+	CHECK(scheduler.Wait(QueueType::Graphics, QueueType::Compute, computeValue));
+	fences.Execute(QueueType::Graphics, [&order]() { order.push_back(2); });
+	const uint64_t graphicsValue = scheduler.Signal(QueueType::Graphics);
+
+	CHECK(fences.WaitOnCPU(QueueType::Graphics, graphicsValue));
+	CHECK((order == std::vector<int>{ 1, 2 }));
+}
+
+TEST_CASE(QueueSchedulerTlasFrameLoop)
+{
+	// Mirrors the frame loop of App and Scene with two buffered frames. Update moves entities. Render brings the
+	// buffer's instance records up to date, builds its TLAS on compute if they changed, and traces rays against it
+	// on graphics after waiting for the build. AdvanceGfxFrame then waits on the CPU for the frame that last used
+	// the next buffer. Every trace has to see the entities where they were when its frame was rendered.
+	constexpr uint32_t k_bufferCount = 2;
+	constexpr size_t k_instanceCount = 16;
+
+	FakeQueueFences fences;
+	QueueScheduler scheduler;
+	scheduler.Init(&fences);
+
+	InstanceTransforms transforms;
+	std::vector<InstanceRecordAttributes> attributes(k_instanceCount, InstanceRecordAttributes::Pack(0, 0xFF, 0, 0, 0));
+	std::vector<float> positions(k_instanceCount, 0.f);
+	transforms.Resize(k_instanceCount);
+
+	auto moveInstance = [&transforms, &positions](const size_t instanceIndex, const float x)
+	{
+		const float m[4][4] = { { 1.f, 0.f, 0.f, 0.f }, { 0.f, 1.f, 0.f, 0.f }, { 0.f, 0.f, 1.f, 0.f }, { x, 0.f, 0.f, 1.f } };
+		transforms.Set(instanceIndex, m);
+		positions[instanceIndex] = x;
+	};
+
+	DirtyTracker tracker;
+	tracker.Init(k_instanceCount, k_bufferCount);
+
+	std::vector<InstanceRecord> records(k_instanceCount * k_bufferCount);
+	std::array<std::vector<float>, k_bufferCount> tlases;	// the x translation of each instance, as seen by the build
+	for (uint32_t bufferIndex = 0; bufferIndex < k_bufferCount; bufferIndex++)
+	{
+		for (size_t instanceIndex = 0; instanceIndex < k_instanceCount; instanceIndex++)
+		{
+			moveInstance(instanceIndex, 0.f);
+		}
+
+		WriteInstanceRecords(transforms, attributes.data(), 0, k_instanceCount, records.data() + bufferIndex * k_instanceCount);
+		tlases[bufferIndex] = positions;
+	}
+
+	std::array<uint64_t, k_bufferCount> gfxFenceValues = {};
+	std::array<uint64_t, k_bufferCount> tlasFenceValues = {};
+	std::vector<size_t> dirtyScratch;
+	size_t traceCount = 0;
+	size_t staleTraceCount = 0;
+	size_t buildCount = 0;
+	uint32_t bufferIndex = 0;
+
+	for (int frame = 1; frame <= 60; frame++)
+	{
+		// Update: some frames move nothing
+		if (frame % 3 != 0)
+		{
+			moveInstance((frame * 5) % k_instanceCount, static_cast<float>(frame));
+			tracker.MarkDirty((frame * 5) % k_instanceCount);
+		}
+
+		// Render: the build reads the records when the compute queue gets to it, not when it is submitted
+		InstanceRecord* bufferRecords = records.data() + bufferIndex * k_instanceCount;
+		if (UpdateInstanceRecords(transforms, attributes.data(), tracker, bufferIndex, dirtyScratch, bufferRecords))
+		{
+			fences.Execute(QueueType::Compute, [&tlases, &buildCount, bufferRecords, bufferIndex]()
+			{
+				for (size_t instanceIndex = 0; instanceIndex < k_instanceCount; instanceIndex++)
+				{
+					tlases[bufferIndex][instanceIndex] = bufferRecords[instanceIndex].transform[0][3];
+				}
+
+				buildCount++;
+			});
+
+			tlasFenceValues[bufferIndex] = scheduler.Signal(QueueType::Compute);
+		}
+
+		scheduler.Wait(QueueType::Graphics, QueueType::Compute, tlasFenceValues[bufferIndex]);
+		fences.Execute(QueueType::Graphics, [&tlases, &traceCount, &staleTraceCount, expected = positions, bufferIndex]()
+		{
+			staleTraceCount += tlases[bufferIndex] == expected ? 0 : 1;
+			traceCount++;
+		});
+
+		// AdvanceGfxFrame
+		gfxFenceValues[bufferIndex] = scheduler.Signal(QueueType::Graphics);
+		bufferIndex = (bufferIndex + 1) % k_bufferCount;
+		CHECK(fences.WaitOnCPU(QueueType::Graphics, gfxFenceValues[bufferIndex]));
+	}
+
+	CHECK(fences.Flush());
+	CHECK(traceCount == 60);
+	CHECK(staleTraceCount == 0);
+
+	// Frames that moved nothing still build the TLAS of their buffer if it missed a move made under the other one
+	CHECK(buildCount == 60);
+}
@@ -0,0 +1,53 @@
+#include "Test.h"
+
+#include "RefitPolicy.h"
+
+TEST_CASE(RefitPolicyBuildsFirst)
+{
+	RefitPolicy policy;
+	policy.Init(4, 1.5f);
+
+	// Nothing to refit before the first build, even if nothing changed
+	CHECK(policy.Decide(false, 1.f) == AccelerationStructureUpdate::Rebuild);
+	CHECK(policy.Decide(true, 1.f) == AccelerationStructureUpdate::Rebuild);
+
+	policy.OnRebuild(10.f);
+	CHECK(policy.GetBaselineQuality() == 10.f);
+	CHECK(policy.Decide(false, 100.f) == AccelerationStructureUpdate::None);
+	CHECK(policy.Decide(true, 10.f) == AccelerationStructureUpdate::Refit);
+}
+
+TEST_CASE(RefitPolicyQualityThreshold)
+{
+	RefitPolicy policy;
+	policy.Init(100, 1.5f);
+	policy.OnRebuild(10.f);
+
+	// The metric may grow to exactly the allowed ratio
+	CHECK(policy.Decide(true, 15.f) == AccelerationStructureUpdate::Refit);
+	CHECK(policy.Decide(true, 15.01f) == AccelerationStructureUpdate::Rebuild);
+
+	// A rebuild resets the baseline
+	policy.OnRebuild(20.f);
+	CHECK(policy.Decide(true, 25.f) == AccelerationStructureUpdate::Refit);
+}
+
+TEST_CASE(RefitPolicyRefitCountThreshold)
+{
+	RefitPolicy policy;
+	policy.Init(3, 2.f);
+	policy.OnRebuild(1.f);
+
+	for (uint32_t refitIndex = 0; refitIndex < 3; refitIndex++)
+	{
+		CHECK(policy.Decide(true, 1.f) == AccelerationStructureUpdate::Refit);
+		policy.OnRefit();
+	}
+
+	CHECK(policy.GetRefitCount() == 3);
+	CHECK(policy.Decide(true, 1.f) == AccelerationStructureUpdate::Rebuild);
+
+	policy.OnRebuild(1.f);
+	CHECK(policy.GetRefitCount() == 0);
+	CHECK(policy.Decide(true, 1.f) == AccelerationStructureUpdate::Refit);
+}
@@ -0,0 +1,44 @@
+#include "Test.h"
+
+#include "InstanceTransforms.h"
+#include "SurfaceCategory.h"
+
+TEST_CASE(SurfaceCategoryTraitsTable)
+{
+	const SurfaceTraits& opaque = GetSurfaceTraits(SurfaceCategory::Opaque);
+	CHECK(opaque.instanceMask == 0x01);
+	CHECK(opaque.instanceFlags == InstanceFlags::ForceOpaque);
+	CHECK(opaque.opaqueGeometry);
+
+	const SurfaceTraits& alphaTested = GetSurfaceTraits(SurfaceCategory::AlphaTested);
+	CHECK(alphaTested.instanceMask == 0x02);
+	CHECK(alphaTested.instanceFlags == InstanceFlags::None);
+	CHECK(!alphaTested.opaqueGeometry);
+}
+
+TEST_CASE(SurfaceCategoryMasksAreDistinct)
+{
+	// Each category needs a bit of its own so that rays can include or skip it, eg. shadow rays tracing opaque only
+	uint32_t usedBits = 0;
+	for (size_t categoryIndex = 0; categoryIndex < static_cast<size_t>(SurfaceCategory::Count); categoryIndex++)
+	{
+		const SurfaceTraits& traits = GetSurfaceTraits(static_cast<SurfaceCategory>(categoryIndex));
+		CHECK(traits.instanceMask != 0);
+		CHECK((traits.instanceMask & (traits.instanceMask - 1)) == 0);
+		CHECK((usedBits & traits.instanceMask) == 0);
+		CHECK((traits.instanceMask & InstanceMask::All) == traits.instanceMask);
+		usedBits |= traits.instanceMask;
+
+		// Forcing an instance opaque must agree with the geometry flag, or the any-hit shader runs for one but not the other
+		CHECK(((traits.instanceFlags & InstanceFlags::ForceOpaque) != 0) == traits.opaqueGeometry);
+		CHECK((traits.instanceFlags & InstanceFlags::ForceNonOpaque) == 0);
+	}
+}
+
+TEST_CASE(SurfaceCategoryPacksIntoInstanceRecord)
+{
+	const SurfaceTraits& traits = GetSurfaceTraits(SurfaceCategory::Opaque);
+	const InstanceRecordAttributes attributes = InstanceRecordAttributes::Pack(0x123456, traits.instanceMask, 7, static_cast<uint8_t>(traits.instanceFlags), 0);
+	CHECK(attributes.instanceIdAndMask == (0x123456u | (uint32_t(traits.instanceMask) << 24)));
+	CHECK(attributes.hitGroupOffsetAndFlags == (7u | (traits.instanceFlags << 24)));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <filesystem>
+#include <string>
+#include <system_error>
+#include <vector>
+
+// Empty directory of its own for a test, removed with everything in it when the test is done
+class TemporaryDirectory
+{
+public:
+	explicit TemporaryDirectory(const char* name)
+	{
+		m_path = std::filesystem::temp_directory_path() / name;
+		std::error_code error;
+		std::filesystem::remove_all(m_path, error);
+		std::filesystem::create_directories(m_path);
+	}
+
+	~TemporaryDirectory()
+	{
+		std::error_code error;
+		std::filesystem::remove_all(m_path, error);
+	}
+
+	TemporaryDirectory(const TemporaryDirectory&) = delete;
+	TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+	std::string GetPath() const { return m_path.string(); }
+
+	std::string GetFilePath(const char* fileName) const { return (m_path / fileName).string(); }
+
+	std::vector<std::filesystem::path> GetFiles() const
+	{
+		std::vector<std::filesystem::path> files;
+		for (const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(m_path))
+		{
+			files.push_back(entry.path());
+		}
+
+		return files;
+	}
+
+private:
+	std::filesystem::path m_path;
+};
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <cstdio>
+
+// Minimal test registry for the device independent sources. Each TEST_CASE registers itself with the driver in
+// TestMain.cpp, and a failed CHECK reports the expression and carries on with the rest of the case.
+
+using TestFunction = void(*)();
+
+struct TestRegistrar
+{
+	TestRegistrar(const char* name, TestFunction function);
+};
+
+void ReportCheckFailure(const char* file, const int line, const char* expression);
+
+#define TEST_CASE(name) \
+	static void name(); \
+	static const TestRegistrar name##Registrar(#name, name); \
+	static void name()
+
+#define CHECK(expression) \
+	do { if (!(expression)) { ReportCheckFailure(__FILE__, __LINE__, #expression); } } while (false)
@@ -0,0 +1,70 @@
+// Unit tests for the device independent sources. They do not depend on D3D12, Windows or assimp, and are excluded
+// from the Windows build. Eg.
+//
+//   g++ -std=c++17 -O1 -g -pthread -fsanitize=address,undefined -I../Src *.cpp ../Src/HeapAllocator.cpp
+//       ../Src/BlasCompaction.cpp ../Src/BlasBuildBatch.cpp ../Src/DirtyTracker.cpp ../Src/RefitPolicy.cpp
+//       ../Src/InstanceTransforms.cpp ../Src/AccelerationStructurePolicy.cpp ../Src/SurfaceCategory.cpp
+//       ../Src/QueueScheduler.cpp ../Src/CpuRaytracer.cpp ../Src/SceneData.cpp ../Src/Bvh.cpp ../Src/Bvh8.cpp
+//       ../Src/Bvh8Quantized.cpp ../Src/BvhFile.cpp ../Src/BvhStats.cpp ../Src/TrianglePacket.cpp ../Src/RayPacket.cpp
+//       ../Src/RayStream.cpp ../Src/SimdIsa.cpp ../Src/TaskScheduler.cpp ../Src/OpacityMask.cpp
+//       ../Src/TriangleOpacity.cpp ../Src/AlphaClip.cpp ../Src/TriangleSplit.cpp -o Tests
+//   ./Tests [name filter]
+//
+// Every case whose name contains the filter is run, and the exit code is the number of cases that failed.
+
+#include "Test.h"
+
+#include <cstring>
+#include <vector>
+
+namespace
+{
+	struct TestCaseEntry
+	{
+		const char* name;
+		TestFunction function;
+	};
+
+	std::vector<TestCaseEntry>& GetTestCases()
+	{
+		static std::vector<TestCaseEntry> testCases;
+		return testCases;
+	}
+
+	int g_checkFailures = 0;
+}
+
+TestRegistrar::TestRegistrar(const char* name, TestFunction function)
+{
+	GetTestCases().push_back({ name, function });
+}
+
+void ReportCheckFailure(const char* file, const int line, const char* expression)
+{
+	std::printf("  %s(%d): CHECK(%s) failed\n", file, line, expression);
+	g_checkFailures++;
+}
+
+int main(int argc, char** argv)
+{
+	const char* filter = argc > 1 ? argv[1] : "";
+
+	int runCount = 0;
+	int failedCount = 0;
+	for (const TestCaseEntry& testCase : GetTestCases())
+	{
+		if (std::strstr(testCase.name, filter) == nullptr)
+		{
+			continue;
+		}
+
+		std::printf("%s\n", testCase.name);
+		const int failuresBefore = g_checkFailures;
+		testCase.function();
+		runCount++;
+		failedCount += g_checkFailures > failuresBefore ? 1 : 0;
+	}
+
+	std::printf("%d of %d test cases passed\n", runCount - failedCount, runCount);
+	return failedCount;
+}
@@ -0,0 +1,237 @@
+#include "TestScene.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+
+namespace
+{
+	// Relative distance from an edge or between two hits that float traversal may resolve either way
+	constexpr double k_ambiguityEpsilon = 1e-5;
+
+	void Multiply(const float a[4][4], const float b[4][4], float out[4][4])
+	{
+		for (int row = 0; row < 4; row++)
+		{
+			for (int col = 0; col < 4; col++)
+			{
+				out[row][col] = 0.f;
+				for (int k = 0; k < 4; k++)
+				{
+					out[row][col] += a[row][k] * b[k][col];
+				}
+			}
+		}
+	}
+
+	Vec3 TransformPoint(const Vec3& p, const float m[4][4])
+	{
+		return {
+			p.x * m[0][0] + p.y * m[1][0] + p.z * m[2][0] + m[3][0],
+			p.x * m[0][1] + p.y * m[1][1] + p.z * m[2][1] + m[3][1],
+			p.x * m[0][2] + p.y * m[1][2] + p.z * m[2][2] + m[3][2] };
+	}
+
+	struct Vec3d
+	{
+		double x, y, z;
+	};
+
+	Vec3d ToDouble(const Vec3& v) { return { v.x, v.y, v.z }; }
+	Vec3d operator-(const Vec3d& a, const Vec3d& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+	double Dot(const Vec3d& a, const Vec3d& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+	Vec3d Cross(const Vec3d& a, const Vec3d& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+}
+
+SceneData MakeRandomTriangleScene(const uint32_t seed, const uint32_t instanceCount)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> random(-1.f, 1.f);
+
+	SceneData scene;
+	for (uint32_t materialIndex = 0; materialIndex < 6; materialIndex++)
+	{
+		SceneMaterialData material;
+		material.baseColor = { (materialIndex + 1) / 7.f, 0.5f, 1.f - (materialIndex + 1) / 7.f };
+		scene.materials.push_back(material);
+	}
+
+	for (uint32_t meshIndex = 0; meshIndex < 5; meshIndex++)
+	{
+		SceneMeshData mesh;
+		mesh.materialIndex = meshIndex;
+
+		const uint32_t triangleCount = meshIndex == 4 ? 1 : 200 + meshIndex * 300;
+		for (uint32_t triangleIndex = 0; triangleIndex < triangleCount; triangleIndex++)
+		{
+			const Vec3 center = { random(rng) * 3.f, random(rng) * 3.f, random(rng) * 3.f };
+			for (int vertex = 0; vertex < 3; vertex++)
+			{
+				mesh.indices.push_back(static_cast<uint32_t>(mesh.positions.size()));
+				mesh.positions.push_back(center + Vec3{ random(rng) * 0.6f, random(rng) * 0.6f, random(rng) * 0.6f });
+				mesh.uvs.push_back({ 0.f, 0.f });
+			}
+		}
+
+		scene.meshes.push_back(std::move(mesh));
+	}
+
+	scene.meshes.push_back(SceneMeshData{});
+
+	for (uint32_t instanceIndex = 0; instanceIndex < instanceCount; instanceIndex++)
+	{
+		SceneInstanceData instance;
+		instance.meshIndex = instanceIndex % scene.meshes.size();
+
+		const float yaw = random(rng) * 3.14f;
+		const float pitch = random(rng) * 3.14f;
+		const float scaleX = 0.5f + std::abs(random(rng));
+		const float scaleY = 0.5f + std::abs(random(rng));
+		const float scaleZ = instanceIndex % 7 == 0 ? -1.f : 1.f;
+
+		const float scale[4][4] = { { scaleX, 0, 0, 0 }, { 0, scaleY, 0, 0 }, { 0, 0, scaleZ, 0 }, { 0, 0, 0, 1 } };
+		const float rotateZ[4][4] = { { std::cos(yaw), std::sin(yaw), 0, 0 }, { -std::sin(yaw), std::cos(yaw), 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+		const float rotateX[4][4] = { { 1, 0, 0, 0 }, { 0, std::cos(pitch), std::sin(pitch), 0 }, { 0, -std::sin(pitch), std::cos(pitch), 0 }, { 0, 0, 0, 1 } };
+		const float translate[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { random(rng) * 12.f, random(rng) * 9.f, 30.f + random(rng) * 12.f, 1 } };
+
+		float scaleRotate[4][4], scaleRotateRotate[4][4];
+		Multiply(scale, rotateZ, scaleRotate);
+		Multiply(scaleRotate, rotateX, scaleRotateRotate);
+		Multiply(scaleRotateRotate, translate, instance.localToWorld);
+
+		if (instanceIndex == 13)
+		{
+			std::memset(instance.localToWorld, 0, sizeof(instance.localToWorld));
+			instance.localToWorld[3][3] = 1.f;
+		}
+
+		scene.instances.push_back(instance);
+	}
+
+	return scene;
+}
+
+std::vector<WorldTriangle> GatherWorldTriangles(const SceneData& scene)
+{
+	std::vector<WorldTriangle> triangles;
+	for (const SceneInstanceData& instance : scene.instances)
+	{
+		const float (&m)[4][4] = instance.localToWorld;
+		const float determinant =
+			m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+			m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+			m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+		if (determinant == 0.f)
+		{
+			continue;
+		}
+
+		const SceneMeshData& mesh = scene.meshes[instance.meshIndex];
+		for (size_t index = 0; index + 2 < mesh.indices.size(); index += 3)
+		{
+			WorldTriangle triangle;
+			for (int vertex = 0; vertex < 3; vertex++)
+			{
+				triangle.vertices[vertex] = TransformPoint(mesh.positions[mesh.indices[index + vertex]], m);
+			}
+
+			triangle.materialIndex = mesh.materialIndex;
+			triangles.push_back(triangle);
+		}
+	}
+
+	return triangles;
+}
+
+ReferenceHit IntersectReference(
+	const std::vector<WorldTriangle>& triangles,
+	const Vec3& origin,
+	const Vec3& direction,
+	const float tMin,
+	const float tMax)
+{
+	const Vec3d o = ToDouble(origin);
+	const Vec3d d = ToDouble(direction);
+
+	// Closest hit, and the distances of grazed triangles, which float traversal may or may not hit
+	ReferenceHit hit;
+	hit.t = tMax;
+	double closestGrazeT = INFINITY;
+
+	for (const WorldTriangle& triangle : triangles)
+	{
+		const Vec3d a = ToDouble(triangle.vertices[0]);
+		const Vec3d e1 = ToDouble(triangle.vertices[1]) - a;
+		const Vec3d e2 = ToDouble(triangle.vertices[2]) - a;
+
+		const Vec3d p = Cross(d, e2);
+		const double determinant = Dot(e1, p);
+		if (determinant == 0.0)
+		{
+			continue;
+		}
+
+		const double inverseDeterminant = 1.0 / determinant;
+		const Vec3d s = o - a;
+		const double u = Dot(s, p) * inverseDeterminant;
+		const Vec3d q = Cross(s, e1);
+		const double v = Dot(d, q) * inverseDeterminant;
+		const double t = Dot(e2, q) * inverseDeterminant;
+
+		const double edgeDistance = (std::min)({ u, v, 1.0 - u - v });
+		if (edgeDistance < -k_ambiguityEpsilon || t < tMin * (1.0 - k_ambiguityEpsilon) || t > tMax * (1.0 + k_ambiguityEpsilon))
+		{
+			continue;
+		}
+
+		const bool bGrazed = edgeDistance < k_ambiguityEpsilon ||
+			std::abs(t - tMin) < tMin * k_ambiguityEpsilon ||
+			std::abs(t - tMax) < tMax * k_ambiguityEpsilon;
+		if (bGrazed)
+		{
+			closestGrazeT = (std::min)(closestGrazeT, t);
+			continue;
+		}
+
+		if (t < hit.t)
+		{
+			// The closest two hits are too close to tell apart if their materials differ
+			if (hit.materialIndex >= 0 && hit.t - t < t * k_ambiguityEpsilon && hit.materialIndex != static_cast<int32_t>(triangle.materialIndex))
+			{
+				closestGrazeT = (std::min)(closestGrazeT, t);
+			}
+
+			hit.t = t;
+			hit.u = u;
+			hit.v = v;
+			hit.materialIndex = static_cast<int32_t>(triangle.materialIndex);
+		}
+		else if (t - hit.t < hit.t * k_ambiguityEpsilon && hit.materialIndex != static_cast<int32_t>(triangle.materialIndex))
+		{
+			closestGrazeT = (std::min)(closestGrazeT, t);
+		}
+	}
+
+	hit.bAmbiguous = closestGrazeT <= hit.t * (1.0 + k_ambiguityEpsilon);
+	return hit;
+}
+
+Vec3 GetViewPosition(const SceneViewData& view)
+{
+	return { view.viewMatrix[0][3], view.viewMatrix[1][3], view.viewMatrix[2][3] };
+}
+
+Vec3 MakePrimaryRayDirection(const SceneViewData& view, const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height)
+{
+	auto column = [&view](const int col)
+	{
+		return Vec3{ view.viewMatrix[0][col], view.viewMatrix[1][col], view.viewMatrix[2][col] };
+	};
+
+	const float ndcX = 2.f * (x / static_cast<float>(width)) - 1.f;
+	const float ndcY = -2.f * (y / static_cast<float>(height)) + 1.f;
+
+	const Vec3 d = column(2) + column(0) * (view.fovScale.x * ndcX) + column(1) * (view.fovScale.y * ndcY);
+	return d * (1.f / Length(d));
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "CpuMath.h"
+#include "SceneData.h"
+
+#include <cstdint>
+#include <vector>
+
+// Scenes and a brute force reference for the CPU ray tracer and triangle kernel tests
+
+// Six untextured materials and five meshes of random triangles, from a single triangle to a thousand, plus an empty
+// mesh. The instances are scaled, rotated and placed in front of the origin looking down +z. Every seventh instance is
+// mirrored, and instance 13 has a zero transform, which the tracer has to skip.
+SceneData MakeRandomTriangleScene(const uint32_t seed, const uint32_t instanceCount);
+
+struct WorldTriangle
+{
+	Vec3 vertices[3];
+	uint32_t materialIndex;
+};
+
+// Triangles of the instances whose transform can be inverted, moved into world space
+std::vector<WorldTriangle> GatherWorldTriangles(const SceneData& scene);
+
+struct ReferenceHit
+{
+	double t = 0.0;
+	double u = 0.0;				// weights of the second and third vertex, as in TrianglePacketHit
+	double v = 0.0;
+	int32_t materialIndex = -1;	// of the triangle hit, -1 on a miss
+	bool bAmbiguous = false;	// a triangle grazed at an edge, or hit within rounding of tMin, tMax or the closest hit
+};
+
+// Closest hit of a ray with every triangle, tested in double precision
+ReferenceHit IntersectReference(
+	const std::vector<WorldTriangle>& triangles,
+	const Vec3& origin,
+	const Vec3& direction,
+	const float tMin,
+	const float tMax);
+
+// Direction of the primary ray of a pixel, the way Raygen.hlsl makes it
+Vec3 MakePrimaryRayDirection(const SceneViewData& view, const uint32_t x, const uint32_t y, const uint32_t width, const uint32_t height);
+
+// Origin of the primary rays
+Vec3 GetViewPosition(const SceneViewData& view);
@@ -0,0 +1,149 @@
+#include "Test.h"
+
+#include "TaskScheduler.h"
+#include "TriangleOpacity.h"
+
+#include <random>
+#include <vector>
+
+namespace
+{
+	// 16x16 mask whose left half passes the alpha test
+	OpacityMask MakeHalfOpaqueMask()
+	{
+		OpacityMask mask;
+		mask.width = 16;
+		mask.height = 16;
+		mask.texels.resize(16 * 16);
+		for (uint32_t y = 0; y < 16; y++)
+		{
+			for (uint32_t x = 0; x < 16; x++)
+			{
+				mask.texels[y * 16 + x] = x < 8 ? 255 : 0;
+			}
+		}
+
+		return mask;
+	}
+
+	// Appends a triangle given in texels of a 16x16 mask
+	void AddTriangle(std::vector<Vec2>& uvs, std::vector<uint32_t>& indices, const float x0, const float x1, const float y0, const float y1)
+	{
+		const uint32_t base = static_cast<uint32_t>(uvs.size());
+		uvs.push_back({ x0 / 16.f, y0 / 16.f });
+		uvs.push_back({ x1 / 16.f, y0 / 16.f });
+		uvs.push_back({ x0 / 16.f, y1 / 16.f });
+		indices.insert(indices.end(), { base, base + 1, base + 2 });
+	}
+}
+
+TEST_CASE(TriangleOpacityClassifiesFootprints)
+{
+	const OpacityMask mask = MakeHalfOpaqueMask();
+
+	std::vector<Vec2> uvs;
+	std::vector<uint32_t> indices;
+	AddTriangle(uvs, indices, 2.f, 6.f, 2.f, 12.f);		// inside the opaque half
+	AddTriangle(uvs, indices, 10.f, 13.f, 2.f, 12.f);	// inside the transparent half
+	AddTriangle(uvs, indices, 5.f, 11.f, 2.f, 12.f);	// across the edge
+	AddTriangle(uvs, indices, 2.f, 7.8f, 2.f, 12.f);	// past the center of the last opaque texel, where bilinear filtering reads the next
+	AddTriangle(uvs, indices, 18.f, 22.f, 2.f, 12.f);	// wraps around into the opaque half
+	AddTriangle(uvs, indices, -6.f, -3.f, 2.f, 12.f);	// and into the transparent one
+
+	const TriangleOpacityResult result = ClassifyTriangleOpacity(mask, uvs, indices, 128, 1);
+	const std::vector<TriangleOpacity> expected = {
+		TriangleOpacity::Opaque,
+		TriangleOpacity::Transparent,
+		TriangleOpacity::Mixed,
+		TriangleOpacity::Mixed,
+		TriangleOpacity::Opaque,
+		TriangleOpacity::Transparent };
+	CHECK(result.triangles == expected);
+	CHECK(result.counts[static_cast<size_t>(TriangleOpacity::Opaque)] == 2);
+	CHECK(result.counts[static_cast<size_t>(TriangleOpacity::Transparent)] == 2);
+	CHECK(result.counts[static_cast<size_t>(TriangleOpacity::Mixed)] == 2);
+
+	// The cutoff is inclusive
+	const TriangleOpacityResult allOpaque = ClassifyTriangleOpacity(mask, uvs, indices, 0, 1);
+	CHECK(allOpaque.counts[static_cast<size_t>(TriangleOpacity::Opaque)] == 6);
+}
+
+TEST_CASE(TriangleOpacityWithoutMask)
+{
+	std::vector<Vec2> uvs;
+	std::vector<uint32_t> indices;
+	AddTriangle(uvs, indices, 2.f, 6.f, 2.f, 12.f);
+	AddTriangle(uvs, indices, 10.f, 13.f, 2.f, 12.f);
+
+	// A mask that failed to load keeps every triangle alpha tested, as do uvs that are not finite
+	const TriangleOpacityResult result = ClassifyTriangleOpacity(OpacityMask{}, uvs, indices, 128, 1);
+	CHECK(result.triangles == std::vector<TriangleOpacity>(2, TriangleOpacity::Mixed));
+	CHECK(result.counts[static_cast<size_t>(TriangleOpacity::Mixed)] == 2);
+
+	uvs[0].x = NAN;
+	const TriangleOpacityResult nanResult = ClassifyTriangleOpacity(MakeHalfOpaqueMask(), uvs, indices, 128, 1);
+	CHECK(nanResult.triangles[0] == TriangleOpacity::Mixed);
+	CHECK(nanResult.triangles[1] == TriangleOpacity::Transparent);
+}
+
+TEST_CASE(TriangleOpacityThreadCountAgnostic)
+{
+	// Noisy mask with clusters, and triangles of every size up to a fifth of it
+	std::mt19937 rng(17);
+	OpacityMask mask;
+	mask.width = 64;
+	mask.height = 32;
+	for (uint32_t y = 0; y < mask.height; y++)
+	{
+		for (uint32_t x = 0; x < mask.width; x++)
+		{
+			mask.texels.push_back(((x / 5 + y / 3) % 3 == 0 || rng() % 17 == 0) ? 0 : 255);
+		}
+	}
+
+	std::uniform_real_distribution<float> position(-0.5f, 1.5f), size(0.f, 0.2f);
+	std::vector<Vec2> uvs;
+	std::vector<uint32_t> indices;
+	for (uint32_t triIdx = 0; triIdx < 5000; triIdx++)
+	{
+		const Vec2 corner = { position(rng), position(rng) };
+		for (int vertex = 0; vertex < 3; vertex++)
+		{
+			indices.push_back(static_cast<uint32_t>(uvs.size()));
+			uvs.push_back({ corner.x + size(rng), corner.y + size(rng) });
+		}
+	}
+
+	const TriangleOpacityResult serial = ClassifyTriangleOpacity(mask, uvs, indices, 128, 1);
+	const TriangleOpacityResult threaded = ClassifyTriangleOpacity(mask, uvs, indices, 128, 4);
+	TaskScheduler scheduler(3);
+	const TriangleOpacityResult scheduled = ClassifyTriangleOpacity(mask, uvs, indices, 128, scheduler);
+
+	CHECK(threaded.triangles == serial.triangles);
+	CHECK(scheduled.triangles == serial.triangles);
+	for (size_t opacity = 0; opacity < static_cast<size_t>(TriangleOpacity::Count); opacity++)
+	{
+		CHECK(serial.counts[opacity] > 0);
+		CHECK(threaded.counts[opacity] == serial.counts[opacity]);
+		CHECK(scheduled.counts[opacity] == serial.counts[opacity]);
+	}
+}
+
+TEST_CASE(TriangleOpacityPartition)
+{
+	std::vector<uint32_t> indices = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14 };
+	const std::vector<TriangleOpacity> opacity = {
+		TriangleOpacity::Opaque,
+		TriangleOpacity::Mixed,
+		TriangleOpacity::Transparent,
+		TriangleOpacity::Opaque,
+		TriangleOpacity::Mixed };
+
+	// Alpha tested triangles first and opaque ones after, each in their original order, with the transparent one gone
+	CHECK(PartitionTrianglesByOpacity(indices, opacity) == 2);
+	CHECK(indices == std::vector<uint32_t>({ 3, 4, 5, 12, 13, 14, 0, 1, 2, 9, 10, 11 }));
+
+	std::vector<uint32_t> transparent = { 0, 1, 2 };
+	CHECK(PartitionTrianglesByOpacity(transparent, { TriangleOpacity::Transparent }) == 0);
+	CHECK(transparent.empty());
+}
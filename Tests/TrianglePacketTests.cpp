@@ -0,0 +1,219 @@
+#include "Test.h"
+#include "TestScene.h"
+
+#include "TrianglePacket.h"
+
+#include <cmath>
+#include <random>
+#include <vector>
+
+namespace
+{
+	std::vector<SimdIsa> GetSupportedIsas()
+	{
+		std::vector<SimdIsa> isas;
+		for (const SimdIsa isa : { SimdIsa::Scalar, SimdIsa::Sse, SimdIsa::Avx2 })
+		{
+			if (IsSimdIsaSupported(isa))
+			{
+				isas.push_back(isa);
+			}
+		}
+
+		return isas;
+	}
+
+	std::vector<TrianglePacket> MakePackets(const std::vector<WorldTriangle>& triangles)
+	{
+		std::vector<TrianglePacket> packets((triangles.size() + k_trianglePacketWidth - 1) / k_trianglePacketWidth);
+		for (size_t triangleIndex = 0; triangleIndex < triangles.size(); triangleIndex++)
+		{
+			const WorldTriangle& triangle = triangles[triangleIndex];
+			SetTrianglePacketLane(
+				packets[triangleIndex / k_trianglePacketWidth],
+				triangleIndex % k_trianglePacketWidth,
+				triangle.vertices[0],
+				triangle.vertices[1],
+				triangle.vertices[2]);
+		}
+
+		return packets;
+	}
+
+	Vec3 Normalize(const Vec3& v)
+	{
+		return v * (1.f / Length(v));
+	}
+}
+
+TEST_CASE(TrianglePacketMatchesDoubleReference)
+{
+	for (const SimdIsa isa : GetSupportedIsas())
+	{
+		const IntersectTrianglePacketsFunc intersect = GetIntersectTrianglePackets(isa);
+
+		std::mt19937 rng(5);
+		std::uniform_real_distribution<float> random(-1.f, 1.f);
+
+		size_t hitCount = 0;
+		size_t mismatchCount = 0;
+		for (uint32_t iteration = 0; iteration < 20000; iteration++)
+		{
+			// Leaves of one to two packets, with triangles that overlap and face either way
+			std::vector<WorldTriangle> triangles(1 + iteration % 8);
+			for (uint32_t triangleIndex = 0; triangleIndex < triangles.size(); triangleIndex++)
+			{
+				for (Vec3& vertex : triangles[triangleIndex].vertices)
+				{
+					vertex = { random(rng), random(rng), random(rng) };
+				}
+
+				triangles[triangleIndex].materialIndex = triangleIndex;
+			}
+
+			const Vec3 origin = { random(rng) * 3.f, random(rng) * 3.f, random(rng) * 3.f };
+			const Vec3 target = { random(rng) * 0.5f, random(rng) * 0.5f, random(rng) * 0.5f };
+			const Vec3 direction = Normalize(target - origin);
+			const float tMin = iteration % 2 ? 0.f : 1.f;
+
+			const std::vector<TrianglePacket> packets = MakePackets(triangles);
+			float tMax = 1e30f;
+			TrianglePacketHit hit;
+			const bool bHit = intersect(packets.data(), static_cast<uint32_t>(triangles.size()), WatertightRay::Make(origin, direction), tMin, tMax, hit);
+
+			const ReferenceHit reference = IntersectReference(triangles, origin, direction, tMin, 1e30f);
+			if (reference.bAmbiguous)
+			{
+				continue;
+			}
+
+			hitCount += bHit;
+			if (bHit != (reference.materialIndex >= 0))
+			{
+				mismatchCount++;
+			}
+			else if (bHit)
+			{
+				const bool bMatches =
+					hit.triangle == static_cast<uint32_t>(reference.materialIndex) &&
+					tMax == hit.t &&
+					std::abs(hit.t - reference.t) <= 1e-5 * reference.t &&
+					std::abs(hit.u - reference.u) <= 1e-4 &&
+					std::abs(hit.v - reference.v) <= 1e-4;
+				mismatchCount += !bMatches;
+			}
+		}
+
+		CHECK(hitCount > 5000);
+		CHECK(mismatchCount == 0);
+	}
+}
+
+TEST_CASE(TrianglePacketIsWatertight)
+{
+	// Jittered, bumpy grid of triangles that share their edges and vertices
+	constexpr uint32_t k_gridSize = 24;
+	std::mt19937 rng(3);
+	std::uniform_real_distribution<float> random(-1.f, 1.f);
+
+	std::vector<Vec3> vertices;
+	for (uint32_t y = 0; y <= k_gridSize; y++)
+	{
+		for (uint32_t x = 0; x <= k_gridSize; x++)
+		{
+			const bool bBorder = x == 0 || y == 0 || x == k_gridSize || y == k_gridSize;
+			const float jitterX = bBorder ? 0.f : random(rng) * 0.3f;
+			const float jitterY = bBorder ? 0.f : random(rng) * 0.3f;
+			vertices.push_back({ (x + jitterX) * 0.37f - 4.f, (y + jitterY) * 0.41f - 5.f, 5.f + 0.3f * std::sin(x * 0.7f) * std::cos(y * 0.3f) });
+		}
+	}
+
+	auto vertex = [&vertices](const uint32_t x, const uint32_t y) { return vertices[y * (k_gridSize + 1) + x]; };
+
+	std::vector<WorldTriangle> triangles;
+	for (uint32_t y = 0; y < k_gridSize; y++)
+	{
+		for (uint32_t x = 0; x < k_gridSize; x++)
+		{
+			triangles.push_back({ { vertex(x, y), vertex(x + 1, y), vertex(x, y + 1) }, 0 });
+			triangles.push_back({ { vertex(x + 1, y), vertex(x + 1, y + 1), vertex(x, y + 1) }, 0 });
+		}
+	}
+
+	const std::vector<TrianglePacket> packets = MakePackets(triangles);
+
+	// Rays from either side of the grid, aimed exactly at its inner vertices and at points on its inner edges. They are
+	// steeper than the bumps, since a ray that only touches the surface at a silhouette may miss it.
+	std::uniform_real_distribution<float> along(0.f, 1.f);
+	std::vector<WatertightRay> rays;
+	for (uint32_t y = 1; y < k_gridSize; y++)
+	{
+		for (uint32_t x = 1; x < k_gridSize; x++)
+		{
+			const Vec3 v = vertex(x, y);
+			const Vec3 right = vertex(x + 1, y);
+			const Vec3 up = vertex(x, y + 1);
+			const Vec3 targets[] = { v, v + (right - v) * along(rng), v + (up - v) * along(rng), right + (up - right) * along(rng) };
+
+			for (const Vec3& target : targets)
+			{
+				const float side = rays.size() % 2 ? 1.f : -1.f;
+				const Vec3 origin = { random(rng) * 8.f, random(rng) * 8.f, 5.f + side * (17.5f + random(rng) * 2.5f) };
+				rays.push_back(WatertightRay::Make(origin, Normalize(target - origin)));
+			}
+		}
+	}
+
+	for (const SimdIsa isa : GetSupportedIsas())
+	{
+		const IntersectTrianglePacketsFunc intersect = GetIntersectTrianglePackets(isa);
+
+		size_t missCount = 0;
+		for (const WatertightRay& ray : rays)
+		{
+			float tMax = 1e30f;
+			TrianglePacketHit hit;
+			missCount += !intersect(packets.data(), static_cast<uint32_t>(triangles.size()), ray, 0.f, tMax, hit);
+		}
+
+		CHECK(missCount == 0);
+	}
+}
+
+TEST_CASE(TrianglePacketHitRange)
+{
+	// Triangle facing away from the ray at z = 5, and a closer one in the lane past the triangle count
+	const Vec3 origin = { 0.f, 0.f, 0.f };
+	const WatertightRay ray = WatertightRay::Make(origin, { 0.f, 0.f, 1.f });
+
+	TrianglePacket packet = {};
+	SetTrianglePacketLane(packet, 0, { -1.f, -1.f, 5.f }, { -1.f, 2.f, 5.f }, { 2.f, -1.f, 5.f });
+	SetTrianglePacketLane(packet, 1, { -1.f, -1.f, 2.f }, { 2.f, -1.f, 2.f }, { -1.f, 2.f, 2.f });
+
+	for (const SimdIsa isa : GetSupportedIsas())
+	{
+		const IntersectTrianglePacketsFunc intersect = GetIntersectTrianglePackets(isa);
+
+		float tMax = 1e30f;
+		TrianglePacketHit hit;
+		CHECK(intersect(&packet, 1, ray, 0.f, tMax, hit));
+		CHECK(hit.triangle == 0);
+		CHECK(hit.t == 5.f);
+		CHECK(tMax == 5.f);
+		CHECK(std::abs(hit.u - 1.f / 3.f) < 1e-6f && std::abs(hit.v - 1.f / 3.f) < 1e-6f);
+
+		// Hits closer than tMin and not closer than tMax are ignored
+		tMax = 1e30f;
+		CHECK(!intersect(&packet, 1, ray, 5.5f, tMax, hit));
+		CHECK(tMax == 1e30f);
+
+		tMax = 5.f;
+		CHECK(!intersect(&packet, 1, ray, 0.f, tMax, hit));
+
+		// Both lanes
+		tMax = 1e30f;
+		CHECK(intersect(&packet, 2, ray, 0.f, tMax, hit));
+		CHECK(hit.triangle == 1);
+		CHECK(hit.t == 2.f);
+	}
+}
@@ -0,0 +1,238 @@
+#include "Test.h"
+
+#include "TriangleSplit.h"
+
+#include <cmath>
+#include <vector>
+
+namespace
+{
+	// Positions of the input vertices followed by the ones the split created
+	std::vector<Vec3> ResolvePositions(const std::vector<Vec3>& positions, const TriangleSplitResult& result)
+	{
+		std::vector<Vec3> resolved = positions;
+		for (const SplitVertex& vertex : result.newVertices)
+		{
+			resolved.push_back((resolved[vertex.a] + resolved[vertex.b]) * 0.5f);
+		}
+
+		return resolved;
+	}
+
+	// Number of output vertices that lie inside an edge of an output triangle without being one of its ends, ie.
+	// T-junctions
+	size_t CountTJunctions(const std::vector<Vec3>& positions, const std::vector<uint32_t>& indices)
+	{
+		size_t count = 0;
+		for (size_t triIdx = 0; triIdx < indices.size() / 3; triIdx++)
+		{
+			for (int e = 0; e < 3; e++)
+			{
+				const Vec3& a = positions[indices[3 * triIdx + e]];
+				const Vec3& b = positions[indices[3 * triIdx + (e + 1) % 3]];
+				const Vec3 edge = b - a;
+				const float lengthSquared = Dot(edge, edge);
+
+				for (const uint32_t v : indices)
+				{
+					const Vec3 d = positions[v] - a;
+					const float t = Dot(d, edge) / lengthSquared;
+					if (t > 1e-4f && t < 1.f - 1e-4f && Length(d - edge * t) < 1e-5f * std::sqrt(lengthSquared))
+					{
+						count++;
+						break;
+					}
+				}
+			}
+		}
+
+		return count;
+	}
+
+	struct SplitTestMesh
+	{
+		std::vector<Vec3> positions;
+		std::vector<uint32_t> indices;
+	};
+
+	// Bumpy grid of long thin triangles running diagonally to the axes. The triangles of the columns past the middle
+	// have their own copy of the vertices along it, like a uv seam, which the long edges of the middle column run along.
+	SplitTestMesh MakeDiagonalGrid(const uint32_t columns, const uint32_t rows)
+	{
+		SplitTestMesh mesh;
+		auto position = [](const uint32_t column, const uint32_t row)
+		{
+			return Vec3{ row * 4.f + column * 0.3f, row * 4.f - column * 0.3f, 0.2f * std::sin(1.7f * row + 0.9f * column) };
+		};
+
+		for (uint32_t row = 0; row <= rows; row++)
+		{
+			for (uint32_t column = 0; column <= columns; column++)
+			{
+				mesh.positions.push_back(position(column, row));
+			}
+		}
+
+		const uint32_t seamColumn = columns / 2;
+		const uint32_t seamBase = static_cast<uint32_t>(mesh.positions.size());
+		for (uint32_t row = 0; row <= rows; row++)
+		{
+			mesh.positions.push_back(position(seamColumn, row));
+		}
+
+		auto vertex = [&](const uint32_t column, const uint32_t row, const uint32_t cellColumn)
+		{
+			return (column == seamColumn && cellColumn >= seamColumn) ? seamBase + row : row * (columns + 1) + column;
+		};
+
+		for (uint32_t row = 0; row < rows; row++)
+		{
+			for (uint32_t column = 0; column < columns; column++)
+			{
+				const uint32_t v00 = vertex(column, row, column);
+				const uint32_t v10 = vertex(column + 1, row, column);
+				const uint32_t v01 = vertex(column, row + 1, column);
+				const uint32_t v11 = vertex(column + 1, row + 1, column);
+				mesh.indices.insert(mesh.indices.end(), { v00, v10, v11, v00, v11, v01 });
+			}
+		}
+
+		return mesh;
+	}
+
+	Vec3 TriangleNormal(const std::vector<Vec3>& positions, const uint32_t* triangle)
+	{
+		return Cross(positions[triangle[1]] - positions[triangle[0]], positions[triangle[2]] - positions[triangle[0]]);
+	}
+}
+
+TEST_CASE(TriangleSplitAcrossSeams)
+{
+	// A long thin triangle along a diagonal, and a right triangle on the other side of it that is not worth splitting
+	// on its own. The second has its own vertices at the ends of the diagonal, as a mesh imported with a uv seam there
+	// would.
+	const std::vector<Vec3> positions = {
+		{ 0.f, 0.f, 0.f }, { 10.f, 10.f, 0.f }, { 5.5f, 4.5f, 0.f },
+		{ 0.f, 0.f, 0.f }, { 10.f, 10.f, 0.f }, { 0.f, 10.f, 0.f } };
+	const std::vector<uint32_t> indices = { 0, 1, 2, 3, 5, 4 };
+
+	TriangleSplitSettings settings;
+	settings.triangleBudget = 1.f;
+	const TriangleSplitResult result = SplitOversizedTriangles(positions, indices, settings);
+
+	// The diagonal is bisected on both sides, each with a vertex of its own
+	CHECK(result.indices.size() / 3 == 4);
+	CHECK(result.newVertices.size() == 2);
+	if (result.newVertices.size() == 2)
+	{
+		const SplitVertex& first = result.newVertices[0];
+		const SplitVertex& second = result.newVertices[1];
+		CHECK((first.a == 0 && first.b == 1) || (first.a == 1 && first.b == 0));
+		CHECK((second.a == 3 && second.b == 4) || (second.a == 4 && second.b == 3));
+	}
+
+	CHECK(result.sourceTriangles == std::vector<uint32_t>({ 0, 0, 1, 1 }));
+	CHECK(CountTJunctions(ResolvePositions(positions, result), result.indices) == 0);
+
+	// Every piece indexes the vertices of its own side of the seam
+	for (size_t triIdx = 0; triIdx < result.sourceTriangles.size(); triIdx++)
+	{
+		for (int corner = 0; corner < 3; corner++)
+		{
+			const uint32_t v = result.indices[3 * triIdx + corner];
+			const bool bFirstSide = v < 3 || v == 6;
+			CHECK(bFirstSide == (result.sourceTriangles[triIdx] == 0));
+		}
+	}
+}
+
+TEST_CASE(TriangleSplitKeepsMeshWatertight)
+{
+	const SplitTestMesh mesh = MakeDiagonalGrid(6, 5);
+	const size_t triangleCount = mesh.indices.size() / 3;
+
+	TriangleSplitSettings settings;
+	settings.triangleBudget = 1.f;
+	const TriangleSplitResult result = SplitOversizedTriangles(mesh.positions, mesh.indices, settings);
+	CHECK(result.indices.size() / 3 > triangleCount);
+
+	const std::vector<Vec3> positions = ResolvePositions(mesh.positions, result);
+	CHECK(CountTJunctions(positions, result.indices) == 0);
+
+	// The pieces of each triangle add up to it and face the same way
+	std::vector<double> sourceArea(triangleCount, 0.0);
+	size_t flippedCount = 0;
+	for (size_t triIdx = 0; triIdx < result.sourceTriangles.size(); triIdx++)
+	{
+		const uint32_t sourceIdx = result.sourceTriangles[triIdx];
+		const Vec3 normal = TriangleNormal(positions, &result.indices[3 * triIdx]);
+		sourceArea[sourceIdx] += 0.5 * Length(normal);
+		flippedCount += Dot(normal, TriangleNormal(mesh.positions, &mesh.indices[3 * sourceIdx])) <= 0.f;
+	}
+
+	CHECK(flippedCount == 0);
+	for (size_t sourceIdx = 0; sourceIdx < triangleCount; sourceIdx++)
+	{
+		const double area = 0.5 * Length(TriangleNormal(mesh.positions, &mesh.indices[3 * sourceIdx]));
+		CHECK(std::abs(sourceArea[sourceIdx] - area) <= 1e-4 * area);
+	}
+}
+
+TEST_CASE(TriangleSplitBudgetAndOrder)
+{
+	const SplitTestMesh mesh = MakeDiagonalGrid(8, 6);
+	const size_t triangleCount = mesh.indices.size() / 3;
+
+	for (const float triangleBudget : { 0.f, 0.1f, 0.25f, 2.f })
+	{
+		TriangleSplitSettings settings;
+		settings.triangleBudget = triangleBudget;
+		const TriangleSplitResult result = SplitOversizedTriangles(mesh.positions, mesh.indices, settings);
+
+		const size_t outputCount = result.indices.size() / 3;
+		CHECK(outputCount <= triangleCount + static_cast<size_t>(triangleBudget * triangleCount));
+		CHECK(result.sourceTriangles.size() == outputCount);
+		CHECK((triangleBudget == 0.f) == (outputCount == triangleCount));
+
+		// Sorted by source, with every input triangle present, so that a prefix of the input, eg. the alpha tested
+		// triangles, stays a prefix of the output
+		bool bOrdered = result.sourceTriangles.front() == 0 && result.sourceTriangles.back() == triangleCount - 1;
+		for (size_t triIdx = 1; triIdx < result.sourceTriangles.size(); triIdx++)
+		{
+			const uint32_t step = result.sourceTriangles[triIdx] - result.sourceTriangles[triIdx - 1];
+			bOrdered &= step == 0 || step == 1;
+		}
+
+		CHECK(bOrdered);
+	}
+
+	// Triangles whose box is small next to their area are left alone
+	TriangleSplitSettings settings;
+	settings.minBoundsToAreaRatio = 1000.f;
+	const TriangleSplitResult unchanged = SplitOversizedTriangles(mesh.positions, mesh.indices, settings);
+	CHECK(unchanged.indices == mesh.indices);
+	CHECK(unchanged.newVertices.empty());
+}
+
+TEST_CASE(TriangleSplitDeterministic)
+{
+	const SplitTestMesh mesh = MakeDiagonalGrid(8, 6);
+
+	TriangleSplitSettings settings;
+	settings.triangleBudget = 0.5f;
+	const TriangleSplitResult first = SplitOversizedTriangles(mesh.positions, mesh.indices, settings);
+	const TriangleSplitResult second = SplitOversizedTriangles(mesh.positions, mesh.indices, settings);
+
+	CHECK(first.indices == second.indices);
+	CHECK(first.sourceTriangles == second.sourceTriangles);
+	CHECK(first.newVertices.size() == second.newVertices.size());
+	bool bSameVertices = first.newVertices.size() == second.newVertices.size();
+	for (size_t vertexIdx = 0; bSameVertices && vertexIdx < first.newVertices.size(); vertexIdx++)
+	{
+		const SplitVertex& a = first.newVertices[vertexIdx];
+		const SplitVertex& b = second.newVertices[vertexIdx];
+		bSameVertices = a.a == b.a && a.b == b.b;
+	}
+
+	CHECK(bSameVertices);
+}